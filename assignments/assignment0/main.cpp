@@ -8,6 +8,7 @@
 #include <ew/transform.h>
 #include <ew/cameraController.h>
 #include <ew/texture.h>
+#include <ns/glState.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -48,9 +49,8 @@ int main() {
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 	camera.fov = 60.0f; //Vertical field of view, in degrees
 	
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK); //Back face culling
-	glEnable(GL_DEPTH_TEST); //Depth testing
+	ns::setCullState(true, GL_BACK); //Back face culling
+	ns::setDepthState(true, GL_LESS, true); //Depth testing
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -70,7 +70,7 @@ int main() {
 		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
 
 		//Bind rock texture to texture unit 0 
-		glBindTextureUnit(0, rockTexture);
+		ns::bindTextureUnit(0, rockTexture);
 
 		shader.use();
 		shader.setInt("_MainTex", 0); //Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
@@ -119,7 +119,7 @@ void drawUI() {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	ns::setViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
 }
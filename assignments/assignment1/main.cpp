@@ -9,6 +9,7 @@
 #include <ew/cameraController.h>
 #include <ew/texture.h>
 #include <ns/framebuffer.h>
+#include <ns/glState.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -64,11 +65,10 @@ int main() {
 
     if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
         printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete!");
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    ns::bindFramebuffer(0);
 
-    glEnable(GL_CULL_FACE);
-    glCullFace(GL_BACK); //Back face culling
-    glEnable(GL_DEPTH_TEST); //Depth testing
+    ns::setCullState(true, GL_BACK); //Back face culling
+    ns::setDepthState(true, GL_LESS, true); //Depth testing
 
     while (!glfwWindowShouldClose(window)) {
         glfwPollEvents();
@@ -78,7 +78,7 @@ int main() {
         prevFrameTime = time;
 
         //First pass render to offscren frame buffer
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+        ns::bindFramebuffer(framebuffer.fbo);
         glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -89,7 +89,7 @@ int main() {
         monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
 
         //Bind rock texture to texture unit 0
-        glBindTextureUnit(0, rockTexture);
+        ns::bindTextureUnit(0, rockTexture);
 
         shader.use();
         shader.setInt("_MainTex", 0); //Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
@@ -103,7 +103,7 @@ int main() {
         monkeyModel.draw(); //Draws the monkey model using current shader
 
         //Second pass render to screen
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        ns::bindFramebuffer(0);
         glClearColor(0.6f, 0.8f, 0.92f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -113,8 +113,8 @@ int main() {
         postProcessShader.setFloat("bOffset", chromaticAberration.bOffset);
         postProcessShader.setInt("effectOn", chromaticAberration.effectOn);
 
-        glBindTextureUnit(0, framebuffer.colorBuffer[0]);
-        glBindVertexArray(dummyVAO);
+        ns::bindTextureUnit(0, framebuffer.colorBuffer[0]);
+        ns::bindVertexArray(dummyVAO);
         glDrawArrays(GL_TRIANGLES, 0, 3);
 
         drawUI();
@@ -160,7 +160,7 @@ void drawUI() {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-    glViewport(0, 0, width, height);
+    ns::setViewport(0, 0, width, height);
     screenWidth = width;
     screenHeight = height;
 }
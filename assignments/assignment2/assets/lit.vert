@@ -14,9 +14,6 @@ out Surface{
 	vec2 TexCoord;
 }vs_out;
 
-uniform mat4 _LightViewProj; //view + projection of light source camera
-out vec4 LightSpacePos; //Sent to fragment shader
-
 void main(){
 	//Transform vertex position to World Space.
 	vs_out.WorldPos = vec3(_Model * vec4(vPos,1.0));
@@ -25,6 +22,4 @@ void main(){
 	vs_out.TexCoord = vTexCoord;
 	//Set vertex position in homogeneous clip space
 	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
-
-	LightSpacePos = _LightViewProj * _Model * vec4(vPos, 1.0);
 }
@@ -10,7 +10,10 @@
 #include <ew/texture.h>
 #include <ew/procGen.h>
 #include <ns/framebuffer.h>
-#include <ns/shadowMap.h>
+#include <ns/glState.h>
+#include <ns/cascadedShadowMap.h>
+#include <ns/culling.h>
+#include <ns/gpuTimer.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -30,12 +33,18 @@ float deltaTime;
 //Camera
 ew::Camera camera;
 ew::CameraController cameraController;
-ew::Camera shadowCamera;
 
 //Shadow Map Variables
-int shadowMapWidth = 2048;
-int shadowMapHeight = 2048;
-ns::ShadowMap shadowMap;
+//4 cascades of 1024x1024 take the same memory as the single 2048x2048 map they replace
+const int SHADOW_CASCADE_RESOLUTION = 1024;
+const int SHADOW_CASCADE_COUNT = 4;
+ns::CascadedShadowMap shadowMap;
+float shadowDistance = 40.0f; //Nothing is shadowed further than this from the camera
+float shadowCasterDistance = 20.0f; //How far towards the light casters are picked up
+bool showCascades = false;
+int shadowMapDebugCascade = 0; //Layer shown in the Shadow Map window
+ns::GpuTimer shadowPassTimer;
+float staticRedrawRate = 0.0f; //Smoothed numStaticRedraws, stays near zero while flying when the cache works
 
 struct Material {
 	float Ka = 1.0;
@@ -61,6 +70,15 @@ int main() {
 	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
 	ew::Shader postProcessShader = ew::Shader("assets/postProcess.vert", "assets/postProcess.frag");
 	ew::Shader depthOnlyShader = ew::Shader("assets/depthOnly.vert", "assets/depthOnly.frag");
+	ew::Shader shadowResampleShader = ew::Shader("assets/postProcess.vert", "assets/shadowResample.frag");
+	//Per cascade array elements, resolved once instead of building their names every frame
+	ew::UniformHandle cascadeViewProjUniforms[SHADOW_CASCADE_COUNT];
+	ew::UniformHandle cascadeSplitUniforms[SHADOW_CASCADE_COUNT];
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		cascadeViewProjUniforms[i] = shader.uniform("_CascadeViewProj[" + std::to_string(i) + "]");
+		cascadeSplitUniforms[i] = shader.uniform("_CascadeSplits[" + std::to_string(i) + "]");
+	}
 	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
 	ew::Transform monkeyTransform;
 
@@ -74,24 +92,16 @@ int main() {
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 	camera.fov = 60.0f; //Vertical field of view, in degrees
 
-	//Shadow Camera
-	shadowCamera.target = glm::vec3(0.0f, 0.0f, 0.0f);
-	shadowCamera.orthographic = true;
-	shadowCamera.orthoHeight = 15.0f;
-	shadowCamera.nearPlane = 0.01f;
-	shadowCamera.farPlane = 30.0f;
-	shadowCamera.aspectRatio = 1.0f;
-
 	//Create Framebuffer and shadow map
 	ns::Framebuffer framebuffer = ns::createFramebuffer(screenWidth, screenHeight, GL_RGB);
-	shadowMap = ns::createShadowMap(shadowMapWidth, shadowMapHeight);
+	shadowMap = ns::createCascadedShadowMap(SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_COUNT, true);
+	shadowPassTimer = ns::createGpuTimer();
 
 	unsigned int dummyVAO;
 	glCreateVertexArrays(1, &dummyVAO);
 	
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK); //Back face culling
-	glEnable(GL_DEPTH_TEST); //Depth testing
+	ns::setCullState(true, GL_BACK); //Back face culling
+	ns::setDepthState(true, GL_LESS, true); //Depth testing
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -100,45 +110,62 @@ int main() {
 		deltaTime = time - prevFrameTime;
 		prevFrameTime = time;
 
+		//Camera Controller. Moved before the shadow pass so the cascades are fit to this frame's view
+		cameraController.move(window, &camera, deltaTime);
+
 		//RENDER
-		//Shadow Map
-		glCullFace(GL_FRONT);
-		glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
-		glViewport(0, 0, shadowMapWidth, shadowMapHeight);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		
-		shadowCamera.position = (shadowCamera.target - glm::normalize(light.lightDirection)) * 5.0f;
-		depthOnlyShader.use();
-		depthOnlyShader.setMat4("_ViewProjection", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-		glCullFace(GL_BACK);
-		depthOnlyShader.setMat4("_Model", monkeyTransform.modelMatrix());
-		monkeyModel.draw();
-		depthOnlyShader.setMat4("_Model", planeTransform.modelMatrix());
-		planeMesh.draw();
+		//Shadow Map, each cascade only draws the casters inside its own frustum.
+		//The plane is static and cached, the monkey is drawn over it every frame while it spins
+		ns::beginGpuTimer(&shadowPassTimer);
+		ns::updateCascades(&shadowMap, camera, light.lightDirection, shadowDistance, shadowCasterDistance);
+		for (unsigned int cascade = 0; cascade < shadowMap.numCascades; cascade++)
+		{
+			if (ns::beginStaticCascade(&shadowMap, cascade)) {
+				if (ns::isBoundsVisible(shadowMap.staticFrustums[cascade], planeTransform.modelMatrix(), planeMesh.getBounds())) {
+					depthOnlyShader.use();
+					depthOnlyShader.setMat4("_ViewProjection", shadowMap.staticViewProjections[cascade]);
+					depthOnlyShader.setMat4("_Model", planeTransform.modelMatrix());
+					planeMesh.draw();
+				}
+			}
+			bool monkeyVisible = ns::isBoundsVisible(shadowMap.frustums[cascade], monkeyTransform.modelMatrix(), monkeyModel.getBounds());
+			if (ns::beginDynamicCascade(&shadowMap, cascade, monkeyVisible, shadowResampleShader)) {
+				depthOnlyShader.use();
+				depthOnlyShader.setMat4("_ViewProjection", shadowMap.viewProjections[cascade]);
+				depthOnlyShader.setMat4("_Model", monkeyTransform.modelMatrix());
+				monkeyModel.draw();
+			}
+		}
+		ns::endGpuTimer(&shadowPassTimer);
+		staticRedrawRate = glm::mix(staticRedrawRate, (float)shadowMap.numStaticRedraws, 0.05f);
 
 		//Offscreen Framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
-		glViewport(0, 0, screenWidth, screenHeight);
+		ns::bindFramebuffer(framebuffer.fbo);
+		ns::setViewport(0, 0, screenWidth, screenHeight);
 		glClearColor(0.6f,0.8f,0.92f,1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//Camera Controller
-		cameraController.move(window, &camera, deltaTime);
-
 		//Rotate model around Y axis
 		monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
 
 		//Bind textures to texture units
-		glBindTextureUnit(0, rockTexture);
-		glBindTextureUnit(1, shadowMap.depthMap);
+		ns::bindTextureUnit(0, rockTexture);
+		ns::bindTextureUnit(1, shadowMap.depthArray);
 
 		shader.use();
 		shader.setInt("_MainTex", 0); //Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
 		shader.setMat4("_Model", monkeyTransform.modelMatrix());
 		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
 		shader.setVec3("_EyePos", camera.position);
-		shader.setMat4("_LightViewProj", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
 		shader.setInt("_ShadowMap", 1);
+		shader.setMat4("_View", camera.viewMatrix());
+		shader.setInt("_NumCascades", (int)shadowMap.numCascades);
+		shader.setInt("_ShowCascades", showCascades);
+		for (unsigned int i = 0; i < shadowMap.numCascades; i++)
+		{
+			shader.setMat4(cascadeViewProjUniforms[i], shadowMap.viewProjections[i]);
+			shader.setFloat(cascadeSplitUniforms[i], shadowMap.splitDepths[i]);
+		}
 		//Light
 		shader.setVec3("_Light.LightDirection", light.lightDirection);
 		shader.setVec3("_Light.LightColor", light.lightColor);
@@ -156,11 +183,11 @@ int main() {
 		planeMesh.draw();
 
 		//Scene
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		ns::bindFramebuffer(0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		postProcessShader.use();
-		glBindTextureUnit(0, framebuffer.colorBuffer[0]);
-		glBindVertexArray(dummyVAO);
+		ns::bindTextureUnit(0, framebuffer.colorBuffer[0]);
+		ns::bindVertexArray(dummyVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 3);
 
 		drawUI();
@@ -196,12 +223,23 @@ void drawUI() {
 		ImGui::SliderFloat("Min Bias", &minBias, 0.001f, 0.05f);
 		ImGui::SliderFloat("Max Bias", &maxBias, 0.001f, 0.05f);
 	}
+	if (ImGui::CollapsingHeader("Shadows")) {
+		ImGui::SliderFloat("Shadow distance", &shadowDistance, 5.0f, 100.0f);
+		ImGui::SliderFloat("Split lambda", &shadowMap.splitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Caster distance", &shadowCasterDistance, 0.0f, 50.0f);
+		ImGui::Checkbox("Show cascades", &showCascades);
+		ImGui::Checkbox("Cache static casters", &shadowMap.cacheEnabled);
+		ImGui::Text("%u x %dx%d, %zu KB with cache", shadowMap.numCascades, SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION, ns::getCascadedShadowMapMemory(shadowMap) / 1024);
+		ImGui::Text("Static casters redrawn in %u / %u cascades (%.2f per frame on average)", shadowMap.numStaticRedraws, shadowMap.numCascades, staticRedrawRate);
+		ImGui::Text("Shadow pass (GPU time): %.3f ms", shadowPassTimer.ms);
+	}
 	ImGui::End();
 
 	ImGui::Begin("Shadow Map");
+	ImGui::SliderInt("Cascade", &shadowMapDebugCascade, 0, (int)shadowMap.numCascades - 1);
 	ImGui::BeginChild("Shadow Map");
 	ImVec2 windowSize = ImGui::GetWindowSize();
-	ImGui::Image((ImTextureID)shadowMap.depthMap, windowSize, ImVec2(0, 1), ImVec2(1, 0));
+	ImGui::Image((ImTextureID)(size_t)shadowMap.layerViews[shadowMapDebugCascade], windowSize, ImVec2(0, 1), ImVec2(1, 0));
 	ImGui::EndChild();
 	ImGui::End();
 
@@ -211,7 +249,7 @@ void drawUI() {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	ns::setViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
 }
@@ -16,8 +16,25 @@ struct PointLight{
 	float radius;
 	vec4 color;
 };
-#define MAX_POINT_LIGHTS 64
-uniform PointLight _PointLights[MAX_POINT_LIGHTS];
+//Written by ns::LightBuffer. The light count is a runtime value stored in front of the array
+layout(std430, binding = 0) readonly buffer PointLightBuffer{
+	uint _PointLightCount;
+	PointLight _PointLights[];
+};
+
+//Light lists per cluster, built by ns::buildClustersCPU or clusterCull.comp
+layout(std430, binding = 1) readonly buffer ClusterGridBuffer{
+	uvec2 _Clusters[]; //{offset, count} into _ClusterLightIndices
+};
+layout(std430, binding = 2) readonly buffer ClusterIndexBuffer{
+	uint _ClusterLightIndices[];
+};
+//0 = loop over every light, 1 = clustered lists, 2 = none (drawn as light volumes)
+uniform int _PointLightMode;
+uniform uvec3 _ClusterDims; //tiles x, tiles y, depth slices
+uniform vec2 _ClusterDepthParams; //slice = log(depth) * x + y
+uniform float _ClusterNear;
+uniform mat4 _View;
 
 struct Material{
 	float Ka; //Ambient coefficient (0-1)
@@ -26,12 +43,18 @@ struct Material{
 	float Shininess; //Affects size of specular highlight
 };
 uniform Material _Material;
+Material material; //This pixel's material, from _Material or the packed g-buffer
 
 //layout(binding = i) can be used as an alternative to shader.setInt()
 //Each sampler will always be bound to a specific texture unit
-uniform layout(binding = 0) sampler2D _gPositions;
+uniform layout(binding = 0) sampler2D _gPositions; //Material in the packed layout
 uniform layout(binding = 1) sampler2D _gNormals;
 uniform layout(binding = 2) sampler2D _gAlbedo;
+uniform layout(binding = 4) sampler2D _gDepth;
+
+//Packed layout (ns::createPackedGBuffer) reconstructs position from depth
+uniform bool _PackedGBuffer;
+uniform mat4 _InverseViewProjection;
 
 uniform vec3 _EyePos;
 uniform mat4 _LightViewProj; //view + projection of light source camera
@@ -73,9 +96,9 @@ vec3 calcDirectionalLight(vec3 worldNormal, vec3 worldPos) {
 	vec3 toEye = normalize(_EyePos - worldPos);
 	//Blinn-phong uses half angle
 	vec3 h = normalize(toLight + toEye);
-	float specularFactor = pow(max(dot(normal,h),0.0),_Material.Shininess);
+	float specularFactor = pow(max(dot(normal,h),0.0),material.Shininess);
 	//Combination of specular and diffuse reflection
-	vec3 lightColor = (_Material.Kd * diffuseFactor + _Material.Ks * specularFactor) * _Light.LightColor;
+	vec3 lightColor = (material.Kd * diffuseFactor + material.Ks * specularFactor) * _Light.LightColor;
 
 	//Light space position
 	vec4 LightSpacePos;
@@ -86,7 +109,7 @@ vec3 calcDirectionalLight(vec3 worldNormal, vec3 worldPos) {
 	float shadow = calcShadow(_ShadowMap, LightSpacePos, bias);
 	lightColor *= 1.0 - shadow;
 
-	lightColor+=_Light.AmbientColor * _Material.Ka;
+	lightColor+=_Light.AmbientColor * material.Ka;
 	return lightColor;
 }
 
@@ -109,7 +132,7 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 worldPos){
 	//Usual blinn-phong calculations for diffuse + specular
 	float diffuseFactor = max(dot(normal,toLight),0.0);
 	vec3 h = normalize(toLight + toEye);
-	float specularFactor = pow(max(dot(normal,h),0.0),_Material.Shininess);
+	float specularFactor = pow(max(dot(normal,h),0.0),material.Shininess);
 	vec3 lightColor = (diffuseFactor + specularFactor) * vec3(light.color);
 	//Attenuation
 	float d = length(diff); //Distance to light
@@ -117,16 +140,62 @@ vec3 calcPointLight(PointLight light, vec3 normal, vec3 worldPos){
 	return lightColor;
 }
 
+//Cluster containing this pixel. Tiles come from the screen UV, slices from view space depth
+uint getClusterIndex(vec3 worldPos){
+	float depth = -(_View * vec4(worldPos,1.0)).z;
+	uint slice = 0u;
+	if(depth > _ClusterNear)
+		slice = uint(clamp(log(depth) * _ClusterDepthParams.x + _ClusterDepthParams.y, 0.0, float(_ClusterDims.z - 1u)));
+	uvec2 tile = min(uvec2(UV * vec2(_ClusterDims.xy)), _ClusterDims.xy - 1u);
+	return (slice * _ClusterDims.y + tile.y) * _ClusterDims.x + tile.x;
+}
+
+vec3 decodeOctahedral(vec2 e){
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	//Unfold the lower hemisphere
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+//World position of a screen UV and its depth buffer value
+vec3 reconstructWorldPos(vec2 uv, float depth){
+	vec4 clipPos = vec4(uv * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+	vec4 worldPos = _InverseViewProjection * clipPos;
+	return worldPos.xyz / worldPos.w;
+}
+
 void main(){
 	//Sample surface properties for this screen pixel
-	vec3 normal = texture(_gNormals,UV).xyz;
-	vec3 worldPos = texture(_gPositions,UV).xyz;
+	vec3 normal;
+	vec3 worldPos;
+	if(_PackedGBuffer){
+		vec4 packedMaterial = texture(_gPositions,UV);
+		material = Material(packedMaterial.r, packedMaterial.g, packedMaterial.b, exp2(packedMaterial.a * 11.0));
+		normal = decodeOctahedral(texture(_gNormals,UV).xy);
+		worldPos = reconstructWorldPos(UV, texture(_gDepth,UV).r);
+	}
+	else{
+		material = _Material;
+		normal = texture(_gNormals,UV).xyz;
+		worldPos = texture(_gPositions,UV).xyz;
+	}
 	vec3 albedo = texture(_gAlbedo,UV).xyz;
 
 	vec3 totalLight = vec3(0);
 	totalLight+=calcDirectionalLight(normal, worldPos);
-	for(int i=0;i<MAX_POINT_LIGHTS;i++){
-		totalLight+=calcPointLight(_PointLights[i],normal, worldPos);
+	if(_PointLightMode == 1){
+		//Only the lights that can reach this pixel's cluster
+		uvec2 cluster = _Clusters[getClusterIndex(worldPos)];
+		for(uint i=0;i<cluster.y;i++){
+			totalLight+=calcPointLight(_PointLights[_ClusterLightIndices[cluster.x + i]],normal, worldPos);
+		}
+	}
+	else if(_PointLightMode == 0){
+		for(uint i=0;i<_PointLightCount;i++){
+			totalLight+=calcPointLight(_PointLights[i],normal, worldPos);
+		}
 	}
 	
 	FragColor = vec4(albedo * totalLight,1.0);
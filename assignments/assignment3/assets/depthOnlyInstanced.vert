@@ -0,0 +1,10 @@
+#version 450
+layout (location = 0) in vec3 vPos;
+//Instance attributes (ew::InstanceData)
+layout (location = 3) in mat4 iModel;
+
+uniform mat4 _ViewProjection;
+
+void main(){
+	gl_Position = _ViewProjection * iModel * vec4(vPos,1.0);
+}
@@ -1,7 +1,9 @@
 #version 450 core
-layout(location = 0) out vec3 gPosition; //Worldspace position
-layout(location = 1) out vec3 gNormal; //Worldspace normal 
-layout(location = 2) out vec3 gAlbedo;
+//Full layout (ns::createGBuffer): world position, world normal, albedo
+//Packed layout (ns::createPackedGBuffer): material, octahedral normal, albedo. Position comes from depth
+layout(location = 0) out vec4 gTarget0; //Worldspace position, or material
+layout(location = 1) out vec4 gTarget1; //Worldspace normal, or octahedral normal
+layout(location = 2) out vec4 gAlbedo;
 
 in Surface{
 	vec3 WorldPos; 
@@ -9,9 +11,39 @@ in Surface{
 	vec3 WorldNormal;
 }fs_in;
 
+struct Material{
+	float Ka; //Ambient coefficient (0-1)
+	float Kd; //Diffuse coefficient (0-1)
+	float Ks; //Specular coefficient (0-1)
+	float Shininess; //Affects size of specular highlight
+};
+uniform Material _Material;
+
 uniform sampler2D _MainTex;
+uniform bool _PackedGBuffer;
+
+//Folds the lower hemisphere over the diagonals of the upper one
+vec2 octWrap(vec2 v){
+	return (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+//Unit vector to [0,1]^2 by projecting onto an octahedron and unfolding it into a square
+vec2 encodeOctahedral(vec3 n){
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	n.xy = n.z >= 0.0 ? n.xy : octWrap(n.xy);
+	return n.xy * 0.5 + 0.5;
+}
+
 void main(){
-	gPosition = fs_in.WorldPos;
-	gAlbedo = texture(_MainTex,fs_in.TexCoord).rgb;
-	gNormal = normalize(fs_in.WorldNormal);
-}
\ No newline at end of file
+	vec3 normal = normalize(fs_in.WorldNormal);
+	gAlbedo = vec4(texture(_MainTex,fs_in.TexCoord).rgb, 1.0);
+	if(_PackedGBuffer){
+		//Shininess up to 2048 stored logarithmically, so low exponents keep their precision in 8 bits
+		gTarget0 = vec4(_Material.Ka, _Material.Kd, _Material.Ks, log2(max(_Material.Shininess, 1.0)) / 11.0);
+		gTarget1 = vec4(encodeOctahedral(normal), 0.0, 0.0);
+	}
+	else{
+		gTarget0 = vec4(fs_in.WorldPos, 1.0);
+		gTarget1 = vec4(normal, 0.0);
+	}
+}
@@ -1,10 +1,15 @@
 #version 450 core
 //Vertex attributes
 layout(location = 0) in vec3 vPos;
+//Instance attributes (ew::InstanceData)
+layout(location = 3) in mat4 iModel;
+layout(location = 7) in vec4 iColor;
 
-uniform mat4 _Model; 
 uniform mat4 _ViewProjection;
 
+out vec3 Color;
+
 void main(){
-	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
-}
\ No newline at end of file
+	Color = iColor.rgb;
+	gl_Position = _ViewProjection * iModel * vec4(vPos,1.0);
+}
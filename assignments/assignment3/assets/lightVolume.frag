@@ -0,0 +1,94 @@
+#version 450 core
+//Shades a single point light for the pixels covered by its bounding sphere. Output is blended additively
+out vec4 FragColor;
+
+flat in uint LightIndex;
+
+struct PointLight{
+	vec3 position;
+	float radius;
+	vec4 color;
+};
+layout(std430, binding = 0) readonly buffer PointLightBuffer{
+	uint _PointLightCount;
+	PointLight _PointLights[];
+};
+
+struct Material{
+	float Ka; //Ambient coefficient (0-1)
+	float Kd; //Diffuse coefficient (0-1)
+	float Ks; //Specular coefficient (0-1)
+	float Shininess; //Affects size of specular highlight
+};
+uniform Material _Material;
+
+uniform layout(binding = 0) sampler2D _gPositions; //Material in the packed layout
+uniform layout(binding = 1) sampler2D _gNormals;
+uniform layout(binding = 2) sampler2D _gAlbedo;
+uniform layout(binding = 4) sampler2D _gDepth;
+
+uniform vec3 _EyePos;
+//Packed layout (ns::createPackedGBuffer), see deferredLit.frag
+uniform bool _PackedGBuffer;
+uniform mat4 _InverseViewProjection;
+
+//Linear falloff
+float attenuateLinear(float dist, float radius){
+	return clamp(((radius-dist)/radius), 0.0, 1.0);
+}
+
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 worldPos, float shininess){
+	vec3 diff = light.position - worldPos;
+	//Direction toward light position
+	vec3 toLight = normalize(diff);
+	vec3 toEye = normalize(_EyePos - worldPos);
+	//Usual blinn-phong calculations for diffuse + specular
+	float diffuseFactor = max(dot(normal,toLight),0.0);
+	vec3 h = normalize(toLight + toEye);
+	float specularFactor = pow(max(dot(normal,h),0.0),shininess);
+	vec3 lightColor = (diffuseFactor + specularFactor) * vec3(light.color);
+	//Attenuation
+	float d = length(diff); //Distance to light
+	lightColor*=attenuateLinear(d,light.radius);
+	return lightColor;
+}
+
+vec3 decodeOctahedral(vec2 e){
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = clamp(-n.z, 0.0, 1.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+void main(){
+	//Volumes are drawn at g-buffer resolution, so the fragment coordinate addresses the g-buffer directly
+	ivec2 texel = ivec2(gl_FragCoord.xy);
+	vec3 worldPos;
+	if(_PackedGBuffer){
+		vec2 uv = (vec2(texel) + 0.5) / vec2(textureSize(_gDepth,0));
+		vec4 clipPos = vec4(uv * 2.0 - 1.0, texelFetch(_gDepth,texel,0).r * 2.0 - 1.0, 1.0);
+		vec4 worldPos4 = _InverseViewProjection * clipPos;
+		worldPos = worldPos4.xyz / worldPos4.w;
+	}
+	else{
+		worldPos = texelFetch(_gPositions,texel,0).xyz;
+	}
+	PointLight light = _PointLights[LightIndex];
+	//The depth test only rejects surfaces behind the volume, surfaces in front are rejected here
+	vec3 diff = light.position - worldPos;
+	if(dot(diff,diff) > light.radius * light.radius)
+		discard;
+	vec3 normal;
+	float shininess;
+	if(_PackedGBuffer){
+		normal = decodeOctahedral(texelFetch(_gNormals,texel,0).xy);
+		shininess = exp2(texelFetch(_gPositions,texel,0).a * 11.0);
+	}
+	else{
+		normal = texelFetch(_gNormals,texel,0).xyz;
+		shininess = _Material.Shininess;
+	}
+	vec3 albedo = texelFetch(_gAlbedo,texel,0).xyz;
+	FragColor = vec4(albedo * calcPointLight(light, normal, worldPos, shininess),1.0);
+}
@@ -0,0 +1,25 @@
+#version 450
+//Unit sphere, drawn once per point light with instancing
+layout(location = 0) in vec3 vPos;
+
+struct PointLight{
+	vec3 position;
+	float radius;
+	vec4 color;
+};
+layout(std430, binding = 0) readonly buffer PointLightBuffer{
+	uint _PointLightCount;
+	PointLight _PointLights[];
+};
+
+uniform mat4 _ViewProjection;
+uniform float _VolumeScale; //Pushes the faceted sphere out so it fully contains the light radius
+
+flat out uint LightIndex;
+
+void main(){
+	PointLight light = _PointLights[gl_InstanceID];
+	LightIndex = gl_InstanceID;
+	vec3 worldPos = light.position + vPos * light.radius * _VolumeScale;
+	gl_Position = _ViewProjection * vec4(worldPos,1.0);
+}
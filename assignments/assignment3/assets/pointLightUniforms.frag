@@ -0,0 +1,20 @@
+#version 450
+//Only used by the uniform upload benchmark: the point light array the deferred shader had before the light SSBO
+out vec4 FragColor;
+
+struct PointLight{
+	vec3 position;
+	float radius;
+	vec4 color;
+};
+#define MAX_POINT_LIGHTS 64
+uniform PointLight _PointLights[MAX_POINT_LIGHTS];
+
+void main(){
+	//Reads every member so none of them are optimized out
+	vec4 total = vec4(0.0);
+	for(int i=0;i<MAX_POINT_LIGHTS;i++){
+		total += _PointLights[i].color * _PointLights[i].radius + vec4(_PointLights[i].position, 0.0);
+	}
+	FragColor = total;
+}
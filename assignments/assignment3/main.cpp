@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <math.h>
 #include <time.h>
+#include <chrono>
 
 #include <ew/external/glad.h>
 #include <ew/shader.h>
@@ -10,8 +11,19 @@
 #include <ew/cameraController.h>
 #include <ew/texture.h>
 #include <ew/procGen.h>
+#include <glm/gtc/constants.hpp>
 #include <ns/framebuffer.h>
+#include <ns/glState.h>
+#include <ns/renderTargetPool.h>
+#include <ns/renderGraph.h>
 #include <ns/shadowMap.h>
+#include <ns/lightBuffer.h>
+#include <ns/lightClusters.h>
+#include <ns/jobSystem.h>
+#include <ns/gpuTimer.h>
+#include <ns/geometryArena.h>
+#include <ns/occlusionCulling.h>
+#include <ns/meshCache.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -37,8 +49,38 @@ ew::Camera shadowCamera;
 int shadowMapWidth = 2048;
 int shadowMapHeight = 2048;
 ns::ShadowMap shadowMap;
-
+//Every caster here is static, so the shadow map only changes with the light or the set of casters.
+//It is redrawn for two frames after a change, since the first one is culled against the old map's Hi-Z pyramid
+bool shadowCacheEnabled = true;
+glm::mat4 cachedShadowViewProj = glm::mat4(0.0f);
+bool cachedOcclusionScene = false;
+bool cachedOcclusionCulling = false;
+int shadowCacheFrames = 0; //Frames drawn since the last change
+bool shadowMapRedrawn = true;
+
+//G-buffer and lighting target come from the pool at the window size, so they follow resizes.
+//The g-buffer is held from its geometry pass until the next frame's Hi-Z build has read its depth
+ns::RenderTargetPool renderTargets;
+ns::RenderGraph frameGraph; //Declared again every frame
 ns::Framebuffer gBuffer;
+bool packedGBuffer = false; //Layout to use from the next geometry pass
+bool gBufferPacked = false; //Layout gBuffer was acquired with
+
+//Lighting pass GPU time of both g-buffer layouts at 1080p and 4K. Rendering happens at the benchmark's resolution
+//and is scaled to the window
+const int GBUFFER_BENCHMARK_WARMUP_FRAMES = 10;
+const int GBUFFER_BENCHMARK_FRAMES = 120;
+const int GBUFFER_BENCHMARK_SIZES[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+struct GBufferBenchmark {
+	bool running = false;
+	int step = 0; //size * 2 + packed
+	int frame = 0;
+	float totalMs = 0.0f;
+	float results[2][2] = {}; //[size][packed]
+	bool restorePacked = false;
+}gBufferBenchmark;
+void updateGBufferBenchmark();
+void applyGBufferBenchmarkStep(int step);
 
 struct Material {
 	float Ka = 1.0;
@@ -53,19 +95,94 @@ struct Light {
 	glm::vec3 ambientColor = glm::vec3(0.3, 0.4, 0.46);
 }light;
 
-struct PointLight {
-	glm::vec3 position;
-	float radius;
-	glm::vec4 color;
+//Point Lights
+const int MAX_POINT_LIGHTS = 4096;
+int pointLightCount = 64;
+float pointLightSpacing = 1.0f; //Distance between neighbouring lights in the grid
+ns::PointLight pointLights[MAX_POINT_LIGHTS];
+ew::InstanceData lightOrbInstances[MAX_POINT_LIGHTS];
+ns::LightBuffer lightBuffer;
+void layoutPointLights(int count);
+void setGeometryPassUniforms(const ew::Shader& shader);
+
+//Light upload benchmark
+float lightUploadMs = 0.0f; //Smoothed CPU time of the point light upload
+
+//How the lighting pass evaluates point lights
+enum class LightingStrategy {
+	FULLSCREEN_LOOP = 0, //Full-screen triangle, every pixel loops over every light
+	FULLSCREEN_CLUSTERED = 1, //Full-screen triangle, every pixel loops over its cluster's lights
+	LIGHT_VOLUMES = 2 //One instanced sphere per light, blended additively
 };
-const int MAX_POINT_LIGHTS = 64;
-PointLight pointLights[MAX_POINT_LIGHTS];
-
-glm::vec3 positions[MAX_POINT_LIGHTS];
+const char* lightingStrategyNames[] = { "Full-screen loop", "Full-screen clustered", "Light volumes" };
+LightingStrategy lightingStrategy = LightingStrategy::FULLSCREEN_CLUSTERED;
+ns::GpuTimer lightingPassTimer;
+
+//Clustered light culling
+ns::ClusterGrid clusterGrid;
+bool gpuClusterBinning = false;
+float clusterBinningMs = 0.0f; //Smoothed CPU time of building the cluster lists
+
+//Light count sweep: measures the lighting pass of every strategy at increasing light counts
+const int SWEEP_LIGHT_COUNTS[] = { 64, 256, 1024, 4096 };
+const int SWEEP_NUM_COUNTS = 4;
+const int SWEEP_NUM_STRATEGIES = 3;
+const int SWEEP_WARMUP_FRAMES = 10; //Skipped after each switch so results from the previous configuration drain
+const int SWEEP_FRAMES = 60; //Frames averaged per configuration
+struct LightingSweep {
+	bool running = false;
+	int step = 0; //strategy * SWEEP_NUM_COUNTS + light count index
+	int frame = 0;
+	float totalMs = 0.0f;
+	float results[SWEEP_NUM_STRATEGIES][SWEEP_NUM_COUNTS] = {};
+}sweep;
+void applySweepStep(int step);
+void updateSweep();
+
+//Occlusion test scene: a grid of Suzannes behind a row of walls, under a roof that hides part of the grid from the light.
+//Everything goes through one arena with a command per object, culled on the GPU against Hi-Z pyramids of last frame's depth
+const int OCCLUSION_GRID_SIDE = 64;
+const int OCCLUSION_WALLS = 6;
+bool occlusionSceneEnabled = false;
+bool occlusionCullingEnabled = true;
+ns::GeometryArena occlusionArena;
+std::vector<ns::OcclusionBounds> occlusionBounds;
+ns::HiZPyramid cameraHiZ;
+ns::HiZPyramid shadowHiZ;
+ns::OcclusionCuller cameraCuller;
+ns::OcclusionCuller shadowCuller;
+ns::GpuTimer occlusionCullTimer; //Both pyramid builds and both culls
+ns::GpuTimer shadowPassTimer;
+ns::GpuTimer geometryPassTimer;
+void LayoutOcclusionScene(unsigned int suzanneMesh, const ew::MeshBounds& suzanneBounds, unsigned int cubeMesh, const ew::MeshBounds& cubeBounds);
+
+//Shadow + geometry pass GPU time with occlusion culling off, then on
+const int OCCLUSION_BENCHMARK_WARMUP_FRAMES = 10;
+const int OCCLUSION_BENCHMARK_FRAMES = 120;
+struct OcclusionBenchmark {
+	bool running = false;
+	int phase = 0; //0 = culling off, 1 = culling on
+	int frame = 0;
+	float totalMs = 0.0f;
+	float totalCullMs = 0.0f;
+	float passMs[2] = {};
+	float cullMs[2] = {};
+}occlusionBenchmark;
+void updateOcclusionBenchmark();
 
 float minBias = 0.005f;
 float maxBias = 0.015f;
 
+//Uniform upload benchmark, run once at startup. The per frame point light upload from before the light SSBO,
+//64 lights x 3 "_PointLights[i]." members, timed three ways: building the names and querying glGetUniformLocation
+//for each (what the setters did before locations were cached), building the names for the cached table, and handles
+const int UNIFORM_BENCHMARK_LIGHTS = 64;
+const int UNIFORM_BENCHMARK_FRAMES = 200;
+float uniformQueryMs = 0.0f; //Per frame
+float uniformNameMs = 0.0f;
+float uniformHandleMs = 0.0f;
+void benchmarkPointLightUniforms(const ew::Shader& shader);
+
 int main() {
 	GLFWwindow* window = initWindow("Assignment 3", screenWidth, screenHeight);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
@@ -76,6 +193,14 @@ int main() {
 	ew::Shader deferredShader = ew::Shader("assets/deferredLit.vert", "assets/deferredLit.frag");
 	ew::Shader depthOnlyShader = ew::Shader("assets/depthOnly.vert", "assets/depthOnly.frag");
 	ew::Shader lightOrbShader = ew::Shader("assets/lightOrb.vert", "assets/lightOrb.frag");
+	ew::Shader clusterCullShader = ew::Shader("assets/clusterCull.comp");
+	ew::Shader lightVolumeShader = ew::Shader("assets/lightVolume.vert", "assets/lightVolume.frag");
+	ew::Shader geometryInstancedShader = ew::Shader("assets/geometryPassInstanced.vert", "assets/geometryPass.frag");
+	ew::Shader depthOnlyInstancedShader = ew::Shader("assets/depthOnlyInstanced.vert", "assets/depthOnly.frag");
+	ew::Shader hiZDownsampleShader = ew::Shader("assets/hiZDownsample.comp");
+	ew::Shader occlusionCullShader = ew::Shader("assets/occlusionCull.comp");
+
+	ns::JobSystem jobSystem;
 
 	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
 	ew::Transform monkeyTransform;
@@ -84,8 +209,12 @@ int main() {
 	ew::Transform planeTransform;
 	planeTransform.position = glm::vec3(0.0f, -2.0f, 0.0f);
 
-	ew::Mesh sphereMesh = ew::Mesh(ew::createSphere(1.0f, 8));
+	const int sphereSubdivisions = 8;
+	ew::Mesh sphereMesh = ew::Mesh(ew::createSphere(1.0f, sphereSubdivisions));
 	ew::Transform sphereTransform;
+	//Faces of the faceted sphere sit inside the unit sphere by up to cos(step / 2) along both angles
+	float halfStep = glm::pi<float>() / sphereSubdivisions;
+	float lightVolumeScale = 1.0f / (cosf(halfStep) * cosf(halfStep));
 	
 	//Main Camera
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
@@ -101,36 +230,54 @@ int main() {
 	shadowCamera.farPlane = 30.0f;
 	shadowCamera.aspectRatio = 1.0f;
 
-	//Point Light
-	int n = 0;
-	for (int i = 0; i < 8; i++) {
-		for (int j = 0; j < 8; j++) {
-			positions[n] = glm::vec3((float)i, 0.0, (float)j);
-			n++;
-		}
-	}
+	//Point Lights
 	for (int i = 0; i < MAX_POINT_LIGHTS; i++)
 	{
 		float r = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 		float g = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 		float b = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
-
-		pointLights[i].position = positions[i];
-		pointLights[i].radius = 3;
 		pointLights[i].color = glm::vec4(r, g, b, 1.0f);
 	}
+	layoutPointLights(pointLightCount);
+	benchmarkPointLightUniforms(ew::Shader("assets/postProcess.vert", "assets/pointLightUniforms.frag"));
+	lightBuffer = ns::createLightBuffer(MAX_POINT_LIGHTS);
+	//16x9 tiles (120px at 1080p) x 24 depth slices
+	clusterGrid = ns::createClusterGrid(16, 9, 24, 256);
+	lightingPassTimer = ns::createGpuTimer();
 
 	//Create Framebuffers and shadow map
-	ns::Framebuffer framebuffer = ns::createFramebuffer(screenWidth, screenHeight, GL_RGB16F);
-	gBuffer = ns::createGBuffer(screenWidth, screenHeight);
+	ns::Framebuffer framebuffer; //Lighting target, acquired for the lighting pass
+	gBuffer = ns::acquireGBuffer(&renderTargets, screenWidth, screenHeight, packedGBuffer);
 	shadowMap = ns::createShadowMap(shadowMapWidth, shadowMapHeight);
 
+	//Occlusion test scene
+	occlusionArena = ns::createGeometryArena(1 << 20, 1 << 21);
+	std::vector<ew::MeshData> suzanneMeshes = ns::loadCachedMeshData("assets/suzanne.obj");
+	ew::MeshData cubeMeshData = ew::createCube(1.0f);
+	if (!suzanneMeshes.empty()) {
+		int suzanneMesh = ns::addArenaMesh(&occlusionArena, suzanneMeshes[0]);
+		int cubeMesh = ns::addArenaMesh(&occlusionArena, cubeMeshData);
+		if (suzanneMesh >= 0 && cubeMesh >= 0) {
+			ew::MeshBounds suzanneBounds = ew::computeMeshBounds(suzanneMeshes[0].vertices.data(), (unsigned int)suzanneMeshes[0].vertices.size());
+			ew::MeshBounds cubeBounds = ew::computeMeshBounds(cubeMeshData.vertices.data(), (unsigned int)cubeMeshData.vertices.size());
+			LayoutOcclusionScene(suzanneMesh, suzanneBounds, cubeMesh, cubeBounds);
+		}
+	}
+	cameraHiZ = ns::createHiZPyramid(gBuffer.width, gBuffer.height);
+	shadowHiZ = ns::createHiZPyramid(shadowMap.width, shadowMap.height);
+	cameraCuller = ns::createOcclusionCuller();
+	shadowCuller = ns::createOcclusionCuller();
+	ns::setOcclusionBounds(&cameraCuller, occlusionBounds.data(), (unsigned int)occlusionBounds.size());
+	ns::setOcclusionBounds(&shadowCuller, occlusionBounds.data(), (unsigned int)occlusionBounds.size());
+	occlusionCullTimer = ns::createGpuTimer();
+	shadowPassTimer = ns::createGpuTimer();
+	geometryPassTimer = ns::createGpuTimer();
+
 	unsigned int dummyVAO;
 	glCreateVertexArrays(1, &dummyVAO);
 	
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK); //Back face culling
-	glEnable(GL_DEPTH_TEST); //Depth testing
+	ns::setCullState(true, GL_BACK); //Back face culling
+	ns::setDepthState(true, GL_LESS, true); //Depth testing
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -139,107 +286,288 @@ int main() {
 		deltaTime = time - prevFrameTime;
 		prevFrameTime = time;
 
-		//RENDER
-		//Shadow Map
-		glCullFace(GL_FRONT);
-		glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
-		glViewport(0, 0, shadowMapWidth, shadowMapHeight);
-		glClear(GL_DEPTH_BUFFER_BIT);
+		//Size of this frame's render targets. A minimized window still gets 1x1 targets
+		unsigned int targetWidth = glm::max(screenWidth, 1);
+		unsigned int targetHeight = glm::max(screenHeight, 1);
+		if (gBufferBenchmark.running) {
+			targetWidth = GBUFFER_BENCHMARK_SIZES[gBufferBenchmark.step / 2][0];
+			targetHeight = GBUFFER_BENCHMARK_SIZES[gBufferBenchmark.step / 2][1];
+		}
 
+		//RENDER
 		shadowCamera.position = (shadowCamera.target - glm::normalize(light.lightDirection)) * 5.0f;
-		depthOnlyShader.use();
-		depthOnlyShader.setMat4("_ViewProjection", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-		glCullFace(GL_BACK);
-		depthOnlyShader.setMat4("_Model", monkeyTransform.modelMatrix());
-		monkeyModel.draw();
-		depthOnlyShader.setMat4("_Model", planeTransform.modelMatrix());
-		planeMesh.draw();
+		glm::mat4 shadowViewProj = shadowCamera.projectionMatrix() * shadowCamera.viewMatrix();
+		glm::mat4 cameraViewProj = camera.projectionMatrix() * camera.viewMatrix();
+
+		//Shadow cache. The benchmark always redraws so it keeps measuring the shadow pass
+		if (shadowViewProj != cachedShadowViewProj || occlusionSceneEnabled != cachedOcclusionScene || occlusionCullingEnabled != cachedOcclusionCulling) {
+			cachedShadowViewProj = shadowViewProj;
+			cachedOcclusionScene = occlusionSceneEnabled;
+			cachedOcclusionCulling = occlusionCullingEnabled;
+			shadowCacheFrames = 0;
+		}
+		shadowMapRedrawn = !shadowCacheEnabled || occlusionBenchmark.running || shadowCacheFrames < 2;
+		shadowCacheFrames++;
+
+		//Occlusion culling. Depth buffers still hold last frame, which is what the pyramids are built from
+		if (occlusionSceneEnabled) {
+			ns::beginGpuTimer(&occlusionCullTimer);
+			if (occlusionCullingEnabled) {
+				//Pyramid follows the size of last frame's g-buffer
+				if (cameraHiZ.width != glm::max((gBuffer.width + 1) / 2, 1u) || cameraHiZ.height != glm::max((gBuffer.height + 1) / 2, 1u)) {
+					ns::deleteHiZPyramid(&cameraHiZ);
+					cameraHiZ = ns::createHiZPyramid(gBuffer.width, gBuffer.height);
+				}
+				if (shadowMapRedrawn) {
+					ns::buildHiZPyramid(shadowHiZ, hiZDownsampleShader, shadowMap.depthMap);
+				}
+				ns::buildHiZPyramid(cameraHiZ, hiZDownsampleShader, gBuffer.depthBuffer);
+			}
+			if (shadowMapRedrawn) {
+				ns::cullOcclusion(&shadowCuller, &occlusionArena, shadowHiZ, occlusionCullShader, shadowViewProj, occlusionCullingEnabled);
+			}
+			ns::cullOcclusion(&cameraCuller, &occlusionArena, cameraHiZ, occlusionCullShader, cameraViewProj, occlusionCullingEnabled);
+			ns::endGpuTimer(&occlusionCullTimer);
+		}
+
+		//Last frame's g-buffer is done with once the Hi-Z pyramid is built, and is usually handed straight back.
+		//It is live from here to the next frame's Hi-Z build and overlaps the lighting target, so the two never share memory
+		ns::releaseFramebuffer(&renderTargets, &gBuffer);
+		gBuffer = ns::acquireGBuffer(&renderTargets, targetWidth, targetHeight, packedGBuffer);
+		gBufferPacked = packedGBuffer;
+		//Depth is only needed to depth test the light volumes
+		bool lightVolumes = lightingStrategy == LightingStrategy::LIGHT_VOLUMES;
+		framebuffer = ns::acquireFramebuffer(&renderTargets, gBuffer.width, gBuffer.height, GL_RGB16F, lightVolumes);
+
+		//Frame graph. Passes declare what they read and write, the graph binds, sets viewports and clears
+		ns::resetRenderGraph(&frameGraph);
+		unsigned int shadowDepth = ns::addGraphResource(&frameGraph, "Shadow map", ns::GraphResourceType::DEPTH, shadowMap.fbo);
+		unsigned int gBufferColor = ns::addGraphResource(&frameGraph, "G-buffer", ns::GraphResourceType::COLOR, gBuffer.fbo, gBuffer.numColorBuffers);
+		unsigned int gBufferDepth = ns::addGraphResource(&frameGraph, "G-buffer depth", ns::GraphResourceType::DEPTH, gBuffer.fbo);
+		unsigned int litColor = ns::addGraphResource(&frameGraph, "Lit color", ns::GraphResourceType::COLOR, framebuffer.fbo);
+		unsigned int litDepth = ns::addGraphResource(&frameGraph, "Lit depth", ns::GraphResourceType::DEPTH, framebuffer.fbo);
+		unsigned int windowColor = ns::addGraphResource(&frameGraph, "Window", ns::GraphResourceType::COLOR, 0);
+		unsigned int windowDepth = ns::addGraphResource(&frameGraph, "Window depth", ns::GraphResourceType::DEPTH, 0);
+		//The shadow map is cached between frames, and next frame's Hi-Z pyramid is built from the g-buffer depth
+		ns::setGraphResourcePersistent(&frameGraph, shadowDepth);
+		ns::setGraphResourcePersistent(&frameGraph, gBufferDepth);
+		ns::setGraphOutput(&frameGraph, windowColor);
+
+		//Shadow Map
+		if (shadowMapRedrawn) {
+			unsigned int pass = ns::addGraphPass(&frameGraph, "Shadow", shadowMap.fbo, shadowMapWidth, shadowMapHeight, [&]() {
+				ns::beginGpuTimer(&shadowPassTimer);
+				depthOnlyShader.use();
+				depthOnlyShader.setMat4("_ViewProjection", shadowViewProj);
+				depthOnlyShader.setMat4("_Model", monkeyTransform.modelMatrix());
+				monkeyModel.draw();
+				depthOnlyShader.setMat4("_Model", planeTransform.modelMatrix());
+				planeMesh.draw();
+				if (occlusionSceneEnabled) {
+					depthOnlyInstancedShader.use();
+					depthOnlyInstancedShader.setMat4("_ViewProjection", shadowViewProj);
+					ns::drawArenaCommands(&occlusionArena, shadowCuller.commandBuffer);
+				}
+				ns::endGpuTimer(&shadowPassTimer);
+			});
+			ns::passWrites(&frameGraph, pass, shadowDepth);
+		}
+		else {
+			//Cached, nothing to time
+			ns::beginGpuTimer(&shadowPassTimer);
+			ns::endGpuTimer(&shadowPassTimer);
+		}
 
 		//Geometry pass
-		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fbo);
-		glViewport(0, 0, gBuffer.width, gBuffer.height);
-		glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		//Bind rock texture before geometry shader
-		glBindTextureUnit(0, rockTexture);
-
-		geometryShader.use();
-		geometryShader.setInt("_MainTex", 0);
-		geometryShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		geometryShader.setMat4("_Model", monkeyTransform.modelMatrix());
-		monkeyModel.draw();
-		geometryShader.setMat4("_Model", planeTransform.modelMatrix());
-		planeMesh.draw();
+		{
+			unsigned int pass = ns::addGraphPass(&frameGraph, "Geometry", gBuffer.fbo, gBuffer.width, gBuffer.height, [&]() {
+				ns::beginGpuTimer(&geometryPassTimer);
+				//Bind rock texture before geometry shader
+				ns::bindTextureUnit(0, rockTexture);
+
+				geometryShader.use();
+				geometryShader.setInt("_MainTex", 0);
+				setGeometryPassUniforms(geometryShader);
+				geometryShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+				geometryShader.setMat4("_Model", monkeyTransform.modelMatrix());
+				monkeyModel.draw();
+				geometryShader.setMat4("_Model", planeTransform.modelMatrix());
+				planeMesh.draw();
+				if (occlusionSceneEnabled) {
+					geometryInstancedShader.use();
+					geometryInstancedShader.setInt("_MainTex", 0);
+					setGeometryPassUniforms(geometryInstancedShader);
+					geometryInstancedShader.setMat4("_ViewProjection", cameraViewProj);
+					ns::drawArenaCommands(&occlusionArena, cameraCuller.commandBuffer);
+				}
+				ns::endGpuTimer(&geometryPassTimer);
+			});
+			ns::setPassClearValues(&frameGraph, pass, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+			ns::passWrites(&frameGraph, pass, gBufferColor);
+			ns::passWrites(&frameGraph, pass, gBufferDepth);
+		}
 
 		//Draw all light orbs
-		lightOrbShader.use();
-		lightOrbShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		for (int i = 0; i < MAX_POINT_LIGHTS; i++)
 		{
-			glm::mat4 m = glm::mat4(1.0f);
-			m = glm::translate(m, pointLights[i].position);
-			m = glm::scale(m, glm::vec3(0.1f)); //Whatever radius you want
-
-			lightOrbShader.setMat4("_Model", m);
-			lightOrbShader.setVec3("_Color", pointLights[i].color);
-			sphereMesh.draw();
+			unsigned int pass = ns::addGraphPass(&frameGraph, "Light orbs", gBuffer.fbo, gBuffer.width, gBuffer.height, [&]() {
+				lightOrbShader.use();
+				lightOrbShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+				for (int i = 0; i < pointLightCount; i++)
+				{
+					glm::mat4 m = glm::mat4(1.0f);
+					m = glm::translate(m, pointLights[i].position);
+					m = glm::scale(m, glm::vec3(0.1f * pointLightSpacing)); //Whatever radius you want
+
+					lightOrbInstances[i].model = m;
+					lightOrbInstances[i].color = pointLights[i].color;
+				}
+				//All orbs in one draw call
+				sphereMesh.setInstanceData(lightOrbInstances, pointLightCount);
+				sphereMesh.drawInstanced(pointLightCount);
+			});
+			ns::passWrites(&frameGraph, pass, gBufferColor, ns::GraphWrite::LOAD);
+			ns::passWrites(&frameGraph, pass, gBufferDepth, ns::GraphWrite::LOAD);
 		}
 
 		//LIGHTING PASS
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
-		glViewport(0, 0, framebuffer.width, framebuffer.height);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		deferredShader.use();
-		//Set the lighting uniforms for deferredShader
-		deferredShader.setVec3("_EyePos", camera.position);
-		deferredShader.setMat4("_LightViewProj", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-		deferredShader.setVec3("_Light.LightDirection", light.lightDirection);
-		deferredShader.setVec3("_Light.LightColor", light.lightColor);
-		deferredShader.setVec3("_Light.AmbientColor", light.ambientColor);
-		deferredShader.setFloat("_Material.Ka", material.Ka);
-		deferredShader.setFloat("_Material.Kd", material.Kd);
-		deferredShader.setFloat("_Material.Ks", material.Ks);
-		deferredShader.setFloat("_Material.Shininess", material.Shininess);
-		deferredShader.setFloat("_MinBias", minBias);
-		deferredShader.setFloat("_MaxBias", maxBias);
-		deferredShader.setInt("_ShadowMap", 3);
-		//Set shader uniforms
-		for (int i = 0; i < MAX_POINT_LIGHTS; i++) {
-			//Creates prefix "_PointLights[0]." etc
-			std::string prefix = "_PointLights[" + std::to_string(i) + "].";
-			deferredShader.setVec3(prefix + "position", pointLights[i].position);
-			deferredShader.setFloat(prefix + "radius", pointLights[i].radius);
-			deferredShader.setVec4(prefix + "color", pointLights[i].color);
+		{
+			unsigned int pass = ns::addGraphPass(&frameGraph, "Lighting", framebuffer.fbo, framebuffer.width, framebuffer.height, [&]() {
+				ns::beginGpuTimer(&lightingPassTimer);
+				//Upload every point light in one copy and bind it once
+				auto uploadStart = std::chrono::high_resolution_clock::now();
+				ns::updateLightBuffer(&lightBuffer, pointLights, pointLightCount);
+				ns::bindLightBuffer(lightBuffer, 0);
+				std::chrono::duration<float, std::milli> uploadTime = std::chrono::high_resolution_clock::now() - uploadStart;
+				//Exponential moving average so the readout is stable
+				lightUploadMs = glm::mix(lightUploadMs, uploadTime.count(), 0.05f);
+
+				//Assign lights to clusters
+				auto binningStart = std::chrono::high_resolution_clock::now();
+				if (lightingStrategy == LightingStrategy::FULLSCREEN_CLUSTERED) {
+					if (gpuClusterBinning) {
+						ns::buildClustersGPU(&clusterGrid, clusterCullShader, camera);
+					}
+					else {
+						ns::buildClustersCPU(&clusterGrid, pointLights, pointLightCount, camera, &jobSystem);
+					}
+				}
+				std::chrono::duration<float, std::milli> binningTime = std::chrono::high_resolution_clock::now() - binningStart;
+				clusterBinningMs = glm::mix(clusterBinningMs, binningTime.count(), 0.05f);
+
+				deferredShader.use();
+				//Set the lighting uniforms for deferredShader
+				deferredShader.setVec3("_EyePos", camera.position);
+				deferredShader.setMat4("_LightViewProj", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
+				deferredShader.setVec3("_Light.LightDirection", light.lightDirection);
+				deferredShader.setVec3("_Light.LightColor", light.lightColor);
+				deferredShader.setVec3("_Light.AmbientColor", light.ambientColor);
+				deferredShader.setFloat("_Material.Ka", material.Ka);
+				deferredShader.setFloat("_Material.Kd", material.Kd);
+				deferredShader.setFloat("_Material.Ks", material.Ks);
+				deferredShader.setFloat("_Material.Shininess", material.Shininess);
+				deferredShader.setFloat("_MinBias", minBias);
+				deferredShader.setFloat("_MaxBias", maxBias);
+				deferredShader.setInt("_ShadowMap", 3);
+				deferredShader.setMat4("_View", camera.viewMatrix());
+				deferredShader.setInt("_PointLightMode", (int)lightingStrategy);
+				deferredShader.setInt("_PackedGBuffer", gBufferPacked);
+				deferredShader.setMat4("_InverseViewProjection", glm::inverse(camera.projectionMatrix() * camera.viewMatrix()));
+				ns::bindClusterGrid(clusterGrid, deferredShader);
+
+				//Bind g-buffer textures
+				ns::bindTextureUnit(0, gBuffer.colorBuffer[0]);
+				ns::bindTextureUnit(1, gBuffer.colorBuffer[1]);
+				ns::bindTextureUnit(2, gBuffer.colorBuffer[2]);
+				ns::bindTextureUnit(3, shadowMap.depthMap); //For shadow mapping
+				ns::bindTextureUnit(4, gBuffer.depthBuffer); //For position reconstruction
+
+				ns::bindVertexArray(dummyVAO);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+				if (!lightVolumes) {
+					//This frame's light region can be reused once the lighting pass has finished
+					ns::fenceLightBuffer(&lightBuffer);
+					ns::endGpuTimer(&lightingPassTimer);
+				}
+			});
+			ns::passReads(&frameGraph, pass, gBufferColor);
+			ns::passReads(&frameGraph, pass, gBufferDepth);
+			ns::passReads(&frameGraph, pass, shadowDepth);
+			ns::passWrites(&frameGraph, pass, litColor);
 		}
 
-		//Bind g-buffer textures
-		glBindTextureUnit(0, gBuffer.colorBuffer[0]);
-		glBindTextureUnit(1, gBuffer.colorBuffer[1]);
-		glBindTextureUnit(2, gBuffer.colorBuffer[2]);
-		glBindTextureUnit(3, shadowMap.depthMap); //For shadow mapping
-
-		glBindVertexArray(dummyVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 3);
+		//Point lights as volumes, added on top of the directional + ambient result
+		if (lightVolumes) {
+			//Copied rather than shared, the packed layout samples g-buffer depth while the volumes are depth tested
+			unsigned int pass = ns::addGraphPass(&frameGraph, "Depth copy", framebuffer.fbo, framebuffer.width, framebuffer.height, [&]() {
+				//Named blit, so the bound framebuffer never changes
+				glBlitNamedFramebuffer(gBuffer.fbo, framebuffer.fbo, 0, 0, gBuffer.width, gBuffer.height, 0, 0, framebuffer.width, framebuffer.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+			});
+			ns::passReads(&frameGraph, pass, gBufferDepth);
+			ns::passWrites(&frameGraph, pass, litDepth, ns::GraphWrite::OVERWRITE);
+
+			pass = ns::addGraphPass(&frameGraph, "Light volumes", framebuffer.fbo, framebuffer.width, framebuffer.height, [&]() {
+				//Back faces pass only where the scene is in front of the far side of the sphere.
+				//Culling front faces keeps volumes working when the camera is inside them
+				ns::setCullState(true, GL_FRONT);
+				ns::setDepthState(true, GL_GEQUAL, false);
+				ns::setBlendState(true, GL_ONE, GL_ONE);
+
+				lightVolumeShader.use();
+				lightVolumeShader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+				lightVolumeShader.setFloat("_VolumeScale", lightVolumeScale);
+				lightVolumeShader.setVec3("_EyePos", camera.position);
+				lightVolumeShader.setFloat("_Material.Shininess", material.Shininess);
+				lightVolumeShader.setInt("_PackedGBuffer", gBufferPacked);
+				lightVolumeShader.setMat4("_InverseViewProjection", glm::inverse(camera.projectionMatrix() * camera.viewMatrix()));
+				sphereMesh.drawInstanced(pointLightCount);
+
+				ns::setBlendState(false, GL_ONE, GL_ZERO);
+				ns::setDepthState(true, GL_LESS, true);
+				ns::setCullState(true, GL_BACK);
+				ns::fenceLightBuffer(&lightBuffer);
+				ns::endGpuTimer(&lightingPassTimer);
+			});
+			ns::passReads(&frameGraph, pass, gBufferColor);
+			ns::passReads(&frameGraph, pass, gBufferDepth);
+			ns::passReads(&frameGraph, pass, litDepth);
+			ns::passWrites(&frameGraph, pass, litColor, ns::GraphWrite::LOAD);
+		}
 
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer.fbo); //Read from gBuffer 
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer.fbo); //Write to current fbo
-		glBlitFramebuffer(0, 0, screenWidth, screenHeight, 0, 0, screenWidth, screenHeight, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
-		
-		//Scene
-		cameraController.move(window, &camera, deltaTime);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		glViewport(0, 0, framebuffer.width, framebuffer.height);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		//Post process to the window
+		{
+			unsigned int pass = ns::addGraphPass(&frameGraph, "Post process", 0, glm::max(screenWidth, 1), glm::max(screenHeight, 1), [&]() {
+				postProcessShader.use();
+				ns::bindTextureUnit(0, framebuffer.colorBuffer[0]);
+				ns::bindVertexArray(dummyVAO);
+				glDrawArrays(GL_TRIANGLES, 0, 3);
+			});
+			ns::passReads(&frameGraph, pass, litColor);
+			ns::passWrites(&frameGraph, pass, windowColor);
+			ns::passWrites(&frameGraph, pass, windowDepth);
+		}
 
-		postProcessShader.use();
+		//UI, which also shows the g-buffer and shadow map
+		{
+			unsigned int pass = ns::addGraphPass(&frameGraph, "UI", 0, glm::max(screenWidth, 1), glm::max(screenHeight, 1), [&]() {
+				drawUI();
+			});
+			ns::passReads(&frameGraph, pass, gBufferColor);
+			ns::passReads(&frameGraph, pass, shadowDepth);
+			ns::passWrites(&frameGraph, pass, windowColor, ns::GraphWrite::LOAD);
+		}
 
-		glBindTextureUnit(0, framebuffer.colorBuffer[0]);
-		glBindVertexArray(dummyVAO);
-		glDrawArrays(GL_TRIANGLES, 0, 3);
+		ns::compileRenderGraph(&frameGraph);
+		ns::executeRenderGraph(frameGraph);
+		ns::releaseFramebuffer(&renderTargets, &framebuffer);
+		ns::updateRenderTargetPool(&renderTargets);
+		updateOcclusionBenchmark();
+		updateSweep();
+		updateGBufferBenchmark();
 
-		drawUI();
+		//Scene
+		cameraController.move(window, &camera, deltaTime);
 
+		ns::endGLStateFrame();
 		glfwSwapBuffers(window);
 	}
 	printf("Shutting down...");
@@ -251,6 +579,217 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0;
 }
 
+//Spreads the first count lights over an evenly spaced grid covering the same 8x8 area as the original 64 lights
+void layoutPointLights(int count) {
+	int side = (int)ceilf(sqrtf((float)count));
+	if (side < 1)
+		side = 1;
+	pointLightSpacing = 8.0f / side;
+	for (int i = 0; i < count; i++)
+	{
+		int x = i / side;
+		int z = i % side;
+		pointLights[i].position = glm::vec3(x * pointLightSpacing, 0.0f, z * pointLightSpacing);
+		pointLights[i].radius = 3.0f * pointLightSpacing;
+	}
+}
+
+//Walls of cubes with gaps between them, the Suzanne grid behind them, and a roof over the back half of the grid
+void LayoutOcclusionScene(unsigned int suzanneMesh, const ew::MeshBounds& suzanneBounds, unsigned int cubeMesh, const ew::MeshBounds& cubeBounds) {
+	ns::clearArenaDraws(&occlusionArena);
+	occlusionBounds.clear();
+	auto addObject = [&](unsigned int mesh, const ew::MeshBounds& bounds, const glm::mat4& model) {
+		ew::InstanceData instance;
+		instance.model = model;
+		instance.color = glm::vec4(1.0f);
+		ns::pushArenaDraw(&occlusionArena, mesh, instance, false);
+		glm::vec3 min, max;
+		ns::transformBounds(model, bounds, &min, &max);
+		ns::OcclusionBounds objectBounds;
+		objectBounds.min = glm::vec4(min, 1.0f);
+		objectBounds.max = glm::vec4(max, 1.0f);
+		occlusionBounds.push_back(objectBounds);
+	};
+	const float wallWidth = 6.0f;
+	const float wallGap = 1.5f;
+	for (int i = 0; i < OCCLUSION_WALLS; i++)
+	{
+		float x = (i - (OCCLUSION_WALLS - 1) * 0.5f) * (wallWidth + wallGap);
+		glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 2.0f, -4.0f));
+		addObject(cubeMesh, cubeBounds, glm::scale(model, glm::vec3(wallWidth, 8.0f, 0.5f)));
+	}
+	const float spacing = 2.5f;
+	for (int i = 0; i < OCCLUSION_GRID_SIDE * OCCLUSION_GRID_SIDE; i++)
+	{
+		float x = ((i % OCCLUSION_GRID_SIDE) - OCCLUSION_GRID_SIDE * 0.5f) * spacing;
+		float z = -8.0f - (i / OCCLUSION_GRID_SIDE) * spacing;
+		addObject(suzanneMesh, suzanneBounds, glm::translate(glm::mat4(1.0f), glm::vec3(x, -1.0f, z)));
+	}
+	float gridDepth = OCCLUSION_GRID_SIDE * spacing;
+	glm::mat4 roof = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 8.0f, -8.0f - gridDepth * 0.75f));
+	addObject(cubeMesh, cubeBounds, glm::scale(roof, glm::vec3(OCCLUSION_GRID_SIDE * spacing, 0.5f, gridDepth * 0.5f)));
+}
+
+//Called once per frame after the geometry pass timer has been read
+void updateOcclusionBenchmark() {
+	if (!occlusionBenchmark.running)
+		return;
+	occlusionBenchmark.frame++;
+	if (occlusionBenchmark.frame <= OCCLUSION_BENCHMARK_WARMUP_FRAMES)
+		return;
+	occlusionBenchmark.totalMs += shadowPassTimer.lastMs + geometryPassTimer.lastMs;
+	occlusionBenchmark.totalCullMs += occlusionCullTimer.lastMs;
+	if (occlusionBenchmark.frame < OCCLUSION_BENCHMARK_WARMUP_FRAMES + OCCLUSION_BENCHMARK_FRAMES)
+		return;
+
+	int phase = occlusionBenchmark.phase;
+	occlusionBenchmark.passMs[phase] = occlusionBenchmark.totalMs / OCCLUSION_BENCHMARK_FRAMES;
+	occlusionBenchmark.cullMs[phase] = occlusionBenchmark.totalCullMs / OCCLUSION_BENCHMARK_FRAMES;
+	printf("Occlusion culling %s: shadow + geometry %.3f ms, cull %.3f ms\n", phase ? "on" : "off", occlusionBenchmark.passMs[phase], occlusionBenchmark.cullMs[phase]);
+	occlusionBenchmark.frame = 0;
+	occlusionBenchmark.totalMs = 0.0f;
+	occlusionBenchmark.totalCullMs = 0.0f;
+	if (phase == 0) {
+		occlusionBenchmark.phase = 1;
+		occlusionCullingEnabled = true;
+	}
+	else {
+		occlusionBenchmark.running = false;
+		float off = occlusionBenchmark.passMs[0] + occlusionBenchmark.cullMs[0];
+		float on = occlusionBenchmark.passMs[1] + occlusionBenchmark.cullMs[1];
+		printf("Occlusion culling saves %.3f ms per frame (%.3f -> %.3f ms)\n", off - on, off, on);
+	}
+}
+
+//Switches strategy and light count for one configuration of the sweep
+void applySweepStep(int step) {
+	sweep.step = step;
+	sweep.frame = 0;
+	sweep.totalMs = 0.0f;
+	lightingStrategy = (LightingStrategy)(step / SWEEP_NUM_COUNTS);
+	pointLightCount = SWEEP_LIGHT_COUNTS[step % SWEEP_NUM_COUNTS];
+	layoutPointLights(pointLightCount);
+}
+
+//Called once per frame after the lighting pass timer has been read
+void updateSweep() {
+	if (!sweep.running)
+		return;
+	sweep.frame++;
+	if (sweep.frame <= SWEEP_WARMUP_FRAMES)
+		return;
+	sweep.totalMs += lightingPassTimer.lastMs;
+	if (sweep.frame < SWEEP_WARMUP_FRAMES + SWEEP_FRAMES)
+		return;
+
+	int strategy = sweep.step / SWEEP_NUM_COUNTS;
+	int countIndex = sweep.step % SWEEP_NUM_COUNTS;
+	sweep.results[strategy][countIndex] = sweep.totalMs / SWEEP_FRAMES;
+	printf("%s, %d lights: %.3f ms\n", lightingStrategyNames[strategy], SWEEP_LIGHT_COUNTS[countIndex], sweep.results[strategy][countIndex]);
+	if (sweep.step + 1 < SWEEP_NUM_STRATEGIES * SWEEP_NUM_COUNTS) {
+		applySweepStep(sweep.step + 1);
+	}
+	else {
+		sweep.running = false;
+	}
+}
+
+//Layout and material written by geometryPass.frag
+void setGeometryPassUniforms(const ew::Shader& shader) {
+	shader.setInt("_PackedGBuffer", gBufferPacked);
+	shader.setFloat("_Material.Ka", material.Ka);
+	shader.setFloat("_Material.Kd", material.Kd);
+	shader.setFloat("_Material.Ks", material.Ks);
+	shader.setFloat("_Material.Shininess", material.Shininess);
+}
+
+//Switches layout and size for one configuration of the g-buffer benchmark
+void applyGBufferBenchmarkStep(int step) {
+	gBufferBenchmark.step = step;
+	gBufferBenchmark.frame = 0;
+	gBufferBenchmark.totalMs = 0.0f;
+	packedGBuffer = (step % 2) == 1;
+}
+
+//Called once per frame after the lighting pass timer has been read
+void updateGBufferBenchmark() {
+	if (!gBufferBenchmark.running)
+		return;
+	gBufferBenchmark.frame++;
+	if (gBufferBenchmark.frame <= GBUFFER_BENCHMARK_WARMUP_FRAMES)
+		return;
+	gBufferBenchmark.totalMs += lightingPassTimer.lastMs;
+	if (gBufferBenchmark.frame < GBUFFER_BENCHMARK_WARMUP_FRAMES + GBUFFER_BENCHMARK_FRAMES)
+		return;
+
+	int size = gBufferBenchmark.step / 2;
+	int packed = gBufferBenchmark.step % 2;
+	gBufferBenchmark.results[size][packed] = gBufferBenchmark.totalMs / GBUFFER_BENCHMARK_FRAMES;
+	printf("%dx%d %s g-buffer (%zu bytes/pixel): lighting pass %.3f ms\n", GBUFFER_BENCHMARK_SIZES[size][0], GBUFFER_BENCHMARK_SIZES[size][1],
+		packed ? "packed" : "full", ns::getGBufferBytesPerPixel(packed), gBufferBenchmark.results[size][packed]);
+	if (gBufferBenchmark.step + 1 < 4) {
+		applyGBufferBenchmarkStep(gBufferBenchmark.step + 1);
+	}
+	else {
+		gBufferBenchmark.running = false;
+		packedGBuffer = gBufferBenchmark.restorePacked;
+	}
+}
+
+void benchmarkPointLightUniforms(const ew::Shader& shader) {
+	shader.use();
+	GLint program = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < UNIFORM_BENCHMARK_FRAMES; frame++)
+	{
+		for (int i = 0; i < UNIFORM_BENCHMARK_LIGHTS; i++)
+		{
+			std::string prefix = "_PointLights[" + std::to_string(i) + "].";
+			glUniform3fv(glGetUniformLocation(program, (prefix + "position").c_str()), 1, &pointLights[i].position.x);
+			glUniform1f(glGetUniformLocation(program, (prefix + "radius").c_str()), pointLights[i].radius);
+			glUniform4fv(glGetUniformLocation(program, (prefix + "color").c_str()), 1, &pointLights[i].color.x);
+		}
+	}
+	auto queried = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < UNIFORM_BENCHMARK_FRAMES; frame++)
+	{
+		for (int i = 0; i < UNIFORM_BENCHMARK_LIGHTS; i++)
+		{
+			std::string prefix = "_PointLights[" + std::to_string(i) + "].";
+			shader.setVec3(prefix + "position", pointLights[i].position);
+			shader.setFloat(prefix + "radius", pointLights[i].radius);
+			shader.setVec4(prefix + "color", pointLights[i].color);
+		}
+	}
+	auto named = std::chrono::high_resolution_clock::now();
+	//Resolved once, outside the timed loop, like a renderer would at load time
+	ew::UniformHandle handles[UNIFORM_BENCHMARK_LIGHTS][3];
+	for (int i = 0; i < UNIFORM_BENCHMARK_LIGHTS; i++)
+	{
+		std::string prefix = "_PointLights[" + std::to_string(i) + "].";
+		handles[i][0] = shader.uniform(prefix + "position");
+		handles[i][1] = shader.uniform(prefix + "radius");
+		handles[i][2] = shader.uniform(prefix + "color");
+	}
+	auto resolved = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < UNIFORM_BENCHMARK_FRAMES; frame++)
+	{
+		for (int i = 0; i < UNIFORM_BENCHMARK_LIGHTS; i++)
+		{
+			shader.setVec3(handles[i][0], pointLights[i].position);
+			shader.setFloat(handles[i][1], pointLights[i].radius);
+			shader.setVec4(handles[i][2], pointLights[i].color);
+		}
+	}
+	auto end = std::chrono::high_resolution_clock::now();
+	uniformQueryMs = std::chrono::duration<float, std::milli>(queried - start).count() / UNIFORM_BENCHMARK_FRAMES;
+	uniformNameMs = std::chrono::duration<float, std::milli>(named - queried).count() / UNIFORM_BENCHMARK_FRAMES;
+	uniformHandleMs = std::chrono::duration<float, std::milli>(end - resolved).count() / UNIFORM_BENCHMARK_FRAMES;
+	printf("Point light uniform upload, %d lights, per frame: glGetUniformLocation %.4f ms, cached names %.4f ms, handles %.4f ms\n",
+		UNIFORM_BENCHMARK_LIGHTS, uniformQueryMs, uniformNameMs, uniformHandleMs);
+}
+
 void drawUI() {
 	ImGui_ImplGlfw_NewFrame();
 	ImGui_ImplOpenGL3_NewFrame();
@@ -260,6 +799,12 @@ void drawUI() {
 	if (ImGui::Button("Reset Camera")) {
 		resetCamera(&camera, &cameraController);
 	}
+	if (ImGui::CollapsingHeader("Uniform Benchmark")) {
+		ImGui::Text("Uniform point light upload, %d lights x 3 members, per frame", UNIFORM_BENCHMARK_LIGHTS);
+		ImGui::Text("Names + glGetUniformLocation: %.4f ms", uniformQueryMs);
+		ImGui::Text("Names + cached lookup: %.4f ms", uniformNameMs);
+		ImGui::Text("Handles: %.4f ms", uniformHandleMs);
+	}
 	if (ImGui::CollapsingHeader("Material")) {
 		ImGui::SliderFloat("AmbientK", &material.Ka, 0.0f, 1.0f);
 		ImGui::SliderFloat("DiffuseK", &material.Kd, 0.0f, 1.0f);
@@ -271,6 +816,129 @@ void drawUI() {
 		ImGui::SliderFloat("Min Bias", &minBias, 0.001f, 0.05f);
 		ImGui::SliderFloat("Max Bias", &maxBias, 0.001f, 0.05f);
 	}
+	if (ImGui::CollapsingHeader("Point Lights")) {
+		if (ImGui::SliderInt("Count", &pointLightCount, 0, MAX_POINT_LIGHTS)) {
+			layoutPointLights(pointLightCount);
+		}
+		ImGui::Text("Point light upload: %.4f ms", lightUploadMs);
+		int strategy = (int)lightingStrategy;
+		if (ImGui::Combo("Strategy", &strategy, lightingStrategyNames, SWEEP_NUM_STRATEGIES)) {
+			lightingStrategy = (LightingStrategy)strategy;
+		}
+		ImGui::Checkbox("GPU cluster binning", &gpuClusterBinning);
+		ImGui::Text("Cluster binning (CPU time): %.4f ms", clusterBinningMs);
+		ImGui::Text("Lighting pass (GPU time): %.3f ms", lightingPassTimer.ms);
+		if (lightingStrategy == LightingStrategy::FULLSCREEN_CLUSTERED && !gpuClusterBinning) {
+			unsigned int numClusters = clusterGrid.tilesX * clusterGrid.tilesY * clusterGrid.slices;
+			ImGui::Text("Avg lights per cluster: %.2f", (float)clusterGrid.numIndices / numClusters);
+		}
+		if (lightingStrategy == LightingStrategy::FULLSCREEN_CLUSTERED) {
+			ImGui::Text("Lights dropped from full clusters: %u", clusterGrid.numDroppedLights);
+			if (clusterGrid.numDroppedLights > 0) {
+				ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "Clusters hold at most %u lights, some lighting is missing", clusterGrid.maxLightsPerCluster);
+			}
+		}
+		if (ImGui::Button(sweep.running ? "Sweep running..." : "Run light count sweep") && !sweep.running) {
+			sweep.running = true;
+			applySweepStep(0);
+		}
+		//Lighting pass GPU ms, one row per strategy
+		for (int i = 0; i < SWEEP_NUM_STRATEGIES; i++)
+		{
+			ImGui::Text("%-22s %7.3f %7.3f %7.3f %7.3f", lightingStrategyNames[i],
+				sweep.results[i][0], sweep.results[i][1], sweep.results[i][2], sweep.results[i][3]);
+		}
+	}
+	if (ImGui::CollapsingHeader("G-Buffer")) {
+		ImGui::Checkbox("Packed layout", &packedGBuffer);
+		size_t bytesPerPixel = ns::getGBufferBytesPerPixel(gBufferPacked);
+		ImGui::Text("%zu bytes/pixel, %.1f MB at %ux%u", bytesPerPixel, (float)bytesPerPixel * gBuffer.width * gBuffer.height / (1024.0f * 1024.0f), gBuffer.width, gBuffer.height);
+		ImGui::Text("Lighting pass (GPU time): %.3f ms", lightingPassTimer.ms);
+		if (ImGui::Button(gBufferBenchmark.running ? "Benchmark running..." : "Run 1080p / 4K benchmark") && !gBufferBenchmark.running) {
+			gBufferBenchmark = GBufferBenchmark();
+			gBufferBenchmark.running = true;
+			gBufferBenchmark.restorePacked = packedGBuffer;
+			applyGBufferBenchmarkStep(0);
+		}
+		//Lighting pass GPU ms, full then packed
+		for (int i = 0; i < 2; i++)
+		{
+			ImGui::Text("%dx%d: full %7.3f, packed %7.3f", GBUFFER_BENCHMARK_SIZES[i][0], GBUFFER_BENCHMARK_SIZES[i][1],
+				gBufferBenchmark.results[i][0], gBufferBenchmark.results[i][1]);
+		}
+		ImGui::Text("Full %zu bytes/pixel, packed %zu bytes/pixel", ns::getGBufferBytesPerPixel(false), ns::getGBufferBytesPerPixel(true));
+	}
+	if (ImGui::CollapsingHeader("GL State")) {
+		//Last frame, the UI's own calls restore state behind the cache and aren't counted
+		const ns::GLStateCounters& counters = ns::getGLStateCounters();
+		unsigned int totalIssued = 0, totalElided = 0;
+		for (unsigned int i = 0; i < ns::NUM_GL_STATE_CALLS; i++)
+		{
+			ImGui::Text("%-12s %4u issued %4u elided", ns::getGLStateCallName((ns::GLStateCall)i), counters.issued[i], counters.elided[i]);
+			totalIssued += counters.issued[i];
+			totalElided += counters.elided[i];
+		}
+		ImGui::Text("%u of %u state calls reached the driver", totalIssued, totalIssued + totalElided);
+	}
+	if (ImGui::CollapsingHeader("Render Graph")) {
+		//Schedule of the frame being drawn, compiled before this UI pass ran
+		for (size_t i = 0; i < frameGraph.schedule.size(); i++)
+		{
+			const ns::ScheduledPass& scheduled = frameGraph.schedule[i];
+			ImGui::Text("%-14s %s%s%s%s", frameGraph.passes[scheduled.pass].name.c_str(), scheduled.bindFramebuffer ? " bind" : "",
+				scheduled.setViewport ? " viewport" : "", scheduled.clearColor ? " clear-color" : "", scheduled.clearDepth ? " clear-depth" : "");
+			for (size_t d = 0; d < scheduled.discards.size(); d++)
+			{
+				ImGui::Text("    discard %s", frameGraph.resources[scheduled.discards[d]].name.c_str());
+			}
+		}
+		for (size_t i = 0; i < frameGraph.culledPasses.size(); i++)
+		{
+			ImGui::Text("%-14s culled", frameGraph.passes[frameGraph.culledPasses[i]].name.c_str());
+		}
+		ImGui::Text("%u framebuffer binds, %u viewport changes for %zu passes", frameGraph.numFramebufferBinds, frameGraph.numViewportChanges, frameGraph.schedule.size());
+	}
+	if (ImGui::CollapsingHeader("Render Targets")) {
+		const float MB = 1024.0f * 1024.0f;
+		ImGui::Text("Pool: %zu textures, %.1f MB", renderTargets.targets.size(), renderTargets.memory / MB);
+		ImGui::Text("Peak in use last frame: %.1f MB", renderTargets.framePeakMemory / MB);
+		ImGui::Text("Peak owned: %.1f MB, %u textures created", renderTargets.peakMemory / MB, renderTargets.numCreated);
+		//What the g-buffer and a lighting target with its own depth took when both were allocated once at startup.
+		//The pool doesn't alias them, the whole difference is the lit depth only being acquired for light volumes
+		size_t pixels = (size_t)gBuffer.width * gBuffer.height;
+		size_t fixedMemory = (ns::getGBufferBytesPerPixel(gBufferPacked) + 6 + 4) * pixels;
+		ImGui::Text("Fixed targets at this size: %.1f MB", fixedMemory / MB);
+		ImGui::Text("Lit depth (4 bytes/pixel, %.1f MB): %s", 4 * pixels / MB, lightingStrategy == LightingStrategy::LIGHT_VOLUMES ? "acquired for light volumes" : "skipped");
+	}
+	if (ImGui::CollapsingHeader("Shadows")) {
+		ImGui::Checkbox("Cache shadow map", &shadowCacheEnabled);
+		ImGui::Text("Shadow map %s this frame", shadowMapRedrawn ? "redrawn" : "cached");
+		ImGui::Text("Shadow pass (GPU time): %.3f ms", shadowPassTimer.ms);
+	}
+	if (ImGui::CollapsingHeader("Occlusion Culling")) {
+		ImGui::Checkbox("Test scene", &occlusionSceneEnabled);
+		ImGui::Checkbox("Hi-Z occlusion culling", &occlusionCullingEnabled);
+		const ns::OcclusionCuller* cullers[2] = { &cameraCuller, &shadowCuller };
+		const char* cullerNames[2] = { "Camera", "Shadow" };
+		for (int i = 0; i < 2; i++)
+		{
+			unsigned int total = cullers[i]->numVisible + cullers[i]->numFrustumCulled + cullers[i]->numOccluded;
+			float culled = total > 0 ? 100.0f * (total - cullers[i]->numVisible) / total : 0.0f;
+			ImGui::Text("%s: %u / %u visible, %.1f%% culled", cullerNames[i], cullers[i]->numVisible, total, culled);
+			ImGui::Text("  frustum %u, occluded %u", cullers[i]->numFrustumCulled, cullers[i]->numOccluded);
+		}
+		ImGui::Text("Hi-Z build + cull (GPU time): %.3f ms", occlusionCullTimer.ms);
+		ImGui::Text("Shadow pass (GPU time): %.3f ms", shadowPassTimer.ms);
+		ImGui::Text("Geometry pass (GPU time): %.3f ms", geometryPassTimer.ms);
+		if (ImGui::Button(occlusionBenchmark.running ? "Benchmark running..." : "Run on/off benchmark") && !occlusionBenchmark.running) {
+			occlusionSceneEnabled = true;
+			occlusionCullingEnabled = false;
+			occlusionBenchmark = OcclusionBenchmark();
+			occlusionBenchmark.running = true;
+		}
+		ImGui::Text("Off: %.3f ms passes + %.3f ms cull", occlusionBenchmark.passMs[0], occlusionBenchmark.cullMs[0]);
+		ImGui::Text("On:  %.3f ms passes + %.3f ms cull", occlusionBenchmark.passMs[1], occlusionBenchmark.cullMs[1]);
+	}
 	ImGui::End();
 
 	ImGui::Begin("Shadow Map");
@@ -294,9 +962,12 @@ void drawUI() {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	ns::setViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
+	//Render targets pick the new size up next frame
+	if (height > 0)
+		camera.aspectRatio = (float)width / height;
 }
 
 /// <summary>
@@ -23,28 +23,48 @@ struct Material{
 uniform Material _Material;
 
 uniform sampler2D _MainTex; //2D texture sampler
-uniform sampler2D _ShadowMap;
+uniform sampler2DArray _ShadowMap; //One layer per cascade
 uniform vec3 _EyePos;
-in vec4 LightSpacePos;
+in vec4 Tint; //Per instance color
 uniform float _MinBias;
 uniform float _MaxBias;
 
-float calcShadow(sampler2D shadowMap, vec4 lightSpacePos, float bias){
+//Cascades (ns::CascadedShadowMap)
+uniform mat4 _View;
+uniform mat4 _CascadeViewProj[4];
+uniform float _CascadeSplits[4]; //View space distance where each cascade ends
+uniform int _NumCascades;
+uniform bool _ShowCascades; //Tints each cascade a different color
+
+//First cascade whose slice contains the fragment, or _NumCascades past the last one
+int findCascade(vec3 worldPos){
+	float viewDepth = -(_View * vec4(worldPos, 1.0)).z;
+	for(int i = 0; i < _NumCascades; i++){
+		if(viewDepth < _CascadeSplits[i])
+			return i;
+	}
+	return _NumCascades;
+}
+
+float calcShadow(sampler2DArray shadowMap, int cascade, vec3 worldPos, float bias){
+	//Beyond the shadow distance nothing is shadowed
+	if(cascade >= _NumCascades)
+		return 0.0;
+	vec4 lightSpacePos = _CascadeViewProj[cascade] * vec4(worldPos, 1.0);
 	//Homogeneous Clip space to NDC [-w,w] to [-1,1]
     vec3 sampleCoord = lightSpacePos.xyz / lightSpacePos.w;
     //Convert from [-1,1] to [0,1]
     sampleCoord = sampleCoord * 0.5 + 0.5;
 	//Include bias in depth
 	float myDepth = sampleCoord.z - bias; 
-	float shadowMapDepth = texture(shadowMap, sampleCoord.xy).r;
 
 	//PCF 
 	float totalShadow = 0.0;
-	vec2 texelOffset = 1.0 /  textureSize(_ShadowMap,0);
+	vec2 texelOffset = 1.0 / textureSize(shadowMap,0).xy;
 	for(int y = -1; y <=1; y++){
 		for(int x = -1; x <=1; x++){
 			vec2 uv = sampleCoord.xy + vec2(x * texelOffset.x, y * texelOffset.y);
-			totalShadow += step(texture(_ShadowMap,uv).r,myDepth);
+			totalShadow += step(texture(shadowMap,vec3(uv, cascade)).r,myDepth);
 		}
 	}
 	totalShadow /= 9.0;
@@ -72,11 +92,16 @@ void main(){
 
 	//shadow
 	float bias = max(_MaxBias * (1.0 - dot(normal,toLight)),_MinBias);
-	float shadow = calcShadow(_ShadowMap, LightSpacePos, bias);
+	int cascade = findCascade(fs_in.WorldPos);
+	float shadow = calcShadow(_ShadowMap, cascade, fs_in.WorldPos, bias);
 	lightColor *= 1.0 - shadow;
 
 	//Add some ambient light
 	lightColor+=_Light.AmbientColor * _Material.Ka;
 	vec3 objectColor = texture(_MainTex,fs_in.TexCoord).rgb;
-	FragColor = vec4(objectColor * lightColor,1.0);
+	if(_ShowCascades && cascade < _NumCascades){
+		const vec3 cascadeColors[4] = vec3[4](vec3(1.0,0.5,0.5), vec3(0.5,1.0,0.5), vec3(0.5,0.5,1.0), vec3(1.0,1.0,0.5));
+		objectColor *= cascadeColors[cascade];
+	}
+	FragColor = vec4(objectColor * Tint.rgb * lightColor,1.0);
 }
@@ -14,8 +14,7 @@ out Surface{
 	vec2 TexCoord;
 }vs_out;
 
-uniform mat4 _LightViewProj; //view + projection of light source camera
-out vec4 LightSpacePos; //Sent to fragment shader
+out vec4 Tint;
 
 void main(){
 	//Transform vertex position to World Space.
@@ -23,8 +22,7 @@ void main(){
 	//Transform vertex normal to world space using Normal Matrix
 	vs_out.WorldNormal = transpose(inverse(mat3(_Model))) * vNormal;
 	vs_out.TexCoord = vTexCoord;
+	Tint = vec4(1.0);
 	//Set vertex position in homogeneous clip space
 	gl_Position = _ViewProjection * _Model * vec4(vPos,1.0);
-
-	LightSpacePos = _LightViewProj * _Model * vec4(vPos, 1.0);
 }
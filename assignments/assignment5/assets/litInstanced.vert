@@ -0,0 +1,30 @@
+#version 450
+//Vertex attributes
+layout(location = 0) in vec3 vPos; 
+layout(location = 1) in vec3 vNormal; 
+layout(location = 2) in vec2 vTexCoord; 
+//Instance attributes (ew::InstanceData)
+layout(location = 3) in mat4 iModel;
+layout(location = 7) in vec4 iColor;
+
+uniform mat4 _ViewProjection; 
+
+//This whole block will be passed to the next shader stage.
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+}vs_out;
+
+out vec4 Tint;
+
+void main(){
+	//Transform vertex position to World Space.
+	vs_out.WorldPos = vec3(iModel * vec4(vPos,1.0));
+	//Transform vertex normal to world space using Normal Matrix
+	vs_out.WorldNormal = transpose(inverse(mat3(iModel))) * vNormal;
+	vs_out.TexCoord = vTexCoord;
+	Tint = iColor;
+	//Set vertex position in homogeneous clip space
+	gl_Position = _ViewProjection * iModel * vec4(vPos,1.0);
+}
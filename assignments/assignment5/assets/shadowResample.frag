@@ -0,0 +1,23 @@
+#version 450
+//Fills a cascade's layer with the static casters of the cache, which were drawn over a larger, coarsely snapped region.
+//Both maps look down the same light direction, so converting between them is a scale and offset per axis
+uniform sampler2DArray _StaticShadowMap;
+uniform int _Cascade;
+uniform float _Resolution;
+uniform mat4 _DynamicToStatic; //Cascade NDC to static NDC
+uniform mat4 _StaticToDynamic;
+
+void main(){
+	vec2 ndc = gl_FragCoord.xy / _Resolution * 2.0 - 1.0;
+	vec2 staticUV = (_DynamicToStatic * vec4(ndc, 0.0, 1.0)).xy * 0.5 + 0.5;
+	float staticDepth = texture(_StaticShadowMap, vec3(staticUV, _Cascade)).r;
+	//Outside the static region or nothing drawn there
+	if(any(lessThan(staticUV, vec2(0.0))) || any(greaterThan(staticUV, vec2(1.0))) || staticDepth >= 1.0){
+		gl_FragDepth = 1.0;
+		return;
+	}
+	vec4 staticNdc = vec4(staticUV * 2.0 - 1.0, staticDepth * 2.0 - 1.0, 1.0);
+	float depth = (_StaticToDynamic * staticNdc).z * 0.5 + 0.5;
+	//Casters behind the cascade's near plane still shadow it, like depth clamping would
+	gl_FragDepth = clamp(depth, 0.0, 1.0);
+}
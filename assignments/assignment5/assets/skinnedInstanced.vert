@@ -0,0 +1,46 @@
+#version 450
+//Vertex attributes
+layout(location = 0) in vec3 vPos; 
+layout(location = 1) in vec3 vNormal; 
+layout(location = 2) in vec2 vTexCoord; 
+//Instance attributes (ew::InstanceData)
+layout(location = 3) in mat4 iModel;
+layout(location = 7) in vec4 iColor;
+//Skin attributes (ew::VertexSkin)
+layout(location = 8) in uvec4 vJoints;
+layout(location = 9) in vec4 vWeights;
+
+//Joint palettes of every character (ns::JointPaletteBuffer), instance i uses _Joints[i * _PaletteSize + joint]
+layout(std430, binding = 3) readonly buffer JointPaletteBuffer{
+	mat4 _Joints[];
+};
+uniform int _PaletteSize;
+
+uniform mat4 _ViewProjection; 
+
+//This whole block will be passed to the next shader stage.
+out Surface{
+	vec3 WorldPos; //Vertex position in world space
+	vec3 WorldNormal; //Vertex normal in world space
+	vec2 TexCoord;
+}vs_out;
+
+out vec4 Tint;
+
+void main(){
+	//Blend of the joint matrices moving this vertex, in the character's space
+	int paletteStart = gl_InstanceID * _PaletteSize;
+	mat4 skinMatrix = _Joints[paletteStart + vJoints.x] * vWeights.x
+		+ _Joints[paletteStart + vJoints.y] * vWeights.y
+		+ _Joints[paletteStart + vJoints.z] * vWeights.z
+		+ _Joints[paletteStart + vJoints.w] * vWeights.w;
+	mat4 model = iModel * skinMatrix;
+	//Transform vertex position to World Space.
+	vs_out.WorldPos = vec3(model * vec4(vPos,1.0));
+	//Transform vertex normal to world space using Normal Matrix
+	vs_out.WorldNormal = transpose(inverse(mat3(model))) * vNormal;
+	vs_out.TexCoord = vTexCoord;
+	Tint = iColor;
+	//Set vertex position in homogeneous clip space
+	gl_Position = _ViewProjection * vec4(vs_out.WorldPos, 1.0);
+}
@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <math.h>
+#include <vector>
+#include <chrono>
+#include <string.h>
 
 #include <ew/external/glad.h>
 #include <ew/shader.h>
@@ -10,9 +13,24 @@
 #include <ew/texture.h>
 #include <ew/procGen.h>
 #include <ns/framebuffer.h>
-#include <ns/shadowMap.h>
+#include <ns/glState.h>
+#include <ns/cascadedShadowMap.h>
 #include <ns/node.h>
 #include <ns/hierarchy.h>
+#include <ns/geometryArena.h>
+#include <ns/meshCache.h>
+#include <ns/jobSystem.h>
+#include <ns/assetLoader.h>
+#include <ns/gpuTimer.h>
+#include <ns/meshOptimizer.h>
+#include <ns/lodSelection.h>
+#include <ns/culling.h>
+#include <ns/bvh.h>
+#include <ns/fkSolver.h>
+#include <ns/animation.h>
+#include <ns/skinning.h>
+#include <ns/modelImport.h>
+#include <ns/renderQueue.h>
 
 #include <GLFW/glfw3.h>
 #include <imgui.h>
@@ -32,12 +50,17 @@ float deltaTime;
 //Camera
 ew::Camera camera;
 ew::CameraController cameraController;
-ew::Camera shadowCamera;
 
 //Shadow Map Variables
-int shadowMapWidth = 2048;
-int shadowMapHeight = 2048;
-ns::ShadowMap shadowMap;
+//4 cascades of 1024x1024 take the same memory as the single 2048x2048 map they replace
+const int SHADOW_CASCADE_RESOLUTION = 1024;
+const int SHADOW_CASCADE_COUNT = 4;
+ns::CascadedShadowMap shadowMap;
+float shadowDistance = 60.0f; //Nothing is shadowed further than this from the camera
+float shadowCasterDistance = 20.0f; //How far towards the light casters are picked up
+bool showCascades = false;
+ns::GpuTimer shadowPassTimer;
+float staticRedrawRate = 0.0f; //Smoothed numStaticRedraws, stays near zero while flying when the cache works
 
 struct Material {
 	float Ka = 1.0;
@@ -56,25 +79,203 @@ float minBias = 0.005f;
 float maxBias = 0.015f;
 
 //Nodes
-void SolveFK(ns::Hierarchy hierarchy);
+void SolveFKReference(const ns::Hierarchy& hierarchy);
 void InitNodes();
-void DrawNodes(ns::Hierarchy hierarchy, ew::Shader currentShader, ew::Model model);
-void AnimNodes(ns::Hierarchy hierarchy);
+void DrawNodes(const ns::Hierarchy& hierarchy, ew::Model& model, const ns::Frustum& frustum);
 const int NODECOUNT = 8;
 ns::Node skeletonNodes[NODECOUNT];
+unsigned int skeletonNodesUpdated = 0; //Global transforms recomputed by the last updateHierarchyTransforms
+
+//FK benchmark: a forest of random skeletons solved by ns::solveFK on one thread and on the job system,
+//against walking an ns::Node array the way SolveFKReference does, and against dirty propagation
+//with only a small fraction of the joints changed
+bool fkBenchmarkRequested = false;
+int fkBenchmarkSkeletons = 2000;
+int fkBenchmarkJoints = 200;
+float fkBenchmarkChangedPercent = 1.0f;
+float fkReferenceJointsPerSec = 0.0f;
+float fkSingleJointsPerSec = 0.0f;
+float fkMultiJointsPerSec = 0.0f;
+float fkDirtyJointsPerSec = 0.0f; //Every joint counted, not only the ones that were recomputed
+void BenchmarkFK(ns::JobSystem* jobSystem);
+
+//Skeleton animation: a spin clip and a wave clip for the node skeleton, blended by waveWeight,
+//and a nod clip imported from assets/nod.dae layered on by nodWeight
+const char* skeletonJointNames[] = { "Torso", "ShoulderL", "ElbowL", "WristL", "ShoulderR", "ElbowR", "WristR", "Head" };
+ns::Skeleton skeleton;
+std::vector<ns::AnimationClip> skeletonClips;
+ns::CharacterAnimation skeletonAnimation;
+ns::Pose skeletonPose;
+float animationTime = 0.0f;
+float waveWeight = 0.0f;
+float nodWeight = 0.0f;
+void CreateSkeletonClips();
+
+//Animation benchmark: a crowd of characters blending both clips at random times, sampled on one thread and on the job system
+bool animationBenchmarkRequested = false;
+int animationBenchmarkCharacters = 5000;
+float animationSingleMs = 0.0f;
+float animationMultiMs = 0.0f;
+bool animationDeterministic = true; //Both runs gave bit identical poses
+void BenchmarkAnimation(ns::JobSystem* jobSystem);
+
+//Skinned crowd: the skeleton's Suzannes merged into one mesh, each copy skinned to its node. Every character is animated,
+//solved in one FK forest and has its joint palette written to one SSBO, then the whole crowd is one instanced draw
+const int MAX_CROWD_CHARACTERS = 10000;
+bool crowdEnabled = false;
+int crowdCount = 1000;
+bool crowdDirty = true; //Characters need to be laid out again
+ns::Skin crowdSkin;
+ew::Mesh crowdMesh;
+ns::FKHierarchy crowdFK;
+std::vector<ns::CharacterAnimation> crowdAnimations;
+std::vector<ns::Pose> crowdPoses;
+std::vector<ew::InstanceData> crowdInstances;
+ns::JointPaletteBuffer crowdPalettes;
+float crowdUpdateMs = 0.0f; //Smoothed CPU time to animate, solve and write the palettes
+void CreateCrowdMesh(const std::vector<ew::MeshData>& meshes);
+void LayoutCrowd(int count);
+ew::InstanceData nodeInstances[NODECOUNT];
+
+//Handles of the per cascade array elements in a lit shader, so they are not looked up by building names every frame.
+//The shaders stream in through the asset loader, so the handles are resolved again whenever an upload lands
+struct CascadeUniforms {
+	ew::UniformHandle viewProjections[SHADOW_CASCADE_COUNT];
+	ew::UniformHandle splits[SHADOW_CASCADE_COUNT];
+};
+CascadeUniforms litCascadeUniforms;
+CascadeUniforms instancedCascadeUniforms;
+CascadeUniforms skinnedCascadeUniforms;
+CascadeUniforms ResolveCascadeUniforms(const ew::Shader& shader);
+void SetLightingUniforms(const ew::Shader& shader, const CascadeUniforms& cascadeUniforms);
+
+//Stress test: a grid of objects drawn one draw call per object, instanced, or from a multi-draw indirect arena
+const int MAX_STRESS_TEST_COUNT = 100000;
+enum StressTestMode {
+	STRESS_PER_OBJECT,
+	STRESS_INSTANCED,
+	STRESS_MULTI_DRAW_INDIRECT
+};
+const char* stressTestModeNames[] = { "Per object", "Instanced", "Multi-draw indirect" };
+bool stressTestEnabled = false;
+int stressTestMode = STRESS_INSTANCED;
+bool stressTestDirty = true; //Instance buffer needs to be rebuilt
+int stressTestCount = MAX_STRESS_TEST_COUNT;
+float stressSubmitMs = 0.0f; //Smoothed CPU time spent submitting the stress test draws
+std::vector<ew::InstanceData> stressInstances;
+void LayoutStressTest(int count);
+
+//Stress test levels of detail, picked per object from projected error
+const int MAX_LODS = 8;
+bool stressLODEnabled = true;
+float lodMaxPixelError = 1.0f;
+int stressLODCounts[MAX_LODS]; //Objects drawn at each level last frame
+unsigned int stressTrianglesDrawn = 0;
+std::vector<ew::InstanceData> stressLODInstances; //Stress instances grouped by level
+bool stressInstancesGrouped = false; //Instance buffer holds stressLODInstances instead of stressInstances
+
+//Stress test frustum culling
+bool stressCullingEnabled = true;
+bool stressArenaFiltered = false; //Arena draw list holds only the objects visible last frame, or coarser levels
+ns::SphereSet stressSpheres;
+std::vector<unsigned char> stressVisible;
+unsigned int stressVisibleCount = 0;
+unsigned int stressCullThreads = 0;
+float stressCullWallMs = 0.0f;
+float stressCullThreadMs = 0.0f; //Summed over threads
+enum StressCullMode {
+	STRESS_CULL_SIMD,
+	STRESS_CULL_BVH
+};
+const char* stressCullModeNames[] = { "Brute force SIMD", "BVH query" };
+int stressCullMode = STRESS_CULL_SIMD;
+
+//Stress test BVH over the object bounds, refit every frame while the objects move. Also used for picking
+ns::BVH stressBVH;
+std::vector<unsigned int> stressBVHResults;
+bool stressAnimate = false;
+bool stressInstancesChanged = false; //Instances moved or were tinted since they were last uploaded
+float stressBVHBuildMs = 0.0f;
+float stressBVHRefitMs = 0.0f;
+float stressAnimateMs = 0.0f; //Moving the objects and updating their bounds, refit excluded
+int stressPicked = -1;
+float stressPickRadius = 10.0f;
+std::vector<unsigned int> stressTinted; //Objects colored by the last pick
+void AnimateStressTest(ns::JobSystem* jobSystem, const ew::MeshBounds& bounds, float time);
+
+//Per object stress test draws go through a sort keyed render queue, filled on every thread
+bool stressSortDraws = true;
+ns::RenderQueue stressQueue;
+float stressSortMs = 0.0f;
+void PickStressTest(GLFWwindow* window);
+
+//Model loading benchmark: Assimp OBJ import vs Assimp FBX import vs mapping the binary mesh cache
+const int LOAD_BENCHMARK_ITERATIONS = 10;
+float objLoadMs = 0.0f;
+float fbxLoadMs = 0.0f;
+float cachedLoadMs = 0.0f;
+void BenchmarkModelLoading();
+
+//Vertex format comparison: the same dense sphere uploaded as ew::Vertex and as ew::CompactVertex
+const int VERTEX_BENCHMARK_SUBDIVISIONS = 512;
+bool vertexBenchmarkEnabled = false;
+int vertexBenchmarkDraws = 16;
+ns::GpuTimer fullVertexTimer;
+ns::GpuTimer compactVertexTimer;
+ew::VertexCompressionReport sphereCompressionReport;
+ew::VertexCompressionReport suzanneCompressionReport;
+void PrintCompressionReport(const char* name, const ew::VertexCompressionReport& report);
+
+//Asset streaming
+float assetUploadBudgetMs = 2.0f;
+float timeToFirstFrameMs = 0.0f;
 
 int main() {
+	auto startupStart = std::chrono::high_resolution_clock::now();
 	GLFWwindow* window = initWindow("Assignment 5", screenWidth, screenHeight);
 	glfwSetFramebufferSizeCallback(window, framebufferSizeCallback);
 
-	GLuint rockTexture = ew::loadTexture("assets/Rock_Color.jpg");
-	ew::Shader shader = ew::Shader("assets/lit.vert", "assets/lit.frag");
-	ew::Shader postProcessShader = ew::Shader("assets/postProcess.vert", "assets/postProcess.frag");
-	ew::Shader depthOnlyShader = ew::Shader("assets/depthOnly.vert", "assets/depthOnly.frag");
-	ew::Model monkeyModel = ew::Model("assets/suzanne.obj");
+	//Assets stream in on worker threads and are uploaded a few per frame, placeholders are used until then
+	ns::JobSystem jobSystem;
+	ns::AssetLoader assetLoader(&jobSystem);
+	stressQueue = ns::createRenderQueue(jobSystem.getNumThreads());
+	GLuint rockTexture = assetLoader.loadTexture("assets/Rock_Color.jpg");
+	ew::Shader& shader = *assetLoader.loadShader("assets/lit.vert", "assets/lit.frag");
+	ew::Shader& postProcessShader = *assetLoader.loadShader("assets/postProcess.vert", "assets/postProcess.frag");
+	ew::Shader& depthOnlyShader = *assetLoader.loadShader("assets/depthOnly.vert", "assets/depthOnly.frag");
+	ew::Shader& shadowResampleShader = *assetLoader.loadShader("assets/postProcess.vert", "assets/shadowResample.frag");
+	ew::Shader& instancedShader = *assetLoader.loadShader("assets/litInstanced.vert", "assets/lit.frag");
+	ew::Shader& depthOnlyInstancedShader = *assetLoader.loadShader("assets/depthOnlyInstanced.vert", "assets/depthOnly.frag");
+	ew::Shader& skinnedShader = *assetLoader.loadShader("assets/skinnedInstanced.vert", "assets/lit.frag");
+	ew::Model& monkeyModel = *assetLoader.loadModel("assets/suzanne.obj");
+	//Separate copy so the stress test instances live in their own buffer
+	ew::Model& stressModel = *assetLoader.loadModel("assets/suzanne.obj");
+	bool loadBenchmarkDone = false;
+	//Every mesh the multi-draw path can pick from shares one vertex/index arena
+	ns::GeometryArena stressArena = ns::createGeometryArena(65536, 262144);
+	std::vector<int> stressArenaMeshes = ns::addArenaModel(&stressArena, "assets/suzanne.obj");
+	ew::MeshData stressShapes[3] = { ew::createCube(1.5f), ew::createSphere(1.0f, 16), ew::createCylinder(0.75f, 1.5f, 16) };
+	for (int i = 0; i < 3; i++)
+	{
+		//-1 when the arena is full, those shapes are left out of the rotation
+		int mesh = ns::addArenaMesh(&stressArena, stressShapes[i]);
+		if (mesh >= 0) {
+			stressArenaMeshes.push_back(mesh);
+		}
+	}
 	ew::Transform monkeyTransform;
 
 	ew::Mesh planeMesh = ew::Mesh(ew::createPlane(10, 10, 5));
+
+	ew::MeshData benchmarkSphereData = ew::createSphere(1.0f, VERTEX_BENCHMARK_SUBDIVISIONS);
+	ns::printMeshOptimizationReport("Sphere", ns::optimizeMesh(&benchmarkSphereData));
+	ew::Mesh fullSphereMesh = ew::Mesh(benchmarkSphereData);
+	benchmarkSphereData.format = ew::VertexFormat::COMPACT;
+	ew::Mesh compactSphereMesh = ew::Mesh(benchmarkSphereData);
+	sphereCompressionReport = ew::measureVertexCompression(benchmarkSphereData.vertices.data(), (unsigned int)benchmarkSphereData.vertices.size());
+	PrintCompressionReport("Sphere", sphereCompressionReport);
+	fullVertexTimer = ns::createGpuTimer();
+	compactVertexTimer = ns::createGpuTimer();
 	ew::Transform planeTransform;
 	planeTransform.position = glm::vec3(0.0f, -2.0f, 0.0f);
 
@@ -84,6 +285,17 @@ int main() {
 	ns::Hierarchy hierarchy;
 	hierarchy.nodes = skeletonNodes;
 	hierarchy.nodeCount = NODECOUNT;
+	ns::initHierarchy(&hierarchy);
+	skeleton = ns::createSkeleton(hierarchy);
+	//Imported channels are matched to joints by name
+	for (int i = 0; i < NODECOUNT; i++)
+	{
+		skeleton.jointNames[i] = skeletonJointNames[i];
+	}
+	CreateSkeletonClips();
+	ns::resizePose(&skeletonPose, NODECOUNT);
+	CreateCrowdMesh(ns::loadCachedMeshData("assets/suzanne.obj"));
+	crowdPalettes = ns::createJointPaletteBuffer(MAX_CROWD_CHARACTERS * (unsigned int)crowdSkin.joints.size());
 	
 	//Main Camera
 	camera.position = glm::vec3(0.0f, 0.0f, 5.0f);
@@ -91,24 +303,16 @@ int main() {
 	camera.aspectRatio = (float)screenWidth / screenHeight;
 	camera.fov = 60.0f; //Vertical field of view, in degrees
 
-	//Shadow Camera
-	shadowCamera.target = glm::vec3(0.0f, 0.0f, 0.0f);
-	shadowCamera.orthographic = true;
-	shadowCamera.orthoHeight = 15.0f;
-	shadowCamera.nearPlane = 0.01f;
-	shadowCamera.farPlane = 30.0f;
-	shadowCamera.aspectRatio = 1.0f;
-
 	//Create Framebuffer and shadow map
 	ns::Framebuffer framebuffer = ns::createFramebuffer(screenWidth, screenHeight, GL_RGB);
-	shadowMap = ns::createShadowMap(shadowMapWidth, shadowMapHeight);
+	shadowMap = ns::createCascadedShadowMap(SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_COUNT, true);
+	shadowPassTimer = ns::createGpuTimer();
 
 	unsigned int dummyVAO;
 	glCreateVertexArrays(1, &dummyVAO);
 	
-	glEnable(GL_CULL_FACE);
-	glCullFace(GL_BACK); //Back face culling
-	glEnable(GL_DEPTH_TEST); //Depth testing
+	ns::setCullState(true, GL_BACK); //Back face culling
+	ns::setDepthState(true, GL_LESS, true); //Depth testing
 
 	while (!glfwWindowShouldClose(window)) {
 		glfwPollEvents();
@@ -117,77 +321,384 @@ int main() {
 		deltaTime = time - prevFrameTime;
 		prevFrameTime = time;
 
+		if (assetLoader.processUploads(assetUploadBudgetMs) > 0) {
+			//Instance data set before the stress model arrived went nowhere
+			stressTestDirty = true;
+			litCascadeUniforms = ResolveCascadeUniforms(shader);
+			instancedCascadeUniforms = ResolveCascadeUniforms(instancedShader);
+			skinnedCascadeUniforms = ResolveCascadeUniforms(skinnedShader);
+			//Layers resampled before the resample shader arrived hold nothing
+			ns::invalidateShadowCache(&shadowMap);
+		}
+		//Needs the mesh cache, which the model loads write if it did not exist yet
+		if (!loadBenchmarkDone && assetLoader.getNumPending() == 0) {
+			BenchmarkModelLoading();
+			loadBenchmarkDone = true;
+		}
+
+		//Camera Controller. Moved before the shadow pass so the cascades are fit to this frame's view
+		cameraController.move(window, &camera, deltaTime);
+
 		//RENDER
-		//Shadow Map
-		glCullFace(GL_FRONT);
-		glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
-		glViewport(0, 0, shadowMapWidth, shadowMapHeight);
-		glClear(GL_DEPTH_BUFFER_BIT);
-		
-		shadowCamera.position = (shadowCamera.target - glm::normalize(light.lightDirection)) * 5.0f;
-		depthOnlyShader.use();
-		depthOnlyShader.setMat4("_ViewProjection", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-		glCullFace(GL_BACK);
-		//Nodes
-		DrawNodes(hierarchy, depthOnlyShader, monkeyModel);
-		depthOnlyShader.setMat4("_Model", planeTransform.modelMatrix());
-		planeMesh.draw();
+		//Shadow Map, each cascade only draws the casters inside its own frustum.
+		//The plane is static and cached, the animated nodes are drawn over it every frame
+		ns::beginGpuTimer(&shadowPassTimer);
+		ns::updateCascades(&shadowMap, camera, light.lightDirection, shadowDistance, shadowCasterDistance);
+		for (unsigned int cascade = 0; cascade < shadowMap.numCascades; cascade++)
+		{
+			const ns::Frustum& cascadeFrustum = shadowMap.frustums[cascade];
+			if (ns::beginStaticCascade(&shadowMap, cascade)) {
+				depthOnlyShader.use();
+				depthOnlyShader.setMat4("_ViewProjection", shadowMap.staticViewProjections[cascade]);
+				depthOnlyShader.setMat4("_Model", planeTransform.modelMatrix());
+				if (ns::isBoundsVisible(shadowMap.staticFrustums[cascade], planeTransform.modelMatrix(), planeMesh.getBounds())) {
+					planeMesh.draw();
+				}
+			}
+			//Nodes
+			if (ns::beginDynamicCascade(&shadowMap, cascade, hierarchy.nodeCount > 0, shadowResampleShader)) {
+				depthOnlyInstancedShader.use();
+				depthOnlyInstancedShader.setMat4("_ViewProjection", shadowMap.viewProjections[cascade]);
+				DrawNodes(hierarchy, monkeyModel, cascadeFrustum);
+			}
+		}
+		ns::endGpuTimer(&shadowPassTimer);
+		staticRedrawRate = glm::mix(staticRedrawRate, (float)shadowMap.numStaticRedraws, 0.05f);
 
 		//Offscreen Framebuffer
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
-		glViewport(0, 0, screenWidth, screenHeight);
+		ns::bindFramebuffer(framebuffer.fbo);
+		ns::setViewport(0, 0, screenWidth, screenHeight);
 		glClearColor(0.6f,0.8f,0.92f,1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		//Camera Controller
-		cameraController.move(window, &camera, deltaTime);
+		ns::Frustum cameraFrustum = ns::extractFrustum(camera.projectionMatrix() * camera.viewMatrix());
 
 		//Rotate model around Y axis
 		//monkeyTransform.rotation = glm::rotate(monkeyTransform.rotation, deltaTime, glm::vec3(0.0, 1.0, 0.0));
 
 		//Bind textures to texture units
-		glBindTextureUnit(0, rockTexture);
-		glBindTextureUnit(1, shadowMap.depthMap);
+		ns::bindTextureUnit(0, rockTexture);
+		ns::bindTextureUnit(1, shadowMap.depthArray);
 
 		shader.use();
-		shader.setInt("_MainTex", 0); //Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
 		shader.setMat4("_Model", monkeyTransform.modelMatrix());
-		shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
-		shader.setVec3("_EyePos", camera.position);
-		shader.setMat4("_LightViewProj", shadowCamera.projectionMatrix() * shadowCamera.viewMatrix());
-		shader.setInt("_ShadowMap", 1);
-		//Light
-		shader.setVec3("_Light.LightDirection", light.lightDirection);
-		shader.setVec3("_Light.LightColor", light.lightColor);
-		shader.setVec3("_Light.AmbientColor", light.ambientColor);
-		shader.setFloat("_MinBias", minBias);
-		shader.setFloat("_MaxBias", maxBias);
-		//Material 
-		shader.setFloat("_Material.Ka", material.Ka);
-		shader.setFloat("_Material.Kd", material.Kd);
-		shader.setFloat("_Material.Ks", material.Ks);
-		shader.setFloat("_Material.Shininess", material.Shininess);
+		SetLightingUniforms(shader, litCascadeUniforms);
 		//monkeyModel.draw(); //Draws the monkey model using current shader
 
 		shader.setMat4("_Model", planeTransform.modelMatrix());
-		planeMesh.draw();
+		if (ns::isBoundsVisible(cameraFrustum, planeTransform.modelMatrix(), planeMesh.getBounds())) {
+			planeMesh.draw();
+		}
+
+		//Vertex format benchmark. Scaled down to nothing so the time is spent fetching and shading vertices, not pixels
+		if (vertexBenchmarkEnabled) {
+			shader.setMat4("_Model", glm::scale(glm::mat4(1.0f), glm::vec3(0.0001f)));
+			beginGpuTimer(&fullVertexTimer);
+			for (int i = 0; i < vertexBenchmarkDraws; i++)
+			{
+				fullSphereMesh.draw();
+			}
+			endGpuTimer(&fullVertexTimer);
+			beginGpuTimer(&compactVertexTimer);
+			for (int i = 0; i < vertexBenchmarkDraws; i++)
+			{
+				compactSphereMesh.draw();
+			}
+			endGpuTimer(&compactVertexTimer);
+		}
+
+		//Stress test
+		if (stressTestEnabled) {
+			if (stressTestDirty) {
+				LayoutStressTest(stressTestCount);
+				stressModel.setInstanceData(stressInstances.data(), (unsigned int)stressInstances.size());
+				stressInstancesGrouped = false;
+				stressArenaFiltered = false;
+				//The grid is static, so world space bounds only change with the layout
+				ew::MeshBounds stressBounds = stressModel.getBounds();
+				ns::resizeSphereSet(&stressSpheres, stressTestCount);
+				for (int i = 0; i < stressTestCount; i++)
+				{
+					ns::setSphere(&stressSpheres, i, stressInstances[i].model, stressBounds);
+				}
+				stressVisible.resize(stressTestCount);
+				ns::resizeBVH(&stressBVH, stressTestCount);
+				for (int i = 0; i < stressTestCount; i++)
+				{
+					glm::vec3 min, max;
+					ns::transformBounds(stressInstances[i].model, stressBounds, &min, &max);
+					ns::setBVHObjectBounds(&stressBVH, i, min, max);
+				}
+				auto buildStart = std::chrono::high_resolution_clock::now();
+				ns::buildBVH(&stressBVH, &jobSystem);
+				std::chrono::duration<float, std::milli> buildTime = std::chrono::high_resolution_clock::now() - buildStart;
+				stressBVHBuildMs = buildTime.count();
+				printf("Stress test BVH: %d objects, %zu nodes, %zu subtrees, built in %.3f ms\n", stressTestCount, stressBVH.nodes.size(), stressBVH.subtreeFirst.size(), stressBVHBuildMs);
+				stressPicked = -1;
+				stressTinted.clear();
+				//Neighbouring objects cycle through the arena meshes so each one becomes its own indirect command
+				ns::clearArenaDraws(&stressArena);
+				for (int i = 0; i < stressTestCount && !stressArenaMeshes.empty(); i++)
+				{
+					ns::pushArenaDraw(&stressArena, stressArenaMeshes[i % stressArenaMeshes.size()], stressInstances[i]);
+				}
+				stressTestDirty = false;
+			}
+			if (stressAnimate) {
+				AnimateStressTest(&jobSystem, stressModel.getBounds(), (float)glfwGetTime());
+				auto refitStart = std::chrono::high_resolution_clock::now();
+				ns::refitBVH(&stressBVH, &jobSystem);
+				std::chrono::duration<float, std::milli> refitTime = std::chrono::high_resolution_clock::now() - refitStart;
+				stressBVHRefitMs = glm::mix(stressBVHRefitMs, refitTime.count(), 0.05f);
+			}
+			PickStressTest(window);
+			auto submitStart = std::chrono::high_resolution_clock::now();
+			//Frustum culling
+			if (stressCullingEnabled && stressCullMode == STRESS_CULL_BVH) {
+				auto cullStart = std::chrono::high_resolution_clock::now();
+				stressBVHResults.clear();
+				ns::queryBVHFrustum(stressBVH, cameraFrustum, &stressBVHResults);
+				std::fill(stressVisible.begin(), stressVisible.end(), (unsigned char)0);
+				for (size_t i = 0; i < stressBVHResults.size(); i++)
+				{
+					stressVisible[stressBVHResults[i]] = 1;
+				}
+				std::chrono::duration<float, std::milli> cullTime = std::chrono::high_resolution_clock::now() - cullStart;
+				stressCullWallMs = glm::mix(stressCullWallMs, cullTime.count(), 0.05f);
+				stressCullThreadMs = stressCullWallMs;
+				stressCullThreads = 1;
+				stressVisibleCount = (unsigned int)stressBVHResults.size();
+			}
+			else if (stressCullingEnabled) {
+				ns::CullStats cullStats = ns::cullSpheresParallel(cameraFrustum, stressSpheres, stressVisible.data(), &jobSystem);
+				stressCullWallMs = glm::mix(stressCullWallMs, cullStats.wallMs, 0.05f);
+				stressCullThreadMs = glm::mix(stressCullThreadMs, cullStats.threadMs, 0.05f);
+				stressCullThreads = cullStats.numThreads;
+				stressVisibleCount = cullStats.numVisible;
+			}
+			else {
+				std::fill(stressVisible.begin(), stressVisible.end(), (unsigned char)1);
+				stressVisibleCount = stressTestCount;
+			}
+
+			//Level for every visible object
+			//The multi draw path picks from each object's own arena mesh, every other path from the stress model
+			bool arenaLODs = stressTestMode == STRESS_MULTI_DRAW_INDIRECT && !stressArenaMeshes.empty();
+			unsigned int numLODs = glm::min(stressModel.getNumLODs(), (unsigned int)MAX_LODS);
+			bool useLODs = stressLODEnabled;
+			std::vector<unsigned char> stressLODs(stressTestCount, 0);
+			for (int i = 0; i < MAX_LODS; i++)
+			{
+				stressLODCounts[i] = 0;
+			}
+			for (int i = 0; i < stressTestCount; i++)
+			{
+				if (!stressVisible[i]) {
+					continue;
+				}
+				if (useLODs) {
+					float pixelsPerUnit = ns::projectedPixelsPerUnit(camera, glm::vec3(stressInstances[i].model[3]), 1.0f, (float)screenHeight);
+					if (arenaLODs) {
+						unsigned int lod = ns::selectArenaLOD(stressArena, stressArenaMeshes[i % stressArenaMeshes.size()], pixelsPerUnit, lodMaxPixelError);
+						stressLODs[i] = (unsigned char)glm::min(lod, (unsigned int)MAX_LODS - 1);
+					}
+					else {
+						stressLODs[i] = (unsigned char)ns::selectLOD(stressModel, pixelsPerUnit, lodMaxPixelError);
+					}
+				}
+				stressLODCounts[stressLODs[i]]++;
+			}
+			stressTrianglesDrawn = 0;
+			if (arenaLODs) {
+				for (int i = 0; i < stressTestCount; i++)
+				{
+					if (stressVisible[i]) {
+						const std::vector<ew::MeshLOD>& lods = stressArena.meshes[stressArenaMeshes[i % stressArenaMeshes.size()]].lods;
+						stressTrianglesDrawn += lods[glm::min((size_t)stressLODs[i], lods.size() - 1)].indexCount / 3;
+					}
+				}
+			}
+			else {
+				for (unsigned int lod = 0; lod < numLODs; lod++)
+				{
+					stressTrianglesDrawn += stressLODCounts[lod] * (stressModel.getLODIndexCount(lod) / 3);
+				}
+			}
+			if (stressTestMode == STRESS_INSTANCED && (useLODs || stressCullingEnabled)) {
+				//Group the visible instances by level so each level is one instanced draw over its own range
+				int lodStarts[MAX_LODS];
+				int start = 0;
+				for (unsigned int lod = 0; lod < numLODs; lod++)
+				{
+					lodStarts[lod] = start;
+					start += stressLODCounts[lod];
+				}
+				stressLODInstances.resize(start);
+				int lodFill[MAX_LODS];
+				for (unsigned int lod = 0; lod < numLODs; lod++)
+				{
+					lodFill[lod] = lodStarts[lod];
+				}
+				for (int i = 0; i < stressTestCount; i++)
+				{
+					if (stressVisible[i]) {
+						stressLODInstances[lodFill[stressLODs[i]]++] = stressInstances[i];
+					}
+				}
+				stressModel.setInstanceData(stressLODInstances.data(), (unsigned int)stressLODInstances.size());
+				stressInstancesGrouped = true;
+				instancedShader.use();
+				SetLightingUniforms(instancedShader, instancedCascadeUniforms);
+				for (unsigned int lod = 0; lod < numLODs; lod++)
+				{
+					if (stressLODCounts[lod] > 0) {
+						stressModel.drawInstancedLOD(lod, stressLODCounts[lod], lodStarts[lod]);
+					}
+				}
+			}
+			else if (stressTestMode == STRESS_INSTANCED) {
+				if (stressInstancesGrouped || stressInstancesChanged) {
+					stressModel.setInstanceData(stressInstances.data(), (unsigned int)stressInstances.size());
+					stressInstancesGrouped = false;
+				}
+				instancedShader.use();
+				SetLightingUniforms(instancedShader, instancedCascadeUniforms);
+				stressModel.drawInstanced(stressTestCount);
+			}
+			else if (stressTestMode == STRESS_MULTI_DRAW_INDIRECT) {
+				//The draw list only changes with visibility and levels, drawArena skips the upload otherwise
+				if (stressCullingEnabled || useLODs || stressArenaFiltered || stressInstancesChanged) {
+					ns::clearArenaDraws(&stressArena);
+					for (int i = 0; i < stressTestCount && !stressArenaMeshes.empty(); i++)
+					{
+						if (stressVisible[i]) {
+							ns::pushArenaDrawLOD(&stressArena, stressArenaMeshes[i % stressArenaMeshes.size()], stressLODs[i], stressInstances[i]);
+						}
+					}
+					stressArenaFiltered = stressCullingEnabled || useLODs;
+				}
+				instancedShader.use();
+				SetLightingUniforms(instancedShader, instancedCascadeUniforms);
+				ns::drawArena(&stressArena);
+			}
+			else if (stressSortDraws) {
+				//One level is one mesh id, so draws are grouped by level and front to back within it
+				ns::clearRenderQueue(&stressQueue);
+				glm::mat4 view = camera.viewMatrix();
+				jobSystem.parallelFor((unsigned int)stressTestCount, 1024, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+					for (unsigned int i = begin; i < end; i++)
+					{
+						if (!stressVisible[i]) {
+							continue;
+						}
+						float depth = -(view * stressInstances[i].model[3]).z / camera.farPlane;
+						for (size_t m = 0; m < stressModel.getNumMeshes(); m++)
+						{
+							ns::DrawItem item;
+							item.shader = &shader;
+							item.mesh = &stressModel.getMesh(m);
+							item.lod = stressLODs[i];
+							item.texture = rockTexture;
+							item.model = stressInstances[i].model;
+							unsigned int meshId = (unsigned int)m * MAX_LODS + stressLODs[i];
+							ns::submitDraw(&stressQueue, threadIndex, ns::makeSortKey(0, false, 0, 0, meshId, depth), item);
+						}
+					}
+				});
+				auto sortStart = std::chrono::high_resolution_clock::now();
+				ns::sortRenderQueue(&stressQueue);
+				std::chrono::duration<float, std::milli> sortTime = std::chrono::high_resolution_clock::now() - sortStart;
+				stressSortMs = glm::mix(stressSortMs, sortTime.count(), 0.05f);
+				ns::executeRenderQueue(stressQueue);
+			}
+			else {
+				for (int i = 0; i < stressTestCount; i++)
+				{
+					if (stressVisible[i]) {
+						shader.setMat4("_Model", stressInstances[i].model);
+						stressModel.drawLOD(stressLODs[i]);
+					}
+				}
+			}
+			stressInstancesChanged = false;
+			std::chrono::duration<float, std::milli> submitTime = std::chrono::high_resolution_clock::now() - submitStart;
+			stressSubmitMs = glm::mix(stressSubmitMs, submitTime.count(), 0.05f);
+		}
 
 		//draw nodes
-		AnimNodes(hierarchy);
-		SolveFK(hierarchy);
-		DrawNodes(hierarchy, shader, monkeyModel);
+		animationTime += deltaTime;
+		skeletonAnimation.numLayers = 2;
+		skeletonAnimation.layers[0] = { 0, animationTime, 1.0f - waveWeight };
+		skeletonAnimation.layers[1] = { 1, animationTime, waveWeight };
+		if (skeletonClips.size() > 2) {
+			skeletonAnimation.layers[2] = { 2, animationTime, nodWeight, ns::AnimationLayerMode::PARTIAL };
+			skeletonAnimation.numLayers = 3;
+		}
+		ns::sampleCharacters(skeleton, skeletonClips.data(), &skeletonAnimation, 1, &skeletonPose, nullptr);
+		ns::applyPose(skeletonPose, &hierarchy);
+		if (animationBenchmarkRequested) {
+			BenchmarkAnimation(&jobSystem);
+			animationBenchmarkRequested = false;
+		}
+		skeletonNodesUpdated = ns::updateHierarchyTransforms(&hierarchy);
+		if (fkBenchmarkRequested) {
+			BenchmarkFK(&jobSystem);
+			fkBenchmarkRequested = false;
+		}
+		instancedShader.use();
+		SetLightingUniforms(instancedShader, instancedCascadeUniforms);
+		DrawNodes(hierarchy, monkeyModel, cameraFrustum);
+
+		//Skinned crowd
+		if (crowdEnabled) {
+			if (crowdDirty) {
+				LayoutCrowd(crowdCount);
+				crowdDirty = false;
+			}
+			auto crowdStart = std::chrono::high_resolution_clock::now();
+			for (int i = 0; i < crowdCount; i++)
+			{
+				crowdAnimations[i].layers[0].time += deltaTime;
+				crowdAnimations[i].layers[1].time += deltaTime;
+			}
+			ns::sampleCharacters(skeleton, skeletonClips.data(), crowdAnimations.data(), crowdCount, crowdPoses.data(), &jobSystem);
+			jobSystem.parallelFor((unsigned int)crowdCount, 256, [](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+				for (unsigned int i = begin; i < end; i++)
+				{
+					ns::applyPose(crowdPoses[i], &crowdFK, i * NODECOUNT);
+				}
+			});
+			ns::solveFK(&crowdFK, &jobSystem);
+			unsigned int paletteSize = (unsigned int)crowdSkin.joints.size();
+			glm::mat4* palettes = ns::beginJointPalettes(&crowdPalettes, crowdCount * paletteSize);
+			ns::computeJointPalettes(crowdSkin, crowdFK, crowdCount, NODECOUNT, palettes, &jobSystem);
+			std::chrono::duration<float, std::milli> crowdTime = std::chrono::high_resolution_clock::now() - crowdStart;
+			crowdUpdateMs = glm::mix(crowdUpdateMs, crowdTime.count(), 0.05f);
+
+			ns::bindJointPalettes(crowdPalettes, 3);
+			skinnedShader.use();
+			SetLightingUniforms(skinnedShader, skinnedCascadeUniforms);
+			skinnedShader.setInt("_PaletteSize", (int)paletteSize);
+			crowdMesh.drawInstanced(crowdCount);
+			ns::fenceJointPalettes(&crowdPalettes);
+		}
 
 		//Scene
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		ns::bindFramebuffer(0);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		postProcessShader.use();
-		glBindTextureUnit(0, framebuffer.colorBuffer[0]);
-		glBindVertexArray(dummyVAO);
+		ns::bindTextureUnit(0, framebuffer.colorBuffer[0]);
+		ns::bindVertexArray(dummyVAO);
 		glDrawArrays(GL_TRIANGLES, 0, 3);
 
 		drawUI();
 
 		glfwSwapBuffers(window);
+		if (timeToFirstFrameMs == 0.0f) {
+			std::chrono::duration<float, std::milli> startupTime = std::chrono::high_resolution_clock::now() - startupStart;
+			timeToFirstFrameMs = startupTime.count();
+			printf("Time to first frame: %.3f ms\n", timeToFirstFrameMs);
+		}
 	}
 	printf("Shutting down...");
 }
@@ -198,8 +709,9 @@ void resetCamera(ew::Camera* camera, ew::CameraController* controller) {
 	controller->yaw = controller->pitch = 0;
 }
 
-void SolveFK(ns::Hierarchy hierarchy) {
-	for (int i = 0; i < hierarchy.nodeCount; i++)
+//Straight walk over the node array, parents must come before their children. Baseline for the FK benchmark
+void SolveFKReference(const ns::Hierarchy& hierarchy) {
+	for (unsigned int i = 0; i < hierarchy.nodeCount; i++)
 	{
 		if (hierarchy.nodes[i].parentIndex == -1)
 		{
@@ -233,27 +745,412 @@ void InitNodes() {
 	skeletonNodes[7] = ns::createNode(glm::vec3(0.0f, 1.5f, 0.0f), glm::quat(1.0f, 0.0f, 0.0f, 0.0f), glm::vec3(0.7f, 0.7f, 0.7f), 0);
 }
 
-void DrawNodes(ns::Hierarchy hierarchy, ew::Shader currentShader, ew::Model model) {
+//Draws every node with one instanced draw. Expects an instanced shader to be in use
+//Draws the nodes that intersect the frustum
+void DrawNodes(const ns::Hierarchy& hierarchy, ew::Model& model, const ns::Frustum& frustum) {
+	ew::MeshBounds bounds = model.getBounds();
+	int numVisible = 0;
 	for (int i = 0; i < hierarchy.nodeCount; i++)
 	{
-		currentShader.setMat4("_Model", hierarchy.nodes[i].globalTransform);
-		model.draw();
+		if (!ns::isBoundsVisible(frustum, hierarchy.nodes[i].globalTransform, bounds)) {
+			continue;
+		}
+		nodeInstances[numVisible].model = hierarchy.nodes[i].globalTransform;
+		nodeInstances[numVisible].color = glm::vec4(1.0f);
+		numVisible++;
+	}
+	if (numVisible == 0) {
+		return;
 	}
+	model.setInstanceData(nodeInstances, numVisible);
+	model.drawInstanced(numVisible);
 }
 
-void AnimNodes(ns::Hierarchy hierarchy) {
-	//Torso
-	hierarchy.nodes[0].rotation = glm::rotate(hierarchy.nodes[0].rotation, deltaTime, glm::vec3(0.0, -1.0, 0.0));
-	hierarchy.nodes[0].position = hierarchy.nodes[0].rotation * glm::vec3(2.0f, 0.0f, 0.0f);
+CascadeUniforms ResolveCascadeUniforms(const ew::Shader& shader) {
+	CascadeUniforms cascadeUniforms;
+	for (int i = 0; i < SHADOW_CASCADE_COUNT; i++)
+	{
+		cascadeUniforms.viewProjections[i] = shader.uniform("_CascadeViewProj[" + std::to_string(i) + "]");
+		cascadeUniforms.splits[i] = shader.uniform("_CascadeSplits[" + std::to_string(i) + "]");
+	}
+	return cascadeUniforms;
+}
 
-	//Shoulder L
-	hierarchy.nodes[1].rotation = glm::rotate(hierarchy.nodes[1].rotation, deltaTime, glm::vec3(0.0, 0.0, -0.2));
+//Camera, light, shadow and material uniforms shared by the lit shaders
+void SetLightingUniforms(const ew::Shader& shader, const CascadeUniforms& cascadeUniforms) {
+	shader.setInt("_MainTex", 0); //Make "_MainTex" sampler2D sample from the 2D texture bound to unit 0
+	shader.setMat4("_ViewProjection", camera.projectionMatrix() * camera.viewMatrix());
+	shader.setVec3("_EyePos", camera.position);
+	shader.setInt("_ShadowMap", 1);
+	shader.setMat4("_View", camera.viewMatrix());
+	shader.setInt("_NumCascades", (int)shadowMap.numCascades);
+	shader.setInt("_ShowCascades", showCascades);
+	for (unsigned int i = 0; i < shadowMap.numCascades; i++)
+	{
+		shader.setMat4(cascadeUniforms.viewProjections[i], shadowMap.viewProjections[i]);
+		shader.setFloat(cascadeUniforms.splits[i], shadowMap.splitDepths[i]);
+	}
+	//Light
+	shader.setVec3("_Light.LightDirection", light.lightDirection);
+	shader.setVec3("_Light.LightColor", light.lightColor);
+	shader.setVec3("_Light.AmbientColor", light.ambientColor);
+	shader.setFloat("_MinBias", minBias);
+	shader.setFloat("_MaxBias", maxBias);
+	//Material 
+	shader.setFloat("_Material.Ka", material.Ka);
+	shader.setFloat("_Material.Kd", material.Kd);
+	shader.setFloat("_Material.Ks", material.Ks);
+	shader.setFloat("_Material.Shininess", material.Shininess);
+}
 
-	//Shoulder R
-	hierarchy.nodes[4].rotation = glm::rotate(hierarchy.nodes[4].rotation, deltaTime, glm::vec3(0.0, 0.0, 0.2));
+//Square grid of Suzannes behind the skeleton
+void LayoutStressTest(int count) {
+	stressInstances.resize(count);
+	int side = (int)ceilf(sqrtf((float)count));
+	const float spacing = 3.0f;
+	for (int i = 0; i < count; i++)
+	{
+		float x = ((i % side) - side * 0.5f) * spacing;
+		float z = -8.0f - (i / side) * spacing;
+		stressInstances[i].model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+		stressInstances[i].color = glm::vec4(1.0f);
+	}
+}
 
-	//Head
-	hierarchy.nodes[7].position.y = glm::mix(1.6f, 2.0f, sin((float)glfwGetTime() * 3.0f));
+//Bobs every object up and down and updates its culling sphere and BVH bounds, split across the thread pool
+void AnimateStressTest(ns::JobSystem* jobSystem, const ew::MeshBounds& bounds, float time) {
+	auto start = std::chrono::high_resolution_clock::now();
+	jobSystem->parallelFor((unsigned int)stressTestCount, 1024, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+		for (unsigned int i = begin; i < end; i++)
+		{
+			glm::mat4& model = stressInstances[i].model;
+			model[3].y = sinf(time * 2.0f + model[3].x * 0.3f + model[3].z * 0.2f) * 2.0f;
+			ns::setSphere(&stressSpheres, i, model, bounds);
+			glm::vec3 min, max;
+			ns::transformBounds(model, bounds, &min, &max);
+			ns::setBVHObjectBounds(&stressBVH, i, min, max);
+		}
+	});
+	stressInstancesChanged = true;
+	std::chrono::duration<float, std::milli> animateTime = std::chrono::high_resolution_clock::now() - start;
+	stressAnimateMs = glm::mix(stressAnimateMs, animateTime.count(), 0.05f);
+}
+
+//Left click casts a ray from the cursor through the stress test BVH. The object hit is tinted red and
+//the objects within stressPickRadius of the hit point are tinted yellow
+void PickStressTest(GLFWwindow* window) {
+	if (ImGui::GetIO().WantCaptureMouse || !ImGui::IsMouseClicked(0)) {
+		return;
+	}
+	for (size_t i = 0; i < stressTinted.size(); i++)
+	{
+		if (stressTinted[i] < stressInstances.size()) {
+			stressInstances[stressTinted[i]].color = glm::vec4(1.0f);
+		}
+	}
+	stressTinted.clear();
+	stressPicked = -1;
+	stressInstancesChanged = true;
+
+	double mouseX, mouseY;
+	glfwGetCursorPos(window, &mouseX, &mouseY);
+	glm::vec2 ndc = glm::vec2((float)mouseX / screenWidth, 1.0f - (float)mouseY / screenHeight) * 2.0f - 1.0f;
+	glm::mat4 inverseViewProj = glm::inverse(camera.projectionMatrix() * camera.viewMatrix());
+	glm::vec4 nearPoint = inverseViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+	glm::vec4 farPoint = inverseViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+	glm::vec3 direction = glm::vec3(farPoint) / farPoint.w - origin;
+	float maxDistance = glm::length(direction);
+	direction /= maxDistance;
+
+	unsigned int hit;
+	float hitDistance;
+	if (!ns::raycastBVH(stressBVH, origin, direction, maxDistance, &hit, &hitDistance)) {
+		return;
+	}
+	stressPicked = (int)hit;
+	ns::queryBVHSphere(stressBVH, origin + direction * hitDistance, stressPickRadius, &stressTinted);
+	for (size_t i = 0; i < stressTinted.size(); i++)
+	{
+		stressInstances[stressTinted[i]].color = glm::vec4(1.0f, 1.0f, 0.3f, 1.0f);
+	}
+	//The hit object is always inside the sphere, so it is already in stressTinted
+	stressInstances[hit].color = glm::vec4(1.0f, 0.2f, 0.2f, 1.0f);
+}
+
+void BenchmarkFK(ns::JobSystem* jobSystem) {
+	const int iterations = 10;
+	unsigned int numJoints = (unsigned int)(fkBenchmarkSkeletons * fkBenchmarkJoints);
+	//Every joint hangs off a random earlier joint of its own skeleton
+	std::vector<int> parents(numJoints);
+	std::vector<ns::Node> nodes(numJoints);
+	for (unsigned int i = 0; i < numJoints; i++)
+	{
+		unsigned int joint = i % fkBenchmarkJoints;
+		unsigned int first = i - joint;
+		parents[i] = joint == 0 ? -1 : (int)(first + rand() % joint);
+		float angle = (float)(rand() % 360);
+		nodes[i] = ns::createNode(glm::vec3(0.0f, 1.0f, 0.0f), glm::angleAxis(glm::radians(angle), glm::vec3(0.0f, 0.0f, 1.0f)), glm::vec3(1.0f), (unsigned int)parents[i]);
+	}
+	ns::Hierarchy hierarchy;
+	hierarchy.nodes = nodes.data();
+	hierarchy.nodeCount = numJoints;
+	ns::FKHierarchy fk = ns::createFKHierarchy(hierarchy);
+	ns::initHierarchy(&hierarchy);
+	ns::updateHierarchyTransforms(&hierarchy);
+	std::vector<unsigned int> changed((size_t)(numJoints * fkBenchmarkChangedPercent / 100.0f));
+	for (size_t i = 0; i < changed.size(); i++)
+	{
+		changed[i] = (unsigned int)(rand() % numJoints);
+	}
+
+	auto time = [&](auto solve) {
+		solve();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			solve();
+		}
+		std::chrono::duration<float> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return (float)numJoints * iterations / elapsed.count();
+	};
+	fkReferenceJointsPerSec = time([&]() { SolveFKReference(hierarchy); });
+	fkSingleJointsPerSec = time([&]() { ns::solveFK(&fk, nullptr); });
+	fkMultiJointsPerSec = time([&]() { ns::solveFK(&fk, jobSystem); });
+	fkDirtyJointsPerSec = time([&]() {
+		for (size_t i = 0; i < changed.size(); i++)
+		{
+			ns::markNodeDirty(&hierarchy, changed[i]);
+		}
+		ns::updateHierarchyTransforms(&hierarchy);
+	});
+	printf("FK, %d skeletons x %d joints (%zu levels): node walk %.1f M joints/s, SoA 1 thread %.1f M joints/s, SoA %u threads %.1f M joints/s, dirty (%.1f%% changed) %.1f M joints/s\n",
+		fkBenchmarkSkeletons, fkBenchmarkJoints, fk.levelStart.size() - 1, fkReferenceJointsPerSec / 1e6f, fkSingleJointsPerSec / 1e6f, jobSystem->getNumThreads(), fkMultiJointsPerSec / 1e6f,
+		fkBenchmarkChangedPercent, fkDirtyJointsPerSec / 1e6f);
+}
+
+//Average CPU time to get mesh data in memory, GPU upload is the same for all three and is left out
+void BenchmarkModelLoading() {
+	std::chrono::duration<float, std::milli> objTime(0.0f), fbxTime(0.0f), cachedTime(0.0f);
+	size_t nonZeroVertices = 0;
+	for (int i = 0; i < LOAD_BENCHMARK_ITERATIONS; i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		std::vector<ew::MeshData> objMeshes = ew::loadModelMeshData("assets/suzanne.obj");
+		auto end = std::chrono::high_resolution_clock::now();
+		objTime += end - start;
+
+		start = std::chrono::high_resolution_clock::now();
+		std::vector<ew::MeshData> fbxMeshes = ew::loadModelMeshData("assets/suzanne.fbx");
+		end = std::chrono::high_resolution_clock::now();
+		fbxTime += end - start;
+
+		start = std::chrono::high_resolution_clock::now();
+		ns::MeshCache cache;
+		if (ns::openMeshCache("assets/suzanne.obj", &cache)) {
+			//Touch every vertex so the pages are actually read in
+			for (size_t j = 0; j < cache.meshes.size(); j++)
+			{
+				for (unsigned int k = 0; k < cache.meshes[j].numVertices; k++)
+				{
+					nonZeroVertices += cache.meshes[j].vertices[k].pos.x != 0.0f;
+				}
+			}
+			ns::closeMeshCache(&cache);
+		}
+		end = std::chrono::high_resolution_clock::now();
+		cachedTime += end - start;
+	}
+	//Keeps the reads above from being optimized away
+	volatile size_t sink = nonZeroVertices;
+	(void)sink;
+	std::vector<ew::MeshData> suzanneMeshes = ns::loadCachedMeshData("assets/suzanne.obj");
+	if (!suzanneMeshes.empty()) {
+		suzanneCompressionReport = ew::measureVertexCompression(suzanneMeshes[0].vertices.data(), (unsigned int)suzanneMeshes[0].vertices.size());
+		PrintCompressionReport("Suzanne", suzanneCompressionReport);
+	}
+	objLoadMs = objTime.count() / LOAD_BENCHMARK_ITERATIONS;
+	fbxLoadMs = fbxTime.count() / LOAD_BENCHMARK_ITERATIONS;
+	cachedLoadMs = cachedTime.count() / LOAD_BENCHMARK_ITERATIONS;
+	printf("Model load (avg of %d): OBJ %.3f ms, FBX %.3f ms, cached %.3f ms\n", LOAD_BENCHMARK_ITERATIONS, objLoadMs, fbxLoadMs, cachedLoadMs);
+}
+
+void PrintCompressionReport(const char* name, const ew::VertexCompressionReport& report) {
+	printf("%s: %zu -> %zu bytes, max error position %f, normal %.3f deg, uv %f\n", name, report.fullBytes, report.compactBytes,
+		report.maxPositionError, report.maxNormalErrorDegrees, report.maxUVError);
+}
+
+//Spin reproduces the torso orbit, shoulder spin and head bob the skeleton always had. Wave raises and lowers the arms.
+//Elbows and wrists have no tracks and keep their bind pose
+void CreateSkeletonClips() {
+	const int numKeys = 64;
+	ns::RawAnimationClip spin;
+	spin.name = "Spin";
+	spin.duration = glm::two_pi<float>();
+	spin.tracks.resize(4);
+	spin.tracks[0].joint = 0; //Torso
+	spin.tracks[1].joint = 1; //Shoulder L
+	spin.tracks[2].joint = 4; //Shoulder R
+	spin.tracks[3].joint = 7; //Head
+	for (int i = 0; i <= numKeys; i++)
+	{
+		float time = spin.duration * i / numKeys;
+		glm::quat torsoRotation = skeleton.bindRotations[0] * glm::angleAxis(time, glm::vec3(0.0f, -1.0f, 0.0f));
+		spin.tracks[0].rotationTimes.push_back(time);
+		spin.tracks[0].rotations.push_back(torsoRotation);
+		spin.tracks[0].positionTimes.push_back(time);
+		spin.tracks[0].positions.push_back(torsoRotation * glm::vec3(2.0f, 0.0f, 0.0f));
+		spin.tracks[1].rotationTimes.push_back(time);
+		spin.tracks[1].rotations.push_back(skeleton.bindRotations[1] * glm::angleAxis(time, glm::vec3(0.0f, 0.0f, -1.0f)));
+		spin.tracks[2].rotationTimes.push_back(time);
+		spin.tracks[2].rotations.push_back(skeleton.bindRotations[4] * glm::angleAxis(time, glm::vec3(0.0f, 0.0f, 1.0f)));
+		spin.tracks[3].positionTimes.push_back(time);
+		spin.tracks[3].positions.push_back(glm::vec3(skeleton.bindPositions[7].x, glm::mix(1.6f, 2.0f, sinf(time * 3.0f)), skeleton.bindPositions[7].z));
+	}
+
+	ns::RawAnimationClip wave;
+	wave.name = "Wave";
+	wave.duration = 2.0f;
+	wave.tracks.resize(2);
+	wave.tracks[0].joint = 1;
+	wave.tracks[1].joint = 4;
+	for (int i = 0; i <= numKeys; i++)
+	{
+		float time = wave.duration * i / numKeys;
+		float angle = sinf(time / wave.duration * glm::two_pi<float>()) * 1.2f;
+		wave.tracks[0].rotationTimes.push_back(time);
+		wave.tracks[0].rotations.push_back(skeleton.bindRotations[1] * glm::angleAxis(angle, glm::vec3(1.0f, 0.0f, 0.0f)));
+		wave.tracks[1].rotationTimes.push_back(time);
+		wave.tracks[1].rotations.push_back(skeleton.bindRotations[4] * glm::angleAxis(angle, glm::vec3(1.0f, 0.0f, 0.0f)));
+	}
+
+	skeletonClips.clear();
+	skeletonClips.push_back(ns::compressAnimationClip(spin, skeleton));
+	skeletonClips.push_back(ns::compressAnimationClip(wave, skeleton));
+	//Nod is authored in a file instead of here. It only turns the head, so it is played as a partial layer:
+	//its constant head position and scale keys would otherwise cancel the bob from spin
+	std::vector<ns::AnimationClip> importedClips;
+	if (ns::loadModelClips("assets/nod.dae", skeleton, &importedClips) && !importedClips.empty()) {
+		skeletonClips.push_back(importedClips[0]);
+	}
+	for (size_t i = 0; i < skeletonClips.size(); i++)
+	{
+		printf("Clip %s: %u frames, %zu -> %zu bytes\n", skeletonClips[i].name.c_str(), skeletonClips[i].numFrames,
+			ns::getUncompressedClipMemory(skeletonClips[i]), ns::getClipMemory(skeletonClips[i]));
+	}
+}
+
+//Suzanne placed at every node's bind pose and rigidly skinned to it, as one mesh. The bind pose uses normalized
+//rotations, the same ones the clips are sampled with
+void CreateCrowdMesh(const std::vector<ew::MeshData>& meshes) {
+	ns::FKHierarchy bindFK = ns::createFKHierarchy(skeleton.parents.data(), NODECOUNT);
+	for (unsigned int i = 0; i < NODECOUNT; i++)
+	{
+		ns::setFKLocalPose(&bindFK, i, skeleton.bindPositions[i], glm::normalize(skeleton.bindRotations[i]), skeleton.bindScales[i]);
+	}
+	ns::solveFK(&bindFK, nullptr);
+
+	ew::MeshData crowdData;
+	crowdSkin = ns::Skin();
+	for (unsigned int joint = 0; joint < NODECOUNT; joint++)
+	{
+		const glm::mat4& bind = ns::getFKGlobalTransform(bindFK, joint);
+		glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(bind)));
+		unsigned int jointIndices[4] = { ns::addSkinJoint(&crowdSkin, joint, glm::inverse(bind)), 0, 0, 0 };
+		float jointWeights[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+		ew::VertexSkin vertexSkin = ns::packVertexSkin(jointIndices, jointWeights);
+		for (size_t m = 0; m < meshes.size(); m++)
+		{
+			unsigned int firstVertex = (unsigned int)crowdData.vertices.size();
+			for (size_t v = 0; v < meshes[m].vertices.size(); v++)
+			{
+				ew::Vertex vertex = meshes[m].vertices[v];
+				vertex.pos = glm::vec3(bind * glm::vec4(vertex.pos, 1.0f));
+				vertex.normal = glm::normalize(normalMatrix * vertex.normal);
+				crowdData.vertices.push_back(vertex);
+				crowdData.skin.push_back(vertexSkin);
+			}
+			//Full detail only
+			unsigned int numIndices = meshes[m].lods.empty() ? (unsigned int)meshes[m].indices.size() : meshes[m].lods[0].indexCount;
+			for (unsigned int k = 0; k < numIndices; k++)
+			{
+				crowdData.indices.push_back(firstVertex + meshes[m].indices[k]);
+			}
+		}
+	}
+	crowdData.format = ew::chooseVertexFormat(crowdData.vertices.data(), (unsigned int)crowdData.vertices.size());
+	crowdMesh.load(crowdData);
+}
+
+//Square grid of characters to the right of the skeleton, each starting both clips at its own time
+void LayoutCrowd(int count) {
+	std::vector<int> parents(count * NODECOUNT);
+	for (int i = 0; i < count * NODECOUNT; i++)
+	{
+		int parent = skeleton.parents[i % NODECOUNT];
+		parents[i] = parent < 0 ? -1 : (i / NODECOUNT) * NODECOUNT + parent;
+	}
+	crowdFK = ns::createFKHierarchy(parents.data(), (unsigned int)parents.size());
+	crowdAnimations.resize(count);
+	crowdPoses.resize(count);
+	crowdInstances.resize(count);
+	int side = (int)ceilf(sqrtf((float)count));
+	const float spacing = 8.0f;
+	for (int i = 0; i < count; i++)
+	{
+		float weight = (float)(i % 5) / 4.0f;
+		float start = (float)(i % 17) * 0.37f;
+		crowdAnimations[i].numLayers = 2;
+		crowdAnimations[i].layers[0] = { 0, start, 1.0f - weight };
+		crowdAnimations[i].layers[1] = { 1, start, weight };
+		ns::resizePose(&crowdPoses[i], NODECOUNT);
+		float x = 12.0f + (i % side) * spacing;
+		float z = -(i / side) * spacing;
+		crowdInstances[i].model = glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z));
+		crowdInstances[i].color = glm::vec4(1.0f);
+	}
+	crowdMesh.setInstanceData(crowdInstances.data(), (unsigned int)count);
+}
+
+void BenchmarkAnimation(ns::JobSystem* jobSystem) {
+	const int iterations = 10;
+	unsigned int numCharacters = (unsigned int)animationBenchmarkCharacters;
+	std::vector<ns::CharacterAnimation> characters(numCharacters);
+	for (unsigned int i = 0; i < numCharacters; i++)
+	{
+		float weight = (float)(rand() % 101) / 100.0f;
+		characters[i].numLayers = 2;
+		characters[i].layers[0] = { 0, (float)(rand() % 1000) / 100.0f, 1.0f - weight };
+		characters[i].layers[1] = { 1, (float)(rand() % 1000) / 100.0f, weight };
+	}
+	std::vector<ns::Pose> singlePoses(numCharacters), multiPoses(numCharacters);
+	for (unsigned int i = 0; i < numCharacters; i++)
+	{
+		ns::resizePose(&singlePoses[i], NODECOUNT);
+		ns::resizePose(&multiPoses[i], NODECOUNT);
+	}
+
+	auto time = [&](auto sample) {
+		sample();
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int i = 0; i < iterations; i++)
+		{
+			sample();
+		}
+		std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+		return elapsed.count() / iterations;
+	};
+	animationSingleMs = time([&]() { ns::sampleCharacters(skeleton, skeletonClips.data(), characters.data(), numCharacters, singlePoses.data(), nullptr); });
+	animationMultiMs = time([&]() { ns::sampleCharacters(skeleton, skeletonClips.data(), characters.data(), numCharacters, multiPoses.data(), jobSystem); });
+	animationDeterministic = true;
+	for (unsigned int i = 0; i < numCharacters && animationDeterministic; i++)
+	{
+		animationDeterministic = memcmp(singlePoses[i].positions.data(), multiPoses[i].positions.data(), NODECOUNT * sizeof(glm::vec3)) == 0
+			&& memcmp(singlePoses[i].rotations.data(), multiPoses[i].rotations.data(), NODECOUNT * sizeof(glm::quat)) == 0
+			&& memcmp(singlePoses[i].scales.data(), multiPoses[i].scales.data(), NODECOUNT * sizeof(glm::vec3)) == 0;
+	}
+	printf("Animation, %u characters x 2 clips: 1 thread %.3f ms, %u threads %.3f ms, %s\n", numCharacters, animationSingleMs,
+		jobSystem->getNumThreads(), animationMultiMs, animationDeterministic ? "identical poses" : "POSES DIFFER");
 }
 
 void drawUI() {
@@ -265,6 +1162,121 @@ void drawUI() {
 	if (ImGui::Button("Reset Camera")) {
 		resetCamera(&camera, &cameraController);
 	}
+	if (ImGui::CollapsingHeader("Shadows")) {
+		ImGui::SliderFloat("Shadow distance", &shadowDistance, 5.0f, 100.0f);
+		ImGui::SliderFloat("Split lambda", &shadowMap.splitLambda, 0.0f, 1.0f);
+		ImGui::SliderFloat("Caster distance", &shadowCasterDistance, 0.0f, 50.0f);
+		ImGui::Checkbox("Show cascades", &showCascades);
+		ImGui::Checkbox("Cache static casters", &shadowMap.cacheEnabled);
+		ImGui::Text("%u x %dx%d, %zu KB with cache", shadowMap.numCascades, SHADOW_CASCADE_RESOLUTION, SHADOW_CASCADE_RESOLUTION, ns::getCascadedShadowMapMemory(shadowMap) / 1024);
+		ImGui::Text("Static casters redrawn in %u / %u cascades (%.2f per frame on average)", shadowMap.numStaticRedraws, shadowMap.numCascades, staticRedrawRate);
+		ImGui::Text("Shadow pass (GPU time): %.3f ms", shadowPassTimer.ms);
+		for (unsigned int i = 0; i < shadowMap.numCascades; i++)
+		{
+			ImGui::Text("Cascade %u ends at %.2f", i, shadowMap.splitDepths[i]);
+		}
+	}
+	if (ImGui::CollapsingHeader("Model Loading")) {
+		ImGui::Text("Time to first frame: %.3f ms", timeToFirstFrameMs);
+		ImGui::SliderFloat("Upload budget (ms)", &assetUploadBudgetMs, 0.1f, 16.0f);
+		ImGui::Text("OBJ import: %.3f ms", objLoadMs);
+		ImGui::Text("FBX import: %.3f ms", fbxLoadMs);
+		ImGui::Text("Mesh cache: %.3f ms", cachedLoadMs);
+		if (ImGui::Button("Rerun")) {
+			BenchmarkModelLoading();
+		}
+	}
+	if (ImGui::CollapsingHeader("Vertex Format")) {
+		ImGui::Checkbox("Benchmark", &vertexBenchmarkEnabled);
+		ImGui::SliderInt("Draws", &vertexBenchmarkDraws, 1, 64);
+		ImGui::Text("Full (32 B): %.3f ms", fullVertexTimer.ms);
+		ImGui::Text("Compact (16 B): %.3f ms", compactVertexTimer.ms);
+		const ew::VertexCompressionReport* reports[2] = { &sphereCompressionReport, &suzanneCompressionReport };
+		const char* reportNames[2] = { "Sphere", "Suzanne" };
+		for (int i = 0; i < 2; i++)
+		{
+			ImGui::Text("%s: %zu -> %zu KB", reportNames[i], reports[i]->fullBytes / 1024, reports[i]->compactBytes / 1024);
+			ImGui::Text("  max error pos %.5f, normal %.3f deg, uv %.5f", reports[i]->maxPositionError, reports[i]->maxNormalErrorDegrees, reports[i]->maxUVError);
+		}
+	}
+	if (ImGui::CollapsingHeader("Forward Kinematics")) {
+		ImGui::SliderInt("Skeletons", &fkBenchmarkSkeletons, 1, 5000);
+		ImGui::SliderInt("Joints per skeleton", &fkBenchmarkJoints, 1, 500);
+		ImGui::SliderFloat("Changed joints (%)", &fkBenchmarkChangedPercent, 0.1f, 100.0f);
+		if (ImGui::Button("Run FK benchmark")) {
+			fkBenchmarkRequested = true;
+		}
+		ImGui::Text("Node walk: %.1f M joints/s", fkReferenceJointsPerSec / 1e6f);
+		ImGui::Text("SoA, 1 thread: %.1f M joints/s", fkSingleJointsPerSec / 1e6f);
+		ImGui::Text("SoA, all threads: %.1f M joints/s", fkMultiJointsPerSec / 1e6f);
+		ImGui::Text("Dirty propagation: %.1f M joints/s", fkDirtyJointsPerSec / 1e6f);
+		ImGui::Text("Skeleton nodes updated last frame: %u / %d", skeletonNodesUpdated, NODECOUNT);
+	}
+	if (ImGui::CollapsingHeader("Animation")) {
+		ImGui::SliderFloat("Wave weight", &waveWeight, 0.0f, 1.0f);
+		if (skeletonClips.size() > 2) {
+			ImGui::SliderFloat("Nod weight", &nodWeight, 0.0f, 1.0f);
+		}
+		for (size_t i = 0; i < skeletonClips.size(); i++)
+		{
+			ImGui::Text("%s: %zu -> %zu bytes", skeletonClips[i].name.c_str(), ns::getUncompressedClipMemory(skeletonClips[i]), ns::getClipMemory(skeletonClips[i]));
+		}
+		ImGui::SliderInt("Characters", &animationBenchmarkCharacters, 1, 20000);
+		if (ImGui::Button("Run animation benchmark")) {
+			animationBenchmarkRequested = true;
+		}
+		ImGui::Text("1 thread: %.3f ms", animationSingleMs);
+		ImGui::Text("All threads: %.3f ms", animationMultiMs);
+		ImGui::Text("Results %s", animationDeterministic ? "identical" : "differ");
+	}
+	if (ImGui::CollapsingHeader("Skinned Crowd")) {
+		ImGui::Checkbox("Enabled##Crowd", &crowdEnabled);
+		if (ImGui::SliderInt("Characters##Crowd", &crowdCount, 1, MAX_CROWD_CHARACTERS)) {
+			crowdDirty = true;
+		}
+		ImGui::Text("Animate + FK + palettes: %.3f ms", crowdUpdateMs);
+		ImGui::Text("Palette: %zu joints, %zu KB per frame", crowdSkin.joints.size(), crowdCount * crowdSkin.joints.size() * sizeof(glm::mat4) / 1024);
+		ImGui::Text("Draw calls: 1");
+	}
+	if (ImGui::CollapsingHeader("Stress Test")) {
+		ImGui::Checkbox("Enabled", &stressTestEnabled);
+		ImGui::Combo("Mode", &stressTestMode, stressTestModeNames, IM_ARRAYSIZE(stressTestModeNames));
+		ImGui::Checkbox("Frustum culling", &stressCullingEnabled);
+		ImGui::Combo("Culling", &stressCullMode, stressCullModeNames, IM_ARRAYSIZE(stressCullModeNames));
+		ImGui::Text("Visible: %u / %d", stressVisibleCount, stressTestCount);
+		if (stressCullingEnabled && stressCullThreads > 0) {
+			ImGui::Text("Cull: %.3f ms (%.3f ms CPU over %u threads)", stressCullWallMs, stressCullThreadMs, stressCullThreads);
+			ImGui::Text("  %.3f ms per core", stressCullThreadMs / stressCullThreads);
+		}
+		ImGui::Checkbox("Animate objects", &stressAnimate);
+		ImGui::Text("BVH build: %.3f ms (%zu nodes)", stressBVHBuildMs, stressBVH.nodes.size());
+		if (stressAnimate) {
+			ImGui::Text("BVH refit: %.3f ms, object update %.3f ms", stressBVHRefitMs, stressAnimateMs);
+		}
+		ImGui::SliderFloat("Pick radius", &stressPickRadius, 0.0f, 50.0f);
+		if (stressPicked >= 0) {
+			ImGui::Text("Picked object %d, %zu others in radius", stressPicked, stressTinted.empty() ? (size_t)0 : stressTinted.size() - 1);
+		}
+		ImGui::Checkbox("LOD selection", &stressLODEnabled);
+		ImGui::SliderFloat("Max pixel error", &lodMaxPixelError, 0.1f, 16.0f);
+		ImGui::Text("Triangles: %u", stressTrianglesDrawn);
+		for (int i = 0; i < MAX_LODS; i++)
+		{
+			if (stressLODCounts[i] > 0) {
+				ImGui::Text("  LOD %d: %d objects", i, stressLODCounts[i]);
+			}
+		}
+		if (ImGui::SliderInt("Count", &stressTestCount, 1, MAX_STRESS_TEST_COUNT)) {
+			stressTestDirty = true;
+		}
+		if (stressTestMode == STRESS_PER_OBJECT) {
+			ImGui::Checkbox("Sort draws", &stressSortDraws);
+			if (stressSortDraws) {
+				ImGui::Text("Queue: %zu draws, sort %.3f ms", stressQueue.keys.size(), stressSortMs);
+			}
+		}
+		ImGui::Text("CPU submission: %.3f ms", stressSubmitMs);
+	}
 	ImGui::End();
 
 	ImGui::Render();
@@ -273,7 +1285,7 @@ void drawUI() {
 
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
-	glViewport(0, 0, width, height);
+	ns::setViewport(0, 0, width, height);
 	screenWidth = width;
 	screenHeight = height;
 }
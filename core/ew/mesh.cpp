@@ -7,6 +7,9 @@
 
 #include "mesh.h"
 #include "external/glad.h"
+#include "../ns/glState.h"
+#include <glm/gtc/packing.hpp>
+#include <math.h>
 
 namespace ew {
 	Mesh::Mesh(const MeshData& meshData)
@@ -14,57 +17,282 @@ namespace ew {
 		load(meshData);
 	}
 	void Mesh::load(const MeshData& meshData)
+	{
+		load(meshData.vertices.data(), (unsigned int)meshData.vertices.size(), meshData.indices.data(), (unsigned int)meshData.indices.size(), meshData.format);
+		setLODs(meshData.lods);
+		if (!meshData.skin.empty()) {
+			setSkin(meshData.skin.data(), (unsigned int)meshData.skin.size());
+		}
+	}
+	void Mesh::load(const Vertex* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices, VertexFormat format)
 	{
 		if (!m_initialized) {
 			glGenVertexArrays(1, &m_vao);
-			glBindVertexArray(m_vao);
+			ns::bindVertexArray(m_vao);
 
 			glGenBuffers(1, &m_vbo);
 			glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 
 			glGenBuffers(1, &m_ebo);
 			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
-			//Position attribute
-			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
 			glEnableVertexAttribArray(0);
-
-			//Normal attribute
-			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
 			glEnableVertexAttribArray(1);
-
-			//UV attribute
-			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
 			glEnableVertexAttribArray(2);
 
 			m_initialized = true;
 		}
 
-		glBindVertexArray(m_vao);
+		ns::bindVertexArray(m_vao);
 		glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
 
-		if (meshData.vertices.size() > 0) {
-			glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * meshData.vertices.size(), meshData.vertices.data(), GL_STATIC_DRAW);
+		//Attribute layout depends on the format, so it is set on every load
+		if (format == VertexFormat::COMPACT) {
+			//Position attribute
+			glVertexAttribPointer(0, 3, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (const void*)offsetof(CompactVertex, pos));
+			//Normal attribute
+			glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(CompactVertex), (const void*)offsetof(CompactVertex, normal));
+			//UV attribute
+			glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertex), (const void*)offsetof(CompactVertex, uv));
+			if (numVertices > 0) {
+				std::vector<CompactVertex> compactVertices(numVertices);
+				for (unsigned int i = 0; i < numVertices; i++)
+				{
+					compactVertices[i] = compressVertex(vertices[i]);
+				}
+				glBufferData(GL_ARRAY_BUFFER, sizeof(CompactVertex) * numVertices, compactVertices.data(), GL_STATIC_DRAW);
+			}
 		}
-		if (meshData.indices.size() > 0) {
-			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * meshData.indices.size(), meshData.indices.data(), GL_STATIC_DRAW);
+		else {
+			//Position attribute
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, pos));
+			//Normal attribute
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)offsetof(Vertex, normal));
+			//UV attribute
+			glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const void*)(offsetof(Vertex, uv)));
+			if (numVertices > 0) {
+				glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * numVertices, vertices, GL_STATIC_DRAW);
+			}
 		}
-		m_numVertices = meshData.vertices.size();
-		m_numIndices = meshData.indices.size();
+		m_vertexFormat = format;
+		m_bounds = computeMeshBounds(vertices, numVertices);
+		if (numIndices > 0) {
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * numIndices, indices, GL_STATIC_DRAW);
+		}
+		m_numVertices = numVertices;
+		m_numIndices = numIndices;
+		m_lods.clear();
 
-		glBindVertexArray(0);
+		ns::bindVertexArray(0);
 		glBindBuffer(GL_ARRAY_BUFFER, 0);
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 	}
+	MeshBounds computeMeshBounds(const Vertex* vertices, unsigned int numVertices)
+	{
+		MeshBounds bounds;
+		if (numVertices == 0) {
+			return bounds;
+		}
+		bounds.min = vertices[0].pos;
+		bounds.max = vertices[0].pos;
+		for (unsigned int i = 1; i < numVertices; i++)
+		{
+			bounds.min = glm::min(bounds.min, vertices[i].pos);
+			bounds.max = glm::max(bounds.max, vertices[i].pos);
+		}
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		//Tighter than half the box diagonal for round meshes
+		float radiusSquared = 0.0f;
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			glm::vec3 toVertex = vertices[i].pos - bounds.center;
+			radiusSquared = glm::max(radiusSquared, glm::dot(toVertex, toVertex));
+		}
+		bounds.radius = sqrtf(radiusSquared);
+		return bounds;
+	}
+	MeshBounds mergeMeshBounds(const MeshBounds& a, const MeshBounds& b)
+	{
+		MeshBounds bounds;
+		bounds.min = glm::min(a.min, b.min);
+		bounds.max = glm::max(a.max, b.max);
+		bounds.center = (bounds.min + bounds.max) * 0.5f;
+		bounds.radius = glm::max(glm::length(a.center - bounds.center) + a.radius, glm::length(b.center - bounds.center) + b.radius);
+		return bounds;
+	}
+	CompactVertex compressVertex(const Vertex& vertex)
+	{
+		CompactVertex compact;
+		compact.pos[0] = glm::packHalf1x16(vertex.pos.x);
+		compact.pos[1] = glm::packHalf1x16(vertex.pos.y);
+		compact.pos[2] = glm::packHalf1x16(vertex.pos.z);
+		compact.pos[3] = glm::packHalf1x16(1.0f);
+		compact.normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.normal, 0.0f));
+		compact.uv[0] = glm::packHalf1x16(vertex.uv.x);
+		compact.uv[1] = glm::packHalf1x16(vertex.uv.y);
+		return compact;
+	}
+	Vertex decompressVertex(const CompactVertex& vertex)
+	{
+		Vertex full;
+		full.pos = glm::vec3(glm::unpackHalf1x16(vertex.pos[0]), glm::unpackHalf1x16(vertex.pos[1]), glm::unpackHalf1x16(vertex.pos[2]));
+		full.normal = glm::vec3(glm::unpackSnorm3x10_1x2(vertex.normal));
+		full.uv = glm::vec2(glm::unpackHalf1x16(vertex.uv[0]), glm::unpackHalf1x16(vertex.uv[1]));
+		return full;
+	}
+	VertexFormat chooseVertexFormat(const Vertex* vertices, unsigned int numVertices)
+	{
+		if (numVertices == 0) {
+			return VertexFormat::FULL;
+		}
+		glm::vec3 minPos = vertices[0].pos;
+		glm::vec3 maxPos = vertices[0].pos;
+		float maxUV = 0.0f;
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			minPos = glm::min(minPos, vertices[i].pos);
+			maxPos = glm::max(maxPos, vertices[i].pos);
+			maxUV = glm::max(maxUV, glm::max(fabsf(vertices[i].uv.x), fabsf(vertices[i].uv.y)));
+		}
+		glm::vec3 extent = maxPos - minPos;
+		float size = glm::max(extent.x, glm::max(extent.y, extent.z));
+		float maxCoordinate = glm::max(glm::max(fabsf(minPos.x), fabsf(maxPos.x)), glm::max(glm::max(fabsf(minPos.y), fabsf(maxPos.y)), glm::max(fabsf(minPos.z), fabsf(maxPos.z))));
+		//Half floats have 11 significant bits, so rounding error is at most 2^-11 of the magnitude
+		float positionError = maxCoordinate / 2048.0f;
+		float uvError = maxUV / 2048.0f;
+		if (maxCoordinate > 65504.0f || positionError > size / 1024.0f || uvError > 1.0f / 1024.0f) {
+			return VertexFormat::FULL;
+		}
+		return VertexFormat::COMPACT;
+	}
+	VertexCompressionReport measureVertexCompression(const Vertex* vertices, unsigned int numVertices)
+	{
+		VertexCompressionReport report;
+		report.fullBytes = sizeof(Vertex) * numVertices;
+		report.compactBytes = sizeof(CompactVertex) * numVertices;
+		report.maxPositionError = 0.0f;
+		report.maxNormalErrorDegrees = 0.0f;
+		report.maxUVError = 0.0f;
+		float minNormalCos = 1.0f;
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			Vertex decoded = decompressVertex(compressVertex(vertices[i]));
+			report.maxPositionError = glm::max(report.maxPositionError, glm::length(decoded.pos - vertices[i].pos));
+			report.maxUVError = glm::max(report.maxUVError, glm::length(decoded.uv - vertices[i].uv));
+			float normalLength = glm::length(vertices[i].normal);
+			if (normalLength > 0.0f) {
+				minNormalCos = glm::min(minNormalCos, glm::dot(glm::normalize(decoded.normal), vertices[i].normal / normalLength));
+			}
+		}
+		report.maxNormalErrorDegrees = glm::degrees(acosf(glm::clamp(minNormalCos, -1.0f, 1.0f)));
+		return report;
+	}
+	void Mesh::setLODs(const std::vector<MeshLOD>& lods)
+	{
+		m_lods = lods;
+	}
+	float Mesh::getLODError(unsigned int lod) const
+	{
+		if (m_lods.empty()) {
+			return 0.0f;
+		}
+		return m_lods[lod < m_lods.size() ? lod : m_lods.size() - 1].error;
+	}
+	unsigned int Mesh::getLODIndexCount(unsigned int lod) const
+	{
+		if (m_lods.empty()) {
+			return m_numIndices;
+		}
+		return m_lods[lod < m_lods.size() ? lod : m_lods.size() - 1].indexCount;
+	}
+	void Mesh::drawLOD(unsigned int lod) const
+	{
+		drawInstancedLOD(lod, 1, 0);
+	}
+	void Mesh::drawInstancedLOD(unsigned int lod, unsigned int instanceCount, unsigned int baseInstance) const
+	{
+		unsigned int firstIndex = 0;
+		unsigned int indexCount = m_numIndices;
+		if (!m_lods.empty()) {
+			const MeshLOD& range = m_lods[lod < m_lods.size() ? lod : m_lods.size() - 1];
+			firstIndex = range.firstIndex;
+			indexCount = range.indexCount;
+		}
+		ns::bindVertexArray(m_vao);
+		glDrawElementsInstancedBaseInstance(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, (const void*)(sizeof(unsigned int) * firstIndex), instanceCount, baseInstance);
+	}
 	void Mesh::draw(ew::DrawMode drawMode) const
 	{
-		glBindVertexArray(m_vao);
+		ns::bindVertexArray(m_vao);
 		if (drawMode == DrawMode::TRIANGLES) {
-			glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, NULL);
+			glDrawElements(GL_TRIANGLES, getLODIndexCount(0), GL_UNSIGNED_INT, NULL);
 		}
 		else {
 			glDrawArrays(GL_POINTS, 0, m_numVertices);
 		}
 		
 	}
+	/// <summary>
+	/// Uploads per-instance model matrices and colors for drawInstanced
+	/// </summary>
+	/// <param name="instances">Instance data, one entry per instance</param>
+	/// <param name="instanceCount">Number of instances</param>
+	void Mesh::setInstanceData(const InstanceData* instances, unsigned int instanceCount)
+	{
+		ns::bindVertexArray(m_vao);
+		if (m_instanceVbo == 0) {
+			glGenBuffers(1, &m_instanceVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+			//Model matrix, a mat4 attribute takes 4 consecutive locations
+			for (int i = 0; i < 4; i++)
+			{
+				glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const void*)(offsetof(InstanceData, model) + sizeof(glm::vec4) * i));
+				glEnableVertexAttribArray(3 + i);
+				glVertexAttribDivisor(3 + i, 1);
+			}
+			//Color attribute
+			glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (const void*)offsetof(InstanceData, color));
+			glEnableVertexAttribArray(7);
+			glVertexAttribDivisor(7, 1);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, m_instanceVbo);
+		if (instanceCount > m_instanceCapacity) {
+			m_instanceCapacity = instanceCount;
+		}
+		//Orphan the old storage so an upload never waits on draws still reading it
+		glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * m_instanceCapacity, NULL, GL_STREAM_DRAW);
+		if (instanceCount > 0) {
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * instanceCount, instances);
+		}
+		ns::bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	void Mesh::setSkin(const VertexSkin* skin, unsigned int numVertices)
+	{
+		ns::bindVertexArray(m_vao);
+		if (m_skinVbo == 0) {
+			glGenBuffers(1, &m_skinVbo);
+			glBindBuffer(GL_ARRAY_BUFFER, m_skinVbo);
+			//Joint indices stay integers
+			glVertexAttribIPointer(8, 4, GL_UNSIGNED_SHORT, sizeof(VertexSkin), (const void*)offsetof(VertexSkin, joints));
+			glEnableVertexAttribArray(8);
+			//Weights are normalized to [0, 1]
+			glVertexAttribPointer(9, 4, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(VertexSkin), (const void*)offsetof(VertexSkin, weights));
+			glEnableVertexAttribArray(9);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, m_skinVbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(VertexSkin) * numVertices, skin, GL_STATIC_DRAW);
+		ns::bindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+	void Mesh::drawInstanced(unsigned int instanceCount, ew::DrawMode drawMode) const
+	{
+		ns::bindVertexArray(m_vao);
+		if (drawMode == DrawMode::TRIANGLES) {
+			glDrawElementsInstanced(GL_TRIANGLES, getLODIndexCount(0), GL_UNSIGNED_INT, NULL, instanceCount);
+		}
+		else {
+			glDrawArraysInstanced(GL_POINTS, 0, m_numVertices, instanceCount);
+		}
+	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <vector>
+#include <stdint.h>
 
 namespace ew {
 	struct Vertex {
@@ -13,9 +14,72 @@ namespace ew {
 		glm::vec2 uv;
 	};
 
+	//Compact GPU layout, 16 bytes instead of 32: half float position (w unused), 10:10:10 snorm normal, half float UV.
+	//The hardware unpacks all three, so shaders read the same attributes as with Vertex
+	struct CompactVertex {
+		uint16_t pos[4];
+		uint32_t normal;
+		uint16_t uv[2];
+	};
+
+	//Joints that deform a vertex, as indices into the skin's joint palette, and their weights as unorm16 adding up to 65535.
+	//Stored in a second vertex buffer, shaders read the joints at location 8 and the weights at location 9
+	struct VertexSkin {
+		uint16_t joints[4];
+		uint16_t weights[4];
+	};
+
+	enum class VertexFormat {
+		FULL = 0,
+		COMPACT = 1
+	};
+
+	//Range of the index buffer holding one level of detail. All levels share the vertex buffer
+	struct MeshLOD {
+		unsigned int firstIndex;
+		unsigned int indexCount;
+		float error; //Largest deviation from the full mesh, in object space units
+	};
+
 	struct MeshData {
 		std::vector<Vertex> vertices;
 		std::vector<unsigned int> indices;
+		VertexFormat format = VertexFormat::FULL; //Layout used when uploaded
+		std::vector<MeshLOD> lods; //Empty if the whole index buffer is the only level
+		std::vector<VertexSkin> skin; //Empty for meshes that aren't skinned, otherwise one per vertex
+	};
+
+	//Object space bounds of a mesh
+	struct MeshBounds {
+		glm::vec3 min = glm::vec3(0.0f);
+		glm::vec3 max = glm::vec3(0.0f);
+		glm::vec3 center = glm::vec3(0.0f); //Bounding sphere, centered on the box
+		float radius = 0.0f;
+	};
+	MeshBounds computeMeshBounds(const Vertex* vertices, unsigned int numVertices);
+	//Smallest box/sphere around both. Sphere is around the merged box
+	MeshBounds mergeMeshBounds(const MeshBounds& a, const MeshBounds& b);
+
+	CompactVertex compressVertex(const Vertex& vertex);
+	Vertex decompressVertex(const CompactVertex& vertex);
+	//COMPACT if positions and UVs survive half precision with an error under 1/1024 of the mesh size, FULL otherwise
+	VertexFormat chooseVertexFormat(const Vertex* vertices, unsigned int numVertices);
+
+	//Size and worst case error of storing a mesh as CompactVertex
+	struct VertexCompressionReport {
+		size_t fullBytes;
+		size_t compactBytes;
+		float maxPositionError; //Object space units
+		float maxNormalErrorDegrees;
+		float maxUVError;
+	};
+	VertexCompressionReport measureVertexCompression(const Vertex* vertices, unsigned int numVertices);
+
+	//Per-instance attributes used by drawInstanced.
+	//Shaders read the model matrix at locations 3-6 (one column each) and the color at location 7
+	struct InstanceData {
+		glm::mat4 model;
+		glm::vec4 color;
 	};
 
 	enum class DrawMode {
@@ -28,15 +92,40 @@ namespace ew {
 		Mesh() {};
 		Mesh(const MeshData& meshData);
 		void load(const MeshData& meshData);
+		//Uploads vertices and indices straight from memory, e.g. a memory mapped mesh cache
+		void load(const Vertex* vertices, unsigned int numVertices, const unsigned int* indices, unsigned int numIndices, VertexFormat format = VertexFormat::FULL);
+		//Level 0 is used if none are set
+		void setLODs(const std::vector<MeshLOD>& lods);
 		void draw(DrawMode drawMode = DrawMode::TRIANGLES)const;
+		void drawInstanced(unsigned int instanceCount, DrawMode drawMode = DrawMode::TRIANGLES)const;
+		//lod is clamped to the coarsest level
+		void drawLOD(unsigned int lod)const;
+		void drawInstancedLOD(unsigned int lod, unsigned int instanceCount, unsigned int baseInstance = 0)const;
+		void setInstanceData(const InstanceData* instances, unsigned int instanceCount);
+		//Uploads joints and weights, one per vertex. Called by load for mesh data that has them
+		void setSkin(const VertexSkin* skin, unsigned int numVertices);
+		inline bool isSkinned()const { return m_skinVbo != 0; }
 		inline int getNumVertices()const { return m_numVertices; }
-		inline int getNumIndices()const { return m_numIndices; }
+		//Indices of the full mesh. The coarser levels follow them in the index buffer
+		inline int getNumIndices()const { return (int)getLODIndexCount(0); }
+		inline VertexFormat getVertexFormat()const { return m_vertexFormat; }
+		inline const MeshBounds& getBounds()const { return m_bounds; }
+		inline unsigned int getNumLODs()const { return m_lods.empty() ? 1 : (unsigned int)m_lods.size(); }
+		//Object space error of a level, 0 for the full mesh
+		float getLODError(unsigned int lod)const;
+		unsigned int getLODIndexCount(unsigned int lod)const;
 	private:
 		bool m_initialized = false;
 		unsigned int m_vao = 0;
 		unsigned int m_vbo = 0;
 		unsigned int m_ebo = 0;
+		unsigned int m_instanceVbo = 0; //Created on first setInstanceData
+		unsigned int m_instanceCapacity = 0;
+		unsigned int m_skinVbo = 0; //Created on first setSkin
 		unsigned int m_numVertices = 0;
 		unsigned int m_numIndices = 0;
+		VertexFormat m_vertexFormat = VertexFormat::FULL;
+		std::vector<MeshLOD> m_lods;
+		MeshBounds m_bounds; //Computed on load
 	};
 }
\ No newline at end of file
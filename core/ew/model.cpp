@@ -3,26 +3,64 @@
 */
 
 #include "model.h"
+#include "../ns/meshCache.h"
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 
 #include <assimp/scene.h>
 #include <glm/glm.hpp>
+#include <stdio.h>
 
 namespace ew {
-	ew::Mesh processAiMesh(aiMesh* aiMesh);
+	glm::vec3 convertAIVec3(const aiVector3D& v);
 
-	Model::Model(const std::string& filePath)
+	std::vector<ew::MeshData> loadModelMeshData(const std::string& filePath)
 	{
+		std::vector<ew::MeshData> meshes;
 		Assimp::Importer importer;
 		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate);
+		if (aiScene == nullptr) {
+			printf("Failed to load model %s", filePath.c_str());
+			return meshes;
+		}
+		meshes.reserve(aiScene->mNumMeshes);
 		for (size_t i = 0; i < aiScene->mNumMeshes; i++)
 		{
 			aiMesh* aiMesh = aiScene->mMeshes[i];
-			m_meshes.push_back(processAiMesh(aiMesh));
+			meshes.push_back(processAiMesh(aiMesh));
+		}
+		return meshes;
+	}
+
+	Model::Model(const std::string& filePath)
+	{
+		//Upload straight from the mapped cache when it is up to date
+		ns::MeshCache cache;
+		std::vector<ew::MeshData> meshes;
+		if (ns::openOrBuildMeshCache(filePath, &cache, &meshes)) {
+			m_meshes.resize(cache.meshes.size());
+			for (size_t i = 0; i < cache.meshes.size(); i++)
+			{
+				const ns::CachedMesh& mesh = cache.meshes[i];
+				m_meshes[i].load(mesh.vertices, mesh.numVertices, mesh.indices, mesh.numIndices, chooseVertexFormat(mesh.vertices, mesh.numVertices));
+				m_meshes[i].setLODs(std::vector<ew::MeshLOD>(mesh.lods, mesh.lods + mesh.numLods));
+			}
+			ns::closeMeshCache(&cache);
+			return;
+		}
+		//First import, the cache was written for next time
+		m_meshes.resize(meshes.size());
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			m_meshes[i].load(meshes[i]);
 		}
 	}
 
+	void Model::setMeshes(const std::vector<ew::Mesh>& meshes)
+	{
+		m_meshes = meshes;
+	}
+
 	void Model::draw()
 	{
 		for (size_t i = 0; i < m_meshes.size(); i++)
@@ -31,13 +69,90 @@ namespace ew {
 		}
 	}
 
+	void Model::drawInstanced(unsigned int instanceCount)
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].drawInstanced(instanceCount);
+		}
+	}
+
+	void Model::drawLOD(unsigned int lod)
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].drawLOD(lod);
+		}
+	}
+
+	void Model::drawInstancedLOD(unsigned int lod, unsigned int instanceCount, unsigned int baseInstance)
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].drawInstancedLOD(lod, instanceCount, baseInstance);
+		}
+	}
+
+	unsigned int Model::getNumLODs() const
+	{
+		unsigned int numLODs = 1;
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			numLODs = glm::max(numLODs, m_meshes[i].getNumLODs());
+		}
+		return numLODs;
+	}
+
+	float Model::getLODError(unsigned int lod) const
+	{
+		float error = 0.0f;
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			error = glm::max(error, m_meshes[i].getLODError(lod));
+		}
+		return error;
+	}
+
+	unsigned int Model::getLODIndexCount(unsigned int lod) const
+	{
+		unsigned int indexCount = 0;
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			indexCount += m_meshes[i].getLODIndexCount(lod);
+		}
+		return indexCount;
+	}
+
+	MeshBounds Model::getBounds() const
+	{
+		if (m_meshes.empty()) {
+			return MeshBounds();
+		}
+		MeshBounds bounds = m_meshes[0].getBounds();
+		for (size_t i = 1; i < m_meshes.size(); i++)
+		{
+			bounds = mergeMeshBounds(bounds, m_meshes[i].getBounds());
+		}
+		return bounds;
+	}
+
+	void Model::setInstanceData(const ew::InstanceData* instances, unsigned int instanceCount)
+	{
+		for (size_t i = 0; i < m_meshes.size(); i++)
+		{
+			m_meshes[i].setInstanceData(instances, instanceCount);
+		}
+	}
+
 	glm::vec3 convertAIVec3(const aiVector3D& v) {
 		return glm::vec3(v.x, v.y, v.z);
 	}
 
-	//Utility functions local to this file
-	ew::Mesh processAiMesh(aiMesh* aiMesh) {
+	ew::MeshData processAiMesh(aiMesh* aiMesh) {
 		ew::MeshData meshData;
+		meshData.vertices.reserve(aiMesh->mNumVertices);
+		//Faces are triangulated on import
+		meshData.indices.reserve(aiMesh->mNumFaces * 3);
 		for (size_t i = 0; i < aiMesh->mNumVertices; i++)
 		{
 			ew::Vertex vertex;
@@ -58,7 +173,8 @@ namespace ew {
 				meshData.indices.push_back(aiMesh->mFaces[i].mIndices[j]);
 			}
 		}
-		return ew::Mesh(meshData);
+		meshData.format = chooseVertexFormat(meshData.vertices.data(), (unsigned int)meshData.vertices.size());
+		return meshData;
 	}
 
 }
@@ -7,11 +7,37 @@
 #include "shader.h"
 #include <vector>
 
+struct aiMesh;
+
 namespace ew {
+	//Imports every mesh in a model file as CPU-side mesh data
+	std::vector<ew::MeshData> loadModelMeshData(const std::string& filePath);
+	//Vertices and faces of one imported Assimp mesh
+	ew::MeshData processAiMesh(aiMesh* aiMesh);
+
 	class Model {
 	public:
+		//Loads from the binary mesh cache next to filePath if it is current, otherwise imports with Assimp and writes the cache
 		Model(const std::string& filePath);
+		//Empty model, draws nothing until meshes are set
+		Model() {}
+		void setMeshes(const std::vector<ew::Mesh>& meshes);
+		inline size_t getNumMeshes()const { return m_meshes.size(); }
+		inline const ew::Mesh& getMesh(size_t index)const { return m_meshes[index]; }
 		void draw();
+		void drawInstanced(unsigned int instanceCount);
+		//Same level for every mesh, clamped per mesh to its coarsest level
+		void drawLOD(unsigned int lod);
+		void drawInstancedLOD(unsigned int lod, unsigned int instanceCount, unsigned int baseInstance = 0);
+		//Most levels of any mesh
+		unsigned int getNumLODs()const;
+		//Largest error of any mesh at this level
+		float getLODError(unsigned int lod)const;
+		unsigned int getLODIndexCount(unsigned int lod)const;
+		//Bounds of all meshes together
+		MeshBounds getBounds()const;
+		//Same instances for every mesh of the model
+		void setInstanceData(const ew::InstanceData* instances, unsigned int instanceCount);
 	private:
 		std::vector<ew::Mesh> m_meshes;
 	};
@@ -5,7 +5,9 @@
 #include "shader.h"
 #include <fstream>
 #include <sstream>
+#include <vector>
 #include "external/glad.h"
+#include "../ns/glState.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
@@ -79,6 +81,26 @@ namespace ew {
 		return shaderProgram;
 	}
 	/// <summary>
+	/// Creates a shader program with a single compute stage
+	/// </summary>
+	/// <param name="computeShaderSource">GLSL source code for the compute shader</param>
+	/// <returns></returns>
+	unsigned int createComputeShaderProgram(const char* computeShaderSource) {
+		unsigned int computeShader = createShader(GL_COMPUTE_SHADER, computeShaderSource);
+		unsigned int shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, computeShader);
+		glLinkProgram(shaderProgram);
+		int success;
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+		if (!success) {
+			char infoLog[512];
+			glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
+			printf("Failed to link compute shader program: %s", infoLog);
+		}
+		glDeleteShader(computeShader);
+		return shaderProgram;
+	}
+	/// <summary>
 	/// Creates a shader instance with vertex + fragment stages
 	/// </summary>
 	/// <param name="vertexShader">File path to vertex shader</param>
@@ -87,23 +109,103 @@ namespace ew {
 	{
 		std::string vertexShaderSource = ew::loadShaderSourceFromFile(vertexShader.c_str());
 		std::string fragmentShaderSource = ew::loadShaderSourceFromFile(fragmentShader.c_str());
-		m_id = ew::createShaderProgram(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+		load(vertexShaderSource.c_str(), fragmentShaderSource.c_str());
+	}
+	/// <summary>
+	/// Builds the program from source that was already read, e.g. on a loader thread
+	/// </summary>
+	/// <param name="vertexShaderSource">Vertex shader source code</param>
+	/// <param name="fragmentShaderSource">Fragment shader source code</param>
+	void Shader::load(const char* vertexShaderSource, const char* fragmentShaderSource)
+	{
+		if (m_id != 0) {
+			glDeleteProgram(m_id);
+		}
+		m_id = ew::createShaderProgram(vertexShaderSource, fragmentShaderSource);
+		cacheUniformLocations();
+	}
+	/// <summary>
+	/// Creates a compute shader instance
+	/// </summary>
+	/// <param name="computeShader">File path to compute shader</param>
+	Shader::Shader(const std::string& computeShader)
+	{
+		std::string computeShaderSource = ew::loadShaderSourceFromFile(computeShader.c_str());
+		m_id = ew::createComputeShaderProgram(computeShaderSource.c_str());
+		cacheUniformLocations();
+	}
+	/// <summary>
+	/// Reflects every active uniform of the linked program into the location table
+	/// </summary>
+	void Shader::cacheUniformLocations()
+	{
+		m_uniformLocations.clear();
+		int numUniforms = 0;
+		int maxNameLength = 0;
+		glGetProgramInterfaceiv(m_id, GL_UNIFORM, GL_ACTIVE_RESOURCES, &numUniforms);
+		glGetProgramInterfaceiv(m_id, GL_UNIFORM, GL_MAX_NAME_LENGTH, &maxNameLength);
+		std::vector<char> nameBuffer(maxNameLength + 1);
+
+		const GLenum properties[2] = { GL_LOCATION, GL_ARRAY_SIZE };
+		for (int i = 0; i < numUniforms; i++)
+		{
+			int values[2];
+			glGetProgramResourceiv(m_id, GL_UNIFORM, i, 2, properties, 2, NULL, values);
+			//Members of uniform/storage blocks have no location
+			if (values[0] < 0) {
+				continue;
+			}
+			glGetProgramResourceName(m_id, GL_UNIFORM, i, (GLsizei)nameBuffer.size(), NULL, nameBuffer.data());
+			std::string name = nameBuffer.data();
+			m_uniformLocations[name] = values[0];
+
+			//Arrays of basic types are reported once as "name[0]" with consecutive locations.
+			//Register the bare name and every element so lookups match glGetUniformLocation
+			size_t arraySuffix = name.size() >= 3 ? name.size() - 3 : std::string::npos;
+			if (arraySuffix != std::string::npos && name.compare(arraySuffix, 3, "[0]") == 0) {
+				std::string baseName = name.substr(0, arraySuffix);
+				m_uniformLocations[baseName] = values[0];
+				for (int j = 1; j < values[1]; j++)
+				{
+					m_uniformLocations[baseName + "[" + std::to_string(j) + "]"] = values[0] + j;
+				}
+			}
+		}
 	}
 	void Shader::use()const
 	{
-		glUseProgram(m_id);
+		ns::useProgram(m_id);
+	}
+	void Shader::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)const
+	{
+		ns::useProgram(m_id);
+		glDispatchCompute(groupsX, groupsY, groupsZ);
+	}
+	UniformHandle Shader::uniform(const std::string& name) const
+	{
+		UniformHandle handle;
+		handle.location = getUniformLocation(name);
+		return handle;
+	}
+	/// <summary>
+	/// Looks up a uniform location in the cached table. Inactive or unknown names return -1, which GL ignores
+	/// </summary>
+	int Shader::getUniformLocation(const std::string& name) const
+	{
+		auto it = m_uniformLocations.find(name);
+		return it != m_uniformLocations.end() ? it->second : -1;
 	}
 	void Shader::setInt(const std::string& name, int v) const
 	{
-		glUniform1i(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1i(getUniformLocation(name), v);
 	}
 	void Shader::setFloat(const std::string& name, float v) const
 	{
-		glUniform1f(glGetUniformLocation(m_id, name.c_str()), v);
+		glUniform1f(getUniformLocation(name), v);
 	}
 	void Shader::setVec2(const std::string& name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(m_id, name.c_str()), x, y);
+		glUniform2f(getUniformLocation(name), x, y);
 	}
 	void Shader::setVec2(const std::string& name, const glm::vec2& v) const
 	{
@@ -111,7 +213,7 @@ namespace ew {
 	}
 	void Shader::setVec3(const std::string& name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(m_id, name.c_str()), x, y, z);
+		glUniform3f(getUniformLocation(name), x, y, z);
 	}
 	void Shader::setVec3(const std::string& name, const glm::vec3& v) const
 	{
@@ -119,7 +221,7 @@ namespace ew {
 	}
 	void Shader::setVec4(const std::string& name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(m_id, name.c_str()), x, y, z, w);
+		glUniform4f(getUniformLocation(name), x, y, z, w);
 	}
 	void Shader::setVec4(const std::string& name, const glm::vec4& v) const
 	{
@@ -127,7 +229,31 @@ namespace ew {
 	}
 	void Shader::setMat4(const std::string& name, const glm::mat4& m) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, glm::value_ptr(m));
+		glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, glm::value_ptr(m));
+	}
+	void Shader::setInt(UniformHandle handle, int v) const
+	{
+		glUniform1i(handle.location, v);
+	}
+	void Shader::setFloat(UniformHandle handle, float v) const
+	{
+		glUniform1f(handle.location, v);
+	}
+	void Shader::setVec2(UniformHandle handle, const glm::vec2& v) const
+	{
+		glUniform2f(handle.location, v.x, v.y);
+	}
+	void Shader::setVec3(UniformHandle handle, const glm::vec3& v) const
+	{
+		glUniform3f(handle.location, v.x, v.y, v.z);
+	}
+	void Shader::setVec4(UniformHandle handle, const glm::vec4& v) const
+	{
+		glUniform4f(handle.location, v.x, v.y, v.z, v.w);
+	}
+	void Shader::setMat4(UniformHandle handle, const glm::mat4& m) const
+	{
+		glUniformMatrix4fv(handle.location, 1, GL_FALSE, glm::value_ptr(m));
 	}
 }
 
@@ -4,15 +4,33 @@
 
 #pragma once
 #include <string>
+#include <unordered_map>
 #include <glm/glm.hpp>
 
 namespace ew {
 	std::string loadShaderSourceFromFile(const std::string& filePath);
 	unsigned int createShaderProgram(const char* vertexShaderSource, const char* fragmentShaderSource);
+	unsigned int createComputeShaderProgram(const char* computeShaderSource);
+
+	//Location of an active uniform, resolved once with Shader::uniform()
+	//Setting through a handle skips the name lookup, so it is safe to use in hot loops
+	struct UniformHandle {
+		int location = -1;
+	};
+
 	class Shader {
 	public:
+		//Empty shader, stands in until load() is called
+		Shader() {}
 		Shader(const std::string& vertexShader, const std::string& fragmentShader);
+		explicit Shader(const std::string& computeShader);
+		//Compiles and links already loaded source, replacing any previous program
+		void load(const char* vertexShaderSource, const char* fragmentShaderSource);
 		void use()const;
+		//Binds the program and dispatches a compute workload
+		void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1)const;
+		UniformHandle uniform(const std::string& name) const;
+		int getUniformLocation(const std::string& name) const;
 		void setInt(const std::string& name, int v) const;
 		void setFloat(const std::string& name, float v) const;
 		void setVec2(const std::string& name, float x, float y) const;
@@ -22,7 +40,15 @@ namespace ew {
 		void setVec4(const std::string& name, float x, float y, float z, float w) const;
 		void setVec4(const std::string& name, const glm::vec4& v) const;
 		void setMat4(const std::string& name, const glm::mat4& m) const;
+		void setInt(UniformHandle handle, int v) const;
+		void setFloat(UniformHandle handle, float v) const;
+		void setVec2(UniformHandle handle, const glm::vec2& v) const;
+		void setVec3(UniformHandle handle, const glm::vec3& v) const;
+		void setVec4(UniformHandle handle, const glm::vec4& v) const;
+		void setMat4(UniformHandle handle, const glm::mat4& m) const;
 	private:
-		unsigned int m_id; //Shader program handle
+		void cacheUniformLocations();
+		unsigned int m_id = 0; //Shader program handle
+		std::unordered_map<std::string, int> m_uniformLocations; //Active uniform name -> location, filled at link time
 	};
-}
\ No newline at end of file
+}
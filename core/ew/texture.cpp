@@ -5,6 +5,7 @@
 #include "texture.h"
 #include "external/glad.h"
 #include "external/stb_image.h"
+#include "../ns/glState.h"
 
 static int getTextureFormat(int numComponents) {
 	switch (numComponents) {
@@ -33,7 +34,12 @@ namespace ew {
 		}
 		unsigned int texture;
 		glGenTextures(1, &texture);
-		glBindTexture(GL_TEXTURE_2D, texture);
+		uploadTextureData(texture, data, width, height, numComponents, wrapMode, magFilter, minFilter, mipmap);
+		stbi_image_free(data);
+		return texture;
+	}
+	void uploadTextureData(unsigned int texture, const unsigned char* data, int width, int height, int numComponents, int wrapMode, int magFilter, int minFilter, bool mipmap) {
+		ns::bindTexture(GL_TEXTURE_2D, texture);
 		int format = getTextureFormat(numComponents);
 		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrapMode);
@@ -49,9 +55,7 @@ namespace ew {
 			glGenerateMipmap(GL_TEXTURE_2D);
 		}
 
-		glBindTexture(GL_TEXTURE_2D, 0);
-		stbi_image_free(data);
-		return texture;
+		ns::bindTexture(GL_TEXTURE_2D, 0);
 	}
 }
 
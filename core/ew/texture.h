@@ -7,4 +7,6 @@
 namespace ew {
 	unsigned int loadTexture(const char* filePath);
 	unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+	//Uploads decoded pixels into an existing texture object and sets its sampling state
+	void uploadTextureData(unsigned int texture, const unsigned char* data, int width, int height, int numComponents, int wrapMode, int magFilter, int minFilter, bool mipmap);
 }
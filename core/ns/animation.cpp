@@ -0,0 +1,421 @@
+#include "animation.h"
+#include <algorithm>
+#include <math.h>
+
+namespace ns {
+	//Characters per parallelFor batch
+	static const unsigned int ANIMATION_MIN_BATCH = 32;
+	//Largest change for a channel to still be stored as constant
+	static const float CONSTANT_POSITION_TOLERANCE = 1e-5f;
+	static const float CONSTANT_ROTATION_TOLERANCE = 1e-6f;
+
+	Skeleton createSkeleton(const Hierarchy& hierarchy) {
+		Skeleton skeleton;
+		skeleton.jointNames.resize(hierarchy.nodeCount);
+		skeleton.parents.resize(hierarchy.nodeCount);
+		skeleton.bindPositions.resize(hierarchy.nodeCount);
+		skeleton.bindRotations.resize(hierarchy.nodeCount);
+		skeleton.bindScales.resize(hierarchy.nodeCount);
+		for (unsigned int i = 0; i < hierarchy.nodeCount; i++)
+		{
+			const Node& node = hierarchy.nodes[i];
+			skeleton.parents[i] = (int)node.parentIndex;
+			skeleton.bindPositions[i] = node.position;
+			skeleton.bindRotations[i] = node.rotation;
+			skeleton.bindScales[i] = node.scale;
+		}
+		return skeleton;
+	}
+
+	int findJoint(const Skeleton& skeleton, const std::string& name) {
+		for (size_t i = 0; i < skeleton.jointNames.size(); i++)
+		{
+			if (skeleton.jointNames[i] == name) {
+				return (int)i;
+			}
+		}
+		return -1;
+	}
+
+	void resizePose(Pose* pose, unsigned int numJoints) {
+		pose->positions.resize(numJoints, glm::vec3(0.0f));
+		pose->rotations.resize(numJoints, glm::quat(1.0f, 0.0f, 0.0f, 0.0f));
+		pose->scales.resize(numJoints, glm::vec3(1.0f));
+	}
+
+	//Index of the last key at or before time, keys are sorted
+	static size_t findKey(const std::vector<float>& times, float time) {
+		size_t upper = std::upper_bound(times.begin(), times.end(), time) - times.begin();
+		return upper > 0 ? upper - 1 : 0;
+	}
+
+	static glm::vec3 evaluateVec3(const std::vector<float>& times, const std::vector<glm::vec3>& keys, float time, const glm::vec3& fallback) {
+		if (keys.empty()) {
+			return fallback;
+		}
+		size_t key = findKey(times, time);
+		if (key + 1 >= keys.size() || time <= times[key]) {
+			return keys[key];
+		}
+		float t = (time - times[key]) / (times[key + 1] - times[key]);
+		return glm::mix(keys[key], keys[key + 1], t);
+	}
+
+	static glm::quat evaluateQuat(const std::vector<float>& times, const std::vector<glm::quat>& keys, float time, const glm::quat& fallback) {
+		if (keys.empty()) {
+			return fallback;
+		}
+		size_t key = findKey(times, time);
+		if (key + 1 >= keys.size() || time <= times[key]) {
+			return glm::normalize(keys[key]);
+		}
+		float t = (time - times[key]) / (times[key + 1] - times[key]);
+		return glm::normalize(glm::slerp(keys[key], keys[key + 1], t));
+	}
+
+	static QuantizedQuat quantizeQuat(glm::quat q) {
+		if (q.w < 0.0f) {
+			q = -q;
+		}
+		QuantizedQuat result;
+		result.x = (int16_t)roundf(glm::clamp(q.x, -1.0f, 1.0f) * 32767.0f);
+		result.y = (int16_t)roundf(glm::clamp(q.y, -1.0f, 1.0f) * 32767.0f);
+		result.z = (int16_t)roundf(glm::clamp(q.z, -1.0f, 1.0f) * 32767.0f);
+		result.w = (int16_t)roundf(glm::clamp(q.w, -1.0f, 1.0f) * 32767.0f);
+		return result;
+	}
+
+	static glm::quat dequantizeQuat(const QuantizedQuat& q) {
+		const float scale = 1.0f / 32767.0f;
+		return glm::quat(q.w * scale, q.x * scale, q.y * scale, q.z * scale);
+	}
+
+	static QuantizedVec3 quantizeVec3(const glm::vec3& v, const glm::vec3& min, const glm::vec3& extent) {
+		glm::vec3 n = glm::clamp((v - min) / glm::max(extent, glm::vec3(1e-20f)), 0.0f, 1.0f) * 65535.0f;
+		QuantizedVec3 result;
+		result.x = (uint16_t)roundf(n.x);
+		result.y = (uint16_t)roundf(n.y);
+		result.z = (uint16_t)roundf(n.z);
+		return result;
+	}
+
+	//Adds a vec3 channel, sampled at every frame, as a constant or as an animated track
+	static void addVec3Channel(const std::vector<glm::vec3>& samples, unsigned int joint, glm::vec3* constant,
+		std::vector<unsigned int>* joints, std::vector<glm::vec3>* mins, std::vector<glm::vec3>* extents, std::vector<std::vector<QuantizedVec3>>* tracks) {
+		glm::vec3 min = samples[0], max = samples[0];
+		for (size_t f = 1; f < samples.size(); f++)
+		{
+			min = glm::min(min, samples[f]);
+			max = glm::max(max, samples[f]);
+		}
+		glm::vec3 extent = max - min;
+		if (glm::max(extent.x, glm::max(extent.y, extent.z)) <= CONSTANT_POSITION_TOLERANCE) {
+			*constant = samples[0];
+			return;
+		}
+		joints->push_back(joint);
+		mins->push_back(min);
+		extents->push_back(extent);
+		tracks->emplace_back(samples.size());
+		for (size_t f = 0; f < samples.size(); f++)
+		{
+			tracks->back()[f] = quantizeVec3(samples[f], min, extent);
+		}
+	}
+
+	//Tracks are built one at a time, then interleaved so that each frame is one contiguous row
+	template <typename T>
+	static void interleaveTracks(const std::vector<std::vector<T>>& tracks, unsigned int numFrames, std::vector<T>* keys) {
+		keys->resize(tracks.size() * numFrames);
+		for (unsigned int f = 0; f < numFrames; f++)
+		{
+			for (size_t t = 0; t < tracks.size(); t++)
+			{
+				(*keys)[f * tracks.size() + t] = tracks[t][f];
+			}
+		}
+	}
+
+	AnimationClip compressAnimationClip(const RawAnimationClip& raw, const Skeleton& skeleton, float sampleRate) {
+		AnimationClip clip;
+		clip.name = raw.name;
+		clip.duration = glm::max(raw.duration, 0.0f);
+		clip.sampleRate = sampleRate;
+		clip.numFrames = (unsigned int)ceilf(clip.duration * sampleRate) + 1;
+		clip.numJoints = (unsigned int)skeleton.parents.size();
+		resizePose(&clip.constantPose, clip.numJoints);
+		for (unsigned int i = 0; i < clip.numJoints; i++)
+		{
+			clip.constantPose.positions[i] = skeleton.bindPositions[i];
+			clip.constantPose.rotations[i] = skeleton.bindRotations[i];
+			clip.constantPose.scales[i] = skeleton.bindScales[i];
+		}
+
+		std::vector<std::vector<QuantizedQuat>> rotationTracks;
+		std::vector<std::vector<QuantizedVec3>> positionTracks, scaleTracks;
+		std::vector<glm::vec3> vec3Samples(clip.numFrames);
+		std::vector<glm::quat> quatSamples(clip.numFrames);
+		for (size_t i = 0; i < raw.tracks.size(); i++)
+		{
+			const AnimationTrack& track = raw.tracks[i];
+			unsigned int joint = track.joint;
+			if (joint >= clip.numJoints) {
+				continue;
+			}
+			//Rotations
+			bool constant = true;
+			for (unsigned int f = 0; f < clip.numFrames; f++)
+			{
+				float time = glm::min(f / sampleRate, clip.duration);
+				quatSamples[f] = evaluateQuat(track.rotationTimes, track.rotations, time, skeleton.bindRotations[joint]);
+				constant &= fabsf(glm::dot(quatSamples[f], quatSamples[0])) >= 1.0f - CONSTANT_ROTATION_TOLERANCE;
+			}
+			if (constant) {
+				clip.constantPose.rotations[joint] = quatSamples[0];
+			}
+			else {
+				clip.rotationJoints.push_back(joint);
+				rotationTracks.emplace_back(clip.numFrames);
+				for (unsigned int f = 0; f < clip.numFrames; f++)
+				{
+					rotationTracks.back()[f] = quantizeQuat(quatSamples[f]);
+				}
+			}
+			//Positions
+			for (unsigned int f = 0; f < clip.numFrames; f++)
+			{
+				float time = glm::min(f / sampleRate, clip.duration);
+				vec3Samples[f] = evaluateVec3(track.positionTimes, track.positions, time, skeleton.bindPositions[joint]);
+			}
+			addVec3Channel(vec3Samples, joint, &clip.constantPose.positions[joint], &clip.positionJoints, &clip.positionMin, &clip.positionExtent, &positionTracks);
+			//Scales
+			for (unsigned int f = 0; f < clip.numFrames; f++)
+			{
+				float time = glm::min(f / sampleRate, clip.duration);
+				vec3Samples[f] = evaluateVec3(track.scaleTimes, track.scales, time, skeleton.bindScales[joint]);
+			}
+			addVec3Channel(vec3Samples, joint, &clip.constantPose.scales[joint], &clip.scaleJoints, &clip.scaleMin, &clip.scaleExtent, &scaleTracks);
+		}
+		interleaveTracks(rotationTracks, clip.numFrames, &clip.rotationKeys);
+		interleaveTracks(positionTracks, clip.numFrames, &clip.positionKeys);
+		interleaveTracks(scaleTracks, clip.numFrames, &clip.scaleKeys);
+		return clip;
+	}
+
+	size_t getClipMemory(const AnimationClip& clip) {
+		size_t bytes = clip.numJoints * (sizeof(glm::vec3) * 2 + sizeof(glm::quat));
+		bytes += clip.rotationJoints.size() * sizeof(unsigned int) + clip.rotationKeys.size() * sizeof(QuantizedQuat);
+		bytes += clip.positionJoints.size() * (sizeof(unsigned int) + sizeof(glm::vec3) * 2) + clip.positionKeys.size() * sizeof(QuantizedVec3);
+		bytes += clip.scaleJoints.size() * (sizeof(unsigned int) + sizeof(glm::vec3) * 2) + clip.scaleKeys.size() * sizeof(QuantizedVec3);
+		return bytes;
+	}
+
+	size_t getUncompressedClipMemory(const AnimationClip& clip) {
+		return (size_t)clip.numFrames * clip.numJoints * (sizeof(glm::vec3) * 2 + sizeof(glm::quat));
+	}
+
+	static void sampleVec3Tracks(const std::vector<unsigned int>& joints, const std::vector<glm::vec3>& mins, const std::vector<glm::vec3>& extents,
+		const QuantizedVec3* row0, const QuantizedVec3* row1, float t, glm::vec3* values) {
+		for (size_t i = 0; i < joints.size(); i++)
+		{
+			glm::vec3 a = glm::vec3(row0[i].x, row0[i].y, row0[i].z);
+			glm::vec3 b = glm::vec3(row1[i].x, row1[i].y, row1[i].z);
+			values[joints[i]] = mins[i] + glm::mix(a, b, t) * (extents[i] * (1.0f / 65535.0f));
+		}
+	}
+
+	void sampleClip(const AnimationClip& clip, float time, Pose* pose) {
+		std::copy(clip.constantPose.positions.begin(), clip.constantPose.positions.end(), pose->positions.begin());
+		std::copy(clip.constantPose.rotations.begin(), clip.constantPose.rotations.end(), pose->rotations.begin());
+		std::copy(clip.constantPose.scales.begin(), clip.constantPose.scales.end(), pose->scales.begin());
+
+		float localTime = 0.0f;
+		if (clip.duration > 0.0f) {
+			localTime = fmodf(time, clip.duration);
+			if (localTime < 0.0f) {
+				localTime += clip.duration;
+			}
+		}
+		float frame = localTime * clip.sampleRate;
+		unsigned int f0 = glm::min((unsigned int)frame, clip.numFrames - 1);
+		unsigned int f1 = glm::min(f0 + 1, clip.numFrames - 1);
+		float t = glm::clamp(frame - (float)f0, 0.0f, 1.0f);
+
+		size_t numRotations = clip.rotationJoints.size();
+		const QuantizedQuat* rotations0 = clip.rotationKeys.data() + f0 * numRotations;
+		const QuantizedQuat* rotations1 = clip.rotationKeys.data() + f1 * numRotations;
+		for (size_t i = 0; i < numRotations; i++)
+		{
+			glm::quat a = dequantizeQuat(rotations0[i]);
+			glm::quat b = dequantizeQuat(rotations1[i]);
+			if (glm::dot(a, b) < 0.0f) {
+				b = -b;
+			}
+			pose->rotations[clip.rotationJoints[i]] = glm::normalize(a * (1.0f - t) + b * t);
+		}
+		size_t numPositions = clip.positionJoints.size();
+		sampleVec3Tracks(clip.positionJoints, clip.positionMin, clip.positionExtent,
+			clip.positionKeys.data() + f0 * numPositions, clip.positionKeys.data() + f1 * numPositions, t, pose->positions.data());
+		size_t numScales = clip.scaleJoints.size();
+		sampleVec3Tracks(clip.scaleJoints, clip.scaleMin, clip.scaleExtent,
+			clip.scaleKeys.data() + f0 * numScales, clip.scaleKeys.data() + f1 * numScales, t, pose->scales.data());
+	}
+
+	//result = pose * weight when first, otherwise result += pose * weight with rotations flipped into result's hemisphere
+	static void accumulatePose(const Pose& pose, float weight, bool first, Pose* result) {
+		size_t numJoints = pose.positions.size();
+		if (first) {
+			for (size_t i = 0; i < numJoints; i++)
+			{
+				result->positions[i] = pose.positions[i] * weight;
+				result->rotations[i] = pose.rotations[i] * weight;
+				result->scales[i] = pose.scales[i] * weight;
+			}
+			return;
+		}
+		for (size_t i = 0; i < numJoints; i++)
+		{
+			result->positions[i] += pose.positions[i] * weight;
+			float sign = glm::dot(result->rotations[i], pose.rotations[i]) < 0.0f ? -weight : weight;
+			result->rotations[i] = result->rotations[i] + pose.rotations[i] * sign;
+			result->scales[i] += pose.scales[i] * weight;
+		}
+	}
+
+	static void normalizePose(float totalWeight, Pose* result) {
+		float inverseWeight = 1.0f / totalWeight;
+		for (size_t i = 0; i < result->positions.size(); i++)
+		{
+			result->positions[i] *= inverseWeight;
+			result->rotations[i] = glm::normalize(result->rotations[i]);
+			result->scales[i] *= inverseWeight;
+		}
+	}
+
+	void blendPoses(const Pose* const* poses, const float* weights, unsigned int count, Pose* result) {
+		float totalWeight = 0.0f;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (weights[i] <= 0.0f) {
+				continue;
+			}
+			accumulatePose(*poses[i], weights[i], totalWeight == 0.0f, result);
+			totalWeight += weights[i];
+		}
+		if (totalWeight > 0.0f) {
+			normalizePose(totalWeight, result);
+		}
+	}
+
+	void applyPose(const Pose& pose, Hierarchy* hierarchy) {
+		unsigned int numJoints = glm::min((unsigned int)pose.positions.size(), hierarchy->nodeCount);
+		for (unsigned int i = 0; i < numJoints; i++)
+		{
+			Node& node = hierarchy->nodes[i];
+			if (node.position == pose.positions[i] && node.rotation == pose.rotations[i] && node.scale == pose.scales[i]) {
+				continue;
+			}
+			node.position = pose.positions[i];
+			node.rotation = pose.rotations[i];
+			node.scale = pose.scales[i];
+			markNodeDirty(hierarchy, i);
+		}
+	}
+
+	void applyPose(const Pose& pose, FKHierarchy* fk, unsigned int firstJoint) {
+		for (unsigned int i = 0; i < pose.positions.size() && firstJoint + i < fk->numJoints; i++)
+		{
+			setFKLocalPose(fk, firstJoint + i, pose.positions[i], pose.rotations[i], pose.scales[i]);
+		}
+	}
+
+	//Sum of the layer weights that touched each channel of a joint
+	struct ChannelWeights {
+		float position;
+		float rotation;
+		float scale;
+	};
+
+	static void addPosition(const Pose& pose, unsigned int joint, float weight, Pose* result, ChannelWeights* weights) {
+		result->positions[joint] += pose.positions[joint] * weight;
+		weights[joint].position += weight;
+	}
+	//Flipped into the hemisphere of what was accumulated so far, which is zero for the first layer
+	static void addRotation(const Pose& pose, unsigned int joint, float weight, Pose* result, ChannelWeights* weights) {
+		float sign = glm::dot(result->rotations[joint], pose.rotations[joint]) < 0.0f ? -weight : weight;
+		result->rotations[joint] = result->rotations[joint] + pose.rotations[joint] * sign;
+		weights[joint].rotation += weight;
+	}
+	static void addScale(const Pose& pose, unsigned int joint, float weight, Pose* result, ChannelWeights* weights) {
+		result->scales[joint] += pose.scales[joint] * weight;
+		weights[joint].scale += weight;
+	}
+
+	static void sampleCharacter(const Skeleton& skeleton, const AnimationClip* clips, const CharacterAnimation& character, Pose* pose) {
+		static thread_local Pose scratch;
+		static thread_local std::vector<ChannelWeights> weights;
+		if (character.numLayers == 1 && character.layers[0].mode == AnimationLayerMode::FULL && character.layers[0].weight > 0.0f) {
+			sampleClip(clips[character.layers[0].clip], character.layers[0].time, pose);
+			return;
+		}
+		unsigned int numJoints = (unsigned int)pose->positions.size();
+		resizePose(&scratch, numJoints);
+		weights.assign(numJoints, ChannelWeights{ 0.0f, 0.0f, 0.0f });
+		std::fill(pose->positions.begin(), pose->positions.end(), glm::vec3(0.0f));
+		std::fill(pose->rotations.begin(), pose->rotations.end(), glm::quat(0.0f, 0.0f, 0.0f, 0.0f));
+		std::fill(pose->scales.begin(), pose->scales.end(), glm::vec3(0.0f));
+		for (unsigned int i = 0; i < character.numLayers; i++)
+		{
+			const AnimationLayer& layer = character.layers[i];
+			if (layer.weight <= 0.0f) {
+				continue;
+			}
+			const AnimationClip& clip = clips[layer.clip];
+			sampleClip(clip, layer.time, &scratch);
+			if (layer.mode == AnimationLayerMode::FULL) {
+				for (unsigned int j = 0; j < numJoints; j++)
+				{
+					addPosition(scratch, j, layer.weight, pose, weights.data());
+					addRotation(scratch, j, layer.weight, pose, weights.data());
+					addScale(scratch, j, layer.weight, pose, weights.data());
+				}
+				continue;
+			}
+			for (size_t j = 0; j < clip.positionJoints.size(); j++)
+			{
+				addPosition(scratch, clip.positionJoints[j], layer.weight, pose, weights.data());
+			}
+			for (size_t j = 0; j < clip.rotationJoints.size(); j++)
+			{
+				addRotation(scratch, clip.rotationJoints[j], layer.weight, pose, weights.data());
+			}
+			for (size_t j = 0; j < clip.scaleJoints.size(); j++)
+			{
+				addScale(scratch, clip.scaleJoints[j], layer.weight, pose, weights.data());
+			}
+		}
+		for (unsigned int j = 0; j < numJoints; j++)
+		{
+			const ChannelWeights& w = weights[j];
+			pose->positions[j] = w.position > 0.0f ? pose->positions[j] / w.position : skeleton.bindPositions[j];
+			pose->rotations[j] = w.rotation > 0.0f ? glm::normalize(pose->rotations[j]) : skeleton.bindRotations[j];
+			pose->scales[j] = w.scale > 0.0f ? pose->scales[j] / w.scale : skeleton.bindScales[j];
+		}
+	}
+
+	void sampleCharacters(const Skeleton& skeleton, const AnimationClip* clips, const CharacterAnimation* characters, unsigned int numCharacters, Pose* poses, JobSystem* jobSystem) {
+		if (jobSystem == nullptr || numCharacters < ANIMATION_MIN_BATCH * 2) {
+			for (unsigned int i = 0; i < numCharacters; i++)
+			{
+				sampleCharacter(skeleton, clips, characters[i], &poses[i]);
+			}
+			return;
+		}
+		jobSystem->parallelFor(numCharacters, ANIMATION_MIN_BATCH, [&skeleton, clips, characters, poses](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int i = begin; i < end; i++)
+			{
+				sampleCharacter(skeleton, clips, characters[i], &poses[i]);
+			}
+		});
+	}
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <stdint.h>
+#include <stddef.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "hierarchy.h"
+#include "fkSolver.h"
+#include "jobSystem.h"
+
+namespace ns {
+	//Joints in parent-before-child order, with the pose they have when no clip moves them
+	struct Skeleton {
+		std::vector<std::string> jointNames;
+		std::vector<int> parents; //-1 for roots
+		std::vector<glm::vec3> bindPositions;
+		std::vector<glm::quat> bindRotations;
+		std::vector<glm::vec3> bindScales;
+	};
+	//Skeleton of the nodes as they are now, joint i is node i. Nodes are unnamed
+	Skeleton createSkeleton(const Hierarchy& hierarchy);
+	int findJoint(const Skeleton& skeleton, const std::string& name);
+
+	//Local transform of every joint of a skeleton
+	struct Pose {
+		std::vector<glm::vec3> positions;
+		std::vector<glm::quat> rotations;
+		std::vector<glm::vec3> scales;
+	};
+	void resizePose(Pose* pose, unsigned int numJoints);
+
+	//Keys of one joint as authored or imported, each channel with its own key times in seconds
+	struct AnimationTrack {
+		unsigned int joint;
+		std::vector<float> positionTimes;
+		std::vector<glm::vec3> positions;
+		std::vector<float> rotationTimes;
+		std::vector<glm::quat> rotations;
+		std::vector<float> scaleTimes;
+		std::vector<glm::vec3> scales;
+	};
+	struct RawAnimationClip {
+		std::string name;
+		float duration; //Seconds
+		std::vector<AnimationTrack> tracks;
+	};
+
+	//8 bytes, components scaled to [-32767, 32767] with w >= 0
+	struct QuantizedQuat {
+		int16_t x, y, z, w;
+	};
+	//6 bytes, components scaled to [0, 65535] over the range of their track
+	struct QuantizedVec3 {
+		uint16_t x, y, z;
+	};
+
+	//Clip resampled at a fixed rate so sampling never searches for keys. Channels that don't move are stored once
+	//in the constant pose, and the keys of every animated channel are stored frame by frame, so sampling reads
+	//two contiguous rows per channel type whatever the number of tracks
+	struct AnimationClip {
+		std::string name;
+		float duration;
+		float sampleRate;
+		unsigned int numFrames;
+		unsigned int numJoints;
+		Pose constantPose; //Every joint, animated channels are overwritten when sampling
+		//Animated rotations, frame f of track t is rotationKeys[f * rotationJoints.size() + t]
+		std::vector<unsigned int> rotationJoints;
+		std::vector<QuantizedQuat> rotationKeys;
+		//Animated positions and scales, dequantized as min + key / 65535 * extent
+		std::vector<unsigned int> positionJoints;
+		std::vector<glm::vec3> positionMin, positionExtent;
+		std::vector<QuantizedVec3> positionKeys;
+		std::vector<unsigned int> scaleJoints;
+		std::vector<glm::vec3> scaleMin, scaleExtent;
+		std::vector<QuantizedVec3> scaleKeys;
+	};
+	//Resamples and quantizes a clip for the skeleton. Channels missing from the raw clip keep the bind pose
+	AnimationClip compressAnimationClip(const RawAnimationClip& raw, const Skeleton& skeleton, float sampleRate = 30.0f);
+	//Bytes used by the keys of a clip, and by the same keys stored uncompressed at every frame
+	size_t getClipMemory(const AnimationClip& clip);
+	size_t getUncompressedClipMemory(const AnimationClip& clip);
+
+	//Pose of the clip at time seconds, looping. pose must be sized for clip.numJoints
+	void sampleClip(const AnimationClip& clip, float time, Pose* pose);
+	//Weighted blend of count poses, weights don't need to add up to 1. Rotations are blended by normalized lerp.
+	//result is left as it was if no weight is above 0
+	void blendPoses(const Pose* const* poses, const float* weights, unsigned int count, Pose* result);
+
+	//Copies a pose into the nodes, marking dirty only the ones it changed
+	void applyPose(const Pose& pose, Hierarchy* hierarchy);
+	//Copies a pose into joints [firstJoint, firstJoint + numJoints of the pose) of a solver hierarchy
+	void applyPose(const Pose& pose, FKHierarchy* fk, unsigned int firstJoint = 0);
+
+	const int MAX_ANIMATION_LAYERS = 4;
+	enum class AnimationLayerMode {
+		FULL = 0, //Every channel of every joint, untracked joints pull towards the bind pose
+		PARTIAL = 1 //Only the channels the clip changes over time, e.g. a clip that just turns the head.
+		            //Channels keyed to one value are constant and left to the other layers too
+	};
+	struct AnimationLayer {
+		unsigned int clip;
+		float time;
+		float weight;
+		AnimationLayerMode mode; //FULL when left out of an initializer list
+	};
+	//Clips played by one character, blended by weight
+	struct CharacterAnimation {
+		AnimationLayer layers[MAX_ANIMATION_LAYERS];
+		unsigned int numLayers = 0;
+	};
+	//Samples and blends every character's layers into poses[i]. All clips must be for the skeleton and poses sized for it.
+	//Each channel is normalized by the weight of the layers that touched it, channels no layer touched get the bind pose.
+	//Each character is evaluated start to finish by one thread, so results are identical for any number of threads.
+	//jobSystem may be null to sample on the calling thread
+	void sampleCharacters(const Skeleton& skeleton, const AnimationClip* clips, const CharacterAnimation* characters, unsigned int numCharacters, Pose* poses, JobSystem* jobSystem);
+}
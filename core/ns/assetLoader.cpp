@@ -0,0 +1,216 @@
+#include "assetLoader.h"
+#include "meshCache.h"
+#include "../ew/texture.h"
+#include "../ew/external/glad.h"
+#include "../ew/external/stb_image.h"
+#include <chrono>
+#include <stdio.h>
+
+namespace ns {
+	enum class AssetType {
+		TEXTURE,
+		MODEL,
+		SHADER
+	};
+
+	//CPU-side result of a load job, consumed by processUploads
+	struct LoadedAsset {
+		AssetType type;
+		std::string filePath;
+		bool failed = false;
+
+		//Texture
+		unsigned int texture = 0;
+		int wrapMode, magFilter, minFilter;
+		bool mipmap;
+		unsigned char* pixels = NULL;
+		int width = 0, height = 0, numComponents = 0;
+
+		//Model, either still mapped from the mesh cache or freshly imported
+		ew::Model* model = NULL;
+		MeshCache cache;
+		bool fromCache = false;
+		std::vector<ew::VertexFormat> cachedFormats; //Picked on the worker so the upload does not scan the vertices
+		std::vector<ew::MeshData> meshes;
+
+		//Shader
+		ew::Shader* shader = NULL;
+		std::string fragmentFilePath;
+		std::string vertexSource, fragmentSource;
+
+		~LoadedAsset() {
+			if (pixels != NULL) {
+				stbi_image_free(pixels);
+			}
+			if (fromCache) {
+				closeMeshCache(&cache);
+			}
+		}
+	};
+
+	AssetLoader::AssetLoader(JobSystem* jobSystem)
+		: m_jobSystem(jobSystem)
+	{
+	}
+
+	AssetLoader::~AssetLoader()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_jobFinished.wait(lock, [this] { return m_numRunning == 0; });
+		m_ready.clear();
+	}
+
+	void AssetLoader::submit(std::function<void(LoadedAsset*)> load, std::unique_ptr<LoadedAsset> asset)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_numRunning++;
+			m_numPending++;
+		}
+		//std::function must be copyable, so the asset travels as a raw pointer and is owned again by the ready queue
+		LoadedAsset* rawAsset = asset.release();
+		m_jobSystem->submit([this, load, rawAsset] {
+			load(rawAsset);
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_ready.push_back(std::unique_ptr<LoadedAsset>(rawAsset));
+			m_numRunning--;
+			m_jobFinished.notify_all();
+		});
+	}
+
+	unsigned int AssetLoader::loadTexture(const char* filePath)
+	{
+		return loadTexture(filePath, GL_REPEAT, GL_LINEAR, GL_LINEAR_MIPMAP_LINEAR, true);
+	}
+
+	unsigned int AssetLoader::loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap)
+	{
+		//Placeholder storage until the decoded image replaces it
+		unsigned int texture;
+		glGenTextures(1, &texture);
+		const unsigned char grey[4] = { 128, 128, 128, 255 };
+		ew::uploadTextureData(texture, grey, 1, 1, 4, wrapMode, GL_NEAREST, GL_NEAREST, false);
+
+		std::unique_ptr<LoadedAsset> asset(new LoadedAsset());
+		asset->type = AssetType::TEXTURE;
+		asset->filePath = filePath;
+		asset->texture = texture;
+		asset->wrapMode = wrapMode;
+		asset->magFilter = magFilter;
+		asset->minFilter = minFilter;
+		asset->mipmap = mipmap;
+		submit([](LoadedAsset* asset) {
+			//The flip flag is global in stb_image, use the per-thread one so workers do not race
+			stbi_set_flip_vertically_on_load_thread(true);
+			asset->pixels = stbi_load(asset->filePath.c_str(), &asset->width, &asset->height, &asset->numComponents, 0);
+			asset->failed = asset->pixels == NULL;
+		}, std::move(asset));
+		return texture;
+	}
+
+	ew::Model* AssetLoader::loadModel(const std::string& filePath)
+	{
+		m_models.push_back(std::unique_ptr<ew::Model>(new ew::Model()));
+		std::unique_ptr<LoadedAsset> asset(new LoadedAsset());
+		asset->type = AssetType::MODEL;
+		asset->filePath = filePath;
+		asset->model = m_models.back().get();
+		submit([](LoadedAsset* asset) {
+			//Other loads of the same file wait for this import instead of importing and writing the cache as well
+			asset->fromCache = openOrBuildMeshCache(asset->filePath, &asset->cache, &asset->meshes);
+			if (asset->fromCache) {
+				//Reading every vertex also faults the pages in, so the render thread does not during upload
+				for (size_t i = 0; i < asset->cache.meshes.size(); i++)
+				{
+					const CachedMesh& mesh = asset->cache.meshes[i];
+					asset->cachedFormats.push_back(ew::chooseVertexFormat(mesh.vertices, mesh.numVertices));
+				}
+				return;
+			}
+			asset->failed = asset->meshes.empty();
+		}, std::move(asset));
+		return m_models.back().get();
+	}
+
+	ew::Shader* AssetLoader::loadShader(const std::string& vertexShader, const std::string& fragmentShader)
+	{
+		m_shaders.push_back(std::unique_ptr<ew::Shader>(new ew::Shader()));
+		std::unique_ptr<LoadedAsset> asset(new LoadedAsset());
+		asset->type = AssetType::SHADER;
+		asset->filePath = vertexShader;
+		asset->fragmentFilePath = fragmentShader;
+		asset->shader = m_shaders.back().get();
+		submit([](LoadedAsset* asset) {
+			asset->vertexSource = ew::loadShaderSourceFromFile(asset->filePath);
+			asset->fragmentSource = ew::loadShaderSourceFromFile(asset->fragmentFilePath);
+		}, std::move(asset));
+		return m_shaders.back().get();
+	}
+
+	unsigned int AssetLoader::processUploads(float budgetMs)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		unsigned int numUploaded = 0;
+		while (true) {
+			if (numUploaded > 0) {
+				std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+				if (elapsed.count() >= budgetMs) {
+					break;
+				}
+			}
+			std::unique_ptr<LoadedAsset> asset;
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_ready.empty()) {
+					break;
+				}
+				asset = std::move(m_ready.front());
+				m_ready.pop_front();
+				m_numPending--;
+			}
+			numUploaded++;
+			if (asset->failed) {
+				//The placeholder stays in place
+				printf("Failed to load asset %s", asset->filePath.c_str());
+				continue;
+			}
+			switch (asset->type) {
+			case AssetType::TEXTURE:
+				ew::uploadTextureData(asset->texture, asset->pixels, asset->width, asset->height, asset->numComponents,
+					asset->wrapMode, asset->magFilter, asset->minFilter, asset->mipmap);
+				break;
+			case AssetType::MODEL: {
+				std::vector<ew::Mesh> meshes;
+				if (asset->fromCache) {
+					meshes.resize(asset->cache.meshes.size());
+					for (size_t i = 0; i < meshes.size(); i++)
+					{
+						const CachedMesh& mesh = asset->cache.meshes[i];
+						meshes[i].load(mesh.vertices, mesh.numVertices, mesh.indices, mesh.numIndices, asset->cachedFormats[i]);
+						meshes[i].setLODs(std::vector<ew::MeshLOD>(mesh.lods, mesh.lods + mesh.numLods));
+					}
+				}
+				else {
+					meshes.resize(asset->meshes.size());
+					for (size_t i = 0; i < meshes.size(); i++)
+					{
+						meshes[i].load(asset->meshes[i]);
+					}
+				}
+				asset->model->setMeshes(meshes);
+				break;
+			}
+			case AssetType::SHADER:
+				asset->shader->load(asset->vertexSource.c_str(), asset->fragmentSource.c_str());
+				break;
+			}
+		}
+		return numUploaded;
+	}
+
+	unsigned int AssetLoader::getNumPending() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_numPending;
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include "jobSystem.h"
+#include "../ew/model.h"
+#include "../ew/shader.h"
+
+namespace ns {
+	struct LoadedAsset;
+
+	//Loads textures, models and shaders in the background.
+	//File reads, image decoding and mesh parsing run as jobs on the JobSystem, finished CPU data is queued
+	//and uploaded to GL by processUploads() on the render thread within a per-frame time budget.
+	//Every load returns its handle immediately. Until the upload happens the handle is a placeholder:
+	//textures are 1x1 grey, models have no meshes and shaders have no program.
+	class AssetLoader {
+	public:
+		AssetLoader(JobSystem* jobSystem);
+		//Waits for jobs that are still running and drops anything not uploaded yet
+		~AssetLoader();
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+
+		//Texture object name, valid right away. Same parameters as ew::loadTexture
+		unsigned int loadTexture(const char* filePath);
+		unsigned int loadTexture(const char* filePath, int wrapMode, int magFilter, int minFilter, bool mipmap);
+		//Owned by the loader. Uses the mesh cache the same way ew::Model does
+		ew::Model* loadModel(const std::string& filePath);
+		//Owned by the loader
+		ew::Shader* loadShader(const std::string& vertexShader, const std::string& fragmentShader);
+
+		//Uploads finished assets until budgetMs has been spent. At least one asset is uploaded per call if any is ready.
+		//Must be called on the thread that owns the GL context. Returns the number of assets uploaded
+		unsigned int processUploads(float budgetMs);
+		//Requested assets that have not been uploaded yet
+		unsigned int getNumPending()const;
+	private:
+		void submit(std::function<void(LoadedAsset*)> load, std::unique_ptr<LoadedAsset> asset);
+		JobSystem* m_jobSystem;
+		std::vector<std::unique_ptr<ew::Model>> m_models;
+		std::vector<std::unique_ptr<ew::Shader>> m_shaders;
+		std::deque<std::unique_ptr<LoadedAsset>> m_ready; //Finished on a worker, waiting for upload
+		mutable std::mutex m_mutex;
+		std::condition_variable m_jobFinished;
+		unsigned int m_numRunning = 0; //Jobs still executing on workers
+		unsigned int m_numPending = 0;
+	};
+}
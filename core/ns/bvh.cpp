@@ -0,0 +1,400 @@
+#include "bvh.h"
+#include <float.h>
+#include <algorithm>
+
+namespace ns {
+	static const unsigned int BVH_MAX_LEAF_SIZE = 4;
+	static const unsigned int BVH_BINS = 12;
+	static const unsigned int BVH_MAX_DEPTH = 64;
+	//Subtrees built in parallel, per thread
+	static const unsigned int BVH_TASKS_PER_THREAD = 4;
+
+	void resizeBVH(BVH* bvh, unsigned int numObjects) {
+		bvh->objectMin.resize(numObjects);
+		bvh->objectMax.resize(numObjects);
+	}
+
+	void transformBounds(const glm::mat4& model, const ew::MeshBounds& bounds, glm::vec3* min, glm::vec3* max) {
+		//Arvo: transform the center, the extents go through the absolute matrix
+		glm::vec3 center = glm::vec3(model * glm::vec4((bounds.min + bounds.max) * 0.5f, 1.0f));
+		glm::vec3 extents = (bounds.max - bounds.min) * 0.5f;
+		glm::vec3 worldExtents = glm::abs(glm::vec3(model[0])) * extents.x + glm::abs(glm::vec3(model[1])) * extents.y + glm::abs(glm::vec3(model[2])) * extents.z;
+		*min = center - worldExtents;
+		*max = center + worldExtents;
+	}
+
+	static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+		glm::vec3 e = max - min;
+		return 2.0f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+
+	static void computeNodeBounds(const BVH& bvh, BVHNode* node) {
+		node->min = glm::vec3(FLT_MAX);
+		node->max = glm::vec3(-FLT_MAX);
+		for (unsigned int i = 0; i < node->count; i++)
+		{
+			unsigned int object = bvh.objectIndices[node->leftFirst + i];
+			node->min = glm::min(node->min, bvh.objectMin[object]);
+			node->max = glm::max(node->max, bvh.objectMax[object]);
+		}
+	}
+
+	//Splits a leaf in nodes with the binned surface area heuristic. Returns false if it should stay a leaf.
+	//Children are appended to nodes, so several threads can each split into their own vector
+	static bool splitNode(BVH* bvh, std::vector<BVHNode>* nodes, unsigned int nodeIndex) {
+		BVHNode node = (*nodes)[nodeIndex];
+		if (node.count <= BVH_MAX_LEAF_SIZE) {
+			return false;
+		}
+		unsigned int* indices = &bvh->objectIndices[node.leftFirst];
+		//Split along the largest axis of the centroid bounds
+		glm::vec3 centroidMin = glm::vec3(FLT_MAX);
+		glm::vec3 centroidMax = glm::vec3(-FLT_MAX);
+		for (unsigned int i = 0; i < node.count; i++)
+		{
+			glm::vec3 centroid = (bvh->objectMin[indices[i]] + bvh->objectMax[indices[i]]) * 0.5f;
+			centroidMin = glm::min(centroidMin, centroid);
+			centroidMax = glm::max(centroidMax, centroid);
+		}
+		glm::vec3 extent = centroidMax - centroidMin;
+		int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+		if (extent[axis] <= 0.0f) {
+			return false;
+		}
+
+		struct Bin {
+			glm::vec3 min = glm::vec3(FLT_MAX);
+			glm::vec3 max = glm::vec3(-FLT_MAX);
+			unsigned int count = 0;
+		};
+		Bin bins[BVH_BINS];
+		float binScale = BVH_BINS / extent[axis];
+		for (unsigned int i = 0; i < node.count; i++)
+		{
+			unsigned int object = indices[i];
+			float centroid = (bvh->objectMin[object][axis] + bvh->objectMax[object][axis]) * 0.5f;
+			unsigned int bin = glm::min((unsigned int)((centroid - centroidMin[axis]) * binScale), BVH_BINS - 1);
+			bins[bin].count++;
+			bins[bin].min = glm::min(bins[bin].min, bvh->objectMin[object]);
+			bins[bin].max = glm::max(bins[bin].max, bvh->objectMax[object]);
+		}
+		//Sweep from both sides to get the cost of every split plane between bins
+		float leftArea[BVH_BINS - 1], rightArea[BVH_BINS - 1];
+		unsigned int leftCount[BVH_BINS - 1], rightCount[BVH_BINS - 1];
+		glm::vec3 leftMin = glm::vec3(FLT_MAX), leftMax = glm::vec3(-FLT_MAX);
+		glm::vec3 rightMin = glm::vec3(FLT_MAX), rightMax = glm::vec3(-FLT_MAX);
+		unsigned int leftSum = 0, rightSum = 0;
+		for (unsigned int i = 0; i < BVH_BINS - 1; i++)
+		{
+			leftSum += bins[i].count;
+			leftCount[i] = leftSum;
+			leftMin = glm::min(leftMin, bins[i].min);
+			leftMax = glm::max(leftMax, bins[i].max);
+			leftArea[i] = leftSum > 0 ? surfaceArea(leftMin, leftMax) : 0.0f;
+			unsigned int j = BVH_BINS - 1 - i;
+			rightSum += bins[j].count;
+			rightCount[j - 1] = rightSum;
+			rightMin = glm::min(rightMin, bins[j].min);
+			rightMax = glm::max(rightMax, bins[j].max);
+			rightArea[j - 1] = rightSum > 0 ? surfaceArea(rightMin, rightMax) : 0.0f;
+		}
+		float bestCost = FLT_MAX;
+		unsigned int bestSplit = 0;
+		for (unsigned int i = 0; i < BVH_BINS - 1; i++)
+		{
+			float cost = leftCount[i] * leftArea[i] + rightCount[i] * rightArea[i];
+			if (leftCount[i] > 0 && rightCount[i] > 0 && cost < bestCost) {
+				bestCost = cost;
+				bestSplit = i;
+			}
+		}
+		float leafCost = node.count * surfaceArea(node.min, node.max);
+		if (bestCost == FLT_MAX || (bestCost >= leafCost && node.count <= BVH_MAX_LEAF_SIZE * 4)) {
+			return false;
+		}
+
+		//Partition the node's objects in place
+		unsigned int* left = indices;
+		unsigned int* right = indices + node.count;
+		while (left < right) {
+			float centroid = (bvh->objectMin[*left][axis] + bvh->objectMax[*left][axis]) * 0.5f;
+			unsigned int bin = glm::min((unsigned int)((centroid - centroidMin[axis]) * binScale), BVH_BINS - 1);
+			if (bin <= bestSplit) {
+				left++;
+			}
+			else {
+				std::swap(*left, *--right);
+			}
+		}
+		unsigned int leftObjects = (unsigned int)(left - indices);
+
+		BVHNode leftChild;
+		leftChild.leftFirst = node.leftFirst;
+		leftChild.count = leftObjects;
+		computeNodeBounds(*bvh, &leftChild);
+		BVHNode rightChild;
+		rightChild.leftFirst = node.leftFirst + leftObjects;
+		rightChild.count = node.count - leftObjects;
+		computeNodeBounds(*bvh, &rightChild);
+
+		unsigned int childIndex = (unsigned int)nodes->size();
+		nodes->push_back(leftChild);
+		nodes->push_back(rightChild);
+		(*nodes)[nodeIndex].leftFirst = childIndex;
+		(*nodes)[nodeIndex].count = 0;
+		return true;
+	}
+
+	//Depth is capped so the fixed size traversal stacks in the queries can't overflow
+	static void buildSubtree(BVH* bvh, std::vector<BVHNode>* nodes, unsigned int root, unsigned int rootDepth) {
+		std::vector<std::pair<unsigned int, unsigned int>> stack;
+		stack.push_back({ root, rootDepth });
+		while (!stack.empty()) {
+			unsigned int nodeIndex = stack.back().first;
+			unsigned int depth = stack.back().second;
+			stack.pop_back();
+			if (depth + 1 < BVH_MAX_DEPTH && splitNode(bvh, nodes, nodeIndex)) {
+				unsigned int child = (*nodes)[nodeIndex].leftFirst;
+				stack.push_back({ child, depth + 1 });
+				stack.push_back({ child + 1, depth + 1 });
+			}
+		}
+	}
+
+	void buildBVH(BVH* bvh, JobSystem* jobSystem) {
+		unsigned int numObjects = (unsigned int)bvh->objectMin.size();
+		bvh->nodes.clear();
+		bvh->objectIndices.resize(numObjects);
+		for (unsigned int i = 0; i < numObjects; i++)
+		{
+			bvh->objectIndices[i] = i;
+		}
+		BVHNode root;
+		root.leftFirst = 0;
+		root.count = numObjects;
+		computeNodeBounds(*bvh, &root);
+		bvh->nodes.push_back(root);
+		bvh->subtreeFirst.clear();
+		if (numObjects == 0) {
+			bvh->numTopNodes = 1;
+			return;
+		}
+
+		//Split breadth first on this thread until there are enough independent subtrees to keep every thread busy
+		unsigned int numTasks = jobSystem->getNumThreads() * BVH_TASKS_PER_THREAD;
+		std::vector<unsigned int> tasks(1, 0);
+		std::vector<unsigned int> nextTasks;
+		unsigned int taskDepth = 0;
+		while (tasks.size() < numTasks) {
+			nextTasks.clear();
+			bool split = false;
+			for (size_t i = 0; i < tasks.size(); i++)
+			{
+				if (splitNode(bvh, &bvh->nodes, tasks[i])) {
+					unsigned int child = bvh->nodes[tasks[i]].leftFirst;
+					nextTasks.push_back(child);
+					nextTasks.push_back(child + 1);
+					split = true;
+				}
+			}
+			if (!split) {
+				tasks.clear();
+				break;
+			}
+			tasks.swap(nextTasks);
+			taskDepth++;
+		}
+
+		//Each subtree goes into its own node list, with its root at local index 0
+		std::vector<std::vector<BVHNode>> subtrees(tasks.size());
+		jobSystem->parallelFor((unsigned int)tasks.size(), 1, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int t = begin; t < end; t++)
+			{
+				subtrees[t].push_back(bvh->nodes[tasks[t]]);
+				buildSubtree(bvh, &subtrees[t], 0, taskDepth);
+			}
+		});
+		//Stitch the subtrees in, local index i > 0 lands at base + i - 1
+		bvh->numTopNodes = (unsigned int)bvh->nodes.size();
+		for (size_t t = 0; t < tasks.size(); t++)
+		{
+			const std::vector<BVHNode>& subtree = subtrees[t];
+			unsigned int base = (unsigned int)bvh->nodes.size();
+			bvh->subtreeFirst.push_back(base);
+			for (size_t i = 0; i < subtree.size(); i++)
+			{
+				BVHNode node = subtree[i];
+				if (node.count == 0) {
+					node.leftFirst = base + node.leftFirst - 1;
+				}
+				if (i == 0) {
+					bvh->nodes[tasks[t]] = node;
+				}
+				else {
+					bvh->nodes.push_back(node);
+				}
+			}
+		}
+	}
+
+	static void refitNode(BVH* bvh, unsigned int nodeIndex) {
+		BVHNode& node = bvh->nodes[nodeIndex];
+		if (node.count > 0) {
+			computeNodeBounds(*bvh, &node);
+		}
+		else {
+			const BVHNode& left = bvh->nodes[node.leftFirst];
+			const BVHNode& right = bvh->nodes[node.leftFirst + 1];
+			node.min = glm::min(left.min, right.min);
+			node.max = glm::max(left.max, right.max);
+		}
+	}
+
+	void refitBVH(BVH* bvh, JobSystem* jobSystem) {
+		if (bvh->nodes.empty()) {
+			return;
+		}
+		//Subtrees don't share nodes, and each one is contiguous, so a backwards walk per subtree is enough
+		unsigned int numSubtrees = (unsigned int)bvh->subtreeFirst.size();
+		jobSystem->parallelFor(numSubtrees, 1, [bvh, numSubtrees](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int t = begin; t < end; t++)
+			{
+				unsigned int first = bvh->subtreeFirst[t];
+				unsigned int last = t + 1 < numSubtrees ? bvh->subtreeFirst[t + 1] : (unsigned int)bvh->nodes.size();
+				for (unsigned int i = last; i-- > first;)
+				{
+					refitNode(bvh, i);
+				}
+			}
+		});
+		//Subtree roots live in the top nodes and are refit here along with everything above them
+		for (unsigned int i = bvh->numTopNodes; i-- > 0;)
+		{
+			refitNode(bvh, i);
+		}
+	}
+
+	static bool overlapsSphere(const glm::vec3& min, const glm::vec3& max, const glm::vec3& center, float radius) {
+		glm::vec3 closest = glm::clamp(center, min, max);
+		glm::vec3 offset = closest - center;
+		return glm::dot(offset, offset) <= radius * radius;
+	}
+
+	void queryBVHFrustum(const BVH& bvh, const Frustum& frustum, std::vector<unsigned int>* results) {
+		if (bvh.nodes.empty() || bvh.objectIndices.empty()) {
+			return;
+		}
+		unsigned int stack[BVH_MAX_DEPTH * 2];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BVHNode& node = bvh.nodes[stack[--stackSize]];
+			if (!isAABBVisible(frustum, node.min, node.max)) {
+				continue;
+			}
+			if (node.count > 0) {
+				for (unsigned int i = 0; i < node.count; i++)
+				{
+					unsigned int object = bvh.objectIndices[node.leftFirst + i];
+					if (isAABBVisible(frustum, bvh.objectMin[object], bvh.objectMax[object])) {
+						results->push_back(object);
+					}
+				}
+			}
+			else if (stackSize + 2 <= BVH_MAX_DEPTH * 2) {
+				stack[stackSize++] = node.leftFirst;
+				stack[stackSize++] = node.leftFirst + 1;
+			}
+		}
+	}
+
+	void queryBVHSphere(const BVH& bvh, const glm::vec3& center, float radius, std::vector<unsigned int>* results) {
+		if (bvh.nodes.empty() || bvh.objectIndices.empty()) {
+			return;
+		}
+		unsigned int stack[BVH_MAX_DEPTH * 2];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BVHNode& node = bvh.nodes[stack[--stackSize]];
+			if (!overlapsSphere(node.min, node.max, center, radius)) {
+				continue;
+			}
+			if (node.count > 0) {
+				for (unsigned int i = 0; i < node.count; i++)
+				{
+					unsigned int object = bvh.objectIndices[node.leftFirst + i];
+					if (overlapsSphere(bvh.objectMin[object], bvh.objectMax[object], center, radius)) {
+						results->push_back(object);
+					}
+				}
+			}
+			else if (stackSize + 2 <= BVH_MAX_DEPTH * 2) {
+				stack[stackSize++] = node.leftFirst;
+				stack[stackSize++] = node.leftFirst + 1;
+			}
+		}
+	}
+
+	//Slab test. Returns the entry distance, or FLT_MAX on a miss
+	static float intersectAABB(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& inverseDirection, float maxDistance) {
+		glm::vec3 t0 = (min - origin) * inverseDirection;
+		glm::vec3 t1 = (max - origin) * inverseDirection;
+		glm::vec3 tNear = glm::min(t0, t1);
+		glm::vec3 tFar = glm::max(t0, t1);
+		float enter = glm::max(glm::max(tNear.x, tNear.y), glm::max(tNear.z, 0.0f));
+		float exit = glm::min(glm::min(tFar.x, tFar.y), glm::min(tFar.z, maxDistance));
+		return enter <= exit ? enter : FLT_MAX;
+	}
+
+	bool raycastBVH(const BVH& bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned int* hitObject, float* hitDistance) {
+		if (bvh.nodes.empty() || bvh.objectIndices.empty()) {
+			return false;
+		}
+		glm::vec3 inverseDirection = 1.0f / direction;
+		float closest = maxDistance;
+		bool hit = false;
+		unsigned int stack[BVH_MAX_DEPTH * 2];
+		unsigned int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0) {
+			const BVHNode& node = bvh.nodes[stack[--stackSize]];
+			if (intersectAABB(node.min, node.max, origin, inverseDirection, closest) == FLT_MAX) {
+				continue;
+			}
+			if (node.count > 0) {
+				for (unsigned int i = 0; i < node.count; i++)
+				{
+					unsigned int object = bvh.objectIndices[node.leftFirst + i];
+					float distance = intersectAABB(bvh.objectMin[object], bvh.objectMax[object], origin, inverseDirection, closest);
+					if (distance < closest || (!hit && distance <= closest)) {
+						closest = distance;
+						*hitObject = object;
+						hit = true;
+					}
+				}
+			}
+			else if (stackSize + 2 <= BVH_MAX_DEPTH * 2) {
+				//Visit the nearer child first so the far one is more likely to be rejected by the closest hit so far
+				unsigned int left = node.leftFirst;
+				unsigned int right = node.leftFirst + 1;
+				float leftDistance = intersectAABB(bvh.nodes[left].min, bvh.nodes[left].max, origin, inverseDirection, closest);
+				float rightDistance = intersectAABB(bvh.nodes[right].min, bvh.nodes[right].max, origin, inverseDirection, closest);
+				if (leftDistance > rightDistance) {
+					std::swap(left, right);
+					std::swap(leftDistance, rightDistance);
+				}
+				if (rightDistance != FLT_MAX) {
+					stack[stackSize++] = right;
+				}
+				if (leftDistance != FLT_MAX) {
+					stack[stackSize++] = left;
+				}
+			}
+		}
+		if (hit) {
+			*hitDistance = closest;
+		}
+		return hit;
+	}
+}
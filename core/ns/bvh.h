@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "culling.h"
+#include "jobSystem.h"
+
+namespace ns {
+	//32 bytes. Leaves have count > 0 and own objectIndices[leftFirst, leftFirst + count).
+	//Interior nodes have count == 0, children are leftFirst and leftFirst + 1
+	struct BVHNode {
+		glm::vec3 min;
+		unsigned int leftFirst;
+		glm::vec3 max;
+		unsigned int count;
+	};
+
+	//Bounding volume hierarchy over world space object AABBs.
+	//Fill the object bounds, build once, then after objects move update their bounds and refit.
+	//Refitting keeps the topology, so rebuild when objects are added/removed or have moved far from where they were at build time.
+	//Children are always stored after their parent, so walking the nodes backwards visits children before parents
+	struct BVH {
+		std::vector<glm::vec3> objectMin;
+		std::vector<glm::vec3> objectMax;
+		std::vector<BVHNode> nodes;
+		std::vector<unsigned int> objectIndices;
+		unsigned int numTopNodes = 0; //Nodes split on the calling thread, stored first
+		std::vector<unsigned int> subtreeFirst; //Subtree t owns nodes [subtreeFirst[t], subtreeFirst[t + 1]), the last one runs to the end
+	};
+
+	void resizeBVH(BVH* bvh, unsigned int numObjects);
+	inline void setBVHObjectBounds(BVH* bvh, unsigned int object, const glm::vec3& min, const glm::vec3& max) {
+		bvh->objectMin[object] = min;
+		bvh->objectMax[object] = max;
+	}
+	//World space AABB of a mesh moved by model
+	void transformBounds(const glm::mat4& model, const ew::MeshBounds& bounds, glm::vec3* min, glm::vec3* max);
+
+	//Binned SAH build. The top of the tree is split on the calling thread, the subtrees below it are built in parallel
+	void buildBVH(BVH* bvh, JobSystem* jobSystem);
+	//Recomputes node bounds from the current object bounds. Subtrees are refit in parallel, then the top of the tree
+	void refitBVH(BVH* bvh, JobSystem* jobSystem);
+
+	//Objects whose bounds intersect the frustum, appended to results
+	void queryBVHFrustum(const BVH& bvh, const Frustum& frustum, std::vector<unsigned int>* results);
+	//Objects whose bounds intersect the sphere, appended to results
+	void queryBVHSphere(const BVH& bvh, const glm::vec3& center, float radius, std::vector<unsigned int>* results);
+	//Closest object whose bounds the ray hits within maxDistance. Returns false if there is none
+	bool raycastBVH(const BVH& bvh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, unsigned int* hitObject, float* hitDistance);
+}
@@ -0,0 +1,225 @@
+#include "cascadedShadowMap.h"
+#include "glState.h"
+#include "../ew/external/glad.h"
+#include <stdio.h>
+#include <math.h>
+
+namespace ns {
+	static unsigned int createDepthArray(unsigned int resolution, unsigned int numCascades) {
+		unsigned int depthArray;
+		glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &depthArray);
+		//16 bit depth values, same as ns::ShadowMap
+		glTextureStorage3D(depthArray, 1, GL_DEPTH_COMPONENT16, resolution, resolution, numCascades);
+		glTextureParameteri(depthArray, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTextureParameteri(depthArray, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		//Pixels outside of frustum should have max distance (white)
+		glTextureParameteri(depthArray, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+		glTextureParameteri(depthArray, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+		float borderColor[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glTextureParameterfv(depthArray, GL_TEXTURE_BORDER_COLOR, borderColor);
+		return depthArray;
+	}
+
+	CascadedShadowMap createCascadedShadowMap(unsigned int resolution, unsigned int numCascades, bool cacheStatic) {
+		CascadedShadowMap shadowMap;
+		shadowMap.resolution = resolution;
+		shadowMap.numCascades = glm::clamp(numCascades, 1u, MAX_SHADOW_CASCADES);
+		for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		{
+			shadowMap.splitDepths[i] = 0.0f;
+			shadowMap.viewProjections[i] = glm::mat4(1.0f);
+			shadowMap.layerViews[i] = 0;
+			shadowMap.staticViewProjections[i] = glm::mat4(1.0f);
+			shadowMap.drawnStaticViewProjections[i] = glm::mat4(1.0f);
+			shadowMap.staticValid[i] = false;
+			shadowMap.layerMatchesStatic[i] = false;
+		}
+		shadowMap.numStaticRedraws = 0;
+
+		shadowMap.depthArray = createDepthArray(resolution, shadowMap.numCascades);
+		if (cacheStatic) {
+			shadowMap.staticDepthArray = createDepthArray(resolution, shadowMap.numCascades);
+			glCreateVertexArrays(1, &shadowMap.resampleVAO);
+			shadowMap.cacheEnabled = true;
+		}
+		glGenTextures(shadowMap.numCascades, shadowMap.layerViews);
+		for (unsigned int i = 0; i < shadowMap.numCascades; i++)
+		{
+			glTextureView(shadowMap.layerViews[i], GL_TEXTURE_2D, shadowMap.depthArray, GL_DEPTH_COMPONENT16, 0, 1, i, 1);
+		}
+
+		glCreateFramebuffers(1, &shadowMap.fbo);
+		glNamedFramebufferTextureLayer(shadowMap.fbo, GL_DEPTH_ATTACHMENT, shadowMap.depthArray, 0, 0);
+		//Tell open gl we are not drawing colors
+		glNamedFramebufferDrawBuffer(shadowMap.fbo, GL_NONE);
+		glNamedFramebufferReadBuffer(shadowMap.fbo, GL_NONE);
+		if (glCheckNamedFramebufferStatus(shadowMap.fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("ERROR::FRAMEBUFFER:: Cascaded Shadow Map Framebuffer is not complete!");
+
+		return shadowMap;
+	}
+
+	size_t getCascadedShadowMapMemory(const CascadedShadowMap& shadowMap) {
+		size_t layers = shadowMap.staticDepthArray != 0 ? shadowMap.numCascades * 2 : shadowMap.numCascades;
+		return (size_t)shadowMap.resolution * shadowMap.resolution * layers * sizeof(unsigned short);
+	}
+
+	void computeCascadeSplits(float nearPlane, float farPlane, unsigned int numCascades, float lambda, float* splits) {
+		for (unsigned int i = 1; i <= numCascades; i++)
+		{
+			float t = (float)i / numCascades;
+			float logSplit = nearPlane * powf(farPlane / nearPlane, t);
+			float uniformSplit = nearPlane + (farPlane - nearPlane) * t;
+			splits[i - 1] = glm::mix(uniformSplit, logSplit, lambda);
+		}
+	}
+
+	void updateCascades(CascadedShadowMap* shadowMap, const ew::Camera& camera, const glm::vec3& lightDirection, float shadowDistance, float casterDistance) {
+		float nearPlane = camera.nearPlane;
+		float farPlane = glm::max(glm::min(camera.farPlane, shadowDistance), nearPlane * 2.0f);
+		computeCascadeSplits(nearPlane, farPlane, shadowMap->numCascades, shadowMap->splitLambda, shadowMap->splitDepths);
+		shadowMap->numStaticRedraws = 0;
+		bool cached = shadowMap->staticDepthArray != 0 && shadowMap->cacheEnabled;
+
+		glm::mat4 inverseView = glm::inverse(camera.viewMatrix());
+		float tanHalfFov = tanf(glm::radians(camera.fov) * 0.5f);
+		glm::vec3 direction = glm::normalize(lightDirection);
+		//Same fallback as ew::Camera when looking straight along the up vector
+		glm::vec3 up = fabsf(direction.y) >= 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+		//Rotation into light space, shared by every cascade and static region
+		glm::mat4 lightView = glm::lookAt(glm::vec3(0.0f), direction, up);
+		float sliceNear = nearPlane;
+		for (unsigned int c = 0; c < shadowMap->numCascades; c++)
+		{
+			float sliceFar = shadowMap->splitDepths[c];
+			//Corners of the slice in world space
+			glm::vec3 corners[8];
+			for (int i = 0; i < 8; i++)
+			{
+				float depth = (i & 4) ? sliceFar : sliceNear;
+				float halfHeight = camera.orthographic ? camera.orthoHeight * 0.5f : depth * tanHalfFov;
+				float halfWidth = halfHeight * camera.aspectRatio;
+				glm::vec4 viewCorner = glm::vec4((i & 1) ? halfWidth : -halfWidth, (i & 2) ? halfHeight : -halfHeight, -depth, 1.0f);
+				corners[i] = glm::vec3(inverseView * viewCorner);
+			}
+			glm::vec3 center = glm::vec3(0.0f);
+			for (int i = 0; i < 8; i++)
+			{
+				center += corners[i] / 8.0f;
+			}
+			float radius = 0.0f;
+			for (int i = 0; i < 8; i++)
+			{
+				radius = glm::max(radius, glm::length(corners[i] - center));
+			}
+			//Rounded up so float error doesn't change the size from frame to frame
+			radius = ceilf(radius * 16.0f) / 16.0f;
+
+			glm::mat4 view = glm::lookAt(center - direction * (radius + casterDistance), center, up);
+			glm::mat4 projection = glm::ortho(-radius, radius, -radius, radius, 0.0f, radius * 2.0f + casterDistance);
+			//Snap the world origin to a texel so every texel keeps covering the same world space as the camera moves
+			glm::vec4 origin = projection * view * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+			glm::vec2 originTexels = glm::vec2(origin) * (shadowMap->resolution * 0.5f);
+			glm::vec2 offset = (glm::round(originTexels) - originTexels) * (2.0f / shadowMap->resolution);
+			projection[3][0] += offset.x;
+			projection[3][1] += offset.y;
+
+			glm::mat4 viewProjection = projection * view;
+			if (viewProjection != shadowMap->viewProjections[c]) {
+				shadowMap->layerMatchesStatic[c] = false;
+			}
+			shadowMap->viewProjections[c] = viewProjection;
+			shadowMap->frustums[c] = extractFrustum(viewProjection);
+
+			if (cached) {
+				//Static region: the light space center snapped to coarse steps, grown by half a step on every side
+				//(and the caster distance towards the light) so it always contains the cascade
+				float step = radius * shadowMap->staticStep;
+				glm::vec3 lightCenter = glm::vec3(lightView * glm::vec4(center, 1.0f));
+				glm::vec3 snapped = glm::round(lightCenter / step) * step;
+				float halfSize = radius + step * 0.5f;
+				float depth = -snapped.z;
+				glm::mat4 staticProjection = glm::ortho(snapped.x - halfSize, snapped.x + halfSize, snapped.y - halfSize, snapped.y + halfSize,
+					depth - halfSize - casterDistance, depth + halfSize);
+				shadowMap->staticViewProjections[c] = staticProjection * lightView;
+			}
+			else {
+				shadowMap->staticViewProjections[c] = viewProjection;
+			}
+			shadowMap->staticFrustums[c] = extractFrustum(shadowMap->staticViewProjections[c]);
+			sliceNear = sliceFar;
+		}
+	}
+
+	void beginCascade(const CascadedShadowMap& shadowMap, unsigned int cascade) {
+		glNamedFramebufferTextureLayer(shadowMap.fbo, GL_DEPTH_ATTACHMENT, shadowMap.depthArray, 0, cascade);
+		bindFramebuffer(shadowMap.fbo);
+		setViewport(0, 0, shadowMap.resolution, shadowMap.resolution);
+		glClear(GL_DEPTH_BUFFER_BIT);
+	}
+
+	bool beginStaticCascade(CascadedShadowMap* shadowMap, unsigned int cascade) {
+		if (shadowMap->staticDepthArray == 0 || !shadowMap->cacheEnabled) {
+			//Everything is drawn every frame, and the cache has to be rebuilt when turned back on
+			shadowMap->staticValid[cascade] = false;
+			shadowMap->layerMatchesStatic[cascade] = false;
+			shadowMap->numStaticRedraws++;
+			beginCascade(*shadowMap, cascade);
+			return true;
+		}
+		//Exact compare. The regions are snapped, so they are bit identical until the cascade crosses a step or the light turns
+		if (shadowMap->staticValid[cascade] && shadowMap->drawnStaticViewProjections[cascade] == shadowMap->staticViewProjections[cascade]) {
+			return false;
+		}
+		shadowMap->drawnStaticViewProjections[cascade] = shadowMap->staticViewProjections[cascade];
+		shadowMap->staticValid[cascade] = true;
+		shadowMap->layerMatchesStatic[cascade] = false;
+		shadowMap->numStaticRedraws++;
+		glNamedFramebufferTextureLayer(shadowMap->fbo, GL_DEPTH_ATTACHMENT, shadowMap->staticDepthArray, 0, cascade);
+		bindFramebuffer(shadowMap->fbo);
+		setViewport(0, 0, shadowMap->resolution, shadowMap->resolution);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		return true;
+	}
+
+	bool beginDynamicCascade(CascadedShadowMap* shadowMap, unsigned int cascade, bool hasDynamicCasters, const ew::Shader& resampleShader) {
+		bool cached = shadowMap->staticDepthArray != 0 && shadowMap->cacheEnabled;
+		if (cached) {
+			glNamedFramebufferTextureLayer(shadowMap->fbo, GL_DEPTH_ATTACHMENT, shadowMap->depthArray, 0, cascade);
+			bindFramebuffer(shadowMap->fbo);
+			setViewport(0, 0, shadowMap->resolution, shadowMap->resolution);
+		}
+		if (cached && !shadowMap->layerMatchesStatic[cascade]) {
+			//Replaces last frame's dynamic casters, a cascade that moved, or a static layer that was just redrawn.
+			//Every texel is written, so the layer needs no clear
+			glm::mat4 dynamicToStatic = shadowMap->staticViewProjections[cascade] * glm::inverse(shadowMap->viewProjections[cascade]);
+			resampleShader.use();
+			resampleShader.setInt("_StaticShadowMap", 0);
+			resampleShader.setInt("_Cascade", (int)cascade);
+			resampleShader.setFloat("_Resolution", (float)shadowMap->resolution);
+			resampleShader.setMat4("_DynamicToStatic", dynamicToStatic);
+			resampleShader.setMat4("_StaticToDynamic", glm::inverse(dynamicToStatic));
+			bindTextureUnit(0, shadowMap->staticDepthArray);
+			bindVertexArray(shadowMap->resampleVAO);
+			setDepthState(true, GL_ALWAYS, true);
+			glDrawArrays(GL_TRIANGLES, 0, 3);
+			setDepthState(true, GL_LESS, true);
+			shadowMap->layerMatchesStatic[cascade] = true;
+		}
+		if (!hasDynamicCasters) {
+			return false;
+		}
+		if (cached) {
+			shadowMap->layerMatchesStatic[cascade] = false;
+		}
+		//Uncached, beginStaticCascade left the cascade's layer bound with the static casters in it
+		return true;
+	}
+
+	void invalidateShadowCache(CascadedShadowMap* shadowMap) {
+		for (unsigned int i = 0; i < MAX_SHADOW_CASCADES; i++)
+		{
+			shadowMap->staticValid[i] = false;
+		}
+	}
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "../ew/camera.h"
+#include "../ew/shader.h"
+#include "culling.h"
+
+namespace ns {
+	const unsigned int MAX_SHADOW_CASCADES = 4;
+
+	//Directional shadow split into cascades along the view, one layer of a depth texture array each.
+	//Near cascades cover a small slice of the camera frustum, so they get far more texels per world unit than one map
+	//covering the whole scene. Cascades are fit to the bounding sphere of their slice, which doesn't change size as the
+	//camera turns, and moved in whole texels, so the shadow edges don't shimmer when the camera moves
+	struct CascadedShadowMap {
+		unsigned int fbo;
+		unsigned int depthArray; //GL_TEXTURE_2D_ARRAY, layer i is cascade i
+		unsigned int layerViews[MAX_SHADOW_CASCADES]; //GL_TEXTURE_2D view of each layer, for debug display
+		unsigned int resolution; //Width and height of every layer
+		unsigned int numCascades;
+		float splitLambda = 0.75f; //0 splits the view distance uniformly, 1 logarithmically
+		//Filled by updateCascades
+		float splitDepths[MAX_SHADOW_CASCADES]; //View space distance where each cascade ends
+		glm::mat4 viewProjections[MAX_SHADOW_CASCADES];
+		Frustum frustums[MAX_SHADOW_CASCADES]; //For culling the casters of each cascade
+		//Static caster cache. Static casters are drawn into their own layers over a region that only moves in coarse steps,
+		//and resampled under the dynamic casters whenever either side changes. A camera flying through the scene redraws them
+		//only as it crosses a step, a still camera and light never
+		unsigned int staticDepthArray = 0; //Static casters only, 0 when created without a cache
+		unsigned int resampleVAO = 0; //Empty, for the fullscreen resample pass
+		bool cacheEnabled = false; //Can be turned off at runtime to draw everything every frame
+		float staticStep = 0.5f; //Step the static region moves in, as a fraction of the cascade's radius
+		glm::mat4 staticViewProjections[MAX_SHADOW_CASCADES]; //Draw the static casters with these, same as viewProjections when not caching
+		Frustum staticFrustums[MAX_SHADOW_CASCADES];
+		glm::mat4 drawnStaticViewProjections[MAX_SHADOW_CASCADES]; //What each static layer holds
+		bool staticValid[MAX_SHADOW_CASCADES];
+		bool layerMatchesStatic[MAX_SHADOW_CASCADES]; //depthArray layer holds only the static casters, for the current viewProjection
+		unsigned int numStaticRedraws; //Cascades whose static casters were drawn since updateCascades
+	};
+	//cacheStatic allocates a second depth array for the static caster cache
+	CascadedShadowMap createCascadedShadowMap(unsigned int resolution, unsigned int numCascades, bool cacheStatic = false);
+	size_t getCascadedShadowMapMemory(const CascadedShadowMap& shadowMap);
+
+	//Practical split scheme, a mix of uniform and logarithmic splits of [nearPlane, farPlane] weighted by lambda
+	void computeCascadeSplits(float nearPlane, float farPlane, unsigned int numCascades, float lambda, float* splits);
+	//Fits every cascade to its slice of the camera frustum up to shadowDistance. casterDistance extends each cascade
+	//towards the light so casters outside the view still cast into it
+	void updateCascades(CascadedShadowMap* shadowMap, const ew::Camera& camera, const glm::vec3& lightDirection, float shadowDistance, float casterDistance);
+	//Attaches the cascade's layer, sets the viewport and clears it
+	void beginCascade(const CascadedShadowMap& shadowMap, unsigned int cascade);
+
+	//Cached drawing of a cascade, static casters then dynamic casters:
+	//	if (beginStaticCascade(&shadowMap, c)) { draw static casters with staticViewProjections[c], culled by staticFrustums[c] }
+	//	if (beginDynamicCascade(&shadowMap, c, hasDynamicCasters, resampleShader)) { draw dynamic casters with viewProjections[c] }
+	//Returns true if the static casters must be drawn, into the static layer when caching and the cascade's layer when not
+	bool beginStaticCascade(CascadedShadowMap* shadowMap, unsigned int cascade);
+	//Brings the cascade's layer up to date with the static layer, resampling it with resampleShader (fullscreen triangle
+	//vertex shader, shadowResample.frag). This changes the bound program. Returns true with the layer bound if the dynamic
+	//casters must be drawn, false if there are none and the layer is already complete
+	bool beginDynamicCascade(CascadedShadowMap* shadowMap, unsigned int cascade, bool hasDynamicCasters, const ew::Shader& resampleShader);
+	//Static casters are redrawn next frame. Call when static geometry moves. Light and camera changes are detected
+	//from the static regions
+	void invalidateShadowCache(CascadedShadowMap* shadowMap);
+}
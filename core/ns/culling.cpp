@@ -0,0 +1,154 @@
+#include "culling.h"
+#include <chrono>
+#include <math.h>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NS_CULLING_SSE 1
+#endif
+
+namespace ns {
+	//Objects per batch handed to one thread
+	static const unsigned int CULL_BATCH_SIZE = 4096;
+
+	Frustum extractFrustum(const glm::mat4& viewProjection) {
+		//Rows of the matrix, glm stores columns
+		glm::vec4 rows[4];
+		for (int i = 0; i < 4; i++)
+		{
+			rows[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+		}
+		Frustum frustum;
+		frustum.planes[0] = rows[3] + rows[0];
+		frustum.planes[1] = rows[3] - rows[0];
+		frustum.planes[2] = rows[3] + rows[1];
+		frustum.planes[3] = rows[3] - rows[1];
+		frustum.planes[4] = rows[3] + rows[2];
+		frustum.planes[5] = rows[3] - rows[2];
+		for (int i = 0; i < 6; i++)
+		{
+			frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+		}
+		return frustum;
+	}
+
+	bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius) {
+		for (int i = 0; i < 6; i++)
+		{
+			if (glm::dot(glm::vec3(frustum.planes[i]), center) + frustum.planes[i].w < -radius) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool isAABBVisible(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max) {
+		for (int i = 0; i < 6; i++)
+		{
+			//Corner furthest along the plane normal
+			glm::vec3 normal = glm::vec3(frustum.planes[i]);
+			glm::vec3 corner = glm::vec3(normal.x >= 0.0f ? max.x : min.x, normal.y >= 0.0f ? max.y : min.y, normal.z >= 0.0f ? max.z : min.z);
+			if (glm::dot(normal, corner) + frustum.planes[i].w < 0.0f) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool isBoundsVisible(const Frustum& frustum, const glm::mat4& model, const ew::MeshBounds& bounds) {
+		glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+		float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		return isSphereVisible(frustum, center, bounds.radius * scale);
+	}
+
+	void resizeSphereSet(SphereSet* spheres, unsigned int count) {
+		spheres->x.resize(count);
+		spheres->y.resize(count);
+		spheres->z.resize(count);
+		spheres->radius.resize(count);
+	}
+
+	void setSphere(SphereSet* spheres, unsigned int index, const glm::mat4& model, const ew::MeshBounds& bounds) {
+		glm::vec3 center = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+		float scale = glm::max(glm::length(glm::vec3(model[0])), glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+		spheres->x[index] = center.x;
+		spheres->y[index] = center.y;
+		spheres->z[index] = center.z;
+		spheres->radius[index] = bounds.radius * scale;
+	}
+
+	void cullSpheres(const Frustum& frustum, const SphereSet& spheres, unsigned int begin, unsigned int end, unsigned char* visible) {
+		const float* xs = spheres.x.data();
+		const float* ys = spheres.y.data();
+		const float* zs = spheres.z.data();
+		const float* radii = spheres.radius.data();
+		unsigned int i = begin;
+#ifdef NS_CULLING_SSE
+		__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+		for (int p = 0; p < 6; p++)
+		{
+			planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+			planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+			planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+			planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for (; i + 4 <= end; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(xs + i);
+			__m128 y = _mm_loadu_ps(ys + i);
+			__m128 z = _mm_loadu_ps(zs + i);
+			__m128 negativeRadius = _mm_sub_ps(zero, _mm_loadu_ps(radii + i));
+			__m128 inside = _mm_cmpeq_ps(zero, zero);
+			for (int p = 0; p < 6; p++)
+			{
+				__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], x), _mm_mul_ps(planeY[p], y)), _mm_add_ps(_mm_mul_ps(planeZ[p], z), planeW[p]));
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+			}
+			int mask = _mm_movemask_ps(inside);
+			visible[i] = (unsigned char)(mask & 1);
+			visible[i + 1] = (unsigned char)((mask >> 1) & 1);
+			visible[i + 2] = (unsigned char)((mask >> 2) & 1);
+			visible[i + 3] = (unsigned char)((mask >> 3) & 1);
+		}
+#endif
+		for (; i < end; i++)
+		{
+			visible[i] = isSphereVisible(frustum, glm::vec3(xs[i], ys[i], zs[i]), radii[i]) ? 1 : 0;
+		}
+	}
+
+	CullStats cullSpheresParallel(const Frustum& frustum, const SphereSet& spheres, unsigned char* visible, JobSystem* jobSystem) {
+		unsigned int count = (unsigned int)spheres.x.size();
+		unsigned int numThreads = jobSystem->getNumThreads();
+		std::vector<float> threadMs(numThreads, 0.0f);
+		std::vector<unsigned int> threadVisible(numThreads, 0);
+		auto start = std::chrono::high_resolution_clock::now();
+		jobSystem->parallelFor(count, CULL_BATCH_SIZE, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			auto batchStart = std::chrono::high_resolution_clock::now();
+			cullSpheres(frustum, spheres, begin, end, visible);
+			unsigned int numVisible = 0;
+			for (unsigned int i = begin; i < end; i++)
+			{
+				numVisible += visible[i];
+			}
+			std::chrono::duration<float, std::milli> batchTime = std::chrono::high_resolution_clock::now() - batchStart;
+			threadMs[threadIndex] += batchTime.count();
+			threadVisible[threadIndex] += numVisible;
+		});
+		std::chrono::duration<float, std::milli> wallTime = std::chrono::high_resolution_clock::now() - start;
+
+		CullStats stats;
+		stats.numVisible = 0;
+		stats.numThreads = 0;
+		stats.threadMs = 0.0f;
+		stats.wallMs = wallTime.count();
+		for (unsigned int t = 0; t < numThreads; t++)
+		{
+			stats.numVisible += threadVisible[t];
+			stats.threadMs += threadMs[t];
+			stats.numThreads += threadMs[t] > 0.0f ? 1 : 0;
+		}
+		return stats;
+	}
+}
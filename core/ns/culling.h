@@ -0,0 +1,42 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "../ew/mesh.h"
+#include "jobSystem.h"
+
+namespace ns {
+	//Planes in the order left, right, bottom, top, near, far. Points with dot(plane.xyz, p) + plane.w >= 0 are inside.
+	//Planes are normalized so the dot product is a distance
+	struct Frustum {
+		glm::vec4 planes[6];
+	};
+	//Gribb & Hartmann plane extraction. Works for perspective and orthographic cameras alike,
+	//and gives world space planes when given projection * view
+	Frustum extractFrustum(const glm::mat4& viewProjection);
+	bool isSphereVisible(const Frustum& frustum, const glm::vec3& center, float radius);
+	bool isAABBVisible(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max);
+	//Tests the mesh's bounding sphere moved into world space by model
+	bool isBoundsVisible(const Frustum& frustum, const glm::mat4& model, const ew::MeshBounds& bounds);
+
+	//World space bounding spheres as separate arrays so they can be tested four at a time
+	struct SphereSet {
+		std::vector<float> x;
+		std::vector<float> y;
+		std::vector<float> z;
+		std::vector<float> radius;
+	};
+	void resizeSphereSet(SphereSet* spheres, unsigned int count);
+	void setSphere(SphereSet* spheres, unsigned int index, const glm::mat4& model, const ew::MeshBounds& bounds);
+
+	//Writes 1 to visible[i] for spheres that touch the frustum and 0 for the rest, for i in [begin, end)
+	void cullSpheres(const Frustum& frustum, const SphereSet& spheres, unsigned int begin, unsigned int end, unsigned char* visible);
+
+	struct CullStats {
+		unsigned int numVisible;
+		unsigned int numThreads; //Threads that received work
+		float wallMs; //Time until every thread was done
+		float threadMs; //Sum of the time each thread spent culling
+	};
+	//cullSpheres over the whole set, split across the job system
+	CullStats cullSpheresParallel(const Frustum& frustum, const SphereSet& spheres, unsigned char* visible, JobSystem* jobSystem);
+}
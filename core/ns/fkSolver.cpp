@@ -0,0 +1,220 @@
+#include "fkSolver.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define NS_FK_SSE 1
+#endif
+
+namespace ns {
+	//Joints per parallelFor batch, small levels are solved on the calling thread
+	static const unsigned int FK_MIN_BATCH = 256;
+
+	FKHierarchy createFKHierarchy(const int* parents, unsigned int numJoints) {
+		FKHierarchy fk;
+		fk.numJoints = numJoints;
+		//Depth of every joint. Parents can come after children, so walk up until a known depth is found
+		std::vector<int> depths(numJoints, -1);
+		std::vector<unsigned int> chain;
+		unsigned int maxDepth = 0;
+		for (unsigned int i = 0; i < numJoints; i++)
+		{
+			unsigned int joint = i;
+			chain.clear();
+			while (depths[joint] < 0 && parents[joint] >= 0) {
+				chain.push_back(joint);
+				joint = (unsigned int)parents[joint];
+			}
+			if (depths[joint] < 0) {
+				depths[joint] = 0;
+			}
+			int depth = depths[joint];
+			for (size_t j = chain.size(); j-- > 0;)
+			{
+				depths[chain[j]] = ++depth;
+			}
+			maxDepth = glm::max(maxDepth, (unsigned int)depths[i]);
+		}
+		//Counting sort by depth, stable so siblings keep their order
+		fk.levelStart.assign(numJoints > 0 ? maxDepth + 2 : 1, 0);
+		for (unsigned int i = 0; i < numJoints; i++)
+		{
+			fk.levelStart[depths[i] + 1]++;
+		}
+		for (size_t d = 1; d < fk.levelStart.size(); d++)
+		{
+			fk.levelStart[d] += fk.levelStart[d - 1];
+		}
+		std::vector<unsigned int> fill(fk.levelStart.begin(), fk.levelStart.end() - 1);
+		fk.sourceIndex.resize(numJoints);
+		fk.sortedIndex.resize(numJoints);
+		for (unsigned int i = 0; i < numJoints; i++)
+		{
+			unsigned int sorted = fill[depths[i]]++;
+			fk.sourceIndex[sorted] = i;
+			fk.sortedIndex[i] = sorted;
+		}
+		fk.parents.resize(numJoints);
+		for (unsigned int i = 0; i < numJoints; i++)
+		{
+			int parent = parents[fk.sourceIndex[i]];
+			fk.parents[i] = parent >= 0 ? (int)fk.sortedIndex[parent] : -1;
+		}
+
+		fk.positionX.assign(numJoints, 0.0f); fk.positionY.assign(numJoints, 0.0f); fk.positionZ.assign(numJoints, 0.0f);
+		fk.rotationX.assign(numJoints, 0.0f); fk.rotationY.assign(numJoints, 0.0f); fk.rotationZ.assign(numJoints, 0.0f);
+		fk.rotationW.assign(numJoints, 1.0f);
+		fk.scaleX.assign(numJoints, 1.0f); fk.scaleY.assign(numJoints, 1.0f); fk.scaleZ.assign(numJoints, 1.0f);
+		fk.localMatrices.assign(numJoints, glm::mat4(1.0f));
+		fk.globalMatrices.assign(numJoints, glm::mat4(1.0f));
+		return fk;
+	}
+
+	FKHierarchy createFKHierarchy(const Hierarchy& hierarchy) {
+		//Node::parentIndex is unsigned with -1 meaning no parent
+		std::vector<int> parents(hierarchy.nodeCount);
+		for (unsigned int i = 0; i < hierarchy.nodeCount; i++)
+		{
+			parents[i] = (int)hierarchy.nodes[i].parentIndex;
+		}
+		FKHierarchy fk = createFKHierarchy(parents.data(), hierarchy.nodeCount);
+		readFKLocalPoses(&fk, hierarchy);
+		return fk;
+	}
+
+	void setFKLocalPose(FKHierarchy* fk, unsigned int joint, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale) {
+		unsigned int i = fk->sortedIndex[joint];
+		fk->positionX[i] = position.x; fk->positionY[i] = position.y; fk->positionZ[i] = position.z;
+		fk->rotationX[i] = rotation.x; fk->rotationY[i] = rotation.y; fk->rotationZ[i] = rotation.z; fk->rotationW[i] = rotation.w;
+		fk->scaleX[i] = scale.x; fk->scaleY[i] = scale.y; fk->scaleZ[i] = scale.z;
+	}
+
+	void readFKLocalPoses(FKHierarchy* fk, const Hierarchy& hierarchy) {
+		for (unsigned int i = 0; i < hierarchy.nodeCount && i < fk->numJoints; i++)
+		{
+			const Node& node = hierarchy.nodes[i];
+			setFKLocalPose(fk, i, node.position, node.rotation, node.scale);
+		}
+	}
+
+	void writeFKGlobalTransforms(const FKHierarchy& fk, Hierarchy* hierarchy) {
+		for (unsigned int i = 0; i < hierarchy->nodeCount && i < fk.numJoints; i++)
+		{
+			hierarchy->nodes[i].globalTransform = getFKGlobalTransform(fk, i);
+		}
+	}
+
+	//translate * mat4_cast(rotation) * scale, same as Node::localTransform
+	static void computeLocalMatrix(FKHierarchy* fk, unsigned int i) {
+		float x = fk->rotationX[i], y = fk->rotationY[i], z = fk->rotationZ[i], w = fk->rotationW[i];
+		glm::mat4& m = fk->localMatrices[i];
+		m[0] = glm::vec4(1.0f - 2.0f * (y * y + z * z), 2.0f * (x * y + w * z), 2.0f * (x * z - w * y), 0.0f) * fk->scaleX[i];
+		m[1] = glm::vec4(2.0f * (x * y - w * z), 1.0f - 2.0f * (x * x + z * z), 2.0f * (y * z + w * x), 0.0f) * fk->scaleY[i];
+		m[2] = glm::vec4(2.0f * (x * z + w * y), 2.0f * (y * z - w * x), 1.0f - 2.0f * (x * x + y * y), 0.0f) * fk->scaleZ[i];
+		m[3] = glm::vec4(fk->positionX[i], fk->positionY[i], fk->positionZ[i], 1.0f);
+	}
+
+#ifdef NS_FK_SSE
+	//Four joints starting at i. The pose arrays are read a component at a time, then transposed into 4 column-major matrices
+	static void computeLocalMatrices4(FKHierarchy* fk, unsigned int i) {
+		__m128 x = _mm_loadu_ps(&fk->rotationX[i]);
+		__m128 y = _mm_loadu_ps(&fk->rotationY[i]);
+		__m128 z = _mm_loadu_ps(&fk->rotationZ[i]);
+		__m128 w = _mm_loadu_ps(&fk->rotationW[i]);
+		__m128 one = _mm_set1_ps(1.0f);
+		__m128 two = _mm_set1_ps(2.0f);
+		__m128 zero = _mm_setzero_ps();
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), zz = _mm_mul_ps(z, z);
+		__m128 xy = _mm_mul_ps(x, y), xz = _mm_mul_ps(x, z), yz = _mm_mul_ps(y, z);
+		__m128 wx = _mm_mul_ps(w, x), wy = _mm_mul_ps(w, y), wz = _mm_mul_ps(w, z);
+		__m128 sx = _mm_loadu_ps(&fk->scaleX[i]);
+		__m128 sy = _mm_loadu_ps(&fk->scaleY[i]);
+		__m128 sz = _mm_loadu_ps(&fk->scaleZ[i]);
+
+		__m128 columns[4][4];
+		columns[0][0] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+		columns[0][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+		columns[0][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+		columns[0][3] = zero;
+		columns[1][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+		columns[1][1] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+		columns[1][2] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+		columns[1][3] = zero;
+		columns[2][0] = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+		columns[2][1] = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+		columns[2][2] = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+		columns[2][3] = zero;
+		columns[3][0] = _mm_loadu_ps(&fk->positionX[i]);
+		columns[3][1] = _mm_loadu_ps(&fk->positionY[i]);
+		columns[3][2] = _mm_loadu_ps(&fk->positionZ[i]);
+		columns[3][3] = one;
+		for (int c = 0; c < 4; c++)
+		{
+			//Lanes hold joints, after the transpose each register is one joint's column
+			_MM_TRANSPOSE4_PS(columns[c][0], columns[c][1], columns[c][2], columns[c][3]);
+			for (int j = 0; j < 4; j++)
+			{
+				_mm_storeu_ps(&fk->localMatrices[i + j][c][0], columns[c][j]);
+			}
+		}
+	}
+
+	static void multiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4* result) {
+		__m128 a0 = _mm_loadu_ps(&a[0][0]);
+		__m128 a1 = _mm_loadu_ps(&a[1][0]);
+		__m128 a2 = _mm_loadu_ps(&a[2][0]);
+		__m128 a3 = _mm_loadu_ps(&a[3][0]);
+		for (int c = 0; c < 4; c++)
+		{
+			__m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+			column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+			column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+			column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+			_mm_storeu_ps(&(*result)[c][0], column);
+		}
+	}
+#else
+	static void multiplyMatrix(const glm::mat4& a, const glm::mat4& b, glm::mat4* result) {
+		*result = a * b;
+	}
+#endif
+
+	//Joints [begin, end) of one level: local matrices, then globals from the already solved parent level
+	static void solveJoints(FKHierarchy* fk, unsigned int begin, unsigned int end) {
+		unsigned int i = begin;
+#ifdef NS_FK_SSE
+		for (; i + 4 <= end; i += 4)
+		{
+			computeLocalMatrices4(fk, i);
+		}
+#endif
+		for (; i < end; i++)
+		{
+			computeLocalMatrix(fk, i);
+		}
+		for (i = begin; i < end; i++)
+		{
+			int parent = fk->parents[i];
+			if (parent < 0) {
+				fk->globalMatrices[i] = fk->localMatrices[i];
+			}
+			else {
+				multiplyMatrix(fk->globalMatrices[parent], fk->localMatrices[i], &fk->globalMatrices[i]);
+			}
+		}
+	}
+
+	void solveFK(FKHierarchy* fk, JobSystem* jobSystem) {
+		for (size_t level = 0; level + 1 < fk->levelStart.size(); level++)
+		{
+			unsigned int first = fk->levelStart[level];
+			unsigned int count = fk->levelStart[level + 1] - first;
+			if (jobSystem == nullptr || count < FK_MIN_BATCH * 2) {
+				solveJoints(fk, first, first + count);
+				continue;
+			}
+			jobSystem->parallelFor(count, FK_MIN_BATCH, [fk, first](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+				solveJoints(fk, first + begin, first + end);
+			});
+		}
+	}
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "hierarchy.h"
+#include "jobSystem.h"
+
+namespace ns {
+	//Forward kinematics over one or many hierarchies, stored structure-of-arrays and sorted by depth so that
+	//every parent is solved before its children. Joints of the same depth don't depend on each other,
+	//so each depth level is split across threads, and local matrices are built 4 joints at a time with SSE.
+	//Any number of skeletons can share one FKHierarchy, which gives the levels more parallel work
+	struct FKHierarchy {
+		unsigned int numJoints = 0;
+		std::vector<unsigned int> levelStart; //Joints at depth d are [levelStart[d], levelStart[d + 1])
+		std::vector<int> parents; //Sorted parent index, -1 for roots
+		std::vector<unsigned int> sourceIndex; //Index the joint was given at creation, for each sorted joint
+		std::vector<unsigned int> sortedIndex; //Inverse of sourceIndex
+		//Local pose, one array per component
+		std::vector<float> positionX, positionY, positionZ;
+		std::vector<float> rotationX, rotationY, rotationZ, rotationW;
+		std::vector<float> scaleX, scaleY, scaleZ;
+		std::vector<glm::mat4> localMatrices;
+		std::vector<glm::mat4> globalMatrices;
+	};
+	//parents[i] is the parent of joint i, or -1 for a root. Parents may appear after their children
+	FKHierarchy createFKHierarchy(const int* parents, unsigned int numJoints);
+	FKHierarchy createFKHierarchy(const Hierarchy& hierarchy);
+
+	//Sets the local pose of a joint by its creation index
+	void setFKLocalPose(FKHierarchy* fk, unsigned int joint, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale);
+	//Copies every node's local pose in, and the solved global transforms back out
+	void readFKLocalPoses(FKHierarchy* fk, const Hierarchy& hierarchy);
+	void writeFKGlobalTransforms(const FKHierarchy& fk, Hierarchy* hierarchy);
+	inline const glm::mat4& getFKGlobalTransform(const FKHierarchy& fk, unsigned int joint) {
+		return fk.globalMatrices[fk.sortedIndex[joint]];
+	}
+
+	//Computes local and global matrices for every joint. jobSystem may be null to solve on the calling thread
+	void solveFK(FKHierarchy* fk, JobSystem* jobSystem);
+}
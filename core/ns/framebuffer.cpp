@@ -1,4 +1,5 @@
 #include "framebuffer.h"
+#include "glState.h"
 #include "../ew/external/glad.h"
 #include <stdio.h>
 
@@ -7,12 +8,13 @@ namespace ns {
 		Framebuffer framebuffer;
 		framebuffer.width = width;
 		framebuffer.height = height;
+		framebuffer.numColorBuffers = 1;
 
 		glGenFramebuffers(1, &framebuffer.fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, framebuffer.fbo);
+		bindFramebuffer(framebuffer.fbo);
 		//create and bind color buffer
 		glGenTextures(1, &framebuffer.colorBuffer[0]);
-		glBindTexture(GL_TEXTURE_2D, framebuffer.colorBuffer[0]);
+		bindTexture(GL_TEXTURE_2D, framebuffer.colorBuffer[0]);
 		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, 0);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -25,30 +27,27 @@ namespace ns {
 
 		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			printf("ERROR::FRAMEBUFFER:: Framebuffer is not complete!");
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		bindFramebuffer(0);
 
 		return framebuffer;
 	}
 
-	Framebuffer createGBuffer(unsigned int width, unsigned int height) {
+	//Three color targets in the given formats plus a depth texture
+	static Framebuffer createGBufferTargets(unsigned int width, unsigned int height, const int* formats) {
 		Framebuffer gBuffer;
 		gBuffer.width = width;
 		gBuffer.height = height;
+		gBuffer.numColorBuffers = 3;
+		gBuffer.depthTexture = true;
 
 		glCreateFramebuffers(1, &gBuffer.fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fbo);
-
-		int formats[3] = {
-			GL_RGB32F, //0 = World Position 
-			GL_RGB16F, //1 = World Normal
-			GL_RGB16F  //2 = Albedo
-		};
+		bindFramebuffer(gBuffer.fbo);
 
 		//Create 3 color textures
 		for (size_t i = 0; i < 3; i++)
 		{
 			glGenTextures(1, &gBuffer.colorBuffer[i]);
-			glBindTexture(GL_TEXTURE_2D, gBuffer.colorBuffer[i]);
+			bindTexture(GL_TEXTURE_2D, gBuffer.colorBuffer[i]);
 			glTexStorage2D(GL_TEXTURE_2D, 1, formats[i], width, height);
 			//Clamp to border so we don't wrap when sampling for post processing
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
@@ -68,20 +67,65 @@ namespace ns {
 
 		//Add texture2D depth buffer
 		glGenTextures(1, &gBuffer.depthBuffer);
-		glBindTexture(GL_TEXTURE_2D, gBuffer.depthBuffer);
-		//16 bit depth values, 2k resolution
-		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT16, width, height);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gBuffer.depthBuffer, 0);
+		bindTexture(GL_TEXTURE_2D, gBuffer.depthBuffer);
+		//Same format as createFramebuffer's depth so it can be blitted into the lighting target
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH24_STENCIL8, width, height);
+		//Sampled texel by texel to reconstruct position in the packed layout
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, gBuffer.depthBuffer, 0);
 
 		//Check for completeness
 		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			printf("ERROR::FRAMEBUFFER:: GBuffer is not complete!");
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		bindFramebuffer(0);
 
 		//Clean up global state
-		glBindTexture(GL_TEXTURE_2D, 0);
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		bindTexture(GL_TEXTURE_2D, 0);
+		bindFramebuffer(0);
 
 		return gBuffer;
 	}
-}
\ No newline at end of file
+
+	Framebuffer createGBuffer(unsigned int width, unsigned int height) {
+		int formats[3] = {
+			GL_RGB32F, //0 = World Position 
+			GL_RGB16F, //1 = World Normal
+			GL_RGB16F  //2 = Albedo
+		};
+		return createGBufferTargets(width, height, formats);
+	}
+
+	Framebuffer createPackedGBuffer(unsigned int width, unsigned int height) {
+		int formats[3] = {
+			GL_RGBA8, //0 = Material
+			GL_RG16,  //1 = Octahedral World Normal
+			GL_RGBA8  //2 = Albedo
+		};
+		return createGBufferTargets(width, height, formats);
+	}
+
+	size_t getGBufferBytesPerPixel(bool packed) {
+		//Depth is DEPTH24_STENCIL8 in both. Drivers may pad the RGB formats to RGBA, making the full layout bigger still
+		if (packed)
+			return 4 + 4 + 4 + 4;
+		return 12 + 6 + 6 + 4;
+	}
+
+	void deleteFramebuffer(Framebuffer* framebuffer) {
+		releaseFramebufferBinding(framebuffer->fbo);
+		releaseTextureBindings(framebuffer->colorBuffer, framebuffer->numColorBuffers);
+		glDeleteFramebuffers(1, &framebuffer->fbo);
+		glDeleteTextures(framebuffer->numColorBuffers, framebuffer->colorBuffer);
+		if (framebuffer->depthTexture) {
+			releaseTextureBindings(&framebuffer->depthBuffer, 1);
+			glDeleteTextures(1, &framebuffer->depthBuffer);
+		}
+		else {
+			glDeleteRenderbuffers(1, &framebuffer->depthBuffer);
+		}
+		framebuffer->fbo = 0;
+		framebuffer->numColorBuffers = 0;
+		framebuffer->depthBuffer = 0;
+	}
+}
@@ -1,4 +1,5 @@
 #pragma once
+#include <stddef.h>
 namespace ns {
 	struct Framebuffer {
 		unsigned int fbo;
@@ -6,7 +7,16 @@ namespace ns {
 		unsigned int depthBuffer;
 		unsigned int width;
 		unsigned int height;
+		unsigned int numColorBuffers = 0;
+		bool depthTexture = false; //depthBuffer is a texture that can be sampled, otherwise a renderbuffer
 	};
 	Framebuffer createFramebuffer(unsigned int width, unsigned int height, int colorFormat);
+	//0 = world position (RGB32F), 1 = world normal (RGB16F), 2 = albedo (RGB16F)
 	Framebuffer createGBuffer(unsigned int width, unsigned int height);
-}
\ No newline at end of file
+	//Same attachments and depth as createGBuffer in about half the bytes per pixel. Position is reconstructed from depth.
+	//0 = material Ka, Kd, Ks, log2(shininess) / 11 (RGBA8), 1 = octahedral world normal (RG16), 2 = albedo (RGBA8)
+	Framebuffer createPackedGBuffer(unsigned int width, unsigned int height);
+	//Bytes written per pixel by the geometry pass, depth included
+	size_t getGBufferBytesPerPixel(bool packed);
+	void deleteFramebuffer(Framebuffer* framebuffer);
+}
@@ -0,0 +1,185 @@
+#include "geometryArena.h"
+#include "meshCache.h"
+#include "glState.h"
+#include "../ew/external/glad.h"
+#include <stddef.h>
+#include <stdio.h>
+
+namespace ns {
+	GeometryArena createGeometryArena(unsigned int vertexCapacity, unsigned int indexCapacity) {
+		GeometryArena arena;
+		arena.vertexCapacity = vertexCapacity;
+		arena.indexCapacity = indexCapacity;
+		arena.numVertices = 0;
+		arena.numIndices = 0;
+		arena.commandCapacity = 0;
+		arena.instanceCapacity = 0;
+		arena.dirty = false;
+
+		glCreateBuffers(1, &arena.vbo);
+		glNamedBufferStorage(arena.vbo, sizeof(ew::Vertex) * vertexCapacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &arena.ebo);
+		glNamedBufferStorage(arena.ebo, sizeof(unsigned int) * indexCapacity, NULL, GL_DYNAMIC_STORAGE_BIT);
+		glCreateBuffers(1, &arena.instanceBuffer);
+		glCreateBuffers(1, &arena.indirectBuffer);
+
+		glCreateVertexArrays(1, &arena.vao);
+		//Binding 0: vertices
+		glVertexArrayVertexBuffer(arena.vao, 0, arena.vbo, 0, sizeof(ew::Vertex));
+		glVertexArrayElementBuffer(arena.vao, arena.ebo);
+		//Position attribute
+		glVertexArrayAttribFormat(arena.vao, 0, 3, GL_FLOAT, GL_FALSE, offsetof(ew::Vertex, pos));
+		//Normal attribute
+		glVertexArrayAttribFormat(arena.vao, 1, 3, GL_FLOAT, GL_FALSE, offsetof(ew::Vertex, normal));
+		//UV attribute
+		glVertexArrayAttribFormat(arena.vao, 2, 2, GL_FLOAT, GL_FALSE, offsetof(ew::Vertex, uv));
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			glVertexArrayAttribBinding(arena.vao, i, 0);
+			glEnableVertexArrayAttrib(arena.vao, i);
+		}
+
+		//Binding 1: instances, advanced once per instance. baseInstance selects the draw's first element
+		glVertexArrayBindingDivisor(arena.vao, 1, 1);
+		for (unsigned int i = 0; i < 4; i++)
+		{
+			glVertexArrayAttribFormat(arena.vao, 3 + i, 4, GL_FLOAT, GL_FALSE, offsetof(ew::InstanceData, model) + sizeof(glm::vec4) * i);
+		}
+		glVertexArrayAttribFormat(arena.vao, 7, 4, GL_FLOAT, GL_FALSE, offsetof(ew::InstanceData, color));
+		for (unsigned int i = 3; i <= 7; i++)
+		{
+			glVertexArrayAttribBinding(arena.vao, i, 1);
+			glEnableVertexArrayAttrib(arena.vao, i);
+		}
+		return arena;
+	}
+
+	int addArenaMesh(GeometryArena* arena, const ew::MeshData& meshData) {
+		unsigned int numVertices = (unsigned int)meshData.vertices.size();
+		unsigned int numIndices = (unsigned int)meshData.indices.size();
+		if (arena->numVertices + numVertices > arena->vertexCapacity || arena->numIndices + numIndices > arena->indexCapacity) {
+			printf("Geometry arena is full");
+			return -1;
+		}
+		ArenaMesh mesh;
+		//Every level is uploaded, their ranges are moved from the mesh's index buffer to the arena's
+		if (meshData.lods.empty()) {
+			ew::MeshLOD full = { 0, numIndices, 0.0f };
+			mesh.lods.push_back(full);
+		}
+		else {
+			mesh.lods = meshData.lods;
+		}
+		for (size_t i = 0; i < mesh.lods.size(); i++)
+		{
+			mesh.lods[i].firstIndex += arena->numIndices;
+		}
+		mesh.firstIndex = mesh.lods[0].firstIndex;
+		mesh.indexCount = mesh.lods[0].indexCount;
+		//Indices stay local to the mesh, baseVertex offsets them at draw time
+		mesh.baseVertex = (int)arena->numVertices;
+		glNamedBufferSubData(arena->vbo, sizeof(ew::Vertex) * arena->numVertices, sizeof(ew::Vertex) * numVertices, meshData.vertices.data());
+		glNamedBufferSubData(arena->ebo, sizeof(unsigned int) * arena->numIndices, sizeof(unsigned int) * numIndices, meshData.indices.data());
+		arena->numVertices += numVertices;
+		arena->numIndices += numIndices;
+		arena->meshes.push_back(mesh);
+		return (int)arena->meshes.size() - 1;
+	}
+
+	std::vector<int> addArenaModel(GeometryArena* arena, const std::string& filePath) {
+		std::vector<ew::MeshData> meshes = loadCachedMeshData(filePath);
+		std::vector<int> meshIndices;
+		meshIndices.reserve(meshes.size());
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			int mesh = addArenaMesh(arena, meshes[i]);
+			if (mesh >= 0) {
+				meshIndices.push_back(mesh);
+			}
+		}
+		return meshIndices;
+	}
+
+	void pushArenaDraw(GeometryArena* arena, unsigned int mesh, const ew::InstanceData& instance, bool merge) {
+		pushArenaDrawLOD(arena, mesh, 0, instance, merge);
+	}
+
+	void pushArenaDrawLOD(GeometryArena* arena, unsigned int mesh, unsigned int lod, const ew::InstanceData& instance, bool merge) {
+		//Catches -1 from a failed addArenaMesh as well
+		if (mesh >= arena->meshes.size()) {
+			return;
+		}
+		const std::vector<ew::MeshLOD>& lods = arena->meshes[mesh].lods;
+		const ew::MeshLOD& range = lods[lod < lods.size() ? lod : lods.size() - 1];
+		int baseVertex = arena->meshes[mesh].baseVertex;
+		arena->dirty = true;
+		unsigned int instanceIndex = (unsigned int)arena->instances.size();
+		arena->instances.push_back(instance);
+		if (merge && !arena->commands.empty()) {
+			DrawElementsIndirectCommand& last = arena->commands.back();
+			if (last.firstIndex == range.firstIndex && last.baseVertex == baseVertex && last.baseInstance + last.instanceCount == instanceIndex) {
+				last.instanceCount++;
+				return;
+			}
+		}
+		DrawElementsIndirectCommand command;
+		command.count = range.indexCount;
+		command.instanceCount = 1;
+		command.firstIndex = range.firstIndex;
+		command.baseVertex = baseVertex;
+		command.baseInstance = instanceIndex;
+		arena->commands.push_back(command);
+	}
+
+	unsigned int selectArenaLOD(const GeometryArena& arena, unsigned int mesh, float pixelsPerUnit, float maxPixelError) {
+		if (mesh >= arena.meshes.size()) {
+			return 0;
+		}
+		//Errors only grow with the level, walk down until the next one would be visible
+		const std::vector<ew::MeshLOD>& lods = arena.meshes[mesh].lods;
+		unsigned int lod = 0;
+		while (lod + 1 < lods.size() && lods[lod + 1].error * pixelsPerUnit <= maxPixelError) {
+			lod++;
+		}
+		return lod;
+	}
+
+	void clearArenaDraws(GeometryArena* arena) {
+		arena->commands.clear();
+		arena->instances.clear();
+		arena->dirty = true;
+	}
+
+	void uploadArenaDraws(GeometryArena* arena) {
+		if (arena->dirty) {
+			//Grow or orphan the GPU copies, then upload the draw list
+			if (arena->instances.size() > arena->instanceCapacity) {
+				arena->instanceCapacity = (unsigned int)arena->instances.size();
+			}
+			if (arena->commands.size() > arena->commandCapacity) {
+				arena->commandCapacity = (unsigned int)arena->commands.size();
+			}
+			glNamedBufferData(arena->instanceBuffer, sizeof(ew::InstanceData) * arena->instanceCapacity, NULL, GL_STREAM_DRAW);
+			glNamedBufferSubData(arena->instanceBuffer, 0, sizeof(ew::InstanceData) * arena->instances.size(), arena->instances.data());
+			glNamedBufferData(arena->indirectBuffer, sizeof(DrawElementsIndirectCommand) * arena->commandCapacity, NULL, GL_STREAM_DRAW);
+			glNamedBufferSubData(arena->indirectBuffer, 0, sizeof(DrawElementsIndirectCommand) * arena->commands.size(), arena->commands.data());
+			glVertexArrayVertexBuffer(arena->vao, 1, arena->instanceBuffer, 0, sizeof(ew::InstanceData));
+			arena->dirty = false;
+		}
+	}
+
+	void drawArena(GeometryArena* arena) {
+		drawArenaCommands(arena, arena->indirectBuffer);
+	}
+
+	void drawArenaCommands(GeometryArena* arena, unsigned int commandBuffer) {
+		if (arena->commands.empty()) {
+			return;
+		}
+		uploadArenaDraws(arena);
+		bindVertexArray(arena->vao);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, (GLsizei)arena->commands.size(), 0);
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "../ew/mesh.h"
+
+namespace ns {
+	//Matches the command layout read by glMultiDrawElementsIndirect
+	struct DrawElementsIndirectCommand {
+		unsigned int count;
+		unsigned int instanceCount;
+		unsigned int firstIndex;
+		int baseVertex;
+		unsigned int baseInstance;
+	};
+
+	//Location of one mesh inside the arena
+	struct ArenaMesh {
+		unsigned int firstIndex; //Full mesh, same as lods[0]
+		unsigned int indexCount;
+		int baseVertex;
+		std::vector<ew::MeshLOD> lods; //Every level, firstIndex into the arena's index buffer. Always has level 0
+	};
+
+	//Shared vertex/index storage for many meshes behind a single VAO.
+	//Draws queued during a frame go out as one glMultiDrawElementsIndirect.
+	//Vertices use the ew::Vertex layout (locations 0-2), per draw data uses ew::InstanceData (locations 3-7) indexed by baseInstance
+	struct GeometryArena {
+		unsigned int vao;
+		unsigned int vbo;
+		unsigned int ebo;
+		unsigned int instanceBuffer;
+		unsigned int indirectBuffer;
+		unsigned int vertexCapacity;
+		unsigned int indexCapacity;
+		unsigned int numVertices;
+		unsigned int numIndices;
+		std::vector<ArenaMesh> meshes;
+
+		//Draw list for the current batch
+		std::vector<DrawElementsIndirectCommand> commands;
+		std::vector<ew::InstanceData> instances;
+		unsigned int commandCapacity; //Capacity of the GPU side buffers
+		unsigned int instanceCapacity;
+		bool dirty; //Draw list changed since it was last uploaded
+	};
+	GeometryArena createGeometryArena(unsigned int vertexCapacity, unsigned int indexCapacity);
+	//Copies a mesh into the arena. Returns its mesh index, or -1 if the arena is full
+	int addArenaMesh(GeometryArena* arena, const ew::MeshData& meshData);
+	//Copies every mesh of a model file into the arena. Returns the indices of the meshes that fit, meshes that don't are skipped
+	std::vector<int> addArenaModel(GeometryArena* arena, const std::string& filePath);
+	//Queues one draw of a mesh. Consecutive draws of the same mesh are merged into one instanced command unless merge is false,
+	//which keeps one command per object for passes that edit commands individually (e.g. GPU culling).
+	//Draws of a mesh the arena doesn't have are dropped
+	void pushArenaDraw(GeometryArena* arena, unsigned int mesh, const ew::InstanceData& instance, bool merge = true);
+	//Same as pushArenaDraw for one level of detail of the mesh, clamped to its coarsest level
+	void pushArenaDrawLOD(GeometryArena* arena, unsigned int mesh, unsigned int lod, const ew::InstanceData& instance, bool merge = true);
+	//Coarsest level of an arena mesh whose simplification error stays within maxPixelError pixels, like ns::selectLOD
+	unsigned int selectArenaLOD(const GeometryArena& arena, unsigned int mesh, float pixelsPerUnit, float maxPixelError);
+	void clearArenaDraws(GeometryArena* arena);
+	//Uploads the draw list if it changed since the last upload
+	void uploadArenaDraws(GeometryArena* arena);
+	//Uploads the draw list if it changed and issues all commands with a single multi draw
+	void drawArena(GeometryArena* arena);
+	//Same as drawArena, but reads the commands from another indirect buffer holding arena->commands.size() commands,
+	//such as a culled copy of arena->indirectBuffer
+	void drawArenaCommands(GeometryArena* arena, unsigned int commandBuffer);
+}
@@ -0,0 +1,208 @@
+#include "glState.h"
+#include "../ew/external/glad.h"
+
+namespace ns {
+	//One GL context, driven from one thread
+	struct GLState {
+		unsigned int program;
+		unsigned int vertexArray;
+		unsigned int framebuffer;
+		unsigned int textures[GL_STATE_TEXTURE_UNITS];
+		unsigned int cullEnabled, cullFace;
+		unsigned int depthTest, depthFunc, depthWrite;
+		unsigned int blendEnabled, blendSrc, blendDst;
+		unsigned int colorWrite;
+		int viewport[4];
+		bool viewportKnown;
+		GLStateCounters frame; //Being counted
+		GLStateCounters last; //Finished
+	};
+	static GLState state = {};
+	static bool stateInitialized = false;
+
+	static GLState* getState() {
+		if (!stateInitialized) {
+			invalidateGLState();
+		}
+		return &state;
+	}
+
+	//True if the cached value has to change, counting the call either way
+	static bool changeState(GLState* s, GLStateCall call, unsigned int* cached, unsigned int value) {
+		if (*cached == value) {
+			s->frame.elided[(int)call]++;
+			return false;
+		}
+		*cached = value;
+		s->frame.issued[(int)call]++;
+		return true;
+	}
+
+	static void setCapability(GLState* s, GLStateCall call, GLenum capability, unsigned int* cached, bool enabled) {
+		if (changeState(s, call, cached, enabled ? 1 : 0)) {
+			if (enabled)
+				glEnable(capability);
+			else
+				glDisable(capability);
+		}
+	}
+
+	const char* getGLStateCallName(GLStateCall call) {
+		switch (call) {
+		case GLStateCall::PROGRAM: return "Program";
+		case GLStateCall::VERTEX_ARRAY: return "Vertex array";
+		case GLStateCall::FRAMEBUFFER: return "Framebuffer";
+		case GLStateCall::TEXTURE: return "Texture";
+		case GLStateCall::CULL: return "Cull";
+		case GLStateCall::DEPTH: return "Depth";
+		case GLStateCall::BLEND: return "Blend";
+		case GLStateCall::VIEWPORT: return "Viewport";
+		case GLStateCall::COLOR_MASK: return "Color mask";
+		}
+		return "";
+	}
+
+	void useProgram(unsigned int program) {
+		GLState* s = getState();
+		if (changeState(s, GLStateCall::PROGRAM, &s->program, program))
+			glUseProgram(program);
+	}
+
+	void bindVertexArray(unsigned int vao) {
+		GLState* s = getState();
+		if (changeState(s, GLStateCall::VERTEX_ARRAY, &s->vertexArray, vao))
+			glBindVertexArray(vao);
+	}
+
+	void bindFramebuffer(unsigned int fbo) {
+		GLState* s = getState();
+		if (changeState(s, GLStateCall::FRAMEBUFFER, &s->framebuffer, fbo))
+			glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	}
+
+	void bindTextureUnit(unsigned int unit, unsigned int texture) {
+		GLState* s = getState();
+		if (unit >= GL_STATE_TEXTURE_UNITS) {
+			s->frame.issued[(int)GLStateCall::TEXTURE]++;
+			glBindTextureUnit(unit, texture);
+			return;
+		}
+		if (changeState(s, GLStateCall::TEXTURE, &s->textures[unit], texture))
+			glBindTextureUnit(unit, texture);
+	}
+
+	void bindTexture(unsigned int target, unsigned int texture) {
+		GLState* s = getState();
+		//Unbinding one target leaves the unit's other targets bound, so whatever it holds is unknown
+		if (texture == 0) {
+			s->textures[0] = GL_STATE_UNKNOWN;
+			s->frame.issued[(int)GLStateCall::TEXTURE]++;
+			glBindTexture(target, 0);
+			return;
+		}
+		if (changeState(s, GLStateCall::TEXTURE, &s->textures[0], texture))
+			glBindTexture(target, texture);
+	}
+
+	void setCullState(bool enabled, unsigned int face) {
+		GLState* s = getState();
+		setCapability(s, GLStateCall::CULL, GL_CULL_FACE, &s->cullEnabled, enabled);
+		if (enabled && changeState(s, GLStateCall::CULL, &s->cullFace, face))
+			glCullFace(face);
+	}
+
+	void setDepthState(bool test, unsigned int func, bool write) {
+		GLState* s = getState();
+		setCapability(s, GLStateCall::DEPTH, GL_DEPTH_TEST, &s->depthTest, test);
+		if (test && changeState(s, GLStateCall::DEPTH, &s->depthFunc, func))
+			glDepthFunc(func);
+		setDepthWrite(write);
+	}
+
+	void setDepthWrite(bool write) {
+		GLState* s = getState();
+		if (changeState(s, GLStateCall::DEPTH, &s->depthWrite, write ? 1 : 0))
+			glDepthMask(write ? GL_TRUE : GL_FALSE);
+	}
+
+	void setColorWrite(bool write) {
+		GLState* s = getState();
+		GLboolean mask = write ? GL_TRUE : GL_FALSE;
+		if (changeState(s, GLStateCall::COLOR_MASK, &s->colorWrite, write ? 1 : 0))
+			glColorMask(mask, mask, mask, mask);
+	}
+
+	void setBlendState(bool enabled, unsigned int srcFactor, unsigned int dstFactor) {
+		GLState* s = getState();
+		setCapability(s, GLStateCall::BLEND, GL_BLEND, &s->blendEnabled, enabled);
+		if (!enabled)
+			return;
+		//Both factors are set by one call
+		if (s->blendSrc == srcFactor && s->blendDst == dstFactor) {
+			s->frame.elided[(int)GLStateCall::BLEND]++;
+			return;
+		}
+		s->blendSrc = srcFactor;
+		s->blendDst = dstFactor;
+		s->frame.issued[(int)GLStateCall::BLEND]++;
+		glBlendFunc(srcFactor, dstFactor);
+	}
+
+	void setViewport(int x, int y, int width, int height) {
+		GLState* s = getState();
+		if (s->viewportKnown && s->viewport[0] == x && s->viewport[1] == y && s->viewport[2] == width && s->viewport[3] == height) {
+			s->frame.elided[(int)GLStateCall::VIEWPORT]++;
+			return;
+		}
+		s->viewport[0] = x;
+		s->viewport[1] = y;
+		s->viewport[2] = width;
+		s->viewport[3] = height;
+		s->viewportKnown = true;
+		s->frame.issued[(int)GLStateCall::VIEWPORT]++;
+		glViewport(x, y, width, height);
+	}
+
+	void releaseTextureBindings(const unsigned int* textures, unsigned int count) {
+		GLState* s = getState();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			for (unsigned int unit = 0; unit < GL_STATE_TEXTURE_UNITS; unit++)
+			{
+				if (s->textures[unit] == textures[i])
+					s->textures[unit] = 0;
+			}
+		}
+	}
+
+	void releaseFramebufferBinding(unsigned int fbo) {
+		GLState* s = getState();
+		if (s->framebuffer == fbo)
+			s->framebuffer = 0;
+	}
+
+	void invalidateGLState() {
+		state.program = GL_STATE_UNKNOWN;
+		state.vertexArray = GL_STATE_UNKNOWN;
+		state.framebuffer = GL_STATE_UNKNOWN;
+		for (unsigned int i = 0; i < GL_STATE_TEXTURE_UNITS; i++)
+		{
+			state.textures[i] = GL_STATE_UNKNOWN;
+		}
+		state.cullEnabled = state.cullFace = GL_STATE_UNKNOWN;
+		state.depthTest = state.depthFunc = state.depthWrite = GL_STATE_UNKNOWN;
+		state.blendEnabled = state.blendSrc = state.blendDst = GL_STATE_UNKNOWN;
+		state.colorWrite = GL_STATE_UNKNOWN;
+		state.viewportKnown = false;
+		stateInitialized = true;
+	}
+
+	const GLStateCounters& getGLStateCounters() {
+		return state.last;
+	}
+
+	void endGLStateFrame() {
+		state.last = state.frame;
+		state.frame = {};
+	}
+}
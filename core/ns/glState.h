@@ -0,0 +1,56 @@
+#pragma once
+namespace ns {
+	//Value the cache holds for state it hasn't seen set, so the next change is always issued
+	const unsigned int GL_STATE_UNKNOWN = 0xFFFFFFFF;
+	const unsigned int GL_STATE_TEXTURE_UNITS = 32;
+
+	enum class GLStateCall {
+		PROGRAM = 0,
+		VERTEX_ARRAY = 1,
+		FRAMEBUFFER = 2,
+		TEXTURE = 3,
+		CULL = 4,
+		DEPTH = 5,
+		BLEND = 6,
+		VIEWPORT = 7,
+		COLOR_MASK = 8
+	};
+	const unsigned int NUM_GL_STATE_CALLS = 9;
+	const char* getGLStateCallName(GLStateCall call);
+
+	//GL calls made and skipped because the state was already set, by type
+	struct GLStateCounters {
+		unsigned int issued[NUM_GL_STATE_CALLS];
+		unsigned int elided[NUM_GL_STATE_CALLS];
+	};
+
+	//Thin cache over the GL context, calls that wouldn't change anything are dropped.
+	//It only knows what went through it, so code changing the same state directly must call invalidateGLState after.
+	//Texture units are bound with glBindTextureUnit, the active texture unit stays GL_TEXTURE0
+	void useProgram(unsigned int program);
+	void bindVertexArray(unsigned int vao);
+	//Binds to GL_FRAMEBUFFER, read and draw
+	void bindFramebuffer(unsigned int fbo);
+	void bindTextureUnit(unsigned int unit, unsigned int texture);
+	//For editing with the non-DSA texture calls, binds to target on GL_TEXTURE0
+	void bindTexture(unsigned int target, unsigned int texture);
+	//face, func and the factors are GL enums, and are only set while enabled. Depth writes are set either way
+	void setCullState(bool enabled, unsigned int face);
+	void setDepthState(bool test, unsigned int func, bool write);
+	//Depth writes alone, keeping the test and func. Clears are masked by it too
+	void setDepthWrite(bool write);
+	//All four channels together, clears are masked by it like any other color write
+	void setColorWrite(bool write);
+	void setBlendState(bool enabled, unsigned int srcFactor, unsigned int dstFactor);
+	void setViewport(int x, int y, int width, int height);
+
+	//GL unbinds objects as they are deleted, call these before deleting so the cache does too
+	void releaseTextureBindings(const unsigned int* textures, unsigned int count);
+	void releaseFramebufferBinding(unsigned int fbo);
+	//Forget everything, e.g. after a library changed state without restoring it
+	void invalidateGLState();
+
+	//Counters of the last finished frame. endGLStateFrame finishes the current one
+	const GLStateCounters& getGLStateCounters();
+	void endGLStateFrame();
+}
@@ -0,0 +1,30 @@
+#include "gpuTimer.h"
+#include "../ew/external/glad.h"
+
+namespace ns {
+	GpuTimer createGpuTimer() {
+		GpuTimer timer;
+		glGenQueries(GPU_TIMER_QUERIES, timer.queries);
+		timer.frame = 0;
+		timer.lastMs = 0.0f;
+		timer.ms = 0.0f;
+		return timer;
+	}
+
+	void beginGpuTimer(GpuTimer* timer) {
+		unsigned int query = timer->queries[timer->frame % GPU_TIMER_QUERIES];
+		//Collect the result this query held from GPU_TIMER_QUERIES frames ago before reusing it
+		if (timer->frame >= GPU_TIMER_QUERIES) {
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+			timer->lastMs = nanoseconds / 1000000.0f;
+			timer->ms += (timer->lastMs - timer->ms) * 0.05f;
+		}
+		glBeginQuery(GL_TIME_ELAPSED, query);
+	}
+
+	void endGpuTimer(GpuTimer* timer) {
+		glEndQuery(GL_TIME_ELAPSED);
+		timer->frame++;
+	}
+}
@@ -0,0 +1,16 @@
+#pragma once
+namespace ns {
+	const unsigned int GPU_TIMER_QUERIES = 4;
+
+	//GL_TIME_ELAPSED queries used as a ring, so results are read a few frames late and never stall the pipeline.
+	//Time elapsed queries cannot nest, only one timer can be running at a time
+	struct GpuTimer {
+		unsigned int queries[GPU_TIMER_QUERIES];
+		unsigned int frame; //Number of measurements started
+		float lastMs; //Most recent result
+		float ms; //Smoothed result
+	};
+	GpuTimer createGpuTimer();
+	void beginGpuTimer(GpuTimer* timer);
+	void endGpuTimer(GpuTimer* timer);
+}
@@ -0,0 +1,92 @@
+#include "hierarchy.h"
+
+namespace ns {
+	void initHierarchy(Hierarchy* hierarchy) {
+		unsigned int count = hierarchy->nodeCount;
+		//Counting sort of the nodes by parent
+		hierarchy->childStart.assign(count + 1, 0);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int parent = hierarchy->nodes[i].parentIndex;
+			if (parent != -1) {
+				hierarchy->childStart[parent + 1]++;
+			}
+		}
+		for (unsigned int i = 0; i < count; i++)
+		{
+			hierarchy->childStart[i + 1] += hierarchy->childStart[i];
+		}
+		hierarchy->children.resize(hierarchy->childStart[count]);
+		std::vector<unsigned int> fill(hierarchy->childStart.begin(), hierarchy->childStart.end() - 1);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			unsigned int parent = hierarchy->nodes[i].parentIndex;
+			if (parent != -1) {
+				hierarchy->children[fill[parent]++] = i;
+			}
+		}
+		hierarchy->dirtyNodes.clear();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			hierarchy->nodes[i].dirty = true;
+			hierarchy->dirtyNodes.push_back(i);
+		}
+	}
+
+	void markNodeDirty(Hierarchy* hierarchy, unsigned int node) {
+		if (hierarchy->nodes[node].dirty) {
+			return;
+		}
+		hierarchy->nodes[node].dirty = true;
+		hierarchy->dirtyNodes.push_back(node);
+	}
+
+	unsigned int updateHierarchyTransforms(Hierarchy* hierarchy) {
+		Node* nodes = hierarchy->nodes;
+		unsigned int numUpdated = 0;
+		std::vector<unsigned int> stack;
+		for (size_t i = 0; i < hierarchy->dirtyNodes.size(); i++)
+		{
+			unsigned int root = hierarchy->dirtyNodes[i];
+			//Already reached from a dirty ancestor earlier in the list
+			if (!nodes[root].dirty) {
+				continue;
+			}
+			//A dirty ancestor will reach this node when its own subtree is updated
+			bool ancestorDirty = false;
+			for (unsigned int parent = nodes[root].parentIndex; parent != -1; parent = nodes[parent].parentIndex)
+			{
+				if (nodes[parent].dirty) {
+					ancestorDirty = true;
+					break;
+				}
+			}
+			if (ancestorDirty) {
+				continue;
+			}
+			stack.push_back(root);
+			while (!stack.empty()) {
+				unsigned int n = stack.back();
+				stack.pop_back();
+				Node& node = nodes[n];
+				if (node.dirty) {
+					node.localMatrix = node.localTransform();
+					node.dirty = false;
+				}
+				if (node.parentIndex == -1) {
+					node.globalTransform = node.localMatrix;
+				}
+				else {
+					node.globalTransform = nodes[node.parentIndex].globalTransform * node.localMatrix;
+				}
+				numUpdated++;
+				for (unsigned int c = hierarchy->childStart[n]; c < hierarchy->childStart[n + 1]; c++)
+				{
+					stack.push_back(hierarchy->children[c]);
+				}
+			}
+		}
+		hierarchy->dirtyNodes.clear();
+		return numUpdated;
+	}
+}
@@ -1,9 +1,22 @@
 #pragma once
+#include <vector>
 #include "node.h"
 
 namespace ns {
 	struct Hierarchy {
 		Node* nodes;
 		unsigned int nodeCount;
+
+		//Change tracking, filled in by initHierarchy
+		std::vector<unsigned int> childStart; //Children of node i are children[childStart[i], childStart[i + 1])
+		std::vector<unsigned int> children;
+		std::vector<unsigned int> dirtyNodes; //Nodes marked dirty since the last updateHierarchyTransforms
 	};
-}
\ No newline at end of file
+	//Builds the child lists and queues every node for the first update. Call again if parentIndex changes
+	void initHierarchy(Hierarchy* hierarchy);
+	//Call after changing a node's position, rotation or scale
+	void markNodeDirty(Hierarchy* hierarchy, unsigned int node);
+	//Recomputes localMatrix for the dirty nodes and globalTransform for them and their descendants,
+	//nothing else is touched. Returns the number of global transforms recomputed
+	unsigned int updateHierarchyTransforms(Hierarchy* hierarchy);
+}
@@ -0,0 +1,124 @@
+#include "jobSystem.h"
+#include <atomic>
+#include <memory>
+
+namespace ns {
+	static thread_local unsigned int t_threadIndex = 0;
+
+	JobSystem::JobSystem(unsigned int numWorkers) {
+		if (numWorkers == 0) {
+			unsigned int hardwareThreads = std::thread::hardware_concurrency();
+			numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+		m_workers.reserve(numWorkers);
+		for (unsigned int i = 0; i < numWorkers; i++)
+		{
+			//Index 0 is reserved for the thread that owns the job system
+			m_workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+		}
+	}
+
+	JobSystem::~JobSystem() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_shuttingDown = true;
+		}
+		m_jobAvailable.notify_all();
+		for (size_t i = 0; i < m_workers.size(); i++)
+		{
+			m_workers[i].join();
+		}
+	}
+
+	unsigned int JobSystem::getThreadIndex() {
+		return t_threadIndex;
+	}
+
+	void JobSystem::submit(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_jobs.push_back(std::move(job));
+		}
+		m_jobAvailable.notify_one();
+	}
+
+	void JobSystem::workerLoop(unsigned int threadIndex) {
+		t_threadIndex = threadIndex;
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_jobAvailable.wait(lock, [this] { return m_shuttingDown || !m_jobs.empty(); });
+				if (m_jobs.empty()) {
+					return;
+				}
+				job = std::move(m_jobs.front());
+				m_jobs.pop_front();
+			}
+			job();
+		}
+	}
+
+	//Shared between the caller and the helper jobs of one parallelFor.
+	//Helpers can start after the loop has already finished, so this outlives the call
+	struct ParallelForState {
+		std::atomic<unsigned int> nextBatch{ 0 };
+		std::atomic<unsigned int> batchesDone{ 0 };
+		unsigned int numBatches = 0;
+		unsigned int batchSize = 0;
+		unsigned int count = 0;
+		const std::function<void(unsigned int, unsigned int, unsigned int)>* fn = nullptr;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+
+	static void runBatches(ParallelForState* state) {
+		while (true) {
+			unsigned int batch = state->nextBatch.fetch_add(1);
+			if (batch >= state->numBatches) {
+				return;
+			}
+			unsigned int begin = batch * state->batchSize;
+			unsigned int end = begin + state->batchSize < state->count ? begin + state->batchSize : state->count;
+			(*state->fn)(begin, end, t_threadIndex);
+			if (state->batchesDone.fetch_add(1) + 1 == state->numBatches) {
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	}
+
+	void JobSystem::parallelFor(unsigned int count, unsigned int minBatchSize, const std::function<void(unsigned int begin, unsigned int end, unsigned int threadIndex)>& fn) {
+		if (count == 0) {
+			return;
+		}
+		//A few batches per thread so uneven batches still balance out
+		unsigned int numThreads = getNumThreads();
+		unsigned int batchSize = (count + numThreads * 4 - 1) / (numThreads * 4);
+		if (batchSize < minBatchSize)
+			batchSize = minBatchSize;
+		if (batchSize < 1)
+			batchSize = 1;
+		unsigned int numBatches = (count + batchSize - 1) / batchSize;
+		if (numBatches == 1 || m_workers.empty()) {
+			fn(0, count, t_threadIndex);
+			return;
+		}
+
+		std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+		state->numBatches = numBatches;
+		state->batchSize = batchSize;
+		state->count = count;
+		state->fn = &fn;
+
+		unsigned int numHelpers = numBatches - 1 < (unsigned int)m_workers.size() ? numBatches - 1 : (unsigned int)m_workers.size();
+		for (unsigned int i = 0; i < numHelpers; i++)
+		{
+			submit([state] { runBatches(state.get()); });
+		}
+		runBatches(state.get());
+
+		std::unique_lock<std::mutex> lock(state->mutex);
+		state->finished.wait(lock, [&state] { return state->batchesDone.load() == state->numBatches; });
+	}
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <functional>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace ns {
+	//Fixed pool of worker threads shared by the CPU-side systems (light binning, culling, asset loading, ...)
+	class JobSystem {
+	public:
+		//numWorkers = 0 uses one worker per hardware thread, minus the calling thread
+		JobSystem(unsigned int numWorkers = 0);
+		~JobSystem();
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		//Queues a job that runs on a worker thread at some point in the future
+		void submit(std::function<void()> job);
+		//Splits [0, count) into batches of at least minBatchSize and runs fn(begin, end, threadIndex) across all threads.
+		//The calling thread takes part and the call returns once every batch has finished.
+		void parallelFor(unsigned int count, unsigned int minBatchSize, const std::function<void(unsigned int begin, unsigned int end, unsigned int threadIndex)>& fn);
+
+		//Workers + the calling thread. Thread indices passed to parallelFor are in [0, getNumThreads())
+		inline unsigned int getNumThreads()const { return (unsigned int)m_workers.size() + 1; }
+		//0 on any thread that is not a worker of a JobSystem
+		static unsigned int getThreadIndex();
+	private:
+		void workerLoop(unsigned int threadIndex);
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_jobs;
+		std::mutex m_mutex;
+		std::condition_variable m_jobAvailable;
+		bool m_shuttingDown = false;
+	};
+}
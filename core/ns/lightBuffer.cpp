@@ -0,0 +1,34 @@
+#include "lightBuffer.h"
+#include "../ew/external/glad.h"
+#include <string.h>
+
+namespace ns {
+	//Size of the count header in front of the light array. PointLight has 16 byte alignment in std430
+	static const unsigned int LIGHT_BUFFER_HEADER_SIZE = 16;
+
+	LightBuffer createLightBuffer(unsigned int capacity, unsigned int frameCount) {
+		LightBuffer lightBuffer;
+		lightBuffer.capacity = capacity;
+		lightBuffer.lightCount = 0;
+		lightBuffer.ring = createPersistentRing(LIGHT_BUFFER_HEADER_SIZE + capacity * sizeof(PointLight), frameCount);
+		return lightBuffer;
+	}
+
+	void updateLightBuffer(LightBuffer* lightBuffer, const PointLight* lights, unsigned int count) {
+		unsigned char* region = beginPersistentRegion(&lightBuffer->ring);
+		if (count > lightBuffer->capacity)
+			count = lightBuffer->capacity;
+		lightBuffer->lightCount = count;
+		memcpy(region, &count, sizeof(unsigned int));
+		memcpy(region + LIGHT_BUFFER_HEADER_SIZE, lights, sizeof(PointLight) * count);
+	}
+
+	void bindLightBuffer(const LightBuffer& lightBuffer, unsigned int binding) {
+		GLsizeiptr size = LIGHT_BUFFER_HEADER_SIZE + sizeof(PointLight) * (lightBuffer.lightCount > 0 ? lightBuffer.lightCount : 1);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, lightBuffer.ring.buffer, getPersistentRegionOffset(lightBuffer.ring), size);
+	}
+
+	void fenceLightBuffer(LightBuffer* lightBuffer) {
+		fencePersistentRegion(&lightBuffer->ring);
+	}
+}
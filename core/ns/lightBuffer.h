@@ -0,0 +1,30 @@
+#pragma once
+#include <glm/glm.hpp>
+#include "persistentRing.h"
+
+namespace ns {
+	//Matches the std430 PointLight struct in the lighting shaders (32 bytes)
+	struct PointLight {
+		glm::vec3 position;
+		float radius;
+		glm::vec4 color;
+	};
+
+	const unsigned int MAX_LIGHT_BUFFER_FRAMES = MAX_PERSISTENT_RING_FRAMES;
+
+	//Point lights packed into a persistently mapped shader storage buffer.
+	//The ring has one region per frame in flight so the CPU never writes lights the GPU is still reading.
+	//Each region is laid out as { uint count; pad; PointLight lights[capacity]; }
+	struct LightBuffer {
+		PersistentRing ring;
+		unsigned int capacity; //Max lights per frame
+		unsigned int lightCount; //Lights written by the last update
+	};
+	LightBuffer createLightBuffer(unsigned int capacity, unsigned int frameCount = MAX_LIGHT_BUFFER_FRAMES);
+	//Moves to the next region, waits until the GPU has released it, then copies the lights in
+	void updateLightBuffer(LightBuffer* lightBuffer, const PointLight* lights, unsigned int count);
+	//Binds the region written by the last update to an SSBO binding point
+	void bindLightBuffer(const LightBuffer& lightBuffer, unsigned int binding);
+	//Call after issuing the draws that read the current region
+	void fenceLightBuffer(LightBuffer* lightBuffer);
+}
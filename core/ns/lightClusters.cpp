@@ -0,0 +1,249 @@
+#include "lightClusters.h"
+#include "../ew/external/glad.h"
+#include <math.h>
+#include <string.h>
+
+namespace ns {
+	ClusterGrid createClusterGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices, unsigned int maxLightsPerCluster) {
+		ClusterGrid grid;
+		grid.tilesX = tilesX;
+		grid.tilesY = tilesY;
+		grid.slices = slices;
+		grid.maxLightsPerCluster = maxLightsPerCluster;
+		grid.nearPlane = 0.1f;
+		grid.farPlane = 100.0f;
+		grid.numIndices = 0;
+		grid.numDroppedLights = 0;
+
+		unsigned int numClusters = tilesX * tilesY * slices;
+		grid.clusters.resize(numClusters);
+		grid.sliceIndices.resize(slices);
+		grid.sliceDropped.resize(slices);
+
+		glCreateBuffers(1, &grid.clusterBuffer);
+		glNamedBufferData(grid.clusterBuffer, sizeof(glm::uvec2) * numClusters, NULL, GL_DYNAMIC_DRAW);
+		//Large enough for the fixed stride compute layout, and so for the clamped CPU lists
+		grid.indexCapacity = numClusters * maxLightsPerCluster;
+		glCreateBuffers(1, &grid.indexBuffer);
+		glNamedBufferData(grid.indexBuffer, sizeof(unsigned int) * grid.indexCapacity, NULL, GL_DYNAMIC_DRAW);
+		grid.statsRing = createPersistentRing(sizeof(unsigned int), MAX_PERSISTENT_RING_FRAMES, true);
+		return grid;
+	}
+
+	//Exponential slicing: slice = log(depth / near) / log(far / near) * slices
+	static int depthToSlice(const ClusterGrid& grid, float depth) {
+		if (depth <= grid.nearPlane)
+			return 0;
+		int slice = (int)(logf(depth / grid.nearPlane) / logf(grid.farPlane / grid.nearPlane) * grid.slices);
+		return slice < (int)grid.slices ? slice : (int)grid.slices - 1;
+	}
+
+	static int ndcToTile(float ndc, unsigned int tiles) {
+		int tile = (int)floorf((ndc * 0.5f + 0.5f) * tiles);
+		if (tile < 0)
+			return 0;
+		return tile < (int)tiles ? tile : (int)tiles - 1;
+	}
+
+	//Conservative screen rectangle and slice range of a sphere in view space
+	static ClusterLightBounds computeLightBounds(const ClusterGrid& grid, glm::vec3 viewPos, float radius, const glm::mat4& projection, float cameraNear) {
+		ClusterLightBounds bounds;
+		bounds.minSlice = 1;
+		bounds.maxSlice = 0;
+
+		//Camera looks down -Z
+		float depth = -viewPos.z;
+		float minDepth = depth - radius;
+		float maxDepth = depth + radius;
+		if (maxDepth < cameraNear || minDepth > grid.farPlane) {
+			return bounds;
+		}
+
+		if (minDepth <= cameraNear) {
+			//Sphere crosses the near plane, it can cover any part of the screen
+			bounds.minTileX = 0;
+			bounds.minTileY = 0;
+			bounds.maxTileX = grid.tilesX - 1;
+			bounds.maxTileY = grid.tilesY - 1;
+		}
+		else {
+			//x/depth is monotonic on the box around the sphere, so the extremes are at its corners
+			float xs[2] = { viewPos.x - radius, viewPos.x + radius };
+			float ys[2] = { viewPos.y - radius, viewPos.y + radius };
+			float depths[2] = { minDepth, maxDepth };
+			float minX = 1e30f, maxX = -1e30f, minY = 1e30f, maxY = -1e30f;
+			for (int i = 0; i < 2; i++)
+			{
+				for (int j = 0; j < 2; j++)
+				{
+					float x = projection[0][0] * xs[i] / depths[j];
+					float y = projection[1][1] * ys[i] / depths[j];
+					minX = fminf(minX, x);
+					maxX = fmaxf(maxX, x);
+					minY = fminf(minY, y);
+					maxY = fmaxf(maxY, y);
+				}
+			}
+			if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) {
+				return bounds;
+			}
+			bounds.minTileX = ndcToTile(minX, grid.tilesX);
+			bounds.maxTileX = ndcToTile(maxX, grid.tilesX);
+			bounds.minTileY = ndcToTile(minY, grid.tilesY);
+			bounds.maxTileY = ndcToTile(maxY, grid.tilesY);
+		}
+		bounds.minSlice = depthToSlice(grid, minDepth);
+		bounds.maxSlice = depthToSlice(grid, maxDepth);
+		return bounds;
+	}
+
+	void buildClustersCPU(ClusterGrid* grid, const PointLight* lights, unsigned int count, const ew::Camera& camera, JobSystem* jobSystem) {
+		grid->farPlane = camera.farPlane;
+		glm::mat4 view = camera.viewMatrix();
+		glm::mat4 projection = camera.projectionMatrix();
+		unsigned int tilesPerSlice = grid->tilesX * grid->tilesY;
+
+		//1. Screen rect + slice range per light
+		grid->lightBounds.resize(count);
+		jobSystem->parallelFor(count, 64, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int i = begin; i < end; i++)
+			{
+				glm::vec3 viewPos = glm::vec3(view * glm::vec4(lights[i].position, 1.0f));
+				grid->lightBounds[i] = computeLightBounds(*grid, viewPos, lights[i].radius, projection, camera.nearPlane);
+			}
+		});
+
+		//2. Each slice is binned independently, in light order, so the result does not depend on thread timing
+		jobSystem->parallelFor(grid->slices, 1, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int slice = begin; slice < end; slice++)
+			{
+				glm::uvec2* sliceClusters = grid->clusters.data() + slice * tilesPerSlice;
+				std::vector<unsigned int>& sliceIndices = grid->sliceIndices[slice];
+				for (unsigned int t = 0; t < tilesPerSlice; t++)
+				{
+					sliceClusters[t] = glm::uvec2(0, 0);
+				}
+				//Count lights per cluster
+				for (unsigned int i = 0; i < count; i++)
+				{
+					const ClusterLightBounds& b = grid->lightBounds[i];
+					if ((int)slice < b.minSlice || (int)slice > b.maxSlice)
+						continue;
+					for (int y = b.minTileY; y <= b.maxTileY; y++)
+					{
+						for (int x = b.minTileX; x <= b.maxTileX; x++)
+						{
+							sliceClusters[y * grid->tilesX + x].y++;
+						}
+					}
+				}
+				//Offsets within the slice. Full clusters keep their first lights, like the compute path
+				unsigned int total = 0;
+				unsigned int dropped = 0;
+				for (unsigned int t = 0; t < tilesPerSlice; t++)
+				{
+					unsigned int kept = glm::min(sliceClusters[t].y, grid->maxLightsPerCluster);
+					dropped += sliceClusters[t].y - kept;
+					sliceClusters[t].x = total;
+					total += kept;
+					sliceClusters[t].y = 0;
+				}
+				grid->sliceDropped[slice] = dropped;
+				//Fill
+				sliceIndices.resize(total);
+				for (unsigned int i = 0; i < count; i++)
+				{
+					const ClusterLightBounds& b = grid->lightBounds[i];
+					if ((int)slice < b.minSlice || (int)slice > b.maxSlice)
+						continue;
+					for (int y = b.minTileY; y <= b.maxTileY; y++)
+					{
+						for (int x = b.minTileX; x <= b.maxTileX; x++)
+						{
+							glm::uvec2& cluster = sliceClusters[y * grid->tilesX + x];
+							if (cluster.y == grid->maxLightsPerCluster)
+								continue;
+							sliceIndices[cluster.x + cluster.y] = i;
+							cluster.y++;
+						}
+					}
+				}
+			}
+		});
+
+		//3. Concatenate the slices into one list
+		std::vector<unsigned int> sliceOffsets(grid->slices);
+		unsigned int numIndices = 0;
+		grid->numDroppedLights = 0;
+		for (unsigned int slice = 0; slice < grid->slices; slice++)
+		{
+			sliceOffsets[slice] = numIndices;
+			numIndices += (unsigned int)grid->sliceIndices[slice].size();
+			grid->numDroppedLights += grid->sliceDropped[slice];
+		}
+		grid->indices.resize(numIndices);
+		jobSystem->parallelFor(grid->slices, 1, [&](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int slice = begin; slice < end; slice++)
+			{
+				glm::uvec2* sliceClusters = grid->clusters.data() + slice * tilesPerSlice;
+				for (unsigned int t = 0; t < tilesPerSlice; t++)
+				{
+					sliceClusters[t].x += sliceOffsets[slice];
+				}
+				const std::vector<unsigned int>& sliceIndices = grid->sliceIndices[slice];
+				if (!sliceIndices.empty()) {
+					memcpy(grid->indices.data() + sliceOffsets[slice], sliceIndices.data(), sizeof(unsigned int) * sliceIndices.size());
+				}
+			}
+		});
+		grid->numIndices = numIndices;
+
+		//Upload
+		glNamedBufferSubData(grid->clusterBuffer, 0, sizeof(glm::uvec2) * grid->clusters.size(), grid->clusters.data());
+		if (numIndices > 0) {
+			glNamedBufferSubData(grid->indexBuffer, 0, sizeof(unsigned int) * numIndices, grid->indices.data());
+		}
+	}
+
+	void buildClustersGPU(ClusterGrid* grid, const ew::Shader& cullShader, const ew::Camera& camera) {
+		grid->farPlane = camera.farPlane;
+		glm::mat4 projection = camera.projectionMatrix();
+
+		cullShader.use();
+		cullShader.setMat4("_View", camera.viewMatrix());
+		cullShader.setVec2("_ProjectionScale", projection[0][0], projection[1][1]);
+		cullShader.setFloat("_CameraNear", camera.nearPlane);
+		cullShader.setFloat("_ClusterNear", grid->nearPlane);
+		cullShader.setFloat("_ClusterFar", grid->farPlane);
+		cullShader.setInt("_MaxLightsPerCluster", grid->maxLightsPerCluster);
+		glUniform3ui(cullShader.getUniformLocation("_ClusterDims"), grid->tilesX, grid->tilesY, grid->slices);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_GRID_BINDING, grid->clusterBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BINDING, grid->indexBuffer);
+
+		//Dropped count of the build two frames back, if the GPU has finished it. Reading the current one would stall
+		unsigned int* dropped = (unsigned int*)beginPersistentRegion(&grid->statsRing);
+		const unsigned char* finished = peekPersistentRegion(grid->statsRing, 2);
+		if (finished) {
+			memcpy(&grid->numDroppedLights, finished, sizeof(unsigned int));
+		}
+		*dropped = 0;
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, CLUSTER_STATS_BINDING, grid->statsRing.buffer, getPersistentRegionOffset(grid->statsRing), sizeof(unsigned int));
+
+		//One invocation per cluster, 64 per work group (matches clusterCull.comp)
+		unsigned int numClusters = grid->tilesX * grid->tilesY * grid->slices;
+		cullShader.dispatch((numClusters + 63) / 64);
+		//Lighting pass reads the lists as SSBOs, the CPU reads the dropped count through the mapping
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+		fencePersistentRegion(&grid->statsRing);
+	}
+
+	void bindClusterGrid(const ClusterGrid& grid, const ew::Shader& shader) {
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_GRID_BINDING, grid.clusterBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, CLUSTER_INDEX_BINDING, grid.indexBuffer);
+		glUniform3ui(shader.getUniformLocation("_ClusterDims"), grid.tilesX, grid.tilesY, grid.slices);
+		//slice = log(depth) * scale + bias
+		float logRange = logf(grid.farPlane / grid.nearPlane);
+		shader.setVec2("_ClusterDepthParams", grid.slices / logRange, -(float)grid.slices * logf(grid.nearPlane) / logRange);
+		shader.setFloat("_ClusterNear", grid.nearPlane);
+	}
+}
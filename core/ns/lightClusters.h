@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "lightBuffer.h"
+#include "persistentRing.h"
+#include "jobSystem.h"
+#include "../ew/camera.h"
+#include "../ew/shader.h"
+
+namespace ns {
+	//SSBO binding points used by the clustered lighting shaders. The light buffer itself is bound at 0
+	const unsigned int CLUSTER_GRID_BINDING = 1;
+	const unsigned int CLUSTER_INDEX_BINDING = 2;
+	const unsigned int CLUSTER_STATS_BINDING = 3;
+
+	//Per light screen tile rectangle and depth slice range. minSlice > maxSlice means the light was culled
+	struct ClusterLightBounds {
+		int minTileX, minTileY, maxTileX, maxTileY;
+		int minSlice, maxSlice;
+	};
+
+	//View frustum split into tilesX * tilesY screen tiles and exponentially spaced depth slices.
+	//Each cluster stores {offset, count} into a flat list of light indices.
+	//The two build paths bin with different conservative tests, so their lists can differ by lights near cluster edges
+	struct ClusterGrid {
+		unsigned int tilesX;
+		unsigned int tilesY;
+		unsigned int slices;
+		unsigned int maxLightsPerCluster; //Both paths keep the first lights up to this and drop the rest. Also the compute path's stride
+		float nearPlane; //Depth where slice 0 ends its exponential range, everything closer lands in slice 0
+		float farPlane;
+		unsigned int clusterBuffer; //uvec2 {offset, count} per cluster
+		unsigned int indexBuffer; //uint light indices
+		unsigned int indexCapacity; //Indices the index buffer can hold
+		unsigned int numIndices; //Indices written by the last CPU build
+		unsigned int numDroppedLights; //Light and cluster pairs dropped because the cluster was full. GPU builds report it two frames late
+		PersistentRing statsRing; //Dropped count written by the compute path, read back once the GPU is done with it
+
+		//CPU binning scratch, reused between frames
+		std::vector<ClusterLightBounds> lightBounds;
+		std::vector<glm::uvec2> clusters;
+		std::vector<std::vector<unsigned int>> sliceIndices;
+		std::vector<unsigned int> sliceDropped;
+		std::vector<unsigned int> indices;
+	};
+	ClusterGrid createClusterGrid(unsigned int tilesX, unsigned int tilesY, unsigned int slices, unsigned int maxLightsPerCluster);
+	//Bins lights into clusters on the CPU, spread over the job system, and uploads the result.
+	//A light goes into every cluster of its screen tile rectangle within its depth slice range
+	void buildClustersCPU(ClusterGrid* grid, const PointLight* lights, unsigned int count, const ew::Camera& camera, JobSystem* jobSystem);
+	//Bins lights with a compute shader, testing each light's sphere against each cluster's view space AABB.
+	//Expects the light buffer to be bound at binding 0. Call once per frame
+	void buildClustersGPU(ClusterGrid* grid, const ew::Shader& cullShader, const ew::Camera& camera);
+	//Binds the grid buffers and sets the _ClusterDims/_ClusterDepthParams uniforms on a shader that is in use
+	void bindClusterGrid(const ClusterGrid& grid, const ew::Shader& shader);
+}
@@ -0,0 +1,22 @@
+#include "lodSelection.h"
+
+namespace ns {
+	float projectedPixelsPerUnit(const ew::Camera& camera, const glm::vec3& worldPosition, float objectScale, float viewportHeight) {
+		if (camera.orthographic) {
+			return objectScale * viewportHeight / camera.orthoHeight;
+		}
+		float distance = glm::max(glm::length(worldPosition - camera.position), camera.nearPlane);
+		float viewHeight = 2.0f * distance * tanf(glm::radians(camera.fov) * 0.5f);
+		return objectScale * viewportHeight / viewHeight;
+	}
+
+	unsigned int selectLOD(const ew::Model& model, float pixelsPerUnit, float maxPixelError) {
+		//Errors only grow with the level, walk down until the next one would be visible
+		unsigned int numLODs = model.getNumLODs();
+		unsigned int lod = 0;
+		while (lod + 1 < numLODs && model.getLODError(lod + 1) * pixelsPerUnit <= maxPixelError) {
+			lod++;
+		}
+		return lod;
+	}
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "../ew/camera.h"
+#include "../ew/model.h"
+
+namespace ns {
+	//Screen pixels covered by one object space unit at worldPosition
+	float projectedPixelsPerUnit(const ew::Camera& camera, const glm::vec3& worldPosition, float objectScale, float viewportHeight);
+	//Coarsest level of detail whose simplification error stays within maxPixelError pixels on screen
+	unsigned int selectLOD(const ew::Model& model, float pixelsPerUnit, float maxPixelError);
+}
@@ -0,0 +1,391 @@
+#include "meshCache.h"
+#include "meshOptimizer.h"
+#include "meshSimplifier.h"
+#include "../ew/model.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ns {
+	static const char MESH_CACHE_MAGIC[4] = { 'N','S','M','C' };
+	//Bump whenever the layout below, ew::Vertex or ew::MeshLOD changes, or the import pipeline produces different data
+	static const uint32_t MESH_CACHE_VERSION = 3;
+	static const size_t MESH_CACHE_ALIGNMENT = 16;
+
+	struct MeshCacheHeader {
+		char magic[4];
+		uint32_t version;
+		uint32_t vertexSize;
+		uint32_t meshCount;
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		uint64_t sourceHash;
+	};
+
+	struct MeshCacheEntry {
+		uint32_t numVertices;
+		uint32_t numIndices;
+		uint32_t numLods;
+		uint32_t padding;
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint64_t lodOffset;
+	};
+
+	//Sources being imported, so concurrent loads of one source import and write it once
+	static std::mutex importLocksMutex;
+	static std::map<std::string, std::shared_ptr<std::mutex>> importLocks;
+
+	static size_t alignOffset(size_t offset) {
+		return (offset + MESH_CACHE_ALIGNMENT - 1) & ~(MESH_CACHE_ALIGNMENT - 1);
+	}
+
+	static bool getSourceInfo(const std::string& sourcePath, uint64_t* size, int64_t* modifiedTime) {
+		struct stat info;
+		if (stat(sourcePath.c_str(), &info) != 0) {
+			return false;
+		}
+		*size = (uint64_t)info.st_size;
+		*modifiedTime = (int64_t)info.st_mtime;
+		return true;
+	}
+
+	//FNV-1a over the whole source file
+	static bool hashFile(const std::string& filePath, uint64_t* hash) {
+		MappedFile file;
+		if (!mapFile(filePath.c_str(), &file)) {
+			return false;
+		}
+		uint64_t h = 14695981039346656037ull;
+		for (size_t i = 0; i < file.size; i++)
+		{
+			h ^= file.data[i];
+			h *= 1099511628211ull;
+		}
+		unmapFile(&file);
+		*hash = h;
+		return true;
+	}
+
+	bool mapFile(const char* filePath, MappedFile* mappedFile) {
+		mappedFile->data = NULL;
+		mappedFile->size = 0;
+		mappedFile->fileHandle = NULL;
+		mappedFile->mappingHandle = NULL;
+#ifdef _WIN32
+		HANDLE file = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			CloseHandle(file);
+			return false;
+		}
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (data == NULL) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+		mappedFile->data = (const unsigned char*)data;
+		mappedFile->size = (size_t)size.QuadPart;
+		mappedFile->fileHandle = file;
+		mappedFile->mappingHandle = mapping;
+#else
+		int fd = open(filePath, O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0) {
+			close(fd);
+			return false;
+		}
+		void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		//The mapping keeps the file alive on its own
+		close(fd);
+		if (data == MAP_FAILED) {
+			return false;
+		}
+		mappedFile->data = (const unsigned char*)data;
+		mappedFile->size = (size_t)info.st_size;
+#endif
+		return true;
+	}
+
+	void unmapFile(MappedFile* mappedFile) {
+		if (mappedFile->data == NULL) {
+			return;
+		}
+#ifdef _WIN32
+		UnmapViewOfFile(mappedFile->data);
+		CloseHandle((HANDLE)mappedFile->mappingHandle);
+		CloseHandle((HANDLE)mappedFile->fileHandle);
+#else
+		munmap((void*)mappedFile->data, mappedFile->size);
+#endif
+		mappedFile->data = NULL;
+		mappedFile->size = 0;
+		mappedFile->fileHandle = NULL;
+		mappedFile->mappingHandle = NULL;
+	}
+
+	std::string getMeshCachePath(const std::string& sourcePath) {
+		return sourcePath + ".nsmesh";
+	}
+
+	//Writes a uniquely named temp file and renames it over filePath, so a reader never maps a half written file.
+	//Existing mappings keep the old contents. Windows refuses to replace a file that is mapped, the file in place is kept then
+	static bool writeFileReplacing(const std::string& filePath, const void* data, size_t size) {
+		static std::atomic<unsigned int> tempCounter(0);
+#ifdef _WIN32
+		unsigned long processId = GetCurrentProcessId();
+#else
+		unsigned long processId = (unsigned long)getpid();
+#endif
+		std::string tempPath = filePath + "." + std::to_string(processId) + "." + std::to_string(tempCounter++) + ".tmp";
+		FILE* file = fopen(tempPath.c_str(), "wb");
+		if (file == NULL) {
+			return false;
+		}
+		size_t written = fwrite(data, 1, size, file);
+		bool closed = fclose(file) == 0;
+		if (written != size || !closed) {
+			remove(tempPath.c_str());
+			return false;
+		}
+#ifdef _WIN32
+		bool replaced = MoveFileExA(tempPath.c_str(), filePath.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+		bool replaced = rename(tempPath.c_str(), filePath.c_str()) == 0;
+#endif
+		if (!replaced) {
+			remove(tempPath.c_str());
+		}
+		return replaced;
+	}
+
+	bool writeMeshCache(const std::string& sourcePath, const std::vector<ew::MeshData>& meshes) {
+		MeshCacheHeader header;
+		memcpy(header.magic, MESH_CACHE_MAGIC, sizeof(header.magic));
+		header.version = MESH_CACHE_VERSION;
+		header.vertexSize = sizeof(ew::Vertex);
+		header.meshCount = (uint32_t)meshes.size();
+		if (!getSourceInfo(sourcePath, &header.sourceSize, &header.sourceModifiedTime) || !hashFile(sourcePath, &header.sourceHash)) {
+			printf("Failed to read mesh cache source %s", sourcePath.c_str());
+			return false;
+		}
+
+		//Lay out the blobs after the mesh table
+		std::vector<MeshCacheEntry> entries(meshes.size());
+		size_t offset = sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * entries.size();
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			entries[i].numVertices = (uint32_t)meshes[i].vertices.size();
+			entries[i].numIndices = (uint32_t)meshes[i].indices.size();
+			offset = alignOffset(offset);
+			entries[i].vertexOffset = offset;
+			offset += sizeof(ew::Vertex) * entries[i].numVertices;
+			offset = alignOffset(offset);
+			entries[i].indexOffset = offset;
+			offset += sizeof(unsigned int) * entries[i].numIndices;
+			entries[i].numLods = (uint32_t)meshes[i].lods.size();
+			entries[i].padding = 0;
+			offset = alignOffset(offset);
+			entries[i].lodOffset = offset;
+			offset += sizeof(ew::MeshLOD) * entries[i].numLods;
+		}
+
+		//Assemble the whole file in memory so it goes out in one write
+		std::vector<unsigned char> blob(offset, 0);
+		memcpy(blob.data(), &header, sizeof(header));
+		if (!entries.empty()) {
+			memcpy(blob.data() + sizeof(header), entries.data(), sizeof(MeshCacheEntry) * entries.size());
+		}
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			if (entries[i].numVertices > 0) {
+				memcpy(blob.data() + entries[i].vertexOffset, meshes[i].vertices.data(), sizeof(ew::Vertex) * entries[i].numVertices);
+			}
+			if (entries[i].numIndices > 0) {
+				memcpy(blob.data() + entries[i].indexOffset, meshes[i].indices.data(), sizeof(unsigned int) * entries[i].numIndices);
+			}
+			if (entries[i].numLods > 0) {
+				memcpy(blob.data() + entries[i].lodOffset, meshes[i].lods.data(), sizeof(ew::MeshLOD) * entries[i].numLods);
+			}
+		}
+
+		std::string cachePath = getMeshCachePath(sourcePath);
+		if (!writeFileReplacing(cachePath, blob.data(), blob.size())) {
+			printf("Failed to write mesh cache %s", cachePath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	//Null if the mapped file is not a cache this build can read
+	static const MeshCacheHeader* getMeshCacheHeader(const MappedFile& file) {
+		const MeshCacheHeader* header = (const MeshCacheHeader*)file.data;
+		if (file.size < sizeof(MeshCacheHeader) || memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0
+			|| header->version != MESH_CACHE_VERSION || header->vertexSize != sizeof(ew::Vertex)
+			|| file.size < sizeof(MeshCacheHeader) + sizeof(MeshCacheEntry) * (uint64_t)header->meshCount) {
+			return NULL;
+		}
+		return header;
+	}
+
+	bool openMeshCache(const std::string& sourcePath, MeshCache* cache) {
+		cache->meshes.clear();
+		std::string cachePath = getMeshCachePath(sourcePath);
+		if (!mapFile(cachePath.c_str(), &cache->file)) {
+			return false;
+		}
+		const MeshCacheHeader* header = getMeshCacheHeader(cache->file);
+		if (header == NULL) {
+			closeMeshCache(cache);
+			return false;
+		}
+
+		//Size and modification time are a cheap check. If only the time changed (e.g. the file was copied) compare hashes before giving up
+		uint64_t sourceSize;
+		int64_t sourceModifiedTime;
+		if (getSourceInfo(sourcePath, &sourceSize, &sourceModifiedTime)) {
+			if (sourceSize != header->sourceSize) {
+				closeMeshCache(cache);
+				return false;
+			}
+			uint64_t sourceHash;
+			if (sourceModifiedTime != header->sourceModifiedTime) {
+				if (!hashFile(sourcePath, &sourceHash) || sourceHash != header->sourceHash) {
+					closeMeshCache(cache);
+					return false;
+				}
+				//Same contents, store the new time so later opens skip the hash. The mapping is read only, so the cache is
+				//rewritten from a copy, and unmapped first since Windows can't replace a mapped file
+				std::vector<unsigned char> refreshed(cache->file.data, cache->file.data + cache->file.size);
+				((MeshCacheHeader*)refreshed.data())->sourceModifiedTime = sourceModifiedTime;
+				closeMeshCache(cache);
+				writeFileReplacing(cachePath, refreshed.data(), refreshed.size());
+				//Whatever is in place now, the refreshed copy or a cache another load wrote, is checked again
+				if (!mapFile(cachePath.c_str(), &cache->file)) {
+					return false;
+				}
+				header = getMeshCacheHeader(cache->file);
+				if (header == NULL || header->sourceSize != sourceSize || header->sourceHash != sourceHash) {
+					closeMeshCache(cache);
+					return false;
+				}
+			}
+		}
+		//A missing source leaves the cache as the only copy, so it is still used
+		const MappedFile& file = cache->file;
+		const MeshCacheEntry* entries = (const MeshCacheEntry*)(file.data + sizeof(MeshCacheHeader));
+		cache->meshes.resize(header->meshCount);
+		for (uint32_t i = 0; i < header->meshCount; i++)
+		{
+			const MeshCacheEntry& entry = entries[i];
+			if (entry.vertexOffset + sizeof(ew::Vertex) * (uint64_t)entry.numVertices > file.size
+				|| entry.indexOffset + sizeof(unsigned int) * (uint64_t)entry.numIndices > file.size
+				|| entry.lodOffset + sizeof(ew::MeshLOD) * (uint64_t)entry.numLods > file.size) {
+				printf("Mesh cache for %s is truncated", sourcePath.c_str());
+				closeMeshCache(cache);
+				return false;
+			}
+			CachedMesh& mesh = cache->meshes[i];
+			mesh.numVertices = entry.numVertices;
+			mesh.numIndices = entry.numIndices;
+			mesh.vertices = (const ew::Vertex*)(file.data + entry.vertexOffset);
+			mesh.indices = (const unsigned int*)(file.data + entry.indexOffset);
+			mesh.numLods = entry.numLods;
+			mesh.lods = (const ew::MeshLOD*)(file.data + entry.lodOffset);
+		}
+		return true;
+	}
+
+	void closeMeshCache(MeshCache* cache) {
+		unmapFile(&cache->file);
+		cache->meshes.clear();
+	}
+
+	std::vector<ew::MeshData> importMeshData(const std::string& sourcePath) {
+		std::vector<ew::MeshData> meshes = ew::loadModelMeshData(sourcePath);
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			MeshOptimizationReport report = optimizeMesh(&meshes[i]);
+			std::string name = sourcePath + "[" + std::to_string(i) + "]";
+			printMeshOptimizationReport(name.c_str(), report);
+			generateLODs(&meshes[i]);
+			for (size_t lod = 1; lod < meshes[i].lods.size(); lod++)
+			{
+				printf("%s LOD %zu: %u triangles, error %f\n", name.c_str(), lod, meshes[i].lods[lod].indexCount / 3, meshes[i].lods[lod].error);
+			}
+		}
+		return meshes;
+	}
+
+	bool openOrBuildMeshCache(const std::string& sourcePath, MeshCache* cache, std::vector<ew::MeshData>* meshes) {
+		meshes->clear();
+		if (openMeshCache(sourcePath, cache)) {
+			return true;
+		}
+		std::shared_ptr<std::mutex> importLock;
+		{
+			std::lock_guard<std::mutex> lock(importLocksMutex);
+			std::shared_ptr<std::mutex>& entry = importLocks[sourcePath];
+			if (!entry) {
+				entry = std::make_shared<std::mutex>();
+			}
+			importLock = entry;
+		}
+		std::lock_guard<std::mutex> lock(*importLock);
+		//Written by another load while this one waited
+		if (openMeshCache(sourcePath, cache)) {
+			return true;
+		}
+		*meshes = importMeshData(sourcePath);
+		if (!meshes->empty()) {
+			writeMeshCache(sourcePath, *meshes);
+		}
+		return false;
+	}
+
+	std::vector<ew::MeshData> loadCachedMeshData(const std::string& sourcePath) {
+		std::vector<ew::MeshData> meshes;
+		MeshCache cache;
+		if (!openOrBuildMeshCache(sourcePath, &cache, &meshes)) {
+			return meshes;
+		}
+		meshes.resize(cache.meshes.size());
+		for (size_t i = 0; i < cache.meshes.size(); i++)
+		{
+			const CachedMesh& mesh = cache.meshes[i];
+			meshes[i].vertices.assign(mesh.vertices, mesh.vertices + mesh.numVertices);
+			meshes[i].indices.assign(mesh.indices, mesh.indices + mesh.numIndices);
+			meshes[i].format = ew::chooseVertexFormat(mesh.vertices, mesh.numVertices);
+			meshes[i].lods.assign(mesh.lods, mesh.lods + mesh.numLods);
+		}
+		closeMeshCache(&cache);
+		return meshes;
+	}
+}
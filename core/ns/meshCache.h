@@ -0,0 +1,49 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <stddef.h>
+#include "../ew/mesh.h"
+
+namespace ns {
+	//Read-only view of a file mapped into memory
+	struct MappedFile {
+		const unsigned char* data;
+		size_t size;
+		void* fileHandle; //Platform handles, only used to unmap
+		void* mappingHandle;
+	};
+	bool mapFile(const char* filePath, MappedFile* mappedFile);
+	void unmapFile(MappedFile* mappedFile);
+
+	//One mesh of a mapped cache. Pointers stay valid until the cache is closed
+	struct CachedMesh {
+		unsigned int numVertices;
+		unsigned int numIndices;
+		const ew::Vertex* vertices;
+		const unsigned int* indices; //Every level of detail back to back
+		unsigned int numLods;
+		const ew::MeshLOD* lods;
+	};
+
+	//Binary mesh cache written next to the source model as <source>.nsmesh.
+	//Layout: header, mesh table, then 16 byte aligned vertex, index and LOD blobs in ew::Vertex/uint32/ew::MeshLOD format
+	struct MeshCache {
+		MappedFile file;
+		std::vector<CachedMesh> meshes;
+	};
+	std::string getMeshCachePath(const std::string& sourcePath);
+	//Writes the cache for sourcePath, keyed on the source's size, modification time and hash
+	bool writeMeshCache(const std::string& sourcePath, const std::vector<ew::MeshData>& meshes);
+	//Maps the cache for sourcePath. Fails if there is no cache or it is out of date with the source
+	bool openMeshCache(const std::string& sourcePath, MeshCache* cache);
+	void closeMeshCache(MeshCache* cache);
+	//Imports the source with Assimp, runs the mesh optimizer and builds the LOD chain of every mesh, printing their statistics.
+	//This is the data the cache is built from
+	std::vector<ew::MeshData> importMeshData(const std::string& sourcePath);
+	//Maps the cache for sourcePath, or imports the source and writes its cache if there is no usable one.
+	//Returns true with the cache mapped, false with the imported meshes in *meshes (empty if the import failed).
+	//Safe to call from several threads: one of them imports a source at a time, the others wait and then map its cache
+	bool openOrBuildMeshCache(const std::string& sourcePath, MeshCache* cache, std::vector<ew::MeshData>* meshes);
+	//Copies the cache into CPU-side mesh data, importing and caching the source first if needed
+	std::vector<ew::MeshData> loadCachedMeshData(const std::string& sourcePath);
+}
@@ -0,0 +1,354 @@
+#include "meshOptimizer.h"
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace ns {
+	static const unsigned int INVALID_INDEX = 0xffffffffu;
+
+	VertexCacheStats analyzeVertexCache(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize) {
+		VertexCacheStats stats;
+		stats.acmr = 0.0f;
+		stats.atvr = 0.0f;
+		if (numIndices < 3 || numVertices == 0) {
+			return stats;
+		}
+		//A vertex is in the cache if it was inserted less than cacheSize misses ago
+		std::vector<unsigned int> insertedAt(numVertices, INVALID_INDEX);
+		unsigned int misses = 0;
+		for (unsigned int i = 0; i < numIndices; i++)
+		{
+			unsigned int v = indices[i];
+			if (insertedAt[v] == INVALID_INDEX || misses - insertedAt[v] >= cacheSize) {
+				insertedAt[v] = misses;
+				misses++;
+			}
+		}
+		stats.acmr = (float)misses / (numIndices / 3);
+		stats.atvr = (float)misses / numVertices;
+		return stats;
+	}
+
+	static uint32_t hashVertex(const ew::Vertex& vertex) {
+		const unsigned char* bytes = (const unsigned char*)&vertex;
+		uint32_t h = 2166136261u;
+		for (size_t i = 0; i < sizeof(ew::Vertex); i++)
+		{
+			h ^= bytes[i];
+			h *= 16777619u;
+		}
+		return h;
+	}
+
+	void deduplicateVertices(ew::MeshData* meshData) {
+		std::vector<ew::Vertex>& vertices = meshData->vertices;
+		unsigned int numVertices = (unsigned int)vertices.size();
+		//Open addressing table of indices into the unique vertex list
+		unsigned int tableSize = 1;
+		while (tableSize < numVertices * 2) {
+			tableSize *= 2;
+		}
+		std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+		std::vector<unsigned int> remap(numVertices);
+		std::vector<ew::Vertex> unique;
+		unique.reserve(numVertices);
+		for (unsigned int i = 0; i < numVertices; i++)
+		{
+			unsigned int slot = hashVertex(vertices[i]) & (tableSize - 1);
+			while (table[slot] != INVALID_INDEX && memcmp(&unique[table[slot]], &vertices[i], sizeof(ew::Vertex)) != 0) {
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == INVALID_INDEX) {
+				table[slot] = (unsigned int)unique.size();
+				unique.push_back(vertices[i]);
+			}
+			remap[i] = table[slot];
+		}
+		for (size_t i = 0; i < meshData->indices.size(); i++)
+		{
+			meshData->indices[i] = remap[meshData->indices[i]];
+		}
+		vertices.swap(unique);
+	}
+
+	//Scoring constants from the original article
+	static const float CACHE_DECAY_POWER = 1.5f;
+	static const float LAST_TRIANGLE_SCORE = 0.75f;
+	static const float VALENCE_BOOST_SCALE = 2.0f;
+	static const float VALENCE_BOOST_POWER = 0.5f;
+
+	static float scoreVertex(int cachePosition, unsigned int remainingTriangles, unsigned int cacheSize) {
+		if (remainingTriangles == 0) {
+			return -1.0f;
+		}
+		float score = 0.0f;
+		if (cachePosition >= 0) {
+			if (cachePosition < 3) {
+				//Vertices of the triangle just drawn get a fixed score so the next triangle does not favour one of them
+				score = LAST_TRIANGLE_SCORE;
+			}
+			else {
+				float scaler = 1.0f / (cacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+			}
+		}
+		//Boost vertices with few triangles left so they are finished off instead of left as stragglers
+		score += VALENCE_BOOST_SCALE * powf((float)remainingTriangles, -VALENCE_BOOST_POWER);
+		return score;
+	}
+
+	void optimizeVertexCache(ew::MeshData* meshData, unsigned int cacheSize) {
+		optimizeVertexCache(&meshData->indices, (unsigned int)meshData->vertices.size(), cacheSize);
+	}
+
+	void optimizeVertexCache(std::vector<unsigned int>* indexBuffer, unsigned int numVertices, unsigned int cacheSize) {
+		std::vector<unsigned int>& indices = *indexBuffer;
+		unsigned int numTriangles = (unsigned int)indices.size() / 3;
+		if (numTriangles == 0) {
+			return;
+		}
+
+		//Vertex -> triangles adjacency, stored as one array with per-vertex offsets
+		std::vector<unsigned int> triangleCounts(numVertices, 0);
+		for (unsigned int i = 0; i < numTriangles * 3; i++)
+		{
+			triangleCounts[indices[i]]++;
+		}
+		std::vector<unsigned int> adjacencyOffsets(numVertices + 1, 0);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + triangleCounts[v];
+		}
+		std::vector<unsigned int> adjacency(numTriangles * 3);
+		std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (unsigned int t = 0; t < numTriangles; t++)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				adjacency[fill[indices[t * 3 + k]]++] = t;
+			}
+		}
+
+		//triangleCounts now tracks triangles not yet emitted
+		std::vector<int> cachePositions(numVertices, -1);
+		std::vector<float> vertexScores(numVertices);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			vertexScores[v] = scoreVertex(-1, triangleCounts[v], cacheSize);
+		}
+		std::vector<float> triangleScores(numTriangles);
+		std::vector<bool> emitted(numTriangles, false);
+		for (unsigned int t = 0; t < numTriangles; t++)
+		{
+			triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		}
+
+		std::vector<unsigned int> cache;
+		std::vector<unsigned int> newCache;
+		cache.reserve(cacheSize + 3);
+		newCache.reserve(cacheSize + 3);
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+		unsigned int scanPosition = 0; //Everything before this is already emitted
+
+		unsigned int bestTriangle = INVALID_INDEX;
+		for (unsigned int emittedCount = 0; emittedCount < numTriangles; emittedCount++)
+		{
+			//Nothing left around the cache, continue with the next unemitted triangle in input order.
+			//Scanning for the best score here instead would make disconnected meshes quadratic
+			if (bestTriangle == INVALID_INDEX) {
+				while (emitted[scanPosition]) {
+					scanPosition++;
+				}
+				bestTriangle = scanPosition;
+			}
+			unsigned int triangle = bestTriangle;
+			emitted[triangle] = true;
+
+			//The triangle's vertices go to the front of the cache, everything else shifts back
+			newCache.clear();
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[triangle * 3 + k];
+				output.push_back(v);
+				newCache.push_back(v);
+				//Remove the triangle from the vertex's list of remaining triangles
+				unsigned int begin = adjacencyOffsets[v];
+				unsigned int end = begin + triangleCounts[v];
+				for (unsigned int a = begin; a < end; a++)
+				{
+					if (adjacency[a] == triangle) {
+						adjacency[a] = adjacency[end - 1];
+						break;
+					}
+				}
+				triangleCounts[v]--;
+			}
+			for (size_t c = 0; c < cache.size(); c++)
+			{
+				unsigned int v = cache[c];
+				if (v != newCache[0] && v != newCache[1] && v != newCache[2]) {
+					newCache.push_back(v);
+				}
+			}
+			cache.swap(newCache);
+
+			//Rescore everything that was in the cache, including vertices that just dropped out of it
+			for (size_t c = 0; c < cache.size(); c++)
+			{
+				unsigned int v = cache[c];
+				cachePositions[v] = c < cacheSize ? (int)c : -1;
+				float newScore = scoreVertex(cachePositions[v], triangleCounts[v], cacheSize);
+				float delta = newScore - vertexScores[v];
+				vertexScores[v] = newScore;
+				unsigned int begin = adjacencyOffsets[v];
+				for (unsigned int a = begin; a < begin + triangleCounts[v]; a++)
+				{
+					triangleScores[adjacency[a]] += delta;
+				}
+			}
+
+			//Best next candidate among triangles touching the cache
+			bestTriangle = INVALID_INDEX;
+			float bestScore = -1.0f;
+			if (cache.size() > cacheSize) {
+				cache.resize(cacheSize);
+			}
+			for (size_t c = 0; c < cache.size(); c++)
+			{
+				unsigned int v = cache[c];
+				unsigned int begin = adjacencyOffsets[v];
+				for (unsigned int a = begin; a < begin + triangleCounts[v]; a++)
+				{
+					unsigned int t = adjacency[a];
+					if (triangleScores[t] > bestScore) {
+						bestScore = triangleScores[t];
+						bestTriangle = t;
+					}
+				}
+			}
+		}
+		indices.swap(output);
+	}
+
+	void optimizeOverdraw(ew::MeshData* meshData) {
+		std::vector<unsigned int>& indices = meshData->indices;
+		const std::vector<ew::Vertex>& vertices = meshData->vertices;
+		unsigned int numTriangles = (unsigned int)indices.size() / 3;
+		if (numTriangles == 0) {
+			return;
+		}
+
+		//Start a new cluster wherever all three vertices of a triangle miss the cache.
+		//The cache is cold there anyway, so reordering clusters costs little vertex reuse
+		const unsigned int cacheSize = 16;
+		std::vector<unsigned int> insertedAt(vertices.size(), INVALID_INDEX);
+		unsigned int misses = 0;
+		std::vector<unsigned int> clusterStarts;
+		for (unsigned int t = 0; t < numTriangles; t++)
+		{
+			unsigned int triangleMisses = 0;
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				unsigned int v = indices[t * 3 + k];
+				if (insertedAt[v] == INVALID_INDEX || misses - insertedAt[v] >= cacheSize) {
+					insertedAt[v] = misses;
+					misses++;
+					triangleMisses++;
+				}
+			}
+			if (t == 0 || triangleMisses == 3) {
+				clusterStarts.push_back(t);
+			}
+		}
+		clusterStarts.push_back(numTriangles);
+
+		glm::vec3 meshCentroid(0.0f);
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			meshCentroid += vertices[i].pos;
+		}
+		meshCentroid /= (float)vertices.size();
+
+		//Sort key: how far the cluster sits out along its own average normal
+		struct Cluster {
+			unsigned int start;
+			unsigned int end;
+			float sortKey;
+		};
+		std::vector<Cluster> clusters(clusterStarts.size() - 1);
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			Cluster& cluster = clusters[c];
+			cluster.start = clusterStarts[c];
+			cluster.end = clusterStarts[c + 1];
+			glm::vec3 centroid(0.0f);
+			glm::vec3 normal(0.0f);
+			float area = 0.0f;
+			for (unsigned int t = cluster.start; t < cluster.end; t++)
+			{
+				glm::vec3 p0 = vertices[indices[t * 3]].pos;
+				glm::vec3 p1 = vertices[indices[t * 3 + 1]].pos;
+				glm::vec3 p2 = vertices[indices[t * 3 + 2]].pos;
+				glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+				float triangleArea = glm::length(n);
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+				normal += n;
+				area += triangleArea;
+			}
+			centroid = area > 0.0f ? centroid / area : vertices[indices[cluster.start * 3]].pos;
+			float normalLength = glm::length(normal);
+			cluster.sortKey = normalLength > 0.0f ? glm::dot(centroid - meshCentroid, normal / normalLength) : 0.0f;
+		}
+		std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) {
+			return a.sortKey > b.sortKey;
+		});
+
+		std::vector<unsigned int> output;
+		output.reserve(indices.size());
+		for (size_t c = 0; c < clusters.size(); c++)
+		{
+			output.insert(output.end(), indices.begin() + clusters[c].start * 3, indices.begin() + clusters[c].end * 3);
+		}
+		indices.swap(output);
+	}
+
+	void optimizeVertexFetch(ew::MeshData* meshData) {
+		std::vector<ew::Vertex>& vertices = meshData->vertices;
+		std::vector<unsigned int> remap(vertices.size(), INVALID_INDEX);
+		std::vector<ew::Vertex> ordered;
+		ordered.reserve(vertices.size());
+		for (size_t i = 0; i < meshData->indices.size(); i++)
+		{
+			unsigned int& index = meshData->indices[i];
+			if (remap[index] == INVALID_INDEX) {
+				remap[index] = (unsigned int)ordered.size();
+				ordered.push_back(vertices[index]);
+			}
+			index = remap[index];
+		}
+		//Vertices no indices refer to are dropped
+		vertices.swap(ordered);
+	}
+
+	MeshOptimizationReport optimizeMesh(ew::MeshData* meshData) {
+		MeshOptimizationReport report;
+		report.verticesBefore = (unsigned int)meshData->vertices.size();
+		report.before = analyzeVertexCache(meshData->indices.data(), (unsigned int)meshData->indices.size(), report.verticesBefore);
+		deduplicateVertices(meshData);
+		optimizeVertexCache(meshData);
+		optimizeOverdraw(meshData);
+		optimizeVertexFetch(meshData);
+		report.verticesAfter = (unsigned int)meshData->vertices.size();
+		report.after = analyzeVertexCache(meshData->indices.data(), (unsigned int)meshData->indices.size(), report.verticesAfter);
+		return report;
+	}
+
+	void printMeshOptimizationReport(const char* name, const MeshOptimizationReport& report) {
+		printf("%s: vertices %u -> %u, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name, report.verticesBefore, report.verticesAfter,
+			report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr);
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+#include "../ew/mesh.h"
+
+namespace ns {
+	//Post-transform cache behaviour of an index buffer, simulated with a FIFO cache
+	struct VertexCacheStats {
+		float acmr; //Average cache miss ratio: transformed vertices per triangle. 3 is worst, ~0.5-0.7 is good
+		float atvr; //Average transformed vertex ratio: transformed vertices per unique vertex. 1 is ideal
+	};
+	VertexCacheStats analyzeVertexCache(const unsigned int* indices, unsigned int numIndices, unsigned int numVertices, unsigned int cacheSize = 16);
+
+	//Merges bitwise identical vertices and remaps the indices
+	void deduplicateVertices(ew::MeshData* meshData);
+	//Reorders triangles for the post-transform vertex cache (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+	void optimizeVertexCache(ew::MeshData* meshData, unsigned int cacheSize = 32);
+	//Same, for an index buffer on its own, e.g. one level of detail
+	void optimizeVertexCache(std::vector<unsigned int>* indices, unsigned int numVertices, unsigned int cacheSize = 32);
+	//Splits the cache optimized triangle order into clusters at cache flushes and sorts the clusters front to back
+	//from the outside in, so outward facing parts of the mesh tend to be drawn first and occlude the rest
+	void optimizeOverdraw(ew::MeshData* meshData);
+	//Reorders vertices by first use so vertex fetch walks memory linearly
+	void optimizeVertexFetch(ew::MeshData* meshData);
+
+	struct MeshOptimizationReport {
+		unsigned int verticesBefore;
+		unsigned int verticesAfter;
+		VertexCacheStats before;
+		VertexCacheStats after;
+	};
+	//Runs every stage above in order
+	MeshOptimizationReport optimizeMesh(ew::MeshData* meshData);
+	void printMeshOptimizationReport(const char* name, const MeshOptimizationReport& report);
+}
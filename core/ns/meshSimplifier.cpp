@@ -0,0 +1,309 @@
+#include "meshSimplifier.h"
+#include "meshOptimizer.h"
+#include <unordered_map>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include <float.h>
+
+namespace ns {
+	static const unsigned int INVALID_INDEX = 0xffffffffu;
+	//Levels that keep more than this share of the previous level's triangles are not worth storing
+	static const float MIN_LOD_REDUCTION = 0.85f;
+	static const unsigned int MIN_LOD_INDICES = 36;
+
+	//Symmetric 4x4 matrix, upper triangle stored row by row
+	struct Quadric {
+		double m[10];
+	};
+
+	static Quadric planeQuadric(const glm::vec3& n, float d) {
+		Quadric q;
+		double a = n.x, b = n.y, c = n.z, w = d;
+		q.m[0] = a * a; q.m[1] = a * b; q.m[2] = a * c; q.m[3] = a * w;
+		q.m[4] = b * b; q.m[5] = b * c; q.m[6] = b * w;
+		q.m[7] = c * c; q.m[8] = c * w;
+		q.m[9] = w * w;
+		return q;
+	}
+
+	static void addQuadric(Quadric* q, const Quadric& other) {
+		for (int i = 0; i < 10; i++)
+		{
+			q->m[i] += other.m[i];
+		}
+	}
+
+	//Sum of squared distances from p to the accumulated planes
+	static double evaluateQuadric(const Quadric& q, const glm::vec3& p) {
+		double x = p.x, y = p.y, z = p.z;
+		double error = q.m[0] * x * x + 2.0 * q.m[1] * x * y + 2.0 * q.m[2] * x * z + 2.0 * q.m[3] * x
+			+ q.m[4] * y * y + 2.0 * q.m[5] * y * z + 2.0 * q.m[6] * y
+			+ q.m[7] * z * z + 2.0 * q.m[8] * z
+			+ q.m[9];
+		return error > 0.0 ? error : 0.0;
+	}
+
+	//Maps every vertex to the first vertex sharing its position
+	static std::vector<unsigned int> buildPositionRemap(const std::vector<ew::Vertex>& vertices) {
+		unsigned int tableSize = 1;
+		while (tableSize < vertices.size() * 2) {
+			tableSize *= 2;
+		}
+		std::vector<unsigned int> table(tableSize, INVALID_INDEX);
+		std::vector<unsigned int> remap(vertices.size());
+		for (unsigned int i = 0; i < vertices.size(); i++)
+		{
+			const unsigned char* bytes = (const unsigned char*)&vertices[i].pos;
+			uint32_t h = 2166136261u;
+			for (size_t b = 0; b < sizeof(glm::vec3); b++)
+			{
+				h ^= bytes[b];
+				h *= 16777619u;
+			}
+			unsigned int slot = h & (tableSize - 1);
+			while (table[slot] != INVALID_INDEX && memcmp(&vertices[table[slot]].pos, &vertices[i].pos, sizeof(glm::vec3)) != 0) {
+				slot = (slot + 1) & (tableSize - 1);
+			}
+			if (table[slot] == INVALID_INDEX) {
+				table[slot] = i;
+			}
+			remap[i] = table[slot];
+		}
+		return remap;
+	}
+
+	struct Collapse {
+		unsigned int from;
+		unsigned int to;
+		double cost;
+	};
+
+	std::vector<unsigned int> simplifyMesh(const std::vector<ew::Vertex>& vertices, const std::vector<unsigned int>& indices,
+		unsigned int targetIndexCount, float* resultError) {
+		std::vector<unsigned int> result = indices;
+		double maxCost = 0.0;
+		unsigned int numVertices = (unsigned int)vertices.size();
+		std::vector<unsigned int> positionRemap = buildPositionRemap(vertices);
+
+		//Seam vertices share a position with another vertex, moving one would tear the surface open
+		std::vector<unsigned int> groupSizes(numVertices, 0);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			groupSizes[positionRemap[v]]++;
+		}
+		std::vector<bool> locked(numVertices, false);
+		for (unsigned int v = 0; v < numVertices; v++)
+		{
+			locked[v] = groupSizes[positionRemap[v]] > 1;
+		}
+		//Border edges belong to a single triangle
+		std::unordered_map<uint64_t, unsigned int> edgeCounts;
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				uint64_t a = positionRemap[result[i + k]];
+				uint64_t b = positionRemap[result[i + (k + 1) % 3]];
+				edgeCounts[a < b ? (a << 32) | b : (b << 32) | a]++;
+			}
+		}
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				uint64_t a = positionRemap[result[i + k]];
+				uint64_t b = positionRemap[result[i + (k + 1) % 3]];
+				if (edgeCounts[a < b ? (a << 32) | b : (b << 32) | a] == 1) {
+					locked[result[i + k]] = true;
+					locked[result[i + (k + 1) % 3]] = true;
+				}
+			}
+		}
+
+		//Quadrics live on positions so that seam vertices see the planes of every triangle around them
+		std::vector<Quadric> quadrics(numVertices);
+		memset(quadrics.data(), 0, sizeof(Quadric) * quadrics.size());
+		for (size_t i = 0; i < result.size(); i += 3)
+		{
+			glm::vec3 p0 = vertices[result[i]].pos;
+			glm::vec3 p1 = vertices[result[i + 1]].pos;
+			glm::vec3 p2 = vertices[result[i + 2]].pos;
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float length = glm::length(n);
+			if (length <= 0.0f) {
+				continue;
+			}
+			n /= length;
+			Quadric q = planeQuadric(n, -glm::dot(n, p0));
+			for (unsigned int k = 0; k < 3; k++)
+			{
+				addQuadric(&quadrics[positionRemap[result[i + k]]], q);
+			}
+		}
+
+		std::vector<unsigned int> triangleOffsets(numVertices + 1);
+		std::vector<unsigned int> vertexTriangles;
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(numVertices);
+		std::vector<unsigned int> collapseRemap(numVertices);
+		while (result.size() > targetIndexCount) {
+			unsigned int numTriangles = (unsigned int)result.size() / 3;
+			//Vertex -> triangle adjacency for the flip test
+			std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+			for (size_t i = 0; i < result.size(); i++)
+			{
+				triangleOffsets[result[i] + 1]++;
+			}
+			for (unsigned int v = 0; v < numVertices; v++)
+			{
+				triangleOffsets[v + 1] += triangleOffsets[v];
+			}
+			vertexTriangles.resize(result.size());
+			std::vector<unsigned int> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+			for (unsigned int t = 0; t < numTriangles; t++)
+			{
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					vertexTriangles[fill[result[t * 3 + k]]++] = t;
+				}
+			}
+
+			//Every edge in both directions, cheapest first
+			collapses.clear();
+			for (unsigned int t = 0; t < numTriangles; t++)
+			{
+				for (unsigned int k = 0; k < 3; k++)
+				{
+					unsigned int from = result[t * 3 + k];
+					unsigned int to = result[t * 3 + (k + 1) % 3];
+					for (int direction = 0; direction < 2; direction++)
+					{
+						if (!locked[from] && positionRemap[from] != positionRemap[to]) {
+							Quadric q = quadrics[positionRemap[from]];
+							addQuadric(&q, quadrics[positionRemap[to]]);
+							Collapse collapse;
+							collapse.from = from;
+							collapse.to = to;
+							collapse.cost = evaluateQuadric(q, vertices[to].pos);
+							collapses.push_back(collapse);
+						}
+						std::swap(from, to);
+					}
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.cost < b.cost;
+			});
+
+			//Each collapse removes about two triangles. Collapses in one pass may not share vertices,
+			//so the flip test always sees up to date positions
+			unsigned int collapsesWanted = (unsigned int)(result.size() - targetIndexCount) / 6 + 1;
+			unsigned int numCollapsed = 0;
+			std::fill(touched.begin(), touched.end(), false);
+			for (unsigned int v = 0; v < numVertices; v++)
+			{
+				collapseRemap[v] = v;
+			}
+			for (size_t c = 0; c < collapses.size() && numCollapsed < collapsesWanted; c++)
+			{
+				const Collapse& collapse = collapses[c];
+				if (touched[collapse.from] || touched[collapse.to]) {
+					continue;
+				}
+				//Reject collapses that would flip or degenerate a remaining triangle
+				bool flips = false;
+				glm::vec3 target = vertices[collapse.to].pos;
+				for (unsigned int a = triangleOffsets[collapse.from]; a < triangleOffsets[collapse.from + 1] && !flips; a++)
+				{
+					const unsigned int* triangle = &result[vertexTriangles[a] * 3];
+					if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+						continue; //Removed by the collapse
+					}
+					glm::vec3 p[3];
+					glm::vec3 moved[3];
+					for (unsigned int k = 0; k < 3; k++)
+					{
+						p[k] = vertices[triangle[k]].pos;
+						moved[k] = triangle[k] == collapse.from ? target : p[k];
+					}
+					glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+					glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+					flips = glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after);
+				}
+				if (flips) {
+					continue;
+				}
+				for (unsigned int a = triangleOffsets[collapse.from]; a < triangleOffsets[collapse.from + 1]; a++)
+				{
+					const unsigned int* triangle = &result[vertexTriangles[a] * 3];
+					touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+				}
+				collapseRemap[collapse.from] = collapse.to;
+				addQuadric(&quadrics[positionRemap[collapse.to]], quadrics[positionRemap[collapse.from]]);
+				maxCost = collapse.cost > maxCost ? collapse.cost : maxCost;
+				numCollapsed++;
+			}
+			if (numCollapsed == 0) {
+				break;
+			}
+
+			//Apply the pass and drop triangles that collapsed to a line
+			size_t write = 0;
+			for (size_t i = 0; i < result.size(); i += 3)
+			{
+				unsigned int a = collapseRemap[result[i]];
+				unsigned int b = collapseRemap[result[i + 1]];
+				unsigned int c = collapseRemap[result[i + 2]];
+				if (positionRemap[a] == positionRemap[b] || positionRemap[b] == positionRemap[c] || positionRemap[a] == positionRemap[c]) {
+					continue;
+				}
+				result[write++] = a;
+				result[write++] = b;
+				result[write++] = c;
+			}
+			result.resize(write);
+		}
+		if (resultError != NULL) {
+			*resultError = (float)sqrt(maxCost);
+		}
+		return result;
+	}
+
+	void generateLODs(ew::MeshData* meshData, unsigned int maxLevels, float reduction) {
+		meshData->lods.clear();
+		std::vector<unsigned int> baseIndices = meshData->indices;
+		ew::MeshLOD base;
+		base.firstIndex = 0;
+		base.indexCount = (unsigned int)baseIndices.size();
+		base.error = 0.0f;
+		meshData->lods.push_back(base);
+
+		float targetCount = (float)baseIndices.size();
+		unsigned int previousCount = base.indexCount;
+		for (unsigned int level = 1; level < maxLevels; level++)
+		{
+			targetCount *= reduction;
+			unsigned int target = (unsigned int)targetCount / 3 * 3;
+			if (target < MIN_LOD_INDICES) {
+				break;
+			}
+			//Each level starts from the full mesh so errors do not compound between levels
+			float error = 0.0f;
+			std::vector<unsigned int> lodIndices = simplifyMesh(meshData->vertices, baseIndices, target, &error);
+			if (lodIndices.size() > previousCount * MIN_LOD_REDUCTION) {
+				break;
+			}
+			optimizeVertexCache(&lodIndices, (unsigned int)meshData->vertices.size());
+			ew::MeshLOD lod;
+			lod.firstIndex = (unsigned int)meshData->indices.size();
+			lod.indexCount = (unsigned int)lodIndices.size();
+			//Never report less error than a finer level
+			lod.error = glm::max(error, meshData->lods.back().error);
+			meshData->indices.insert(meshData->indices.end(), lodIndices.begin(), lodIndices.end());
+			meshData->lods.push_back(lod);
+			previousCount = lod.indexCount;
+		}
+	}
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <vector>
+#include "../ew/mesh.h"
+
+namespace ns {
+	//Quadric error metric simplification (Garland & Heckbert) with half edge collapses, so the result only
+	//references the original vertices and can share their buffer.
+	//Vertices on UV/normal seams and open borders are never moved.
+	//Returns the simplified index list. resultError receives the largest collapse error in object space units
+	std::vector<unsigned int> simplifyMesh(const std::vector<ew::Vertex>& vertices, const std::vector<unsigned int>& indices,
+		unsigned int targetIndexCount, float* resultError);
+
+	//Appends up to maxLevels - 1 coarser levels to the index buffer, each with about reduction times the
+	//triangles of the previous one, and fills meshData->lods. Stops early once simplification stalls.
+	//Level 0 is the indices the mesh already has
+	void generateLODs(ew::MeshData* meshData, unsigned int maxLevels = 4, float reduction = 0.5f);
+}
@@ -0,0 +1,148 @@
+#include "modelImport.h"
+#include "../ew/model.h"
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+#include <stdio.h>
+
+namespace ns {
+	static glm::vec3 convertAIVec3(const aiVector3D& v) {
+		return glm::vec3(v.x, v.y, v.z);
+	}
+
+	//aiMatrix4x4 is row major
+	static glm::mat4 convertAIMat4(const aiMatrix4x4& m) {
+		return glm::transpose(glm::mat4(m.a1, m.a2, m.a3, m.a4, m.b1, m.b2, m.b3, m.b4, m.c1, m.c2, m.c3, m.c4, m.d1, m.d2, m.d3, m.d4));
+	}
+
+	//Depth first, so parents are added before their children
+	static void addSkeletonJoint(const aiNode* node, int parent, Skeleton* skeleton) {
+		int joint = (int)skeleton->parents.size();
+		aiVector3D scaling, position;
+		aiQuaternion rotation;
+		node->mTransformation.Decompose(scaling, rotation, position);
+		skeleton->jointNames.push_back(node->mName.C_Str());
+		skeleton->parents.push_back(parent);
+		skeleton->bindPositions.push_back(glm::vec3(position.x, position.y, position.z));
+		skeleton->bindRotations.push_back(glm::quat(rotation.w, rotation.x, rotation.y, rotation.z));
+		skeleton->bindScales.push_back(glm::vec3(scaling.x, scaling.y, scaling.z));
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+		{
+			addSkeletonJoint(node->mChildren[i], joint, skeleton);
+		}
+	}
+
+	//Every animation of the scene compressed for the skeleton, channels matched to joints by node name
+	static void convertAnimations(const aiScene* aiScene, const Skeleton& skeleton, std::vector<AnimationClip>* clips) {
+		clips->clear();
+		clips->reserve(aiScene->mNumAnimations);
+		for (unsigned int i = 0; i < aiScene->mNumAnimations; i++)
+		{
+			const aiAnimation* aiAnimation = aiScene->mAnimations[i];
+			//Key times are in ticks, 0 ticks per second means the exporter didn't say
+			float secondsPerTick = 1.0f / (float)(aiAnimation->mTicksPerSecond > 0.0 ? aiAnimation->mTicksPerSecond : 25.0);
+			RawAnimationClip raw;
+			raw.name = aiAnimation->mName.C_Str();
+			raw.duration = (float)aiAnimation->mDuration * secondsPerTick;
+			for (unsigned int j = 0; j < aiAnimation->mNumChannels; j++)
+			{
+				const aiNodeAnim* channel = aiAnimation->mChannels[j];
+				int joint = findJoint(skeleton, channel->mNodeName.C_Str());
+				if (joint < 0) {
+					continue;
+				}
+				AnimationTrack track;
+				track.joint = (unsigned int)joint;
+				for (unsigned int k = 0; k < channel->mNumPositionKeys; k++)
+				{
+					const aiVectorKey& key = channel->mPositionKeys[k];
+					track.positionTimes.push_back((float)key.mTime * secondsPerTick);
+					track.positions.push_back(convertAIVec3(key.mValue));
+				}
+				for (unsigned int k = 0; k < channel->mNumRotationKeys; k++)
+				{
+					const aiQuatKey& key = channel->mRotationKeys[k];
+					track.rotationTimes.push_back((float)key.mTime * secondsPerTick);
+					track.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+				}
+				for (unsigned int k = 0; k < channel->mNumScalingKeys; k++)
+				{
+					const aiVectorKey& key = channel->mScalingKeys[k];
+					track.scaleTimes.push_back((float)key.mTime * secondsPerTick);
+					track.scales.push_back(convertAIVec3(key.mValue));
+				}
+				raw.tracks.push_back(track);
+			}
+			clips->push_back(compressAnimationClip(raw, skeleton));
+		}
+	}
+
+	bool loadModelAnimations(const std::string& filePath, Skeleton* skeleton, std::vector<AnimationClip>* clips)
+	{
+		Assimp::Importer importer;
+		const aiScene* aiScene = importer.ReadFile(filePath, 0);
+		if (aiScene == nullptr || aiScene->mRootNode == nullptr) {
+			printf("Failed to load animations from %s", filePath.c_str());
+			return false;
+		}
+		*skeleton = Skeleton();
+		addSkeletonJoint(aiScene->mRootNode, -1, skeleton);
+		convertAnimations(aiScene, *skeleton, clips);
+		return true;
+	}
+
+	bool loadModelClips(const std::string& filePath, const Skeleton& skeleton, std::vector<AnimationClip>* clips)
+	{
+		Assimp::Importer importer;
+		const aiScene* aiScene = importer.ReadFile(filePath, 0);
+		if (aiScene == nullptr) {
+			printf("Failed to load animations from %s", filePath.c_str());
+			return false;
+		}
+		convertAnimations(aiScene, skeleton, clips);
+		return true;
+	}
+
+	bool loadSkinnedModelData(const std::string& filePath, Skeleton* skeleton, Skin* skin, std::vector<ew::MeshData>* meshes)
+	{
+		Assimp::Importer importer;
+		const aiScene* aiScene = importer.ReadFile(filePath, aiProcess_Triangulate | aiProcess_LimitBoneWeights);
+		if (aiScene == nullptr || aiScene->mRootNode == nullptr) {
+			printf("Failed to load skinned model %s", filePath.c_str());
+			return false;
+		}
+		*skeleton = Skeleton();
+		addSkeletonJoint(aiScene->mRootNode, -1, skeleton);
+		*skin = Skin();
+		meshes->clear();
+		meshes->reserve(aiScene->mNumMeshes);
+		for (unsigned int i = 0; i < aiScene->mNumMeshes; i++)
+		{
+			aiMesh* aiMesh = aiScene->mMeshes[i];
+			meshes->push_back(ew::processAiMesh(aiMesh));
+			ew::MeshData& meshData = meshes->back();
+			std::vector<unsigned int> joints(aiMesh->mNumVertices * 4, 0);
+			std::vector<float> weights(aiMesh->mNumVertices * 4, 0.0f);
+			for (unsigned int j = 0; j < aiMesh->mNumBones; j++)
+			{
+				const aiBone* aiBone = aiMesh->mBones[j];
+				int joint = findJoint(*skeleton, aiBone->mName.C_Str());
+				if (joint < 0) {
+					continue;
+				}
+				unsigned int paletteIndex = addSkinJoint(skin, (unsigned int)joint, convertAIMat4(aiBone->mOffsetMatrix));
+				for (unsigned int k = 0; k < aiBone->mNumWeights; k++)
+				{
+					const aiVertexWeight& weight = aiBone->mWeights[k];
+					addVertexJoint(paletteIndex, weight.mWeight, &joints[weight.mVertexId * 4], &weights[weight.mVertexId * 4]);
+				}
+			}
+			meshData.skin.resize(aiMesh->mNumVertices);
+			for (unsigned int v = 0; v < aiMesh->mNumVertices; v++)
+			{
+				meshData.skin[v] = packVertexSkin(&joints[v * 4], &weights[v * 4]);
+			}
+		}
+		return true;
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <vector>
+#include <string>
+#include "animation.h"
+#include "skinning.h"
+#include "../ew/mesh.h"
+
+namespace ns {
+	//Imports the node tree of a model file as a skeleton, one joint per node, and its animations as clips compressed for it.
+	//Returns false if the file could not be read
+	bool loadModelAnimations(const std::string& filePath, Skeleton* skeleton, std::vector<AnimationClip>* clips);
+	//Imports the animations of a model file as clips for an existing skeleton, matching channels to joints by name.
+	//Channels of joints the skeleton doesn't have are skipped. Returns false if the file could not be read
+	bool loadModelClips(const std::string& filePath, const Skeleton& skeleton, std::vector<AnimationClip>* clips);
+	//Imports a model skinned with Assimp bones: the node tree as a skeleton (same joints as loadModelAnimations), one skin shared by every mesh,
+	//and the meshes with their 4 heaviest joints per vertex. Skinned meshes skip the mesh cache and optimizer. Returns false if the file could not be read
+	bool loadSkinnedModelData(const std::string& filePath, Skeleton* skeleton, Skin* skin, std::vector<ew::MeshData>* meshes);
+}
@@ -17,8 +17,10 @@ namespace ns {
 			return m;
 		}
 
+		glm::mat4 localMatrix = glm::mat4(1.0f); //localTransform() as of the last updateHierarchyTransforms
 		glm::mat4 globalTransform;
 		unsigned int parentIndex; //Parent index in hierarchy
+		bool dirty = true; //Position, rotation or scale changed since localMatrix was computed
 	};
 	Node createNode(glm::vec3 position, glm::quat rotation, glm::vec3 scale, unsigned int parentIndex);
-}
\ No newline at end of file
+}
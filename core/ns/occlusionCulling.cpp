@@ -0,0 +1,122 @@
+#include "occlusionCulling.h"
+#include "glState.h"
+#include "../ew/external/glad.h"
+#include <string.h>
+
+namespace ns {
+	//Threads per work group in both compute shaders
+	static const unsigned int HIZ_GROUP_SIZE = 8;
+	static const unsigned int OCCLUSION_GROUP_SIZE = 64;
+
+	HiZPyramid createHiZPyramid(unsigned int depthWidth, unsigned int depthHeight) {
+		HiZPyramid pyramid;
+		pyramid.width = glm::max((depthWidth + 1) / 2, 1u);
+		pyramid.height = glm::max((depthHeight + 1) / 2, 1u);
+		//Full chain down to 1x1, each level is max(1, size >> level) like any other mip chain
+		pyramid.numLevels = 1;
+		unsigned int size = glm::max(pyramid.width, pyramid.height);
+		while (size > 1) {
+			size >>= 1;
+			pyramid.numLevels++;
+		}
+		glCreateTextures(GL_TEXTURE_2D, 1, &pyramid.texture);
+		glTextureStorage2D(pyramid.texture, pyramid.numLevels, GL_R32F, pyramid.width, pyramid.height);
+		glTextureParameteri(pyramid.texture, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+		glTextureParameteri(pyramid.texture, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTextureParameteri(pyramid.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(pyramid.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return pyramid;
+	}
+
+	void deleteHiZPyramid(HiZPyramid* pyramid) {
+		releaseTextureBindings(&pyramid->texture, 1);
+		glDeleteTextures(1, &pyramid->texture);
+		pyramid->texture = 0;
+	}
+
+	void buildHiZPyramid(const HiZPyramid& pyramid, const ew::Shader& downsampleShader, unsigned int depthTexture) {
+		downsampleShader.use();
+		downsampleShader.setInt("_Depth", 0);
+		bindTextureUnit(0, depthTexture);
+		for (unsigned int level = 0; level < pyramid.numLevels; level++)
+		{
+			unsigned int width = glm::max(pyramid.width >> level, 1u);
+			unsigned int height = glm::max(pyramid.height >> level, 1u);
+			//Level 0 reads the depth texture, every other level reads the one above it
+			downsampleShader.setInt("_FromDepth", level == 0);
+			if (level > 0) {
+				glBindImageTexture(0, pyramid.texture, level - 1, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+			}
+			glBindImageTexture(1, pyramid.texture, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+			downsampleShader.dispatch((width + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE, (height + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE);
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+		}
+	}
+
+	OcclusionCuller createOcclusionCuller() {
+		OcclusionCuller culler;
+		culler.capacity = 0;
+		culler.numCommands = 0;
+		culler.previousViewProjection = glm::mat4(1.0f);
+		culler.hasHistory = false;
+		culler.numVisible = 0;
+		culler.numFrustumCulled = 0;
+		culler.numOccluded = 0;
+		glCreateBuffers(1, &culler.boundsBuffer);
+		glCreateBuffers(1, &culler.commandBuffer);
+		culler.statsRing = createPersistentRing(sizeof(unsigned int) * 3, MAX_PERSISTENT_RING_FRAMES, true);
+		return culler;
+	}
+
+	void setOcclusionBounds(OcclusionCuller* culler, const OcclusionBounds* bounds, unsigned int count) {
+		if (count > culler->capacity) {
+			culler->capacity = count;
+			glNamedBufferData(culler->boundsBuffer, sizeof(OcclusionBounds) * count, NULL, GL_DYNAMIC_DRAW);
+			glNamedBufferData(culler->commandBuffer, sizeof(DrawElementsIndirectCommand) * count, NULL, GL_DYNAMIC_DRAW);
+		}
+		if (count > 0) {
+			glNamedBufferSubData(culler->boundsBuffer, 0, sizeof(OcclusionBounds) * count, bounds);
+		}
+		culler->numCommands = count;
+	}
+
+	void cullOcclusion(OcclusionCuller* culler, GeometryArena* arena, const HiZPyramid& pyramid, const ew::Shader& cullShader, const glm::mat4& viewProjection, bool occlusion) {
+		unsigned int numCommands = glm::min((unsigned int)arena->commands.size(), culler->numCommands);
+		if (numCommands == 0) {
+			return;
+		}
+		//The region reused now was last written three culls ago, so it is almost always free.
+		//Counts are taken from the cull two frames back, and only once the GPU has finished it
+		unsigned int* stats = (unsigned int*)beginPersistentRegion(&culler->statsRing);
+		const unsigned int* finished = (const unsigned int*)peekPersistentRegion(culler->statsRing, 2);
+		if (finished) {
+			culler->numVisible = finished[0];
+			culler->numFrustumCulled = finished[1];
+			culler->numOccluded = finished[2];
+		}
+		memset(stats, 0, sizeof(unsigned int) * 3);
+
+		uploadArenaDraws(arena);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_COMMAND_BINDING, arena->indirectBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_BOUNDS_BINDING, culler->boundsBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OCCLUSION_OUTPUT_BINDING, culler->commandBuffer);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, OCCLUSION_STATS_BINDING, culler->statsRing.buffer, getPersistentRegionOffset(culler->statsRing), sizeof(unsigned int) * 3);
+		bindTextureUnit(0, pyramid.texture);
+
+		cullShader.use();
+		cullShader.setInt("_HiZ", 0);
+		cullShader.setInt("_NumCommands", (int)numCommands);
+		cullShader.setInt("_HiZLevels", (int)pyramid.numLevels);
+		cullShader.setVec2("_HiZSize", glm::vec2((float)pyramid.width, (float)pyramid.height));
+		cullShader.setInt("_Occlusion", occlusion && culler->hasHistory);
+		cullShader.setMat4("_ViewProjection", viewProjection);
+		cullShader.setMat4("_PreviousViewProjection", culler->previousViewProjection);
+		cullShader.dispatch((numCommands + OCCLUSION_GROUP_SIZE - 1) / OCCLUSION_GROUP_SIZE);
+		//The output is read as draw commands next, the stats through the mapping
+		glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT | GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+		fencePersistentRegion(&culler->statsRing);
+
+		culler->previousViewProjection = viewProjection;
+		culler->hasHistory = true;
+	}
+}
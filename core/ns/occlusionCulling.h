@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "geometryArena.h"
+#include "persistentRing.h"
+#include "../ew/shader.h"
+
+namespace ns {
+	//Storage bindings used by the occlusion cull compute shader
+	const unsigned int OCCLUSION_COMMAND_BINDING = 0;
+	const unsigned int OCCLUSION_BOUNDS_BINDING = 1;
+	const unsigned int OCCLUSION_OUTPUT_BINDING = 2;
+	const unsigned int OCCLUSION_STATS_BINDING = 3;
+
+	//R32F mip chain of a depth buffer where every texel holds the farthest depth of the area it covers.
+	//Level 0 is half the depth buffer's resolution
+	struct HiZPyramid {
+		unsigned int texture;
+		unsigned int width; //Size of level 0
+		unsigned int height;
+		unsigned int numLevels;
+	};
+	HiZPyramid createHiZPyramid(unsigned int depthWidth, unsigned int depthHeight);
+	void deleteHiZPyramid(HiZPyramid* pyramid);
+	//Reduces a depth texture into every level of the pyramid, one dispatch per level
+	void buildHiZPyramid(const HiZPyramid& pyramid, const ew::Shader& downsampleShader, unsigned int depthTexture);
+
+	//World space AABB of one draw command, w is unused
+	struct OcclusionBounds {
+		glm::vec4 min;
+		glm::vec4 max;
+	};
+
+	//Culls the commands of a geometry arena on the GPU against the view frustum and a Hi-Z pyramid of the previous frame's depth,
+	//writing a copy of the commands with instanceCount zeroed for hidden objects. Expects one instance per command
+	//(see pushArenaDraw's merge flag), and one bounds entry per command
+	struct OcclusionCuller {
+		unsigned int boundsBuffer;
+		unsigned int commandBuffer; //Culled commands, draw with drawArenaCommands
+		PersistentRing statsRing; //uint visible, frustum culled, occlusion culled per cull, read back once the GPU is done with it
+		unsigned int capacity; //Commands the buffers can hold
+		unsigned int numCommands;
+		glm::mat4 previousViewProjection; //Camera the pyramid's depth was rendered with
+		bool hasHistory; //False until a frame has been culled, the first frame has no depth to test against
+		//Counts from the cull two frames back, so reading them never waits on the GPU
+		unsigned int numVisible;
+		unsigned int numFrustumCulled;
+		unsigned int numOccluded;
+	};
+	OcclusionCuller createOcclusionCuller();
+	void setOcclusionBounds(OcclusionCuller* culler, const OcclusionBounds* bounds, unsigned int count);
+	//Culls arena->commands for viewProjection. With occlusion off only the frustum test runs.
+	//Call once per frame, after the arena's draw list is final and before this frame's depth is rendered
+	void cullOcclusion(OcclusionCuller* culler, GeometryArena* arena, const HiZPyramid& pyramid, const ew::Shader& cullShader, const glm::mat4& viewProjection, bool occlusion);
+}
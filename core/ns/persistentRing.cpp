@@ -0,0 +1,76 @@
+#include "persistentRing.h"
+#include "../ew/external/glad.h"
+#include <string.h>
+
+namespace ns {
+	PersistentRing createPersistentRing(unsigned int regionSize, unsigned int frameCount, bool readable) {
+		PersistentRing ring;
+		ring.frameCount = frameCount < 1 ? 1 : (frameCount > MAX_PERSISTENT_RING_FRAMES ? MAX_PERSISTENT_RING_FRAMES : frameCount);
+		ring.frameIndex = 0;
+		for (unsigned int i = 0; i < MAX_PERSISTENT_RING_FRAMES; i++)
+		{
+			ring.fences[i] = nullptr;
+		}
+
+		//Each region has to start on a valid glBindBufferRange offset
+		int alignment = 1;
+		glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		ring.regionSize = (regionSize + alignment - 1) / alignment * alignment;
+
+		//Immutable storage that stays mapped for the lifetime of the buffer.
+		//Coherent mapping means CPU writes become visible to the GPU without explicit flushes
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		if (readable)
+			flags |= GL_MAP_READ_BIT;
+		GLsizeiptr totalSize = (GLsizeiptr)ring.regionSize * ring.frameCount;
+		glCreateBuffers(1, &ring.buffer);
+		glNamedBufferStorage(ring.buffer, totalSize, NULL, flags);
+		ring.mapped = (unsigned char*)glMapNamedBufferRange(ring.buffer, 0, totalSize, flags);
+		memset(ring.mapped, 0, totalSize);
+		return ring;
+	}
+
+	unsigned char* beginPersistentRegion(PersistentRing* ring) {
+		ring->frameIndex = (ring->frameIndex + 1) % ring->frameCount;
+
+		//Block until the GPU has finished the frame that last used this region
+		GLsync fence = (GLsync)ring->fences[ring->frameIndex];
+		if (fence) {
+			GLenum result = glClientWaitSync(fence, 0, 0);
+			while (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED && result != GL_WAIT_FAILED) {
+				result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			}
+			glDeleteSync(fence);
+			ring->fences[ring->frameIndex] = nullptr;
+		}
+		return ring->mapped + (size_t)ring->regionSize * ring->frameIndex;
+	}
+
+	unsigned int getPersistentRegionOffset(const PersistentRing& ring) {
+		return ring.regionSize * ring.frameIndex;
+	}
+
+	void fencePersistentRegion(PersistentRing* ring) {
+		GLsync previous = (GLsync)ring->fences[ring->frameIndex];
+		if (previous) {
+			glDeleteSync(previous);
+		}
+		ring->fences[ring->frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	const unsigned char* peekPersistentRegion(const PersistentRing& ring, unsigned int framesAgo) {
+		if (framesAgo == 0 || framesAgo >= ring.frameCount) {
+			return nullptr;
+		}
+		unsigned int index = (ring.frameIndex + ring.frameCount - framesAgo) % ring.frameCount;
+		GLsync fence = (GLsync)ring.fences[index];
+		if (fence == nullptr) {
+			return nullptr;
+		}
+		GLenum result = glClientWaitSync(fence, 0, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) {
+			return nullptr;
+		}
+		return ring.mapped + (size_t)ring.regionSize * index;
+	}
+}
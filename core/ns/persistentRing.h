@@ -0,0 +1,26 @@
+#pragma once
+
+namespace ns {
+	const unsigned int MAX_PERSISTENT_RING_FRAMES = 3;
+
+	//Shader storage buffer that stays mapped for its lifetime, split into one region per frame in flight.
+	//Each region has a fence, so the CPU only reuses a region once the GPU has finished the frame that last used it
+	struct PersistentRing {
+		unsigned int buffer;
+		unsigned char* mapped; //Persistent CPU pointer to the start of the buffer
+		unsigned int regionSize; //Bytes per region, padded to the SSBO offset alignment
+		unsigned int frameCount; //Number of regions (2 = double buffered, 3 = triple buffered)
+		unsigned int frameIndex; //Region of the current frame
+		void* fences[MAX_PERSISTENT_RING_FRAMES]; //GLsync per region, signaled once the GPU is done with it
+	};
+	//Zeroed regions of at least regionSize bytes. readable also maps the buffer for reading, for results the GPU writes back
+	PersistentRing createPersistentRing(unsigned int regionSize, unsigned int frameCount = MAX_PERSISTENT_RING_FRAMES, bool readable = false);
+	//Moves to the next region, waits until the GPU has released it, and returns its CPU pointer
+	unsigned char* beginPersistentRegion(PersistentRing* ring);
+	//Byte offset of the current region, for glBindBufferRange
+	unsigned int getPersistentRegionOffset(const PersistentRing& ring);
+	//Call after issuing the GPU work that uses the current region
+	void fencePersistentRegion(PersistentRing* ring);
+	//Region used framesAgo (1 to frameCount - 1) frames before the current one, or null if the GPU isn't done with it yet. Never waits
+	const unsigned char* peekPersistentRegion(const PersistentRing& ring, unsigned int framesAgo);
+}
@@ -0,0 +1,278 @@
+#include "renderGraph.h"
+#include "glState.h"
+#include "../ew/external/glad.h"
+
+namespace ns {
+	unsigned int addGraphResource(RenderGraph* graph, const char* name, GraphResourceType type, unsigned int fbo, unsigned int numColors) {
+		RenderGraphResource resource;
+		resource.name = name;
+		resource.type = type;
+		resource.fbo = fbo;
+		resource.numColors = numColors;
+		resource.persistent = false;
+		resource.output = false;
+		graph->resources.push_back(resource);
+		return (unsigned int)graph->resources.size() - 1;
+	}
+
+	void setGraphResourcePersistent(RenderGraph* graph, unsigned int resource) {
+		graph->resources[resource].persistent = true;
+	}
+
+	void setGraphOutput(RenderGraph* graph, unsigned int resource) {
+		graph->resources[resource].output = true;
+	}
+
+	unsigned int addGraphPass(RenderGraph* graph, const char* name, unsigned int fbo, unsigned int width, unsigned int height, std::function<void()> execute) {
+		RenderGraphPass pass;
+		pass.name = name;
+		pass.fbo = fbo;
+		pass.width = width;
+		pass.height = height;
+		pass.clearColor = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+		pass.clearDepth = 1.0f;
+		pass.sideEffects = false;
+		pass.execute = execute;
+		graph->passes.push_back(pass);
+		return (unsigned int)graph->passes.size() - 1;
+	}
+
+	void setPassClearValues(RenderGraph* graph, unsigned int pass, const glm::vec4& color, float depth) {
+		graph->passes[pass].clearColor = color;
+		graph->passes[pass].clearDepth = depth;
+	}
+
+	void setPassSideEffects(RenderGraph* graph, unsigned int pass) {
+		graph->passes[pass].sideEffects = true;
+	}
+
+	void passReads(RenderGraph* graph, unsigned int pass, unsigned int resource) {
+		graph->passes[pass].reads.push_back(resource);
+	}
+
+	void passWrites(RenderGraph* graph, unsigned int pass, unsigned int resource, GraphWrite op) {
+		graph->passes[pass].writes.push_back(resource);
+		graph->passes[pass].writeOps.push_back(op);
+	}
+
+	//Passes kept by walking back from the outputs. A write that doesn't load ends the lifetime of whatever was written
+	//before it, so earlier writers are only kept if something in between reads them
+	static std::vector<bool> cullPasses(RenderGraph* graph) {
+		std::vector<bool> needed(graph->resources.size());
+		for (size_t r = 0; r < graph->resources.size(); r++)
+		{
+			needed[r] = graph->resources[r].persistent || graph->resources[r].output;
+		}
+		std::vector<bool> kept(graph->passes.size(), false);
+		for (size_t p = graph->passes.size(); p-- > 0;)
+		{
+			const RenderGraphPass& pass = graph->passes[p];
+			bool keep = pass.sideEffects;
+			for (size_t w = 0; w < pass.writes.size() && !keep; w++)
+			{
+				keep = needed[pass.writes[w]];
+			}
+			if (!keep) {
+				graph->culledPasses.push_back((unsigned int)p);
+				continue;
+			}
+			kept[p] = true;
+			for (size_t w = 0; w < pass.writes.size(); w++)
+			{
+				needed[pass.writes[w]] = pass.writeOps[w] == GraphWrite::LOAD;
+			}
+			for (size_t r = 0; r < pass.reads.size(); r++)
+			{
+				needed[pass.reads[r]] = true;
+			}
+		}
+		return kept;
+	}
+
+	void compileRenderGraph(RenderGraph* graph) {
+		graph->schedule.clear();
+		graph->culledPasses.clear();
+		graph->numFramebufferBinds = 0;
+		graph->numViewportChanges = 0;
+		unsigned int numPasses = (unsigned int)graph->passes.size();
+		std::vector<bool> kept = cullPasses(graph);
+
+		//Edges from each pass to the later passes that have to wait for it: read after write, write after write and
+		//write after read on the same resource
+		std::vector<std::vector<unsigned int>> dependents(numPasses);
+		std::vector<unsigned int> numDependencies(numPasses, 0);
+		std::vector<int> lastWriter(graph->resources.size(), -1);
+		std::vector<std::vector<unsigned int>> readers(graph->resources.size());
+		auto addEdge = [&](int from, unsigned int to) {
+			if (from < 0 || (unsigned int)from == to)
+				return;
+			dependents[from].push_back(to);
+			numDependencies[to]++;
+		};
+		for (unsigned int p = 0; p < numPasses; p++)
+		{
+			if (!kept[p])
+				continue;
+			const RenderGraphPass& pass = graph->passes[p];
+			for (size_t r = 0; r < pass.reads.size(); r++)
+			{
+				addEdge(lastWriter[pass.reads[r]], p);
+				readers[pass.reads[r]].push_back(p);
+			}
+			for (size_t w = 0; w < pass.writes.size(); w++)
+			{
+				unsigned int resource = pass.writes[w];
+				addEdge(lastWriter[resource], p);
+				for (size_t r = 0; r < readers[resource].size(); r++)
+				{
+					addEdge(readers[resource][r], p);
+				}
+				lastWriter[resource] = p;
+				readers[resource].clear();
+			}
+		}
+
+		//Topological order. Of the passes that are ready, one on the framebuffer already bound (or on none) goes first,
+		//then the earliest declared
+		std::vector<unsigned int> ready;
+		for (unsigned int p = 0; p < numPasses; p++)
+		{
+			if (kept[p] && numDependencies[p] == 0)
+				ready.push_back(p);
+		}
+		unsigned int currentFbo = GRAPH_NO_FRAMEBUFFER;
+		bool fboBound = false;
+		unsigned int viewportWidth = 0, viewportHeight = 0;
+		bool viewportSet = false;
+		while (!ready.empty()) {
+			size_t best = 0;
+			bool bestSameFbo = false;
+			for (size_t i = 0; i < ready.size(); i++)
+			{
+				const RenderGraphPass& pass = graph->passes[ready[i]];
+				bool sameFbo = pass.fbo == GRAPH_NO_FRAMEBUFFER || (fboBound && pass.fbo == currentFbo);
+				if ((sameFbo && !bestSameFbo) || (sameFbo == bestSameFbo && ready[i] < ready[best])) {
+					best = i;
+					bestSameFbo = sameFbo;
+				}
+			}
+			unsigned int p = ready[best];
+			ready.erase(ready.begin() + best);
+			for (size_t d = 0; d < dependents[p].size(); d++)
+			{
+				if (--numDependencies[dependents[p][d]] == 0)
+					ready.push_back(dependents[p][d]);
+			}
+
+			const RenderGraphPass& pass = graph->passes[p];
+			ScheduledPass scheduled;
+			scheduled.pass = p;
+			scheduled.bindFramebuffer = false;
+			scheduled.setViewport = false;
+			scheduled.clearColor = false;
+			scheduled.clearDepth = false;
+			if (pass.fbo != GRAPH_NO_FRAMEBUFFER) {
+				scheduled.bindFramebuffer = !fboBound || pass.fbo != currentFbo;
+				scheduled.setViewport = !viewportSet || pass.width != viewportWidth || pass.height != viewportHeight;
+				currentFbo = pass.fbo;
+				fboBound = true;
+				viewportWidth = pass.width;
+				viewportHeight = pass.height;
+				viewportSet = true;
+				graph->numFramebufferBinds += scheduled.bindFramebuffer ? 1 : 0;
+				graph->numViewportChanges += scheduled.setViewport ? 1 : 0;
+				for (size_t w = 0; w < pass.writes.size(); w++)
+				{
+					if (pass.writeOps[w] != GraphWrite::CLEAR)
+						continue;
+					GraphResourceType type = graph->resources[pass.writes[w]].type;
+					scheduled.clearColor |= type == GraphResourceType::COLOR;
+					scheduled.clearDepth |= type == GraphResourceType::DEPTH;
+				}
+			}
+			graph->schedule.push_back(scheduled);
+		}
+
+		//Attachments nobody needs after their last use
+		std::vector<int> lastUse(graph->resources.size(), -1);
+		for (size_t s = 0; s < graph->schedule.size(); s++)
+		{
+			const RenderGraphPass& pass = graph->passes[graph->schedule[s].pass];
+			for (size_t r = 0; r < pass.reads.size(); r++)
+			{
+				lastUse[pass.reads[r]] = (int)s;
+			}
+			for (size_t w = 0; w < pass.writes.size(); w++)
+			{
+				lastUse[pass.writes[w]] = (int)s;
+			}
+		}
+		for (size_t r = 0; r < graph->resources.size(); r++)
+		{
+			const RenderGraphResource& resource = graph->resources[r];
+			if (lastUse[r] < 0 || resource.persistent || resource.output || resource.type == GraphResourceType::BUFFER)
+				continue;
+			graph->schedule[lastUse[r]].discards.push_back((unsigned int)r);
+		}
+	}
+
+	void executeRenderGraph(const RenderGraph& graph) {
+		for (size_t s = 0; s < graph.schedule.size(); s++)
+		{
+			const ScheduledPass& scheduled = graph.schedule[s];
+			const RenderGraphPass& pass = graph.passes[scheduled.pass];
+			if (pass.fbo != GRAPH_NO_FRAMEBUFFER) {
+				if (scheduled.bindFramebuffer)
+					bindFramebuffer(pass.fbo);
+				if (scheduled.setViewport)
+					setViewport(0, 0, pass.width, pass.height);
+				GLbitfield clearMask = 0;
+				//Clears are masked like any other write, and the previous pass may have left writes off
+				if (scheduled.clearColor) {
+					setColorWrite(true);
+					glClearColor(pass.clearColor.r, pass.clearColor.g, pass.clearColor.b, pass.clearColor.a);
+					clearMask |= GL_COLOR_BUFFER_BIT;
+				}
+				if (scheduled.clearDepth) {
+					setDepthWrite(true);
+					glClearDepth(pass.clearDepth);
+					clearMask |= GL_DEPTH_BUFFER_BIT;
+				}
+				if (clearMask != 0)
+					glClear(clearMask);
+			}
+			if (pass.execute)
+				pass.execute();
+			for (size_t d = 0; d < scheduled.discards.size(); d++)
+			{
+				const RenderGraphResource& resource = graph.resources[scheduled.discards[d]];
+				GLenum attachments[8];
+				GLsizei numAttachments = 0;
+				if (resource.type == GraphResourceType::DEPTH) {
+					//Attachments the framebuffer doesn't have are ignored
+					attachments[numAttachments++] = resource.fbo == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT;
+					attachments[numAttachments++] = resource.fbo == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT;
+				}
+				else if (resource.fbo == 0) {
+					attachments[numAttachments++] = GL_COLOR;
+				}
+				else {
+					for (unsigned int c = 0; c < resource.numColors && c < 8; c++)
+					{
+						attachments[numAttachments++] = GL_COLOR_ATTACHMENT0 + c;
+					}
+				}
+				glInvalidateNamedFramebufferData(resource.fbo, numAttachments, attachments);
+			}
+		}
+	}
+
+	void resetRenderGraph(RenderGraph* graph) {
+		graph->resources.clear();
+		graph->passes.clear();
+		graph->schedule.clear();
+		graph->culledPasses.clear();
+		graph->numFramebufferBinds = 0;
+		graph->numViewportChanges = 0;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <functional>
+#include <glm/glm.hpp>
+
+namespace ns {
+	//Framebuffer value for passes that don't draw (compute, uploads). No framebuffer or viewport is set for them
+	const unsigned int GRAPH_NO_FRAMEBUFFER = 0xFFFFFFFFu;
+
+	enum class GraphResourceType {
+		COLOR = 0, //Every color attachment of a framebuffer
+		DEPTH = 1, //Depth (and stencil) attachment of a framebuffer
+		BUFFER = 2 //Anything else passes hand to each other, never cleared or discarded
+	};
+
+	//What passes read and write. Color and depth attachments of one framebuffer are separate resources
+	struct RenderGraphResource {
+		std::string name;
+		GraphResourceType type;
+		unsigned int fbo; //Framebuffer the attachment belongs to, 0 for the window
+		unsigned int numColors; //COLOR only, attachments 0 to numColors - 1
+		bool persistent; //Contents are read next frame, so they are never discarded and their last writer is never culled
+		bool output; //Read once the graph has run, e.g. the window. Same as persistent for scheduling
+	};
+
+	//How a pass treats a resource it writes, the load op
+	enum class GraphWrite {
+		CLEAR = 0, //Old contents are not needed and the pass doesn't cover every pixel
+		OVERWRITE = 1, //Every pixel is written, no clear needed
+		LOAD = 2 //Drawn on top of the old contents, which makes the write a read as well
+	};
+
+	struct RenderGraphPass {
+		std::string name;
+		unsigned int fbo; //0 for the window, GRAPH_NO_FRAMEBUFFER for none
+		unsigned int width, height; //Viewport
+		glm::vec4 clearColor;
+		float clearDepth;
+		std::vector<unsigned int> reads;
+		std::vector<unsigned int> writes;
+		std::vector<GraphWrite> writeOps; //One per write
+		bool sideEffects; //Never culled, for passes whose results the graph can't see (timers, readbacks)
+		//Issues the pass. Must leave fbo bound if it binds another framebuffer, since the graph only binds on changes
+		std::function<void()> execute;
+	};
+
+	//What compileRenderGraph decided for one pass that survived culling
+	struct ScheduledPass {
+		unsigned int pass;
+		bool bindFramebuffer; //Framebuffer differs from the previous drawing pass
+		bool setViewport; //Viewport differs from the previous drawing pass
+		bool clearColor;
+		bool clearDepth;
+		std::vector<unsigned int> discards; //Attachments that are dead after this pass, invalidated so tilers can skip the store
+	};
+
+	//Passes are declared in the order they would be written by hand, and a pass depends on the earlier passes touching the
+	//same resources, so declaration order is always a valid order. Compiling culls passes whose results nothing uses, reorders
+	//the rest within their dependencies to keep passes on the same framebuffer together, and decides every bind, clear and
+	//discard. Compiling makes no GL calls, so schedules can be built and checked without a context
+	struct RenderGraph {
+		std::vector<RenderGraphResource> resources;
+		std::vector<RenderGraphPass> passes;
+		//Filled by compileRenderGraph
+		std::vector<ScheduledPass> schedule;
+		std::vector<unsigned int> culledPasses;
+		unsigned int numFramebufferBinds = 0;
+		unsigned int numViewportChanges = 0;
+	};
+
+	unsigned int addGraphResource(RenderGraph* graph, const char* name, GraphResourceType type, unsigned int fbo = 0, unsigned int numColors = 1);
+	void setGraphResourcePersistent(RenderGraph* graph, unsigned int resource);
+	void setGraphOutput(RenderGraph* graph, unsigned int resource);
+	unsigned int addGraphPass(RenderGraph* graph, const char* name, unsigned int fbo, unsigned int width, unsigned int height, std::function<void()> execute);
+	void setPassClearValues(RenderGraph* graph, unsigned int pass, const glm::vec4& color, float depth = 1.0f);
+	void setPassSideEffects(RenderGraph* graph, unsigned int pass);
+	void passReads(RenderGraph* graph, unsigned int pass, unsigned int resource);
+	void passWrites(RenderGraph* graph, unsigned int pass, unsigned int resource, GraphWrite op = GraphWrite::CLEAR);
+
+	//Culls, orders and decides state changes. No GL calls
+	void compileRenderGraph(RenderGraph* graph);
+	//Runs a compiled graph
+	void executeRenderGraph(const RenderGraph& graph);
+	//Removes every pass and resource so the graph can be declared again next frame
+	void resetRenderGraph(RenderGraph* graph);
+}
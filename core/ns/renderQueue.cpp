@@ -0,0 +1,140 @@
+#include "renderQueue.h"
+#include "glState.h"
+#include <string.h>
+
+namespace ns {
+	static uint64_t keyField(unsigned int value, unsigned int bits) {
+		return (uint64_t)value & ((1ull << bits) - 1);
+	}
+
+	uint64_t makeSortKey(unsigned int pass, bool transparent, unsigned int shader, unsigned int material, unsigned int mesh, float depth) {
+		const uint64_t maxDepth = (1ull << SORT_KEY_DEPTH_BITS) - 1;
+		uint64_t quantizedDepth = (uint64_t)(glm::clamp(depth, 0.0f, 1.0f) * (float)maxDepth);
+		uint64_t key = keyField(pass, SORT_KEY_PASS_BITS);
+		key = (key << 1) | (transparent ? 1 : 0);
+		if (transparent) {
+			//Farthest first, state only breaks ties
+			key = (key << SORT_KEY_DEPTH_BITS) | (maxDepth - quantizedDepth);
+			key = (key << SORT_KEY_SHADER_BITS) | keyField(shader, SORT_KEY_SHADER_BITS);
+			key = (key << SORT_KEY_MATERIAL_BITS) | keyField(material, SORT_KEY_MATERIAL_BITS);
+			key = (key << SORT_KEY_MESH_BITS) | keyField(mesh, SORT_KEY_MESH_BITS);
+		}
+		else {
+			key = (key << SORT_KEY_SHADER_BITS) | keyField(shader, SORT_KEY_SHADER_BITS);
+			key = (key << SORT_KEY_MATERIAL_BITS) | keyField(material, SORT_KEY_MATERIAL_BITS);
+			key = (key << SORT_KEY_MESH_BITS) | keyField(mesh, SORT_KEY_MESH_BITS);
+			key = (key << SORT_KEY_DEPTH_BITS) | quantizedDepth;
+		}
+		return key;
+	}
+
+	RenderQueue createRenderQueue(unsigned int numThreads) {
+		RenderQueue queue;
+		queue.buckets.resize(numThreads > 0 ? numThreads : 1);
+		return queue;
+	}
+
+	void clearRenderQueue(RenderQueue* queue) {
+		for (size_t i = 0; i < queue->buckets.size(); i++)
+		{
+			queue->buckets[i].keys.clear();
+			queue->buckets[i].items.clear();
+		}
+		queue->keys.clear();
+		queue->order.clear();
+		queue->items.clear();
+	}
+
+	void submitDraw(RenderQueue* queue, unsigned int threadIndex, uint64_t key, const DrawItem& item) {
+		RenderQueueBucket& bucket = queue->buckets[threadIndex];
+		bucket.keys.push_back(key);
+		bucket.items.push_back(item);
+	}
+
+	void sortRenderQueue(RenderQueue* queue) {
+		size_t count = 0;
+		for (size_t i = 0; i < queue->buckets.size(); i++)
+		{
+			count += queue->buckets[i].keys.size();
+		}
+		queue->keys.resize(count);
+		queue->order.resize(count);
+		queue->items.resize(count);
+		size_t offset = 0;
+		for (size_t i = 0; i < queue->buckets.size(); i++)
+		{
+			const RenderQueueBucket& bucket = queue->buckets[i];
+			for (size_t j = 0; j < bucket.keys.size(); j++)
+			{
+				queue->keys[offset + j] = bucket.keys[j];
+				queue->order[offset + j] = (unsigned int)(offset + j);
+				queue->items[offset + j] = bucket.items[j];
+			}
+			offset += bucket.keys.size();
+		}
+
+		//LSD radix sort on bytes, stable so ties keep submission order.
+		//Bytes every key shares, e.g. the pass and shader of a single pass, are skipped
+		queue->scratchKeys.resize(count);
+		queue->scratchOrder.resize(count);
+		uint64_t* keys = queue->keys.data();
+		unsigned int* order = queue->order.data();
+		uint64_t* tempKeys = queue->scratchKeys.data();
+		unsigned int* tempOrder = queue->scratchOrder.data();
+		for (unsigned int shift = 0; shift < 64 && count > 1; shift += 8)
+		{
+			size_t histogram[256];
+			memset(histogram, 0, sizeof(histogram));
+			for (size_t i = 0; i < count; i++)
+			{
+				histogram[(keys[i] >> shift) & 0xFF]++;
+			}
+			if (histogram[(keys[0] >> shift) & 0xFF] == count) {
+				continue;
+			}
+			size_t sum = 0;
+			for (unsigned int b = 0; b < 256; b++)
+			{
+				size_t n = histogram[b];
+				histogram[b] = sum;
+				sum += n;
+			}
+			for (size_t i = 0; i < count; i++)
+			{
+				size_t destination = histogram[(keys[i] >> shift) & 0xFF]++;
+				tempKeys[destination] = keys[i];
+				tempOrder[destination] = order[i];
+			}
+			uint64_t* swapKeys = keys;
+			keys = tempKeys;
+			tempKeys = swapKeys;
+			unsigned int* swapOrder = order;
+			order = tempOrder;
+			tempOrder = swapOrder;
+		}
+		//An odd number of passes leaves the result in the scratch arrays
+		if (keys != queue->keys.data()) {
+			queue->keys.swap(queue->scratchKeys);
+			queue->order.swap(queue->scratchOrder);
+		}
+	}
+
+	void executeRenderQueue(const RenderQueue& queue) {
+		const ew::Shader* shader = nullptr;
+		ew::UniformHandle modelUniform;
+		for (size_t i = 0; i < queue.order.size(); i++)
+		{
+			const DrawItem& item = queue.items[queue.order[i]];
+			if (item.shader != shader) {
+				shader = item.shader;
+				shader->use();
+				modelUniform = shader->uniform("_Model");
+			}
+			if (item.texture != 0) {
+				bindTextureUnit(0, item.texture);
+			}
+			shader->setMat4(modelUniform, item.model);
+			item.mesh->drawLOD(item.lod);
+		}
+	}
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+#include "../ew/mesh.h"
+#include "../ew/shader.h"
+
+namespace ns {
+	//Sort key fields, most significant first. Opaque keys are pass | 0 | shader | material | mesh | depth,
+	//transparent keys are pass | 1 | inverted depth | shader | material | mesh. So opaque draws are grouped by state
+	//and front to back within a group, and transparent draws come after them, back to front
+	const unsigned int SORT_KEY_PASS_BITS = 4;
+	const unsigned int SORT_KEY_SHADER_BITS = 11;
+	const unsigned int SORT_KEY_MATERIAL_BITS = 12;
+	const unsigned int SORT_KEY_MESH_BITS = 16;
+	const unsigned int SORT_KEY_DEPTH_BITS = 20;
+	//Ids are masked to their field width. depth is 0 at the camera and 1 at the far plane, and is clamped
+	uint64_t makeSortKey(unsigned int pass, bool transparent, unsigned int shader, unsigned int material, unsigned int mesh, float depth);
+
+	struct DrawItem {
+		const ew::Shader* shader; //_Model is set per item, everything else has to be set before executing
+		const ew::Mesh* mesh;
+		unsigned int lod;
+		unsigned int texture; //Bound to unit 0, 0 leaves the unit alone
+		glm::mat4 model;
+	};
+
+	//Draws submitted by one thread, padded so threads don't share cache lines.
+	//Padded to two lines rather than aligned: over-aligned types in a std::vector need C++17. At least a full line
+	//of padding sits between the vectors of neighbouring buckets wherever the array starts
+	const size_t RENDER_QUEUE_BUCKET_SIZE = 128;
+	struct RenderQueueBucket {
+		std::vector<uint64_t> keys;
+		std::vector<DrawItem> items;
+		char padding[RENDER_QUEUE_BUCKET_SIZE - sizeof(std::vector<uint64_t>) - sizeof(std::vector<DrawItem>)];
+	};
+
+	struct RenderQueue {
+		std::vector<RenderQueueBucket> buckets; //One per thread filling the queue
+		std::vector<uint64_t> keys; //Merged from the buckets, sorted by sortRenderQueue
+		std::vector<unsigned int> order; //Index into items of each sorted key
+		std::vector<DrawItem> items;
+		std::vector<uint64_t> scratchKeys;
+		std::vector<unsigned int> scratchOrder;
+	};
+	//numThreads is usually JobSystem::getNumThreads
+	RenderQueue createRenderQueue(unsigned int numThreads);
+	void clearRenderQueue(RenderQueue* queue);
+	//Threads may submit at the same time as long as each uses its own threadIndex
+	void submitDraw(RenderQueue* queue, unsigned int threadIndex, uint64_t key, const DrawItem& item);
+	//Merges the buckets in thread order and radix sorts the keys, equal keys keep their submission order
+	void sortRenderQueue(RenderQueue* queue);
+	//Draws in sorted order, only switching shader and texture when they change
+	void executeRenderQueue(const RenderQueue& queue);
+}
@@ -0,0 +1,226 @@
+#include "renderTargetPool.h"
+#include "glState.h"
+#include "../ew/external/glad.h"
+#include <stdio.h>
+
+namespace ns {
+	static bool isDepthFormat(int format) {
+		return format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8 || format == GL_DEPTH_COMPONENT16
+			|| format == GL_DEPTH_COMPONENT24 || format == GL_DEPTH_COMPONENT32F;
+	}
+
+	size_t getRenderTargetMemory(const RenderTargetDesc& desc) {
+		size_t bytesPerPixel;
+		switch (desc.format) {
+		case GL_RGBA32F: bytesPerPixel = 16; break;
+		case GL_RGB32F: bytesPerPixel = 12; break;
+		case GL_RGBA16F: case GL_RGBA16: bytesPerPixel = 8; break;
+		case GL_RGB16F: case GL_RGB16: bytesPerPixel = 6; break;
+		case GL_DEPTH32F_STENCIL8: bytesPerPixel = 5; break;
+		case GL_RGB8: bytesPerPixel = 3; break;
+		case GL_DEPTH_COMPONENT16: case GL_RG8: case GL_R16F: case GL_R16: bytesPerPixel = 2; break;
+		case GL_R8: bytesPerPixel = 1; break;
+		default: bytesPerPixel = 4; break; //RGBA8, RG16, RG16F, R32F, RGB10_A2, R11F_G11F_B10F, 24 and 32 bit depth
+		}
+		return (size_t)desc.width * desc.height * bytesPerPixel;
+	}
+
+	unsigned int acquireRenderTarget(RenderTargetPool* pool, unsigned int width, unsigned int height, int format, bool linearFilter) {
+		for (size_t i = 0; i < pool->targets.size(); i++)
+		{
+			PooledRenderTarget& target = pool->targets[i];
+			if (target.inUse || target.desc.width != width || target.desc.height != height
+				|| target.desc.format != format || target.desc.linearFilter != linearFilter) {
+				continue;
+			}
+			target.inUse = true;
+			target.lastUsedFrame = pool->frame;
+			pool->memoryInUse += getRenderTargetMemory(target.desc);
+			pool->currentFramePeak = pool->memoryInUse > pool->currentFramePeak ? pool->memoryInUse : pool->currentFramePeak;
+			return target.texture;
+		}
+
+		PooledRenderTarget target;
+		target.desc.width = width;
+		target.desc.height = height;
+		target.desc.format = format;
+		target.desc.linearFilter = linearFilter;
+		target.inUse = true;
+		target.lastUsedFrame = pool->frame;
+		glCreateTextures(GL_TEXTURE_2D, 1, &target.texture);
+		glTextureStorage2D(target.texture, 1, format, width, height);
+		int filter = linearFilter ? GL_LINEAR : GL_NEAREST;
+		glTextureParameteri(target.texture, GL_TEXTURE_MIN_FILTER, filter);
+		glTextureParameteri(target.texture, GL_TEXTURE_MAG_FILTER, filter);
+		//Full-screen passes sample right up to the edges
+		glTextureParameteri(target.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTextureParameteri(target.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		pool->targets.push_back(target);
+
+		size_t bytes = getRenderTargetMemory(target.desc);
+		pool->memory += bytes;
+		pool->peakMemory = pool->memory > pool->peakMemory ? pool->memory : pool->peakMemory;
+		pool->memoryInUse += bytes;
+		pool->currentFramePeak = pool->memoryInUse > pool->currentFramePeak ? pool->memoryInUse : pool->currentFramePeak;
+		pool->numCreated++;
+		return target.texture;
+	}
+
+	void releaseRenderTarget(RenderTargetPool* pool, unsigned int texture) {
+		for (size_t i = 0; i < pool->targets.size(); i++)
+		{
+			PooledRenderTarget& target = pool->targets[i];
+			if (target.texture != texture || !target.inUse) {
+				continue;
+			}
+			target.inUse = false;
+			pool->memoryInUse -= getRenderTargetMemory(target.desc);
+			return;
+		}
+	}
+
+	static const PooledRenderTarget* findTarget(const RenderTargetPool& pool, unsigned int texture) {
+		for (size_t i = 0; i < pool.targets.size(); i++)
+		{
+			if (pool.targets[i].texture == texture) {
+				return &pool.targets[i];
+			}
+		}
+		return nullptr;
+	}
+
+	unsigned int getPooledFramebuffer(RenderTargetPool* pool, const unsigned int* colors, unsigned int numColors, unsigned int depth) {
+		for (size_t i = 0; i < pool->framebuffers.size(); i++)
+		{
+			PooledFramebuffer& framebuffer = pool->framebuffers[i];
+			if (framebuffer.numColors != numColors || framebuffer.depth != depth) {
+				continue;
+			}
+			bool match = true;
+			for (unsigned int c = 0; c < numColors && match; c++)
+			{
+				match = framebuffer.colors[c] == colors[c];
+			}
+			if (match) {
+				framebuffer.lastUsedFrame = pool->frame;
+				return framebuffer.fbo;
+			}
+		}
+
+		PooledFramebuffer framebuffer;
+		framebuffer.numColors = numColors;
+		framebuffer.depth = depth;
+		framebuffer.lastUsedFrame = pool->frame;
+		glCreateFramebuffers(1, &framebuffer.fbo);
+		GLenum drawBuffers[8];
+		for (unsigned int c = 0; c < numColors; c++)
+		{
+			framebuffer.colors[c] = colors[c];
+			glNamedFramebufferTexture(framebuffer.fbo, GL_COLOR_ATTACHMENT0 + c, colors[c], 0);
+			drawBuffers[c] = GL_COLOR_ATTACHMENT0 + c;
+		}
+		if (numColors > 0) {
+			glNamedFramebufferDrawBuffers(framebuffer.fbo, numColors, drawBuffers);
+		}
+		else {
+			glNamedFramebufferDrawBuffer(framebuffer.fbo, GL_NONE);
+			glNamedFramebufferReadBuffer(framebuffer.fbo, GL_NONE);
+		}
+		if (depth != 0) {
+			const PooledRenderTarget* target = findTarget(*pool, depth);
+			bool stencil = target != nullptr && (target->desc.format == GL_DEPTH24_STENCIL8 || target->desc.format == GL_DEPTH32F_STENCIL8);
+			glNamedFramebufferTexture(framebuffer.fbo, stencil ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, depth, 0);
+		}
+		if (glCheckNamedFramebufferStatus(framebuffer.fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+			printf("ERROR::FRAMEBUFFER:: Pooled framebuffer is not complete!");
+		pool->framebuffers.push_back(framebuffer);
+		return framebuffer.fbo;
+	}
+
+	void updateRenderTargetPool(RenderTargetPool* pool) {
+		pool->framePeakMemory = pool->currentFramePeak;
+		pool->currentFramePeak = pool->memoryInUse;
+		pool->frame++;
+
+		//Targets first, so framebuffers still attached to a freed target can be found below
+		std::vector<unsigned int> freed;
+		for (size_t i = 0; i < pool->targets.size();)
+		{
+			PooledRenderTarget& target = pool->targets[i];
+			if (target.inUse || pool->frame - target.lastUsedFrame <= pool->maxUnusedFrames) {
+				i++;
+				continue;
+			}
+			freed.push_back(target.texture);
+			pool->memory -= getRenderTargetMemory(target.desc);
+			releaseTextureBindings(&target.texture, 1);
+			glDeleteTextures(1, &target.texture);
+			pool->targets[i] = pool->targets.back();
+			pool->targets.pop_back();
+		}
+		for (size_t i = 0; i < pool->framebuffers.size();)
+		{
+			PooledFramebuffer& framebuffer = pool->framebuffers[i];
+			bool stale = pool->frame - framebuffer.lastUsedFrame > pool->maxUnusedFrames;
+			for (size_t f = 0; f < freed.size() && !stale; f++)
+			{
+				stale = framebuffer.depth == freed[f];
+				for (unsigned int c = 0; c < framebuffer.numColors && !stale; c++)
+				{
+					stale = framebuffer.colors[c] == freed[f];
+				}
+			}
+			if (!stale) {
+				i++;
+				continue;
+			}
+			releaseFramebufferBinding(framebuffer.fbo);
+			glDeleteFramebuffers(1, &framebuffer.fbo);
+			pool->framebuffers[i] = pool->framebuffers.back();
+			pool->framebuffers.pop_back();
+		}
+	}
+
+	Framebuffer acquireGBuffer(RenderTargetPool* pool, unsigned int width, unsigned int height, bool packed) {
+		//Same attachments as createGBuffer and createPackedGBuffer
+		int fullFormats[3] = { GL_RGB32F, GL_RGB16F, GL_RGB16F };
+		int packedFormats[3] = { GL_RGBA8, GL_RG16, GL_RGBA8 };
+		const int* formats = packed ? packedFormats : fullFormats;
+		Framebuffer gBuffer;
+		gBuffer.width = width;
+		gBuffer.height = height;
+		gBuffer.numColorBuffers = 3;
+		gBuffer.depthTexture = true;
+		for (unsigned int i = 0; i < 3; i++)
+		{
+			gBuffer.colorBuffer[i] = acquireRenderTarget(pool, width, height, formats[i]);
+		}
+		gBuffer.depthBuffer = acquireRenderTarget(pool, width, height, GL_DEPTH24_STENCIL8);
+		gBuffer.fbo = getPooledFramebuffer(pool, gBuffer.colorBuffer, 3, gBuffer.depthBuffer);
+		return gBuffer;
+	}
+
+	Framebuffer acquireFramebuffer(RenderTargetPool* pool, unsigned int width, unsigned int height, int colorFormat, bool depth) {
+		Framebuffer framebuffer;
+		framebuffer.width = width;
+		framebuffer.height = height;
+		framebuffer.numColorBuffers = 1;
+		framebuffer.depthTexture = true;
+		framebuffer.colorBuffer[0] = acquireRenderTarget(pool, width, height, colorFormat, true);
+		framebuffer.depthBuffer = depth ? acquireRenderTarget(pool, width, height, GL_DEPTH24_STENCIL8) : 0;
+		framebuffer.fbo = getPooledFramebuffer(pool, framebuffer.colorBuffer, 1, framebuffer.depthBuffer);
+		return framebuffer;
+	}
+
+	void releaseFramebuffer(RenderTargetPool* pool, Framebuffer* framebuffer) {
+		for (unsigned int i = 0; i < framebuffer->numColorBuffers; i++)
+		{
+			releaseRenderTarget(pool, framebuffer->colorBuffer[i]);
+		}
+		if (framebuffer->depthBuffer != 0) {
+			releaseRenderTarget(pool, framebuffer->depthBuffer);
+		}
+		framebuffer->numColorBuffers = 0;
+		framebuffer->depthBuffer = 0;
+	}
+}
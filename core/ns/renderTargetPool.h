@@ -0,0 +1,62 @@
+#pragma once
+#include <vector>
+#include <stddef.h>
+#include "framebuffer.h"
+
+namespace ns {
+	//What a pooled texture is, targets are only handed out for an exact match
+	struct RenderTargetDesc {
+		unsigned int width;
+		unsigned int height;
+		int format; //Sized internal format. Depth formats are attached as depth, everything else as color
+		bool linearFilter; //Sampled with GL_LINEAR, otherwise GL_NEAREST
+	};
+	struct PooledRenderTarget {
+		RenderTargetDesc desc;
+		unsigned int texture;
+		bool inUse;
+		unsigned int lastUsedFrame;
+	};
+	struct PooledFramebuffer {
+		unsigned int fbo;
+		unsigned int colors[8];
+		unsigned int numColors;
+		unsigned int depth; //0 for none
+		unsigned int lastUsedFrame;
+	};
+
+	//Transient render targets shared between passes. A pass acquires the textures it writes and releases them once the last
+	//pass reading them is done, and a later pass asking for the same size, format and filter gets the same memory back.
+	//Memory is only shared by targets whose lifetimes don't overlap, so a pipeline where every target is live at the peak
+	//saves nothing over fixed targets. Nothing is ever resized: after a window resize the old size is simply no longer asked
+	//for and gets freed a few frames later
+	struct RenderTargetPool {
+		std::vector<PooledRenderTarget> targets;
+		std::vector<PooledFramebuffer> framebuffers; //Cached by attachments
+		unsigned int frame = 0;
+		unsigned int maxUnusedFrames = 3; //Frames a free target is kept before its memory is returned
+		size_t memory = 0; //Bytes of every texture the pool owns
+		size_t memoryInUse = 0; //Bytes currently acquired
+		size_t framePeakMemory = 0; //Most bytes acquired at once during the last complete frame
+		size_t peakMemory = 0; //Most bytes the pool ever owned
+		unsigned int numCreated = 0; //Textures created since the pool was made
+		size_t currentFramePeak = 0;
+	};
+	//Bytes of one texture, estimated from its format
+	size_t getRenderTargetMemory(const RenderTargetDesc& desc);
+	//A free texture matching the description, created if there is none
+	unsigned int acquireRenderTarget(RenderTargetPool* pool, unsigned int width, unsigned int height, int format, bool linearFilter = false);
+	//Its contents stay untouched until another pass acquires it
+	void releaseRenderTarget(RenderTargetPool* pool, unsigned int texture);
+	//FBO with these pooled textures attached, in order, created the first time the combination is asked for. depth may be 0
+	unsigned int getPooledFramebuffer(RenderTargetPool* pool, const unsigned int* colors, unsigned int numColors, unsigned int depth);
+	//Call once per frame, after the last release. Frees targets and framebuffers unused for maxUnusedFrames
+	void updateRenderTargetPool(RenderTargetPool* pool);
+
+	//createGBuffer/createPackedGBuffer, with every attachment from the pool
+	Framebuffer acquireGBuffer(RenderTargetPool* pool, unsigned int width, unsigned int height, bool packed);
+	//Color target with an optional DEPTH24_STENCIL8 depth, like createFramebuffer
+	Framebuffer acquireFramebuffer(RenderTargetPool* pool, unsigned int width, unsigned int height, int colorFormat, bool depth);
+	//Releases every attachment of an acquired framebuffer
+	void releaseFramebuffer(RenderTargetPool* pool, Framebuffer* framebuffer);
+}
@@ -1,4 +1,5 @@
 #include "shadowMap.h"
+#include "glState.h"
 #include "../ew/external/glad.h"
 #include <stdio.h>
 
@@ -9,10 +10,10 @@ namespace ns {
 		shadowMap.height = height;
 
 		glCreateFramebuffers(1, &shadowMap.fbo);
-		glBindFramebuffer(GL_FRAMEBUFFER, shadowMap.fbo);
+		bindFramebuffer(shadowMap.fbo);
 		//Create and bind depth map (depth texture)
 		glGenTextures(1, &shadowMap.depthMap);
-		glBindTexture(GL_TEXTURE_2D, shadowMap.depthMap);
+		bindTexture(GL_TEXTURE_2D, shadowMap.depthMap);
 		//16 bit depth values, 2k resolution
 		glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT16, width, height);
 
@@ -32,7 +33,7 @@ namespace ns {
 
 		if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 			printf("ERROR::FRAMEBUFFER:: Shadow Map Framebuffer is not complete!");
-		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		bindFramebuffer(0);
 
 		return shadowMap;
 	}
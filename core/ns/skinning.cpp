@@ -0,0 +1,113 @@
+#include "skinning.h"
+#include "../ew/external/glad.h"
+#include <math.h>
+
+namespace ns {
+	//Characters per parallelFor batch
+	static const unsigned int PALETTE_MIN_BATCH = 64;
+
+	unsigned int addSkinJoint(Skin* skin, unsigned int joint, const glm::mat4& inverseBindMatrix) {
+		for (size_t i = 0; i < skin->joints.size(); i++)
+		{
+			if (skin->joints[i] == joint) {
+				return (unsigned int)i;
+			}
+		}
+		skin->joints.push_back(joint);
+		skin->inverseBindMatrices.push_back(inverseBindMatrix);
+		return (unsigned int)skin->joints.size() - 1;
+	}
+
+	void addVertexJoint(unsigned int joint, float weight, unsigned int joints[4], float weights[4]) {
+		int lightest = 0;
+		for (int i = 1; i < 4; i++)
+		{
+			if (weights[i] < weights[lightest]) {
+				lightest = i;
+			}
+		}
+		if (weight > weights[lightest]) {
+			joints[lightest] = joint;
+			weights[lightest] = weight;
+		}
+	}
+
+	ew::VertexSkin packVertexSkin(const unsigned int joints[4], const float weights[4]) {
+		ew::VertexSkin skin;
+		float total = weights[0] + weights[1] + weights[2] + weights[3];
+		if (total <= 0.0f) {
+			//Unweighted vertices follow the first palette entry
+			skin.joints[0] = 0;
+			skin.weights[0] = 65535;
+			for (int i = 1; i < 4; i++)
+			{
+				skin.joints[i] = 0;
+				skin.weights[i] = 0;
+			}
+			return skin;
+		}
+		int heaviest = 0;
+		unsigned int sum = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			skin.joints[i] = (uint16_t)joints[i];
+			skin.weights[i] = (uint16_t)roundf(weights[i] / total * 65535.0f);
+			sum += skin.weights[i];
+			if (weights[i] > weights[heaviest]) {
+				heaviest = i;
+			}
+		}
+		//Rounding error goes to the heaviest joint so the weights add up exactly
+		skin.weights[heaviest] = (uint16_t)((int)skin.weights[heaviest] + 65535 - (int)sum);
+		return skin;
+	}
+
+	void computeJointPalette(const Skin& skin, const glm::mat4* globalTransforms, glm::mat4* palette) {
+		for (size_t i = 0; i < skin.joints.size(); i++)
+		{
+			palette[i] = globalTransforms[skin.joints[i]] * skin.inverseBindMatrices[i];
+		}
+	}
+
+	void computeJointPalettes(const Skin& skin, const FKHierarchy& fk, unsigned int numCharacters, unsigned int jointsPerCharacter, glm::mat4* palettes, JobSystem* jobSystem) {
+		size_t paletteSize = skin.joints.size();
+		auto compute = [&skin, &fk, jointsPerCharacter, palettes, paletteSize](unsigned int begin, unsigned int end, unsigned int threadIndex) {
+			for (unsigned int c = begin; c < end; c++)
+			{
+				glm::mat4* palette = palettes + c * paletteSize;
+				for (size_t i = 0; i < paletteSize; i++)
+				{
+					palette[i] = getFKGlobalTransform(fk, c * jointsPerCharacter + skin.joints[i]) * skin.inverseBindMatrices[i];
+				}
+			}
+		};
+		if (jobSystem == nullptr || numCharacters < PALETTE_MIN_BATCH * 2) {
+			compute(0, numCharacters, 0);
+			return;
+		}
+		jobSystem->parallelFor(numCharacters, PALETTE_MIN_BATCH, compute);
+	}
+
+	JointPaletteBuffer createJointPaletteBuffer(unsigned int capacity, unsigned int frameCount) {
+		JointPaletteBuffer paletteBuffer;
+		paletteBuffer.capacity = capacity;
+		paletteBuffer.matrixCount = 0;
+		paletteBuffer.ring = createPersistentRing(capacity * sizeof(glm::mat4), frameCount);
+		return paletteBuffer;
+	}
+
+	glm::mat4* beginJointPalettes(JointPaletteBuffer* paletteBuffer, unsigned int count) {
+		glm::mat4* palettes = (glm::mat4*)beginPersistentRegion(&paletteBuffer->ring);
+		paletteBuffer->matrixCount = count > paletteBuffer->capacity ? paletteBuffer->capacity : count;
+		return palettes;
+	}
+
+	void bindJointPalettes(const JointPaletteBuffer& paletteBuffer, unsigned int binding) {
+		GLsizeiptr size = sizeof(glm::mat4) * (paletteBuffer.matrixCount > 0 ? paletteBuffer.matrixCount : 1);
+		glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, paletteBuffer.ring.buffer, getPersistentRegionOffset(paletteBuffer.ring), size);
+	}
+
+	void fenceJointPalettes(JointPaletteBuffer* paletteBuffer) {
+		fencePersistentRegion(&paletteBuffer->ring);
+	}
+}
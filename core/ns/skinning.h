@@ -0,0 +1,47 @@
+#pragma once
+#include <vector>
+#include <glm/glm.hpp>
+#include "../ew/mesh.h"
+#include "fkSolver.h"
+#include "jobSystem.h"
+#include "persistentRing.h"
+
+namespace ns {
+	//Joints of a skeleton that deform a mesh. Palette entry i follows skeleton joint joints[i],
+	//and inverseBindMatrices[i] takes mesh space into that joint's space in the bind pose
+	struct Skin {
+		std::vector<unsigned int> joints;
+		std::vector<glm::mat4> inverseBindMatrices;
+	};
+	//Index of the skeleton joint in the skin's palette, added with the given inverse bind matrix if it isn't there yet
+	unsigned int addSkinJoint(Skin* skin, unsigned int joint, const glm::mat4& inverseBindMatrix);
+	//Adds a joint to a vertex, keeping the 4 heaviest. weights are the unnormalized float weights added so far
+	void addVertexJoint(unsigned int joint, float weight, unsigned int joints[4], float weights[4]);
+	//Normalizes the weights and quantizes them to unorm16 adding up to exactly 65535
+	ew::VertexSkin packVertexSkin(const unsigned int joints[4], const float weights[4]);
+
+	//Skinning matrices (global * inverse bind) of one character, one per palette entry
+	void computeJointPalette(const Skin& skin, const glm::mat4* globalTransforms, glm::mat4* palette);
+	//Palettes of numCharacters characters solved together in fk, character c owning joints [c * jointsPerCharacter, (c + 1) * jointsPerCharacter).
+	//Character c's palette is written at palettes + c * skin.joints.size(). jobSystem may be null
+	void computeJointPalettes(const Skin& skin, const FKHierarchy& fk, unsigned int numCharacters, unsigned int jointsPerCharacter, glm::mat4* palettes, JobSystem* jobSystem);
+
+	const unsigned int MAX_JOINT_PALETTE_FRAMES = MAX_PERSISTENT_RING_FRAMES;
+
+	//Joint palettes of every skinned character in one persistently mapped shader storage buffer, read by the vertex shader
+	//as mat4 _Joints[]. Like LightBuffer, the ring has one region per frame in flight so the CPU never writes
+	//matrices the GPU is still reading
+	struct JointPaletteBuffer {
+		PersistentRing ring;
+		unsigned int capacity; //Max matrices per frame
+		unsigned int matrixCount; //Matrices written by the last begin
+	};
+	JointPaletteBuffer createJointPaletteBuffer(unsigned int capacity, unsigned int frameCount = MAX_JOINT_PALETTE_FRAMES);
+	//Moves to the next region and waits until the GPU has released it. Returns where to write count matrices,
+	//count is clamped to the capacity
+	glm::mat4* beginJointPalettes(JointPaletteBuffer* paletteBuffer, unsigned int count);
+	//Binds the region written by the last begin to an SSBO binding point
+	void bindJointPalettes(const JointPaletteBuffer& paletteBuffer, unsigned int binding);
+	//Call after issuing the draws that read the current region
+	void fenceJointPalettes(JointPaletteBuffer* paletteBuffer);
+}
@@ -0,0 +1,145 @@
+//Compiles a deferred style render graph without a GL context and checks the schedule: culling, order, clears and discards
+#include <stdio.h>
+#include <vector>
+#include <algorithm>
+#include <ns/renderGraph.h>
+
+static int numFailures = 0;
+
+static void check(bool condition, const char* what) {
+	if (!condition) {
+		printf("FAILED: %s\n", what);
+		numFailures++;
+	}
+}
+
+//Position of a pass in the schedule, -1 if it was culled
+static int schedulePosition(const ns::RenderGraph& graph, unsigned int pass) {
+	for (size_t s = 0; s < graph.schedule.size(); s++)
+	{
+		if (graph.schedule[s].pass == pass)
+			return (int)s;
+	}
+	return -1;
+}
+
+static const ns::ScheduledPass& scheduled(const ns::RenderGraph& graph, unsigned int pass) {
+	return graph.schedule[schedulePosition(graph, pass)];
+}
+
+static bool discards(const ns::RenderGraph& graph, unsigned int pass, unsigned int resource) {
+	const std::vector<unsigned int>& list = scheduled(graph, pass).discards;
+	return std::find(list.begin(), list.end(), resource) != list.end();
+}
+
+int main() {
+	const unsigned int GBUFFER_FBO = 1, SSAO_FBO = 2, SHADOW_FBO = 3, LIT_FBO = 4, DEBUG_FBO = 5, EDGE_FBO = 6, HISTORY_FBO = 7;
+	const unsigned int W = 1080, H = 720, SHADOW_SIZE = 2048;
+	ns::RenderGraph graph;
+	unsigned int gColor = ns::addGraphResource(&graph, "gColor", ns::GraphResourceType::COLOR, GBUFFER_FBO, 3);
+	unsigned int gDepth = ns::addGraphResource(&graph, "gDepth", ns::GraphResourceType::DEPTH, GBUFFER_FBO);
+	unsigned int shadowDepth = ns::addGraphResource(&graph, "shadowDepth", ns::GraphResourceType::DEPTH, SHADOW_FBO);
+	unsigned int ssao = ns::addGraphResource(&graph, "ssao", ns::GraphResourceType::COLOR, SSAO_FBO);
+	unsigned int edges = ns::addGraphResource(&graph, "edges", ns::GraphResourceType::COLOR, EDGE_FBO);
+	unsigned int lit = ns::addGraphResource(&graph, "lit", ns::GraphResourceType::COLOR, LIT_FBO);
+	unsigned int debug = ns::addGraphResource(&graph, "debug", ns::GraphResourceType::COLOR, DEBUG_FBO);
+	unsigned int history = ns::addGraphResource(&graph, "history", ns::GraphResourceType::COLOR, HISTORY_FBO);
+	unsigned int window = ns::addGraphResource(&graph, "window", ns::GraphResourceType::COLOR, 0);
+	ns::setGraphResourcePersistent(&graph, history);
+	ns::setGraphOutput(&graph, window);
+
+	unsigned int shadowPass = ns::addGraphPass(&graph, "shadows", SHADOW_FBO, SHADOW_SIZE, SHADOW_SIZE, nullptr);
+	ns::passWrites(&graph, shadowPass, shadowDepth);
+	unsigned int gBufferPass = ns::addGraphPass(&graph, "gBuffer", GBUFFER_FBO, W, H, nullptr);
+	ns::passWrites(&graph, gBufferPass, gColor);
+	ns::passWrites(&graph, gBufferPass, gDepth);
+	//Nothing reads debug, so this is culled
+	unsigned int debugPass = ns::addGraphPass(&graph, "debugView", DEBUG_FBO, W, H, nullptr);
+	ns::passReads(&graph, debugPass, gColor);
+	ns::passWrites(&graph, debugPass, debug);
+	//Diamond: gBuffer feeds ssao and edges, which both feed lighting
+	unsigned int ssaoPass = ns::addGraphPass(&graph, "ssao", SSAO_FBO, W / 2, H / 2, nullptr);
+	ns::passReads(&graph, ssaoPass, gDepth);
+	ns::passWrites(&graph, ssaoPass, ssao, ns::GraphWrite::OVERWRITE);
+	//Declared after ssao but on the gBuffer framebuffer, so it should move up next to the gBuffer pass
+	unsigned int decalPass = ns::addGraphPass(&graph, "decals", GBUFFER_FBO, W, H, nullptr);
+	ns::passWrites(&graph, decalPass, gColor, ns::GraphWrite::LOAD);
+	unsigned int edgePass = ns::addGraphPass(&graph, "edges", EDGE_FBO, W, H, nullptr);
+	ns::passReads(&graph, edgePass, gColor);
+	ns::passWrites(&graph, edgePass, edges);
+	unsigned int lightingPass = ns::addGraphPass(&graph, "lighting", LIT_FBO, W, H, nullptr);
+	ns::passReads(&graph, lightingPass, gColor);
+	ns::passReads(&graph, lightingPass, shadowDepth);
+	ns::passReads(&graph, lightingPass, ssao);
+	ns::passReads(&graph, lightingPass, edges);
+	ns::passReads(&graph, lightingPass, history);
+	ns::passWrites(&graph, lightingPass, lit, ns::GraphWrite::OVERWRITE);
+	unsigned int presentPass = ns::addGraphPass(&graph, "present", 0, W, H, nullptr);
+	ns::passReads(&graph, presentPass, lit);
+	ns::passWrites(&graph, presentPass, window, ns::GraphWrite::OVERWRITE);
+
+	ns::compileRenderGraph(&graph);
+
+	//Culling
+	check(graph.culledPasses.size() == 1 && graph.culledPasses[0] == debugPass, "only the unused debug pass is culled");
+	check(graph.schedule.size() == graph.passes.size() - 1, "every other pass is scheduled");
+
+	//Order: dependencies first, then the decals pulled up to share the gBuffer bind
+	check(schedulePosition(graph, gBufferPass) < schedulePosition(graph, ssaoPass), "gBuffer before ssao");
+	check(schedulePosition(graph, gBufferPass) < schedulePosition(graph, edgePass), "gBuffer before edges");
+	check(schedulePosition(graph, decalPass) < schedulePosition(graph, edgePass), "decals before edges, which read them");
+	check(schedulePosition(graph, ssaoPass) < schedulePosition(graph, lightingPass), "ssao before lighting");
+	check(schedulePosition(graph, edgePass) < schedulePosition(graph, lightingPass), "edges before lighting");
+	check(schedulePosition(graph, shadowPass) < schedulePosition(graph, lightingPass), "shadows before lighting");
+	check(schedulePosition(graph, lightingPass) < schedulePosition(graph, presentPass), "lighting before present");
+	check(schedulePosition(graph, decalPass) == schedulePosition(graph, gBufferPass) + 1, "decals right after the gBuffer pass");
+	check(!scheduled(graph, decalPass).bindFramebuffer, "decals reuse the gBuffer bind");
+	check(graph.numFramebufferBinds == 6, "one bind per framebuffer change");
+
+	//Clears follow the write ops
+	check(scheduled(graph, shadowPass).clearDepth && !scheduled(graph, shadowPass).clearColor, "shadows clear depth only");
+	check(scheduled(graph, gBufferPass).clearDepth && scheduled(graph, gBufferPass).clearColor, "gBuffer clears color and depth");
+	check(!scheduled(graph, decalPass).clearColor && !scheduled(graph, decalPass).clearDepth, "decals load instead of clearing");
+	check(!scheduled(graph, ssaoPass).clearColor, "ssao overwrites instead of clearing");
+	check(scheduled(graph, edgePass).clearColor, "edges clear color");
+	check(!scheduled(graph, presentPass).clearColor, "present overwrites instead of clearing");
+
+	//Transient attachments are discarded after their last use, persistent ones and outputs never are
+	check(discards(graph, ssaoPass, gDepth), "gDepth discarded after ssao");
+	check(discards(graph, lightingPass, gColor), "gColor discarded after lighting");
+	check(discards(graph, lightingPass, shadowDepth), "shadowDepth discarded after lighting");
+	check(discards(graph, lightingPass, ssao), "ssao discarded after lighting");
+	check(discards(graph, lightingPass, edges), "edges discarded after lighting");
+	check(discards(graph, presentPass, lit), "lit discarded after present");
+	unsigned int numDiscards = 0;
+	for (size_t s = 0; s < graph.schedule.size(); s++)
+	{
+		const std::vector<unsigned int>& list = graph.schedule[s].discards;
+		numDiscards += (unsigned int)list.size();
+		check(std::find(list.begin(), list.end(), history) == list.end(), "history is never discarded");
+		check(std::find(list.begin(), list.end(), window) == list.end(), "window is never discarded");
+		check(std::find(list.begin(), list.end(), debug) == list.end(), "debug is never discarded");
+	}
+	check(numDiscards == 6, "each transient attachment is discarded once");
+
+	//Compiling again gives the same schedule
+	std::vector<unsigned int> order;
+	for (size_t s = 0; s < graph.schedule.size(); s++)
+	{
+		order.push_back(graph.schedule[s].pass);
+	}
+	ns::compileRenderGraph(&graph);
+	bool sameOrder = graph.schedule.size() == order.size();
+	for (size_t s = 0; s < graph.schedule.size() && sameOrder; s++)
+	{
+		sameOrder = graph.schedule[s].pass == order[s];
+	}
+	check(sameOrder, "recompiling gives the same order");
+
+	if (numFailures > 0) {
+		printf("%d render graph checks failed\n", numFailures);
+		return 1;
+	}
+	printf("Render graph checks passed\n");
+	return 0;
+}